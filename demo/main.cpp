@@ -1,5 +1,7 @@
 #include <GP.h>
 
+#include <sstream>
+
 #include "DemoSample.h"
 #include "sponza/Sponza.h"
 #include "nature/Nature.h"
@@ -59,18 +61,47 @@ private:
 	unsigned int m_CurrentSample = 0;
 };
 
-int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE /*hPrevInstance*/, LPSTR /*lpCmdLine*/, int /*nShowCmd*/)
+// -benchmark [-sample N] [-frames N] [-warmup N] [-path file] [-report file] [-stub] [-hidden]
+bool ParseBenchmarkSettings(const std::string& commandLine, GP::BenchmarkSettings& settings, unsigned int& sample)
+{
+	bool benchmark = false;
+	std::stringstream stream(commandLine);
+	std::string argument;
+	while (stream >> argument)
+	{
+		if (argument == "-benchmark") benchmark = true;
+		else if (argument == "-sample") stream >> sample;
+		else if (argument == "-frames") stream >> settings.NumFrames;
+		else if (argument == "-warmup") stream >> settings.WarmupFrames;
+		else if (argument == "-path") stream >> settings.CameraPath;
+		else if (argument == "-report") stream >> settings.ReportPath;
+		else if (argument == "-stub") settings.StubDraws = true;
+		else if (argument == "-hidden") settings.HiddenWindow = true;
+	}
+	return benchmark;
+}
+
+int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE /*hPrevInstance*/, LPSTR lpCmdLine, int /*nShowCmd*/)
 {
 	GP::Init(hInstance, 1024, 768, "Demo");
 
 	g_Camera = new GP::Camera();
 	g_Camera->SetPosition({ 0.0,100.0,0.0 });
 
-	g_Controller = new MainController(*g_Camera);
+	GP::BenchmarkSettings benchmarkSettings;
+	unsigned int sample = 0;
+	if (ParseBenchmarkSettings(lpCmdLine, benchmarkSettings, sample))
+	{
+		GP::SetController(new GP::BenchmarkController(*g_Camera, benchmarkSettings));
+	}
+	else
+	{
+		g_Controller = new MainController(*g_Camera);
+		GP::ShowCursor(false);
+		GP::SetController((GP::Controller*)g_Controller);
+	}
 
-	GP::ShowCursor(false);
-	GP::SetController((GP::Controller*)g_Controller);
-	SetSample(0);
+	SetSample(sample % NUM_SAMPLES);
 	GP::Run();
 	
 	GP::Deinit();
@@ -27,8 +27,6 @@ namespace NatureSample
 
 			g_SceneRenderer.DrawSkybox(context, g_Camera);
 		}
-
-		virtual void ReloadShaders() override {}
 	};
 
 	class TerrainPass : public GP::RenderPass
@@ -41,8 +39,6 @@ namespace NatureSample
 			GP_SCOPED_PROFILE("Terrain");
 			g_SceneRenderer.DrawTerrain(context, g_Camera);
 		}
-
-		virtual void ReloadShaders() override { }
 	};
 
 	class WaterPass : public GP::RenderPass
@@ -58,76 +54,90 @@ namespace NatureSample
 			m_PlaneModel.SetScale(10000.0f * VEC3_ONE);
 		}
 
-		virtual void Render(GP::GfxContext* context) override
+		virtual void Setup(GP::FrameGraph& frameGraph) override
 		{
+			// Disabled water adds no passes, the frame graph releases its render targets
 			if (!m_EnableWaterVariable.GetValue()) return;
 
-			GP_SCOPED_PROFILE("Water");
-
 			m_PlaneModel.SetPosition(Vec3(0.0f, m_WaterlevelVariable.GetValue(), 0.0f));
 
-			{
-				GP_SCOPED_PROFILE("Refraction texture");
-				GP_SCOPED_RT(context, &m_WaterRefraction, &m_WaterRefraction);
+			frameGraph.AddPass("Water refraction", [this](GP::FrameGraphBuilder& builder) {
+				m_WaterRefraction = builder.CreateRenderTarget("Water refraction", RT_CONFIG);
+				}, [this](GP::GfxContext* context, const GP::FrameGraph& graph) {
+					RenderRefraction(context, graph.GetRenderTarget(m_WaterRefraction));
+				});
+
+			frameGraph.AddPass("Water reflection", [this](GP::FrameGraphBuilder& builder) {
+				m_WaterReflection = builder.CreateRenderTarget("Water reflection", RT_CONFIG);
+				}, [this](GP::GfxContext* context, const GP::FrameGraph& graph) {
+					RenderReflection(context, graph.GetRenderTarget(m_WaterReflection));
+				});
+
+			frameGraph.AddPass("Water plane", [this](GP::FrameGraphBuilder& builder) {
+				builder.Read(m_WaterRefraction);
+				builder.Read(m_WaterReflection);
+				builder.SetSideEffect();
+				}, [this](GP::GfxContext* context, const GP::FrameGraph& graph) {
+					RenderWaterPlane(context, graph.GetTexture(m_WaterReflection), graph.GetTexture(m_WaterRefraction));
+				});
+		}
 
-				context->Clear();
+		// Rendered by the frame graph passes added in Setup
+		virtual void Render(GP::GfxContext* context) override {}
 
-				float clipHeight = m_WaterlevelVariable.GetValue() + WATER_HEIGHT_BIAS;
-				CBSceneParams params = {};
-				params.useClipping = true;
-				params.clipPlane = Vec4(0.0f, -1.0f, 0.0f, clipHeight);
+	private:
+		void RenderRefraction(GP::GfxContext* context, GP::GfxRenderTarget* renderTarget)
+		{
+			GP_SCOPED_RT(context, renderTarget, renderTarget);
 
-				g_SceneRenderer.DrawTerrain(context, g_Camera, params);
-			}
+			context->Clear();
 
-			{
-				GP_SCOPED_PROFILE("Reflection texture");
-				GP_SCOPED_RT(context, &m_WaterReflection, &m_WaterReflection);
+			float clipHeight = m_WaterlevelVariable.GetValue() + WATER_HEIGHT_BIAS;
+			CBSceneParams params = {};
+			params.useClipping = true;
+			params.clipPlane = Vec4(0.0f, -1.0f, 0.0f, clipHeight);
 
-				context->Clear();
+			g_SceneRenderer.DrawTerrain(context, g_Camera, params);
+		}
 
-				float clipHeight = m_WaterlevelVariable.GetValue() - WATER_HEIGHT_BIAS;
-				CBSceneParams params = {};
-				params.useClipping = true;
-				params.clipPlane = Vec4(0.0f, 1.0f, 0.0f, -clipHeight);
+		void RenderReflection(GP::GfxContext* context, GP::GfxRenderTarget* renderTarget)
+		{
+			GP_SCOPED_RT(context, renderTarget, renderTarget);
 
-				Vec3 cameraPos = g_Camera->GetPosition();
-				cameraPos.y -= 2.0f * (cameraPos.y - m_WaterlevelVariable.GetValue());
-				Vec3 cameraRot = g_Camera->GetRotation();
-				cameraRot.x = -cameraRot.x;
-				m_ReflectionCamera.SetPosition(cameraPos);
-				m_ReflectionCamera.SetRotation(cameraRot);
+			context->Clear();
 
-				g_SceneRenderer.DrawSkybox(context, &m_ReflectionCamera, params);
-				g_SceneRenderer.DrawTerrain(context, &m_ReflectionCamera, params);
-			}
+			float clipHeight = m_WaterlevelVariable.GetValue() - WATER_HEIGHT_BIAS;
+			CBSceneParams params = {};
+			params.useClipping = true;
+			params.clipPlane = Vec4(0.0f, 1.0f, 0.0f, -clipHeight);
 
-			{
-				GP_SCOPED_PROFILE("Water plane");
-
-				context->BindShader(&m_WaterShader);
-				context->BindVertexBuffer(GP::GfxDefaults::VB_QUAD);
-				context->BindConstantBuffer(GP::VS, g_Camera->GetBuffer(context), 0);
-				context->BindConstantBuffer(GP::VS, m_PlaneModel.GetBuffer(context), 1);
-				context->BindConstantBuffer(GP::PS, GP::GetGlobalsBuffer(), 2);
-				context->BindTexture2D(GP::PS, &m_WaterReflectionTexture, 0);
-				context->BindTexture2D(GP::PS, &m_WaterRefractionTexture, 1);
-				context->BindTexture2D(GP::PS, &m_DuDvMap, 2);
-				context->Draw(GP::GfxDefaults::VB_QUAD->GetNumVerts());
-
-				context->UnbindTexture(GP::PS, 0);
-				context->UnbindTexture(GP::PS, 1);
-			}
+			Vec3 cameraPos = g_Camera->GetPosition();
+			cameraPos.y -= 2.0f * (cameraPos.y - m_WaterlevelVariable.GetValue());
+			Vec3 cameraRot = g_Camera->GetRotation();
+			cameraRot.x = -cameraRot.x;
+			m_ReflectionCamera.SetPosition(cameraPos);
+			m_ReflectionCamera.SetRotation(cameraRot);
 
+			g_SceneRenderer.DrawSkybox(context, &m_ReflectionCamera, params);
+			g_SceneRenderer.DrawTerrain(context, &m_ReflectionCamera, params);
 		}
 
-		virtual void ReloadShaders() override
+		void RenderWaterPlane(GP::GfxContext* context, GP::GfxTexture2D* reflectionTexture, GP::GfxTexture2D* refractionTexture)
 		{
-			m_WaterShader.Reload();
+			context->BindShader(&m_WaterShader);
+			context->BindVertexBuffer(GP::GfxDefaults::VB_QUAD);
+			context->BindConstantBuffer(GP::VS, g_Camera->GetBuffer(context), 0);
+			context->BindConstantBuffer(GP::VS, m_PlaneModel.GetBuffer(context), 1);
+			context->BindConstantBuffer(GP::PS, GP::GetGlobalsBuffer(), 2);
+			context->BindTexture2D(GP::PS, reflectionTexture, 0);
+			context->BindTexture2D(GP::PS, refractionTexture, 1);
+			context->BindTexture2D(GP::PS, &m_DuDvMap, 2);
+			context->Draw(GP::GfxDefaults::VB_QUAD->GetNumVerts());
+
+			context->UnbindTexture(GP::PS, 0);
+			context->UnbindTexture(GP::PS, 1);
 		}
 
-	private:
-
 		static constexpr unsigned int RT_WIDTH = (unsigned int)(WATER_REF_RESOLUTION * (1024.0f / 768.0f)); // (1024.0f / 768.0f) == ASPECT_RATIO
 		static constexpr unsigned int RT_HEIGHT = (unsigned int)WATER_REF_RESOLUTION;
 		static constexpr GP::RenderTargetConfig RT_CONFIG =
@@ -148,11 +158,8 @@ namespace NatureSample
 
 		GP::GfxTexture2D m_DuDvMap{ "demo/nature/resources/WaterDuDv.png" };
 
-		GP::GfxRenderTarget m_WaterReflection{ RT_CONFIG };
-		GP::GfxRenderTarget m_WaterRefraction{ RT_CONFIG };
-
-		GP::GfxTexture2D m_WaterReflectionTexture{ m_WaterReflection.GetResource(0) };
-		GP::GfxTexture2D m_WaterRefractionTexture{ m_WaterRefraction.GetResource(0) };
+		GP::FrameGraphResource m_WaterReflection = 0;
+		GP::FrameGraphResource m_WaterRefraction = 0;
 
 		GP::Camera m_ReflectionCamera;
 	};
@@ -12,13 +12,6 @@ namespace NatureSample
 		delete m_TerrainIB;
 	}
 
-	void SceneRenderer::ReloadShaders()
-	{
-		m_SkyboxShader.Reload();
-		m_TerrainShader.Reload();
-		// TODO: Regenerate terrain with new shader
-	}
-
 	void SceneRenderer::DrawTerrain(GP::GfxContext* context, GP::Camera* camera, CBSceneParams params)
 	{
 		GP_SCOPED_PROFILE("SceneRenderer::DrawTerrain");
@@ -22,7 +22,6 @@ namespace NatureSample
 	public:
 
 		void Init(GP::GfxContext* context);
-		void ReloadShaders();
 		void DestroyResources();
 
 		void DrawTerrain(GP::GfxContext* context, GP::Camera* camera, CBSceneParams params = CBSceneParams());
@@ -77,11 +76,6 @@ namespace NatureSample
 
 		}
 
-		inline virtual void ReloadShaders() override
-		{
-			m_SceneRenderer->ReloadShaders();
-		}
-
 	private:
 		SceneRenderer* m_SceneRenderer;
 	};
@@ -55,11 +55,6 @@ namespace SponzaSample
 				});
 		}
 
-		virtual void ReloadShaders() override
-		{
-			m_CelShader.Reload();
-		}
-
 	private:
 		GP::Scene m_Scene;
 		GP::GfxShader m_CelShader{ "demo/sponza/shaders/cel_shading.hlsl" };
@@ -71,10 +71,4 @@ static_assert(sizeof(ColorUNORM) == 4);
 X(X const&) = delete; \
 X& operator=(X const&) = delete;
 
-#ifdef _GP
-#define GP_DLL __declspec(dllexport)
-#else
-#define GP_DLL __declspec(dllimport)
-#endif // _GP
-
 #include "debug/Logger.h"
\ No newline at end of file
@@ -1,4 +1,10 @@
 #pragma once
 
 #define SCENE_SUPPORT
-//#define CONTEXT_DEBUG
\ No newline at end of file
+//#define CONTEXT_DEBUG
+
+#ifdef _GP
+#define GP_DLL __declspec(dllexport)
+#else
+#define GP_DLL __declspec(dllimport)
+#endif // _GP
@@ -5,6 +5,8 @@
 #include "core/Renderer.h"
 #include "core/GlobalVariables.h"
 #include "gui/GUI.h"
+#include "gfx/GfxShaderArchive.h"
+#include "debug/MemoryTracker.h"
 
 #include "defaults/DefaultController.h"
 
@@ -41,6 +43,7 @@ namespace GP
 	{
 		SAFE_DELETE(g_Engine);
 		Window::Destroy();
+		MemoryTracker::ReportLeaks();
 	}
 
 	void SetController(Controller* controller)
@@ -73,6 +76,11 @@ namespace GP
 		g_Engine->GetRenderer()->ReloadShaders();
 	}
 
+	void CookShaders()
+	{
+		ShaderRegistry::CookArchive(ShaderArchive::DEFAULT_PATH);
+	}
+
 	GfxConstantBuffer<CBEngineGlobals>* GetGlobalsBuffer()
 	{
 		return g_Engine->GetRenderer()->GetGlobalsBuffer();
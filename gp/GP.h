@@ -8,17 +8,20 @@
 #include "gfx/GfxBuffers.h"
 #include "gfx/GfxTexture.h"
 #include "gfx/GfxShader.h"
+#include "gfx/GfxParameterBlock.h"
 #include "gfx/ScopedOperations.h"
 
 #include "core/Controller.h"
 #include "core/RenderPass.h"
 
 #include "defaults/DefaultController.h"
+#include "defaults/BenchmarkController.h"
 #include "defaults/DefaultSceneRenderPass.h"
 #include "defaults/DefaultSkyboxRenderPass.h"
 #include "defaults/UtilRenderPasses.h"
 
 #include "debug/Logger.h"
+#include "debug/Profiler.h"
 #include "debug/RuntimeVariable.h"
 
 // SCENE_SUPPORT
@@ -43,5 +46,6 @@ namespace GP
 	GP_DLL void ShowCursor(bool show);
 	GP_DLL void Shutdown();
 	GP_DLL void ReloadShaders();
+	GP_DLL void CookShaders();
 	GP_DLL GfxConstantBuffer<CBEngineGlobals>* GetGlobalsBuffer();
 }
\ No newline at end of file
@@ -7,7 +7,13 @@
 #include "core/Renderer.h"
 #include "core/Controller.h"
 #include "core/Loading.h"
+#include "core/GlobalVariables.h"
 #include "gfx/GfxDevice.h"
+#include "gfx/GfxShader.h"
+#include "gfx/GfxShaderCache.h"
+#include "gfx/GfxShaderArchive.h"
+#include "gfx/GfxTextureStreaming.h"
+#include "debug/Profiler.h"
 
 namespace GP
 {
@@ -16,16 +22,24 @@ namespace GP
 
 	GameEngine::GameEngine()
 	{
+		ThreadUtil::SetThreadName("Main");
 		m_Renderer = new Renderer();
 		m_Controller = new Controller();
 		g_LoadingThread = new LoadingThread();
+
+#ifndef DEBUG
+		// Development builds always compile from source so hot reload keeps working
+		if (!ShaderArchive::Open(ShaderArchive::DEFAULT_PATH)) CONSOLE_LOG("[ShaderArchive] No shader archive found, compiling shaders from source");
+#endif
 	}
 
 	GameEngine::~GameEngine()
 	{
+		ShaderRegistry::Shutdown();
 		delete g_LoadingThread;
 		delete m_Renderer;
 		delete m_Controller;
+		ShaderArchive::Close();
 	}
 
 	void GameEngine::UpdateDT()
@@ -34,6 +48,9 @@ namespace GP
 		auto t_now = std::chrono::high_resolution_clock::now();
 		m_DT = std::chrono::duration<float, std::milli>(t_now - t_before).count();
 		t_before = t_now;
+
+		const float fixedDT = GlobalVariables::GP_CONFIG.FixedDT;
+		if (fixedDT > 0.0f) m_DT = fixedDT;
 	}
 
 	void GameEngine::Run()
@@ -44,6 +61,9 @@ namespace GP
 		GameLoop();
 		m_FirstFrame = false;
 
+		// Shaders are compiled on first use, so the first frame covers startup compilation
+		ShaderCache::LogStats();
+
 		while (wnd->IsRunning())
 		{
 			WindowInput::InputFrameBegin();
@@ -55,15 +75,19 @@ namespace GP
 	void GameEngine::Reset()
 	{
 		if (g_LoadingThread) g_LoadingThread->ResetAndWait();
+		TextureStreaming::Reset();
 		m_Renderer->Reset();
 	}
 
 	void GameEngine::GameLoop()
 	{
 		UpdateDT();
-		Window::Get()->Update(m_DT);
-		m_Controller->UpdateInput(m_DT);
-		m_Renderer->Update(m_DT);
+		{
+			GP_SCOPED_CPU_PROFILE("Update");
+			Window::Get()->Update(m_DT);
+			m_Controller->UpdateInput(m_DT);
+			m_Renderer->Update(m_DT);
+		}
 		m_Renderer->RenderIfShould();
 		Logger::Get()->DispatchLogs();
 	}
@@ -9,6 +9,8 @@ namespace GP
 		bool WindowSizeDirty = false;
 		unsigned int FPS = 60;
 		bool VSYNC = false;
+		float FixedDT = 0.0f;		// Miliseconds, when set every update advances by it and renders a frame
+		bool StubDraws = false;		// Draws and dispatches are recorded and counted but not issued to the GPU
 	};
 
 	namespace GlobalVariables
@@ -1,9 +1,12 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
 
 #include "core/Threads.h"
 #include "gfx/GfxDevice.h"
+#include "debug/Profiler.h"
+#include "debug/LoadingTelemetry.h"
 
 namespace GP
 {
@@ -17,8 +20,12 @@ namespace GP
         inline bool IsRunning() const { return m_Running; }
         inline void SetRunning(bool running) { m_Running = running; }
 
+        inline void SetSubmitTime(std::chrono::high_resolution_clock::time_point time) { m_SubmitTime = time; }
+        inline std::chrono::high_resolution_clock::time_point GetSubmitTime() const { return m_SubmitTime; }
+
     private:
         bool m_Running = false;
+        std::chrono::high_resolution_clock::time_point m_SubmitTime;
     };
 
     class PoisonPillTask : public LoadingTask
@@ -48,11 +55,18 @@ namespace GP
 
         void Submit(LoadingTask* task)
         {
+            m_NumPending++;
+            task->SetSubmitTime(std::chrono::high_resolution_clock::now());
+            LoadingTelemetry::TaskSubmitted();
             m_TaskQueue.Push(task);
         }
 
+        // No task is queued or running
+        inline bool IsIdle() const { return m_NumPending == 0; }
+
         void Run()
         {
+            ThreadUtil::SetThreadName("Loading");
             m_Running = true;
             GfxContext* context = new GfxContext();
             while (m_Running)
@@ -60,12 +74,20 @@ namespace GP
                 m_CurrentTask = m_TaskQueue.Pop();
                 if (m_CurrentTask.load() == PoisonPillTask::Get()) break;
                 m_CurrentTask.load()->SetRunning(true);
-                m_CurrentTask.load()->Run(context);
-                context->Submit();
+
+                const auto taskBegin = std::chrono::high_resolution_clock::now();
+                LoadingTelemetry::TaskStarted(std::chrono::duration<float, std::milli>(taskBegin - m_CurrentTask.load()->GetSubmitTime()).count());
+                {
+                    GP_SCOPED_CPU_PROFILE("LoadingTask");
+                    m_CurrentTask.load()->Run(context);
+                    context->Submit();
+                }
                 m_CurrentTask.load()->SetRunning(false);
+                LoadingTelemetry::TaskFinished(std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - taskBegin).count());
 
                 LoadingTask* lastTask = m_CurrentTask.exchange(nullptr);
                 delete lastTask;
+                m_NumPending--;
             }
             delete context;
         }
@@ -82,6 +104,8 @@ namespace GP
             delete m_ThreadHandle;
             m_Running = true;
             m_TaskQueue.Clear();
+            m_NumPending = 0;
+            LoadingTelemetry::QueueCleared();
             m_ThreadHandle = new std::thread(&LoadingThread::Run, this);
         }
 
@@ -98,6 +122,7 @@ namespace GP
         BlockingQueue<LoadingTask*> m_TaskQueue;
         std::thread* m_ThreadHandle = nullptr;
         std::atomic<LoadingTask*> m_CurrentTask = nullptr;
+        std::atomic<unsigned int> m_NumPending = 0;
         bool m_Running = false;
     };
 
@@ -2,6 +2,7 @@
 
 #include "Common.h"
 #include "gfx/ScopedOperations.h"
+#include "gfx/GfxFrameGraph.h"
 
 namespace GP
 {
@@ -14,9 +15,19 @@ namespace GP
 
 		virtual void Init(GfxContext* context) = 0;
 		virtual void Render(GfxContext* context) = 0;
-		virtual void ReloadShaders() {};
+
+		// Adds the pass to the frame graph every frame, by default as one graph pass that calls Render and is never culled
+		// Override to add passes that declare their render targets, see FrameGraph
+		virtual void Setup(FrameGraph& frameGraph) { frameGraph.AddRenderPass(this); }
 		virtual void OnWindowResized(GfxContext* context, unsigned int newWidth, unsigned int newHeight) {}
 
+		// Render is then called on a worker thread with its own deferred context, starting with the default render target and no bound resources
+		// Pass must not upload to resources that other passes upload to in the same frame, shared buffers are uploaded in PrepareParallel
+		virtual bool CanRecordInParallel() const { return false; }
+
+		// Called on the immediate context right before the pass is recorded in parallel, like for lazily updated camera buffers
+		virtual void PrepareParallel(GfxContext* context) {}
+
 		inline void SetInitialized(bool value) { m_Initialized = value; }
 		inline bool IsInitialized() const { return m_Initialized; }
 
@@ -8,6 +8,14 @@
 #include "gui/GUI.h"
 #include "gfx/GfxDevice.h"
 #include "gfx/GfxBuffers.h"
+#include "gfx/GfxShader.h"
+#include "gfx/GfxTextureStreaming.h"
+#include "gfx/GfxFrameGraph.h"
+#include "gfx/GfxRenderTargetPool.h"
+#include "gfx/GfxGPUProfiler.h"
+#include "debug/Profiler.h"
+#include "debug/FrameCounters.h"
+#include "debug/FrameTimes.h"
 #include "util/Timer.h"
 
 namespace GP
@@ -18,6 +26,9 @@ namespace GP
         g_Device->Init();
         ASSERT(g_Device->IsInitialized(), "[Renderer] Device not initialized!");
         g_GUI->InitializeDefaultScene();
+        g_GPUProfiler = new GPUProfiler(CreateD3D11TimestampBackend());
+        g_RenderTargetPool = new RenderTargetPool();
+        g_FrameGraph = new FrameGraph();
 
         m_GlobalsBuffer = new GfxConstantBuffer<CBEngineGlobals>();
     }
@@ -30,6 +41,10 @@ namespace GP
         }
         m_RenderPasses.clear();
         m_Schedule.clear();
+
+        SAFE_DELETE(g_FrameGraph);
+        SAFE_DELETE(g_RenderTargetPool);
+        SAFE_DELETE(g_GPUProfiler);
         
         delete m_GlobalsBuffer;
         delete g_Device;
@@ -57,6 +72,7 @@ namespace GP
         if (gpConfig.WindowSizeDirty)
         {
             g_Device->RecreateSwapchain();
+            g_RenderTargetPool->OnWindowResized(gpConfig.WindowWidth, gpConfig.WindowHeight);
             // TODO: GUI needs some recreation
             for (RenderPass* renderPass : m_RenderPasses)
                 renderPass->OnWindowResized(g_Device->GetImmediateContext(), gpConfig.WindowWidth, gpConfig.WindowHeight);
@@ -67,7 +83,7 @@ namespace GP
         // Update last render time
         static float timeUntilLastRender = 0.0f;
         timeUntilLastRender += dt / 1000.0f;
-        if (timeUntilLastRender > 1.0f / GlobalVariables::GP_CONFIG.FPS)
+        if (gpConfig.FixedDT > 0.0f || timeUntilLastRender > 1.0f / GlobalVariables::GP_CONFIG.FPS)
         {
             m_ShouldRender = true;
             timeUntilLastRender = 0;
@@ -98,35 +114,56 @@ namespace GP
 
     void Renderer::RenderFrame()
     {
+        // Scopes of the previous frame are collected before this frame opens its own, hitches of the previous frame are logged with them
+        Profiler::EndFrame();
+        FrameTimes::BeginFrame();
+        GP_SCOPED_CPU_PROFILE("Frame");
+        g_GPUProfiler->BeginFrame();
+
         static Timer fpsTimer;
         fpsTimer.Start();
 
         GfxContext* context = g_Device->GetImmediateContext();
         context->Clear();
 
+        TextureStreaming::Update();
+        ShaderRegistry::Update();
+
+        bool passesInitialized = false;
         for (RenderPass* renderPass : m_RenderPasses)
         {
             if (!renderPass->IsInitialized())
             {
                 renderPass->Init(context);
                 renderPass->SetInitialized(true);
+                passesInitialized = true;
             }
         }
 
-        for (RenderPass* renderPass : m_Schedule) renderPass->Render(context);
+        // Shaders created in Init start compiling in the background, render only waits for the ones it binds
+        if (passesInitialized) ShaderRegistry::CompileAll();
+
+        // Graph is declared again every frame, passes that are disabled don't add themselves and their render targets get released
+        g_FrameGraph->Reset();
+        for (RenderPass* renderPass : m_Schedule) renderPass->Setup(*g_FrameGraph);
+        g_FrameGraph->Compile();
+        g_FrameGraph->Execute(context);
+        g_RenderTargetPool->EndFrame();
 
         g_GUI->Render();
+        g_GPUProfiler->EndFrame();
+        FrameTimes::BeginPresent();
         g_Device->EndFrame();
+        FrameTimes::EndPresent();
 
         fpsTimer.Stop();
         GlobalVariables::CURRENT_FPS = (int) (1000.0f / fpsTimer.GetTimeMS());
+        FrameCounters::EndFrame(fpsTimer.GetTimeMS());
     }
 
     void Renderer::ReloadShaders()
     {
-        for (RenderPass* renderPass : m_RenderPasses)
-        {
-            renderPass->ReloadShaders();
-        }
+        // Only shaders whose files changed get recompiled, they are swapped in on one of the next frames
+        ShaderRegistry::ReloadChanged();
     }
 }
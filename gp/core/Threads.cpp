@@ -0,0 +1,148 @@
+#include "Threads.h"
+
+#include <unordered_map>
+#include <condition_variable>
+
+namespace GP
+{
+	namespace ThreadUtil
+	{
+		namespace
+		{
+			std::mutex s_NamesMutex;
+			std::unordered_map<ThreadID, std::string> s_Names;
+
+			struct NameRemover
+			{
+				bool Registered = false;
+
+				~NameRemover()
+				{
+					if (!Registered) return;
+					std::lock_guard<std::mutex> lock(s_NamesMutex);
+					s_Names.erase(CURRENT_THREAD);
+				}
+			};
+
+			thread_local NameRemover t_NameRemover;
+
+			// Lives on the stack of the ParallelFor call, workers only touch it while they are counted in NumWorkers
+			struct ParallelJob
+			{
+				const std::function<void(unsigned int)>* Func = nullptr;
+				unsigned int Count = 0;
+				std::atomic<unsigned int> NextIndex = 0;
+				unsigned int NumWorkers = 0;
+			};
+
+			inline void RunJob(ParallelJob& job)
+			{
+				for (unsigned int i = job.NextIndex++; i < job.Count; i = job.NextIndex++) (*job.Func)(i);
+			}
+
+			// Caller of ParallelFor works on its own job too, so a job always finishes even if every worker is busy with another one
+			class WorkerPool
+			{
+			public:
+				WorkerPool()
+				{
+					const unsigned int numWorkers = (std::max)(1u, std::thread::hardware_concurrency()) - 1;
+					for (unsigned int i = 0; i < numWorkers; i++) m_Threads.emplace_back(&WorkerPool::WorkerLoop, this);
+				}
+
+				void Run(ParallelJob& job)
+				{
+					{
+						std::lock_guard<std::mutex> lock(m_Mutex);
+						m_Jobs.push_back(&job);
+					}
+					m_WorkCondition.notify_all();
+
+					RunJob(job);
+
+					// Every index is taken, wait for the workers that are still running one
+					std::unique_lock<std::mutex> lock(m_Mutex);
+					RemoveJob(&job);
+					m_DoneCondition.wait(lock, [&job]() { return job.NumWorkers == 0; });
+				}
+
+			private:
+				void WorkerLoop()
+				{
+					SetThreadName("Worker");
+
+					std::unique_lock<std::mutex> lock(m_Mutex);
+					while (true)
+					{
+						m_WorkCondition.wait(lock, [this]() { return !m_Jobs.empty(); });
+						ParallelJob* job = m_Jobs.front();
+						job->NumWorkers++;
+
+						lock.unlock();
+						RunJob(*job);
+						lock.lock();
+
+						RemoveJob(job);
+						job->NumWorkers--;
+						if (job->NumWorkers == 0) m_DoneCondition.notify_all();
+					}
+				}
+
+				// Must be called with the mutex locked
+				void RemoveJob(ParallelJob* job)
+				{
+					m_Jobs.erase(std::remove(m_Jobs.begin(), m_Jobs.end(), job), m_Jobs.end());
+				}
+
+			private:
+				std::mutex m_Mutex;
+				std::condition_variable m_WorkCondition;
+				std::condition_variable m_DoneCondition;
+				std::vector<ParallelJob*> m_Jobs;
+				std::vector<std::thread> m_Threads;
+			};
+
+			// Never deleted, workers are still waiting for jobs when static destructors run
+			WorkerPool& GetWorkerPool()
+			{
+				static WorkerPool* pool = new WorkerPool();
+				return *pool;
+			}
+		}
+
+		void SetThreadName(const std::string& name)
+		{
+			std::lock_guard<std::mutex> lock(s_NamesMutex);
+			s_Names[CURRENT_THREAD] = name;
+			t_NameRemover.Registered = true;
+		}
+
+		void ParallelFor(unsigned int count, const std::function<void(unsigned int)>& func)
+		{
+			if (count == 0) return;
+			if (count == 1)
+			{
+				func(0);
+				return;
+			}
+
+			ParallelJob job;
+			job.Func = &func;
+			job.Count = count;
+			GetWorkerPool().Run(job);
+		}
+
+		std::string GetThreadName(ThreadID threadID)
+		{
+			{
+				std::lock_guard<std::mutex> lock(s_NamesMutex);
+				const auto it = s_Names.find(threadID);
+				if (it != s_Names.end()) return it->second;
+			}
+
+			std::stringstream ss;
+			ss << threadID;
+			return ss.str();
+		}
+	}
+}
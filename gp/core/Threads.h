@@ -2,9 +2,14 @@
 
 #include <thread>
 #include <mutex>
+#include <atomic>
+#include <algorithm>
 #include <vector>
 #include <queue>
 #include <sstream>
+#include <functional>
+
+#include "Config.h"
 
 #define CURRENT_THREAD std::this_thread::get_id()
 
@@ -15,12 +20,14 @@ namespace GP
 	namespace ThreadUtil
 	{
 		inline bool IsThread(ThreadID id) { return id == CURRENT_THREAD; }
-		static std::string GetThreadName(ThreadID threadID) // TODO: More descriptive names
-		{
-			std::stringstream ss;
-			ss << threadID;
-			return ss.str();
-		}
+
+		// Name is forgotten when the thread exits, threads without a name are shown by their id
+		GP_DLL void SetThreadName(const std::string& name);
+		GP_DLL std::string GetThreadName(ThreadID threadID);
+
+		// Calls func(index) for every index in [0, count) on the calling thread and the worker threads, returns when all calls are done.
+		// Workers are started on first use and live until the process exits, calls from several threads and nested calls share them.
+		GP_DLL void ParallelFor(unsigned int count, const std::function<void(unsigned int)>& func);
 	}
 
 	template<typename T>
@@ -59,6 +66,20 @@ namespace GP
 			return ret;
 		}
 
+		// Takes the last element, returns false if there are none
+		inline bool TryPop(T& element)
+		{
+			Lock();
+			bool ret = !m_Data.empty();
+			if (ret)
+			{
+				element = m_Data.back();
+				m_Data.pop_back();
+			}
+			Unlock();
+			return ret;
+		}
+
 		template<typename F>
 		void ForEach(F& f)
 		{
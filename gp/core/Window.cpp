@@ -213,4 +213,9 @@ namespace GP
         ::ShowCursor(show);
         m_ShowCursor = show;
     }
+
+    void Window::SetVisible(bool visible)
+    {
+        ::ShowWindow(m_Handle, visible ? SW_SHOW : SW_HIDE);
+    }
 }
\ No newline at end of file
@@ -32,6 +32,7 @@ namespace GP
 		inline bool IsCursorShown() const { return  m_ShowCursor; }
 
 		void ShowCursor(bool show);
+		void SetVisible(bool visible);
 
 	private:
 		Window(HINSTANCE instance, const std::string& title);
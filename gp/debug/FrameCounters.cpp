@@ -0,0 +1,204 @@
+#include "FrameCounters.h"
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <fstream>
+
+namespace GP
+{
+	namespace FrameCounters
+	{
+		namespace
+		{
+			static constexpr unsigned int NUM_COUNTERS = (unsigned int) FrameCounter::Count;
+			static constexpr float AVG_WEIGHT = 0.1f; // Weight of the newest frame in the moving average
+
+			static const char* COUNTER_NAMES[NUM_COUNTERS] =
+			{
+				"Draws",
+				"Dispatches",
+				"Shader binds",
+				"Device state binds",
+				"Constant buffer binds",
+				"Resource binds",
+				"RW resource binds",
+				"Sampler binds",
+				"Input assembler binds",
+				"Render target binds",
+				"Buffer maps",
+				"Texture uploads"
+			};
+
+			// Values only grow, the main thread remembers how much of them it already folded
+			struct alignas(64) CounterBlock
+			{
+				std::atomic<unsigned int> Values[NUM_COUNTERS] = {};
+				unsigned int Folded[NUM_COUNTERS] = {}; // Main thread only
+
+				// Blocks of finished threads are given to the next new thread, a block never has two writers
+				std::atomic<bool> Owned = false;
+			};
+
+			// Gives the block back when the thread exits
+			struct BlockOwner
+			{
+				CounterBlock* Block = nullptr;
+
+				~BlockOwner()
+				{
+					if (Block) Block->Owned.store(false, std::memory_order_release);
+				}
+			};
+
+			struct CSVRecording
+			{
+				bool Active = false;
+				unsigned int FramesLeft = 0;
+				std::string Path;
+				std::vector<float> FrameTimes;
+				std::vector<unsigned int> Values; // NUM_COUNTERS per frame
+			};
+
+			std::mutex s_BlocksMutex;
+			std::vector<CounterBlock*> s_Blocks;
+			thread_local CounterBlock* t_Block = nullptr; // Trivially destructible, accessing it doesn't go through the thread local init check
+			thread_local BlockOwner t_BlockOwner;
+
+			// Main thread only
+			unsigned int s_LastFrame[NUM_COUNTERS] = {};
+			float s_Average[NUM_COUNTERS] = {};
+			bool s_HasAverage = false;
+			CSVRecording s_CSV;
+
+			CounterBlock* AcquireBlock()
+			{
+				CounterBlock* block = nullptr;
+				{
+					std::lock_guard<std::mutex> lock(s_BlocksMutex);
+					for (CounterBlock* freeBlock : s_Blocks)
+					{
+						bool owned = false;
+						if (freeBlock->Owned.load(std::memory_order_relaxed) || !freeBlock->Owned.compare_exchange_strong(owned, true, std::memory_order_acquire)) continue;
+						block = freeBlock;
+						break;
+					}
+
+					if (!block)
+					{
+						block = new CounterBlock();
+						block->Owned = true;
+						s_Blocks.push_back(block);
+					}
+				}
+
+				t_Block = block;
+				t_BlockOwner.Block = block;
+				return block;
+			}
+
+			void WriteCSV()
+			{
+				std::ofstream stream(s_CSV.Path, std::ios::out | std::ios::trunc);
+				if (!stream.is_open())
+				{
+					CONSOLE_LOG("[FrameCounters] Failed to write " + s_CSV.Path);
+					return;
+				}
+
+				stream << "Frame,Frame time (ms)";
+				for (const char* name : COUNTER_NAMES) stream << "," << name;
+				stream << "\n";
+
+				const unsigned int numFrames = (unsigned int) s_CSV.FrameTimes.size();
+				for (unsigned int frame = 0; frame < numFrames; frame++)
+				{
+					stream << frame << "," << s_CSV.FrameTimes[frame];
+					for (unsigned int i = 0; i < NUM_COUNTERS; i++) stream << "," << s_CSV.Values[frame * NUM_COUNTERS + i];
+					stream << "\n";
+				}
+
+				CONSOLE_LOG("[FrameCounters] Counters of " + std::to_string(numFrames) + " frames written to " + s_CSV.Path);
+			}
+		}
+
+		void Increment(FrameCounter counter, unsigned int value)
+		{
+			CounterBlock* block = t_Block;
+			if (!block) block = AcquireBlock();
+
+			// Only this thread writes the value, the main thread just reads it
+			std::atomic<unsigned int>& counterValue = block->Values[(unsigned int) counter];
+			counterValue.store(counterValue.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+		}
+
+		void EndFrame(float frameTimeMS)
+		{
+			unsigned int totals[NUM_COUNTERS] = {};
+			{
+				std::lock_guard<std::mutex> lock(s_BlocksMutex);
+				for (CounterBlock* block : s_Blocks)
+				{
+					for (unsigned int i = 0; i < NUM_COUNTERS; i++)
+					{
+						const unsigned int value = block->Values[i].load(std::memory_order_relaxed);
+						totals[i] += value - block->Folded[i];
+						block->Folded[i] = value;
+					}
+				}
+			}
+
+			for (unsigned int i = 0; i < NUM_COUNTERS; i++)
+			{
+				s_LastFrame[i] = totals[i];
+				s_Average[i] = s_HasAverage ? s_Average[i] + (totals[i] - s_Average[i]) * AVG_WEIGHT : (float) totals[i];
+			}
+			s_HasAverage = true;
+
+			if (s_CSV.Active)
+			{
+				s_CSV.FrameTimes.push_back(frameTimeMS);
+				s_CSV.Values.insert(s_CSV.Values.end(), totals, totals + NUM_COUNTERS);
+				if (--s_CSV.FramesLeft == 0)
+				{
+					WriteCSV();
+					s_CSV = {};
+				}
+			}
+		}
+
+		const char* GetName(FrameCounter counter)
+		{
+			return COUNTER_NAMES[(unsigned int) counter];
+		}
+
+		unsigned int GetLastFrame(FrameCounter counter)
+		{
+			return s_LastFrame[(unsigned int) counter];
+		}
+
+		float GetAverage(FrameCounter counter)
+		{
+			return s_Average[(unsigned int) counter];
+		}
+
+		void RecordCSV(unsigned int numFrames, const std::string& path)
+		{
+			if (s_CSV.Active)
+			{
+				CONSOLE_LOG("[FrameCounters] CSV recording already running, " + std::to_string(s_CSV.FramesLeft) + " frames left");
+				return;
+			}
+
+			s_CSV.Active = numFrames > 0;
+			s_CSV.FramesLeft = numFrames;
+			s_CSV.Path = path;
+			CONSOLE_LOG("[FrameCounters] Recording counters of the next " + std::to_string(numFrames) + " frames");
+		}
+
+		bool IsRecordingCSV()
+		{
+			return s_CSV.Active;
+		}
+	}
+}
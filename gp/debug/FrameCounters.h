@@ -0,0 +1,47 @@
+#pragma once
+
+#include <string>
+
+#include "Common.h"
+
+namespace GP
+{
+	enum class FrameCounter : unsigned int
+	{
+		Draws,
+		Dispatches,
+		ShaderBinds,
+		DeviceStateBinds,
+		ConstantBufferBinds,
+		ResourceBinds,
+		RWResourceBinds,
+		SamplerBinds,
+		InputAssemblerBinds,
+		RenderTargetBinds,
+		BufferMaps,
+		TextureUploads,
+		Count
+	};
+
+	// Every thread counts into its own block that only it writes, so incrementing is a plain add without any locked instruction.
+	// Once per frame the main thread folds the difference since the last fold of every block into the frame totals.
+	// Work recorded on other threads is counted in the frame that is being rendered when it gets folded.
+	namespace FrameCounters
+	{
+		static const std::string DEFAULT_CSV_PATH = "frame_counters.csv";
+		static constexpr unsigned int DEFAULT_CSV_FRAMES = 300;
+
+		GP_DLL void Increment(FrameCounter counter, unsigned int value = 1);
+
+		// Folds the counters of all threads into the totals of the frame that just ended, called once per frame on the main thread
+		void EndFrame(float frameTimeMS);
+
+		GP_DLL const char* GetName(FrameCounter counter);
+		GP_DLL unsigned int GetLastFrame(FrameCounter counter);
+		GP_DLL float GetAverage(FrameCounter counter);
+
+		// Totals of the next frames are written to a CSV file, one row per frame, called on the main thread
+		GP_DLL void RecordCSV(unsigned int numFrames = DEFAULT_CSV_FRAMES, const std::string& path = DEFAULT_CSV_PATH);
+		GP_DLL bool IsRecordingCSV();
+	}
+}
@@ -0,0 +1,213 @@
+#include "FrameTimes.h"
+
+#include <chrono>
+#include <algorithm>
+
+#include "debug/Profiler.h"
+
+namespace GP
+{
+	void FrameTimeHistogram::Add(float timeMS)
+	{
+		m_Buckets[GetBucket(timeMS)]++;
+		m_Count++;
+		m_MaxMS = MAX(m_MaxMS, timeMS);
+	}
+
+	void FrameTimeHistogram::Reset()
+	{
+		*this = {};
+	}
+
+	float FrameTimeHistogram::GetPercentile(float percentile) const
+	{
+		if (m_Count == 0) return 0.0f;
+
+		const unsigned int rank = MAX((unsigned int) (m_Count * percentile / 100.0f + 0.999f), 1u);
+		unsigned int numBelow = 0;
+		for (unsigned int bucket = 0; bucket < NUM_BUCKETS; bucket++)
+		{
+			numBelow += m_Buckets[bucket];
+			if (numBelow >= rank) return MIN(GetBucketUpperMS(bucket), m_MaxMS);
+		}
+		return m_MaxMS;
+	}
+
+	float FrameTimeHistogram::GetBucketUpperMS(unsigned int bucket)
+	{
+		const unsigned int shift = bucket < SUB_BUCKETS * 2 ? 0 : bucket / SUB_BUCKETS - 1;
+		const unsigned long long mantissa = bucket - shift * SUB_BUCKETS;
+		return ((mantissa + 1) << shift) / 1000.0f;
+	}
+
+	unsigned int FrameTimeHistogram::GetBucket(float timeMS)
+	{
+		const unsigned long long timeUS = timeMS > 0.0f ? (unsigned long long) (timeMS * 1000.0f) : 0;
+
+		unsigned int shift = 0;
+		while ((timeUS >> shift) >= SUB_BUCKETS * 2) shift++;
+		const unsigned long long bucket = shift * SUB_BUCKETS + (timeUS >> shift);
+		return (unsigned int) MIN(bucket, (unsigned long long) NUM_BUCKETS - 1);
+	}
+
+	namespace FrameTimes
+	{
+		namespace
+		{
+			using Clock = std::chrono::high_resolution_clock;
+
+			// Main thread only
+			FrameTimeSample s_History[HISTORY_SIZE];
+			unsigned int s_HistoryOffset = 0;
+			FrameTimeHistogram s_FrameHistogram;
+			FrameTimeHistogram s_CPUHistogram;
+			FrameTimeHistogram s_PresentHistogram;
+			std::vector<FrameHitch> s_Hitches;
+			float s_HitchThresholdMS = DEFAULT_HITCH_THRESHOLD_MS;
+
+			unsigned long long s_FrameIndex = 0;
+			bool s_FrameStarted = false;
+			Clock::time_point s_FrameBegin;
+			Clock::time_point s_PresentBegin;
+			FrameTimeSample s_Current;
+
+			inline float ElapsedMS(Clock::time_point begin, Clock::time_point end)
+			{
+				return std::chrono::duration<float, std::milli>(end - begin).count();
+			}
+
+			// Scopes of all threads, not only of the main one, a hitch can come from waiting on another thread
+			std::string GetDominantScopes()
+			{
+				const std::vector<ProfileNode>& nodes = Profiler::GetNodes();
+
+				std::vector<std::pair<unsigned int, const char*>> scopes; // Node and its thread
+				std::vector<unsigned int> stack;
+				for (unsigned int root : Profiler::GetRoots())
+				{
+					stack.assign(nodes[root].Children.begin(), nodes[root].Children.end());
+					while (!stack.empty())
+					{
+						const unsigned int node = stack.back();
+						stack.pop_back();
+						if (nodes[node].Calls == 0) continue;
+
+						scopes.push_back({ node, nodes[root].Name });
+						stack.insert(stack.end(), nodes[node].Children.begin(), nodes[node].Children.end());
+					}
+				}
+
+				const unsigned int numScopes = MIN((unsigned int) scopes.size(), HITCH_SCOPES);
+				std::partial_sort(scopes.begin(), scopes.begin() + numScopes, scopes.end(), [&nodes](const auto& a, const auto& b) { return nodes[a.first].ExclusiveMS > nodes[b.first].ExclusiveMS; });
+
+				std::string dominantScopes;
+				for (unsigned int i = 0; i < numScopes; i++)
+				{
+					const ProfileNode& node = nodes[scopes[i].first];
+					dominantScopes += (i ? ", " : "") + std::string(node.Name) + " (" + scopes[i].second + ") " + std::to_string(node.ExclusiveMS) + " ms";
+				}
+				return dominantScopes.empty() ? "no scopes recorded" : dominantScopes;
+			}
+
+			void AddSample(const FrameTimeSample& sample)
+			{
+				s_History[s_HistoryOffset] = sample;
+				s_HistoryOffset = (s_HistoryOffset + 1) % HISTORY_SIZE;
+
+				s_FrameHistogram.Add(sample.FrameMS);
+				s_CPUHistogram.Add(sample.CPUMS);
+				s_PresentHistogram.Add(sample.PresentMS);
+
+				if (sample.FrameMS <= s_HitchThresholdMS) return;
+
+				FrameHitch hitch;
+				hitch.Frame = s_FrameIndex;
+				hitch.FrameMS = sample.FrameMS;
+				hitch.Scopes = GetDominantScopes();
+				CONSOLE_LOG("[FrameTimes] Hitch in frame " + std::to_string(hitch.Frame) + ": " + std::to_string(hitch.FrameMS) + " ms (CPU " + std::to_string(sample.CPUMS) + " ms, present " + std::to_string(sample.PresentMS) + " ms), " + hitch.Scopes);
+
+				if (s_Hitches.size() == MAX_HITCHES) s_Hitches.erase(s_Hitches.begin());
+				s_Hitches.push_back(std::move(hitch));
+			}
+		}
+
+		void BeginFrame()
+		{
+			const Clock::time_point now = Clock::now();
+			if (s_FrameStarted)
+			{
+				s_Current.FrameMS = ElapsedMS(s_FrameBegin, now);
+				AddSample(s_Current);
+			}
+
+			s_FrameIndex++;
+			s_FrameStarted = true;
+			s_FrameBegin = now;
+			s_PresentBegin = now;
+			s_Current = {};
+		}
+
+		void BeginPresent()
+		{
+			s_PresentBegin = Clock::now();
+			s_Current.CPUMS = ElapsedMS(s_FrameBegin, s_PresentBegin);
+		}
+
+		void EndPresent()
+		{
+			s_Current.PresentMS = ElapsedMS(s_PresentBegin, Clock::now());
+		}
+
+		const FrameTimeSample* GetHistory()
+		{
+			return s_History;
+		}
+
+		unsigned int GetHistoryOffset()
+		{
+			return s_HistoryOffset;
+		}
+
+		const FrameTimeSample& GetLastSample()
+		{
+			return s_History[(s_HistoryOffset + HISTORY_SIZE - 1) % HISTORY_SIZE];
+		}
+
+		const FrameTimeHistogram& GetFrameHistogram()
+		{
+			return s_FrameHistogram;
+		}
+
+		const FrameTimeHistogram& GetCPUHistogram()
+		{
+			return s_CPUHistogram;
+		}
+
+		const FrameTimeHistogram& GetPresentHistogram()
+		{
+			return s_PresentHistogram;
+		}
+
+		void ResetHistograms()
+		{
+			s_FrameHistogram.Reset();
+			s_CPUHistogram.Reset();
+			s_PresentHistogram.Reset();
+		}
+
+		void SetHitchThreshold(float thresholdMS)
+		{
+			s_HitchThresholdMS = thresholdMS;
+		}
+
+		float GetHitchThreshold()
+		{
+			return s_HitchThresholdMS;
+		}
+
+		const std::vector<FrameHitch>& GetHitches()
+		{
+			return s_Hitches;
+		}
+	}
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "Common.h"
+
+namespace GP
+{
+	// Buckets are exact up to 32us, after that every power of two is split into SUB_BUCKETS buckets.
+	// A percentile read from it is off by at most 1/SUB_BUCKETS of its value, no matter how long the session is.
+	class FrameTimeHistogram
+	{
+	public:
+		static constexpr unsigned int SUB_BUCKETS = 16;
+		static constexpr unsigned int NUM_BUCKETS = 368; // Up to 67 seconds
+
+		void Add(float timeMS);
+		void Reset();
+
+		// Upper bound of the bucket the percentile falls in, percentile goes from 0 to 100
+		GP_DLL float GetPercentile(float percentile) const;
+
+		inline float GetMaxMS() const { return m_MaxMS; }
+		inline unsigned int GetCount() const { return m_Count; }
+		inline unsigned int GetBucketCount(unsigned int bucket) const { return m_Buckets[bucket]; }
+		GP_DLL static float GetBucketUpperMS(unsigned int bucket);
+		GP_DLL static unsigned int GetBucket(float timeMS);
+
+	private:
+		unsigned int m_Buckets[NUM_BUCKETS] = {};
+		unsigned int m_Count = 0;
+		float m_MaxMS = 0.0f;
+	};
+
+	struct FrameTimeSample
+	{
+		float FrameMS = 0.0f;	// From the start of this frame to the start of the next one
+		float CPUMS = 0.0f;		// Recording the frame, until present
+		float PresentMS = 0.0f;	// Submitting the command lists and presenting
+	};
+
+	struct FrameHitch
+	{
+		unsigned long long Frame = 0;
+		float FrameMS = 0.0f;
+		std::string Scopes; // The ones with the most exclusive time
+	};
+
+	namespace FrameTimes
+	{
+		static constexpr unsigned int HISTORY_SIZE = 512; // frames
+		static constexpr unsigned int MAX_HITCHES = 32;
+		static constexpr unsigned int HITCH_SCOPES = 3;
+		static constexpr float DEFAULT_HITCH_THRESHOLD_MS = 50.0f;
+
+		// Main thread, a frame is finished when the next one begins, so the scopes of the profiler are already collected for it
+		void BeginFrame();
+		void BeginPresent();
+		void EndPresent();
+
+		// History is a ring, the oldest sample is at the history offset
+		GP_DLL const FrameTimeSample* GetHistory();
+		GP_DLL unsigned int GetHistoryOffset();
+		GP_DLL const FrameTimeSample& GetLastSample();
+
+		// Since startup or the last reset
+		GP_DLL const FrameTimeHistogram& GetFrameHistogram();
+		GP_DLL const FrameTimeHistogram& GetCPUHistogram();
+		GP_DLL const FrameTimeHistogram& GetPresentHistogram();
+		GP_DLL void ResetHistograms();
+
+		// Frames longer than the threshold are logged with the scopes that took most of their time
+		GP_DLL void SetHitchThreshold(float thresholdMS);
+		GP_DLL float GetHitchThreshold();
+		GP_DLL const std::vector<FrameHitch>& GetHitches(); // Newest last
+	}
+}
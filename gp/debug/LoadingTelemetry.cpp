@@ -0,0 +1,177 @@
+#include "LoadingTelemetry.h"
+
+#include <mutex>
+
+namespace GP
+{
+	namespace LoadingTelemetry
+	{
+		namespace
+		{
+			using Clock = std::chrono::high_resolution_clock;
+
+			static const char* STAGE_NAMES[(unsigned int) LoadingStage::Count] =
+			{
+				"Queued",
+				"Read",
+				"Decode",
+				"Upload",
+				"Publish",
+				"Task"
+			};
+
+			struct TelemetryState
+			{
+				std::mutex Mutex;
+				LoadingStats Stats;
+				Clock::time_point BurstBegin;
+			};
+
+			TelemetryState& GetState()
+			{
+				static TelemetryState state;
+				return state;
+			}
+
+			inline float ToMB(size_t numBytes)
+			{
+				return numBytes / (1024.0f * 1024.0f);
+			}
+
+			// Must be called with state mutex locked
+			void RecordStageLocked(LoadingStats& stats, LoadingStage stage, float timeMS)
+			{
+				LoadingStageStats& stageStats = stats.Stages[(unsigned int) stage];
+				stageStats.Count++;
+				stageStats.TotalMS += timeMS;
+				stageStats.MaxMS = MAX(stageStats.MaxMS, timeMS);
+				stageStats.LastMS = timeMS;
+			}
+
+			// Must be called with state mutex locked
+			void EndBurst(TelemetryState& state)
+			{
+				LoadingStats& stats = state.Stats;
+				if (!stats.Busy) return;
+
+				stats.CurrentBurst.TimeMS = std::chrono::duration<float, std::milli>(Clock::now() - state.BurstBegin).count();
+				stats.LastBurst = stats.CurrentBurst;
+				stats.CurrentBurst = {};
+				stats.Busy = false;
+				stats.NumBursts++;
+
+				// Texture streaming drains the queue all the time, only log loads that brought new objects
+				const LoadingBurst& burst = stats.LastBurst;
+				if (burst.ObjectsPublished == 0) return;
+				CONSOLE_LOG("[Loading] Loaded " + std::to_string(burst.ObjectsPublished) + " objects in " + std::to_string(burst.TimeMS) + " ms (" + std::to_string(burst.NumTasks) + " tasks), read " +
+					std::to_string(ToMB(burst.BytesRead)) + " MB, decoded " + std::to_string(ToMB(burst.BytesDecoded)) + " MB");
+			}
+		}
+
+		void TaskSubmitted()
+		{
+			TelemetryState& state = GetState();
+			std::lock_guard<std::mutex> lock(state.Mutex);
+
+			LoadingStats& stats = state.Stats;
+			if (!stats.Busy)
+			{
+				stats.Busy = true;
+				state.BurstBegin = Clock::now();
+			}
+
+			stats.TasksSubmitted++;
+			stats.CurrentBurst.NumTasks++;
+			stats.QueueDepth++;
+			stats.MaxQueueDepth = MAX(stats.MaxQueueDepth, stats.QueueDepth);
+		}
+
+		void TaskStarted(float queuedMS)
+		{
+			TelemetryState& state = GetState();
+			std::lock_guard<std::mutex> lock(state.Mutex);
+			RecordStageLocked(state.Stats, LoadingStage::Queued, queuedMS);
+		}
+
+		void TaskFinished(float runMS)
+		{
+			TelemetryState& state = GetState();
+			std::lock_guard<std::mutex> lock(state.Mutex);
+
+			LoadingStats& stats = state.Stats;
+			RecordStageLocked(stats, LoadingStage::Task, runMS);
+			stats.TasksCompleted++;
+			if (stats.QueueDepth > 0) stats.QueueDepth--;
+			if (stats.QueueDepth == 0) EndBurst(state);
+		}
+
+		void QueueCleared()
+		{
+			TelemetryState& state = GetState();
+			std::lock_guard<std::mutex> lock(state.Mutex);
+			state.Stats.QueueDepth = 0;
+			EndBurst(state);
+		}
+
+		void RecordStage(LoadingStage stage, float timeMS)
+		{
+			TelemetryState& state = GetState();
+			std::lock_guard<std::mutex> lock(state.Mutex);
+			RecordStageLocked(state.Stats, stage, timeMS);
+		}
+
+		void AddBytesRead(size_t numBytes)
+		{
+			TelemetryState& state = GetState();
+			std::lock_guard<std::mutex> lock(state.Mutex);
+			state.Stats.BytesRead += numBytes;
+			state.Stats.CurrentBurst.BytesRead += numBytes;
+		}
+
+		void AddBytesDecoded(size_t numBytes)
+		{
+			TelemetryState& state = GetState();
+			std::lock_guard<std::mutex> lock(state.Mutex);
+			state.Stats.BytesDecoded += numBytes;
+			state.Stats.CurrentBurst.BytesDecoded += numBytes;
+		}
+
+		void AddObjectsPublished(unsigned int numObjects)
+		{
+			TelemetryState& state = GetState();
+			std::lock_guard<std::mutex> lock(state.Mutex);
+			state.Stats.ObjectsPublished += numObjects;
+			state.Stats.CurrentBurst.ObjectsPublished += numObjects;
+		}
+
+		LoadingStats GetStats()
+		{
+			TelemetryState& state = GetState();
+			std::lock_guard<std::mutex> lock(state.Mutex);
+
+			LoadingStats stats = state.Stats;
+			if (stats.Busy) stats.CurrentBurst.TimeMS = std::chrono::duration<float, std::milli>(Clock::now() - state.BurstBegin).count();
+			return stats;
+		}
+
+		void Reset()
+		{
+			TelemetryState& state = GetState();
+			std::lock_guard<std::mutex> lock(state.Mutex);
+
+			// Tasks in flight still have to finish, keep the queue and the burst they belong to
+			LoadingStats& stats = state.Stats;
+			LoadingStats resetStats;
+			resetStats.QueueDepth = stats.QueueDepth;
+			resetStats.MaxQueueDepth = stats.QueueDepth;
+			resetStats.Busy = stats.Busy;
+			resetStats.CurrentBurst = stats.CurrentBurst;
+			stats = resetStats;
+		}
+
+		const char* GetStageName(LoadingStage stage)
+		{
+			return STAGE_NAMES[(unsigned int) stage];
+		}
+	}
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <chrono>
+
+#include "Common.h"
+
+namespace GP
+{
+	enum class LoadingStage : unsigned int
+	{
+		Queued,		// Waiting in the loading thread queue
+		Read,		// Reading files and cache entries
+		Decode,		// Image decoding, mip generation, compression and mesh data copies
+		Upload,		// Creating GPU resources
+		Publish,	// Handing loaded objects to the scene
+		Task,		// Whole loading task
+		Count
+	};
+
+	struct LoadingStageStats
+	{
+		unsigned int Count = 0;
+		float TotalMS = 0.0f;
+		float MaxMS = 0.0f;
+		float LastMS = 0.0f;
+	};
+
+	// Work done from the moment a task is submitted to an empty queue until the queue drains again
+	struct LoadingBurst
+	{
+		float TimeMS = 0.0f;
+		unsigned int NumTasks = 0;
+		size_t BytesRead = 0;
+		size_t BytesDecoded = 0;
+		unsigned int ObjectsPublished = 0;
+	};
+
+	struct LoadingStats
+	{
+		LoadingStageStats Stages[(unsigned int) LoadingStage::Count];
+		size_t BytesRead = 0;
+		size_t BytesDecoded = 0;
+		unsigned int ObjectsPublished = 0;
+		unsigned int TasksSubmitted = 0;
+		unsigned int TasksCompleted = 0;
+		unsigned int QueueDepth = 0; // Queued and running tasks
+		unsigned int MaxQueueDepth = 0;
+
+		bool Busy = false;
+		unsigned int NumBursts = 0; // Finished ones
+		LoadingBurst CurrentBurst; // Valid while busy
+		LoadingBurst LastBurst;
+	};
+
+	// Load pipeline telemetry, can be recorded from any thread. Stages are timed where they run, so with the
+	// main thread importing textures too they include work outside of loading tasks.
+	namespace LoadingTelemetry
+	{
+		// Called by the loading thread
+		void TaskSubmitted();
+		void TaskStarted(float queuedMS);
+		void TaskFinished(float runMS);
+		void QueueCleared();
+
+		GP_DLL void RecordStage(LoadingStage stage, float timeMS);
+		GP_DLL void AddBytesRead(size_t numBytes);
+		GP_DLL void AddBytesDecoded(size_t numBytes);
+		GP_DLL void AddObjectsPublished(unsigned int numObjects);
+
+		GP_DLL LoadingStats GetStats();
+		GP_DLL void Reset();
+
+		GP_DLL const char* GetStageName(LoadingStage stage);
+	}
+
+	class ScopedLoadingStage
+	{
+		DELETE_COPY_CONSTRUCTOR(ScopedLoadingStage);
+	public:
+		ScopedLoadingStage(LoadingStage stage):
+			m_Stage(stage),
+			m_Begin(std::chrono::high_resolution_clock::now()) {}
+
+		~ScopedLoadingStage()
+		{
+			LoadingTelemetry::RecordStage(m_Stage, std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - m_Begin).count());
+		}
+
+	private:
+		LoadingStage m_Stage;
+		std::chrono::high_resolution_clock::time_point m_Begin;
+	};
+}
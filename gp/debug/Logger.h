@@ -29,7 +29,7 @@ namespace GP
 
 		inline void ConsoleLog(const std::string& msg)
 		{
-			m_PendingConsoleLogs.push_back(msg);
+			m_PendingConsoleLogs.Add(msg);
 		}
 
 		inline void PopupLog(const std::string& msg)
@@ -41,7 +41,7 @@ namespace GP
 		GP_DLL void DispatchLogs();
 
 	private:
-		std::vector<std::string> m_PendingConsoleLogs;
+		MutexVector<std::string> m_PendingConsoleLogs;
 		MutexVector<std::string> m_PendingFileLogs;
 		MutexVector<std::string> m_PendingPopupLogs;
 	};
@@ -0,0 +1,168 @@
+#include "MemoryTracker.h"
+
+#include <mutex>
+#include <unordered_map>
+#include <algorithm>
+
+namespace GP
+{
+	namespace MemoryTracker
+	{
+		namespace
+		{
+			static constexpr unsigned int NUM_CATEGORIES = (unsigned int) MemoryCategory::Count;
+
+			static const char* CATEGORY_NAMES[NUM_CATEGORIES] =
+			{
+				"Scene meshes",
+				"Scene textures",
+				"Render targets",
+				"Constant buffers",
+				"Buffers",
+				"Textures",
+				"Scene loading",
+				"Texture loading"
+			};
+
+			struct Allocation
+			{
+				MemoryCategory Category;
+				size_t NumBytes;
+				std::string Name;
+			};
+
+			struct TrackerState
+			{
+				std::mutex Mutex;
+				std::unordered_map<const void*, Allocation> Allocations;
+				MemoryStats Stats;
+			};
+
+			// Allocations can be released by static destructors after the tracker would be gone
+			TrackerState& GetState()
+			{
+				static TrackerState* state = new TrackerState();
+				return *state;
+			}
+
+			inline std::string ToMB(size_t numBytes)
+			{
+				return std::to_string(numBytes / (1024.0f * 1024.0f)) + " MB";
+			}
+
+			// Must be called with state mutex locked
+			void Remove(MemoryStats& stats, const Allocation& allocation)
+			{
+				MemoryCategoryStats& categoryStats = stats.Categories[(unsigned int) allocation.Category];
+				categoryStats.NumBytes -= allocation.NumBytes;
+				categoryStats.NumAllocations--;
+				(IsGPU(allocation.Category) ? stats.GPUBytes : stats.CPUBytes) -= allocation.NumBytes;
+			}
+
+			// Must be called with state mutex locked
+			void Add(MemoryStats& stats, const Allocation& allocation)
+			{
+				MemoryCategoryStats& categoryStats = stats.Categories[(unsigned int) allocation.Category];
+				categoryStats.NumBytes += allocation.NumBytes;
+				categoryStats.NumAllocations++;
+				categoryStats.PeakBytes = MAX(categoryStats.PeakBytes, categoryStats.NumBytes);
+
+				if (IsGPU(allocation.Category))
+				{
+					stats.GPUBytes += allocation.NumBytes;
+					stats.GPUPeakBytes = MAX(stats.GPUPeakBytes, stats.GPUBytes);
+				}
+				else
+				{
+					stats.CPUBytes += allocation.NumBytes;
+					stats.CPUPeakBytes = MAX(stats.CPUPeakBytes, stats.CPUBytes);
+				}
+			}
+		}
+
+		void Track(const void* owner, MemoryCategory category, size_t numBytes, const std::string& name)
+		{
+			ASSERT(category < MemoryCategory::Count, "[MemoryTracker] Invalid memory category!");
+
+			TrackerState& state = GetState();
+			std::lock_guard<std::mutex> lock(state.Mutex);
+
+			const auto it = state.Allocations.find(owner);
+			if (it != state.Allocations.end()) Remove(state.Stats, it->second);
+
+			Allocation& allocation = state.Allocations[owner];
+			allocation = { category, numBytes, name };
+			Add(state.Stats, allocation);
+		}
+
+		void Untrack(const void* owner)
+		{
+			TrackerState& state = GetState();
+			std::lock_guard<std::mutex> lock(state.Mutex);
+
+			const auto it = state.Allocations.find(owner);
+			if (it == state.Allocations.end()) return;
+
+			Remove(state.Stats, it->second);
+			state.Allocations.erase(it);
+		}
+
+		MemoryStats GetStats()
+		{
+			TrackerState& state = GetState();
+			std::lock_guard<std::mutex> lock(state.Mutex);
+			return state.Stats;
+		}
+
+		void ResetPeaks()
+		{
+			TrackerState& state = GetState();
+			std::lock_guard<std::mutex> lock(state.Mutex);
+
+			MemoryStats& stats = state.Stats;
+			for (MemoryCategoryStats& categoryStats : stats.Categories) categoryStats.PeakBytes = categoryStats.NumBytes;
+			stats.GPUPeakBytes = stats.GPUBytes;
+			stats.CPUPeakBytes = stats.CPUBytes;
+		}
+
+		const char* GetName(MemoryCategory category)
+		{
+			return CATEGORY_NAMES[(unsigned int) category];
+		}
+
+		void ReportLeaks()
+		{
+			TrackerState& state = GetState();
+			std::lock_guard<std::mutex> lock(state.Mutex);
+
+			const MemoryStats& stats = state.Stats;
+			CONSOLE_LOG("[MemoryTracker] Peak usage: GPU " + ToMB(stats.GPUPeakBytes) + ", CPU " + ToMB(stats.CPUPeakBytes));
+
+			if (state.Allocations.empty())
+			{
+				CONSOLE_LOG("[MemoryTracker] No leaks");
+				return;
+			}
+
+			for (unsigned int i = 0; i < NUM_CATEGORIES; i++)
+			{
+				const MemoryCategoryStats& categoryStats = stats.Categories[i];
+				if (categoryStats.NumAllocations == 0) continue;
+				CONSOLE_LOG("[MemoryTracker] Leaked " + std::to_string(categoryStats.NumAllocations) + " allocations of " + CATEGORY_NAMES[i] + ": " + ToMB(categoryStats.NumBytes));
+			}
+
+			// Largest first, those are the ones worth looking at
+			std::vector<const Allocation*> leaks;
+			for (const auto& it : state.Allocations) leaks.push_back(&it.second);
+			const unsigned int numReported = MIN((unsigned int) leaks.size(), MAX_REPORTED_LEAKS);
+			std::partial_sort(leaks.begin(), leaks.begin() + numReported, leaks.end(), [](const Allocation* a, const Allocation* b) { return a->NumBytes > b->NumBytes; });
+
+			for (unsigned int i = 0; i < numReported; i++)
+			{
+				const Allocation& leak = *leaks[i];
+				CONSOLE_LOG("[MemoryTracker]   " + std::string(CATEGORY_NAMES[(unsigned int) leak.Category]) + " " + std::to_string(leak.NumBytes) + " bytes" + (leak.Name.empty() ? "" : ": " + leak.Name));
+			}
+			if (leaks.size() > numReported) CONSOLE_LOG("[MemoryTracker]   ... and " + std::to_string(leaks.size() - numReported) + " more");
+		}
+	}
+}
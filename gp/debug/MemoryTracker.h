@@ -0,0 +1,83 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "Common.h"
+
+namespace GP
+{
+	enum class MemoryCategory : unsigned int
+	{
+		// GPU
+		SceneMesh,
+		SceneTexture,
+		RenderTarget,
+		ConstantBuffer,
+		Buffer,			// Untagged buffers
+		Texture,		// Untagged textures
+
+		// CPU
+		SceneLoading,
+		TextureLoading,
+
+		Count
+	};
+
+	struct MemoryCategoryStats
+	{
+		size_t NumBytes = 0;
+		size_t PeakBytes = 0;
+		unsigned int NumAllocations = 0;
+	};
+
+	struct MemoryStats
+	{
+		MemoryCategoryStats Categories[(unsigned int) MemoryCategory::Count];
+		size_t GPUBytes = 0;
+		size_t GPUPeakBytes = 0;
+		size_t CPUBytes = 0;
+		size_t CPUPeakBytes = 0;
+	};
+
+	// Estimated sizes of live allocations by the subsystem that owns them, GPU sizes ignore driver padding and alignment.
+	// Allocations are keyed by their owner, tracking an owner again replaces its previous size.
+	namespace MemoryTracker
+	{
+		static constexpr unsigned int MAX_REPORTED_LEAKS = 20;
+
+		GP_DLL void Track(const void* owner, MemoryCategory category, size_t numBytes, const std::string& name = "");
+		GP_DLL void Untrack(const void* owner);
+
+		GP_DLL MemoryStats GetStats();
+		GP_DLL void ResetPeaks();
+
+		GP_DLL const char* GetName(MemoryCategory category);
+		inline bool IsGPU(MemoryCategory category) { return category < MemoryCategory::SceneLoading; }
+
+		// Logs allocations that are still alive, called at shutdown once everything should be released
+		GP_DLL void ReportLeaks();
+	}
+
+	// Tracks a temporary CPU allocation of a loader until the end of the scope
+	class ScopedMemoryTracking
+	{
+		DELETE_COPY_CONSTRUCTOR(ScopedMemoryTracking);
+	public:
+		ScopedMemoryTracking(MemoryCategory category, const std::string& name = ""):
+			m_Category(category),
+			m_Name(name) {}
+
+		~ScopedMemoryTracking()
+		{
+			MemoryTracker::Untrack(this);
+		}
+
+		// Can be called again when the allocation grows or shrinks
+		inline void SetNumBytes(size_t numBytes) { MemoryTracker::Track(this, m_Category, numBytes, m_Name); }
+
+	private:
+		MemoryCategory m_Category;
+		std::string m_Name;
+	};
+}
@@ -0,0 +1,463 @@
+#include "Profiler.h"
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <fstream>
+#include <intrin.h>
+
+#include "core/Threads.h"
+#include "util/StringUtil.h"
+
+namespace GP
+{
+	namespace Profiler
+	{
+		namespace
+		{
+			static constexpr unsigned int MAX_DEPTH = 64;
+			static constexpr unsigned int EVENT_BUFFER_SIZE = 8192; // Power of two
+
+			// Scopes are timed with the time stamp counter, reading the high resolution clock costs more than the rest of a scope
+			using Clock = std::chrono::high_resolution_clock;
+
+			struct ProfileEvent
+			{
+				const char* Name;
+				long long Begin;
+				long long End;
+				unsigned int Depth;
+			};
+
+			// Single producer ring, the owning thread writes and the main thread reads.
+			// Indices are on separate cache lines, so draining doesn't make the writer miss on its own index.
+			struct EventBuffer
+			{
+				ProfileEvent Events[EVENT_BUFFER_SIZE];
+				alignas(64) std::atomic<unsigned int> WriteIndex = 0;
+				alignas(64) std::atomic<unsigned int> ReadIndex = 0;
+				std::atomic<unsigned int> NumDropped = 0;
+
+				// Buffers of finished threads are given to the next new thread once they are drained, a buffer never has two writers
+				std::atomic<bool> Owned = false;
+				unsigned int Index = 0;
+				const char* ThreadName = nullptr; // Of the thread that owns it now or owned it last
+			};
+
+			struct TraceEvent
+			{
+				const char* Name;
+				long long Begin;
+				long long End;
+				unsigned int Lane;
+			};
+
+			// Buffer index is used as the thread id of the trace, threads that reuse a buffer share a lane
+			struct TraceCapture
+			{
+				bool Active = false;
+				unsigned int FramesLeft = 0;
+				std::string Path;
+				std::vector<TraceEvent> Events;
+				std::vector<std::vector<const char*>> LaneNames;
+			};
+
+			struct OpenScope
+			{
+				const char* Name;
+				long long Begin;
+			};
+
+			// Trivially destructible, so accessing it doesn't go through the thread local init check
+			struct ThreadState
+			{
+				EventBuffer* Buffer = nullptr;
+				unsigned int ReadIndex = 0; // Last read index seen by the writer, the buffer is only checked again once it looks full
+				unsigned int Depth = 0;
+				OpenScope Stack[MAX_DEPTH];
+			};
+
+			// Gives the buffer back when the thread exits
+			struct BufferOwner
+			{
+				EventBuffer* Buffer = nullptr;
+
+				~BufferOwner()
+				{
+					if (Buffer) Buffer->Owned.store(false, std::memory_order_release);
+				}
+			};
+
+			std::mutex s_BuffersMutex;
+			std::vector<EventBuffer*> s_Buffers;
+			thread_local ThreadState t_State;
+			thread_local BufferOwner t_BufferOwner;
+
+			std::mutex s_NamesMutex;
+			std::unordered_set<std::string> s_Names;
+			thread_local std::unordered_map<std::string, const char*> t_NameCache;
+
+			// Main thread only
+			long long s_CalibrationTicks = 0;
+			Clock::time_point s_CalibrationTime;
+			double s_TicksToMS = 0.0;
+
+			std::vector<ProfileNode> s_Nodes;
+			std::vector<unsigned int> s_Roots;
+			std::unordered_map<const char*, unsigned int> s_RootOfThread;
+			TraceCapture s_Trace;
+			std::vector<ProfileEvent> s_FrameEvents;
+			std::vector<unsigned int> s_NodeStack;
+
+			inline long long Now()
+			{
+				return (long long) __rdtsc();
+			}
+
+			// Counter frequency is measured against the clock since the first frame, so it gets more precise the longer the app runs
+			void Calibrate()
+			{
+				const long long ticks = Now();
+				const Clock::time_point time = Clock::now();
+				if (s_CalibrationTicks == 0)
+				{
+					s_CalibrationTicks = ticks;
+					s_CalibrationTime = time;
+					return;
+				}
+
+				const double elapsedMS = std::chrono::duration<double, std::milli>(time - s_CalibrationTime).count();
+				if (ticks > s_CalibrationTicks) s_TicksToMS = elapsedMS / (ticks - s_CalibrationTicks);
+			}
+
+			// Events left by the previous owner must be drained first, otherwise they would be shown under the new thread
+			EventBuffer* FindOrCreateBuffer(const char* threadName)
+			{
+				std::lock_guard<std::mutex> lock(s_BuffersMutex);
+				for (EventBuffer* buffer : s_Buffers)
+				{
+					if (buffer->Owned.load(std::memory_order_relaxed) || buffer->ReadIndex.load(std::memory_order_relaxed) != buffer->WriteIndex.load(std::memory_order_relaxed)) continue;
+
+					bool owned = false;
+					if (!buffer->Owned.compare_exchange_strong(owned, true, std::memory_order_acquire)) continue;
+					buffer->ThreadName = threadName;
+					return buffer;
+				}
+
+				EventBuffer* buffer = new EventBuffer();
+				buffer->Owned = true;
+				buffer->Index = (unsigned int) s_Buffers.size();
+				buffer->ThreadName = threadName;
+				s_Buffers.push_back(buffer);
+				return buffer;
+			}
+
+			void AcquireBuffer(ThreadState& state)
+			{
+				EventBuffer* buffer = FindOrCreateBuffer(InternName(ThreadUtil::GetThreadName(CURRENT_THREAD)));
+				t_BufferOwner.Buffer = buffer;
+				state.Buffer = buffer;
+				state.ReadIndex = buffer->ReadIndex.load(std::memory_order_acquire);
+			}
+
+			// Drops events instead of waiting when the main thread didn't drain the buffer in time
+			inline void PushEvent(ThreadState& state, const ProfileEvent& profileEvent)
+			{
+				EventBuffer* buffer = state.Buffer;
+				const unsigned int writeIndex = buffer->WriteIndex.load(std::memory_order_relaxed);
+				if (writeIndex - state.ReadIndex >= EVENT_BUFFER_SIZE)
+				{
+					state.ReadIndex = buffer->ReadIndex.load(std::memory_order_acquire);
+					if (writeIndex - state.ReadIndex >= EVENT_BUFFER_SIZE)
+					{
+						buffer->NumDropped.fetch_add(1, std::memory_order_relaxed);
+						return;
+					}
+				}
+
+				buffer->Events[writeIndex & (EVENT_BUFFER_SIZE - 1)] = profileEvent;
+				buffer->WriteIndex.store(writeIndex + 1, std::memory_order_release);
+			}
+
+			unsigned int AddNode(const char* name, unsigned int parent)
+			{
+				const unsigned int index = (unsigned int) s_Nodes.size();
+				ProfileNode& node = s_Nodes.emplace_back();
+				node.Name = name;
+				node.Parent = parent;
+				return index;
+			}
+
+			unsigned int FindOrAddChild(unsigned int parent, const char* name)
+			{
+				for (unsigned int child : s_Nodes[parent].Children)
+				{
+					const char* childName = s_Nodes[child].Name;
+					if (childName == name || strcmp(childName, name) == 0) return child;
+				}
+
+				const unsigned int child = AddNode(name, parent);
+				s_Nodes[parent].Children.push_back(child);
+				return child;
+			}
+
+			// Threads with the same name share a root, so workers of every ParallelFor end up in one tree
+			unsigned int GetRoot(const char* threadName)
+			{
+				const auto it = s_RootOfThread.find(threadName);
+				if (it != s_RootOfThread.end()) return it->second;
+
+				const unsigned int root = AddNode(threadName, 0);
+				s_RootOfThread[threadName] = root;
+				s_Roots.push_back(root);
+				return root;
+			}
+
+			void AddTraceEvents(const EventBuffer* buffer)
+			{
+				if (buffer->Index >= s_Trace.LaneNames.size()) s_Trace.LaneNames.resize(buffer->Index + 1);
+				std::vector<const char*>& laneNames = s_Trace.LaneNames[buffer->Index];
+				if (std::find(laneNames.begin(), laneNames.end(), buffer->ThreadName) == laneNames.end()) laneNames.push_back(buffer->ThreadName);
+
+				for (const ProfileEvent& profileEvent : s_FrameEvents) s_Trace.Events.push_back({ profileEvent.Name, profileEvent.Begin, profileEvent.End, buffer->Index });
+			}
+
+			// Chrome trace event format, opens in chrome://tracing and in the Perfetto UI
+			void WriteTrace()
+			{
+				std::ofstream stream(s_Trace.Path, std::ios::out | std::ios::trunc);
+				if (!stream.is_open())
+				{
+					CONSOLE_LOG("[Profiler] Failed to write trace " + s_Trace.Path);
+					return;
+				}
+
+				long long startTicks = s_Trace.Events.empty() ? 0 : s_Trace.Events[0].Begin;
+				for (const TraceEvent& traceEvent : s_Trace.Events) startTicks = MIN(startTicks, traceEvent.Begin);
+				const double ticksToUS = s_TicksToMS * 1000.0;
+
+				stream << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+				bool first = true;
+				for (unsigned int lane = 0; lane < s_Trace.LaneNames.size(); lane++)
+				{
+					if (s_Trace.LaneNames[lane].empty()) continue;
+
+					std::string laneName;
+					for (const char* threadName : s_Trace.LaneNames[lane]) laneName += (laneName.empty() ? "" : " / ") + std::string(threadName);
+
+					stream << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << lane << ",\"args\":{\"name\":" << StringUtil::ToJSONString(laneName) << "}}";
+					first = false;
+				}
+
+				stream.setf(std::ios::fixed);
+				stream.precision(3);
+				for (const TraceEvent& traceEvent : s_Trace.Events)
+				{
+					stream << (first ? "" : ",\n") << "{\"name\":" << StringUtil::ToJSONString(traceEvent.Name) << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << traceEvent.Lane << ",\"ts\":" << (traceEvent.Begin - startTicks) * ticksToUS << ",\"dur\":" << (traceEvent.End - traceEvent.Begin) * ticksToUS << "}";
+					first = false;
+				}
+				stream << "\n]}\n";
+
+				CONSOLE_LOG("[Profiler] Trace with " + std::to_string(s_Trace.Events.size()) + " scopes written to " + s_Trace.Path);
+			}
+
+			// Events are pushed when scopes end, so children come before their parents until they are sorted by start
+			void AddEvents(unsigned int root)
+			{
+				std::sort(s_FrameEvents.begin(), s_FrameEvents.end(), [](const ProfileEvent& a, const ProfileEvent& b) {
+					return a.Begin != b.Begin ? a.Begin < b.Begin : a.Depth < b.Depth;
+					});
+
+				s_NodeStack.clear();
+				s_NodeStack.push_back(root);
+				for (const ProfileEvent& profileEvent : s_FrameEvents)
+				{
+					// Parent that is still open at the end of the frame comes in a later frame, its children go to the deepest known scope
+					const unsigned int parentDepth = MIN(profileEvent.Depth, (unsigned int) s_NodeStack.size() - 1);
+					s_NodeStack.resize(parentDepth + 1);
+
+					const unsigned int node = FindOrAddChild(s_NodeStack.back(), profileEvent.Name);
+					s_Nodes[node].Calls++;
+					s_Nodes[node].InclusiveMS += (float) ((profileEvent.End - profileEvent.Begin) * s_TicksToMS);
+					s_NodeStack.push_back(node);
+				}
+			}
+
+			void UpdateHistory(ProfileNode& node)
+			{
+				node.History[node.HistoryIndex] = node.InclusiveMS;
+				node.HistoryIndex = (node.HistoryIndex + 1) % ProfileNode::HISTORY_SIZE;
+				node.HistoryCount = MIN(node.HistoryCount + 1, ProfileNode::HISTORY_SIZE);
+
+				node.MinMS = node.History[0];
+				node.MaxMS = node.History[0];
+				float sum = 0.0f;
+				for (unsigned int i = 0; i < node.HistoryCount; i++)
+				{
+					node.MinMS = MIN(node.MinMS, node.History[i]);
+					node.MaxMS = MAX(node.MaxMS, node.History[i]);
+					sum += node.History[i];
+				}
+				node.AvgMS = sum / node.HistoryCount;
+			}
+		}
+
+		void BeginScope(const char* name)
+		{
+			ThreadState& state = t_State;
+			if (state.Depth < MAX_DEPTH) state.Stack[state.Depth] = { name, Now() };
+			state.Depth++;
+		}
+
+		void EndScope()
+		{
+			ThreadState& state = t_State;
+			ASSERT(state.Depth > 0, "[Profiler] EndScope without BeginScope");
+			state.Depth--;
+			if (state.Depth >= MAX_DEPTH) return;
+
+			if (!state.Buffer) AcquireBuffer(state);
+			const OpenScope& scope = state.Stack[state.Depth];
+			PushEvent(state, { scope.Name, scope.Begin, Now(), state.Depth });
+		}
+
+		const char* InternName(const std::string& name)
+		{
+			const auto cached = t_NameCache.find(name);
+			if (cached != t_NameCache.end()) return cached->second;
+
+			std::lock_guard<std::mutex> lock(s_NamesMutex);
+			const char* interned = s_Names.insert(name).first->c_str();
+			t_NameCache[name] = interned;
+			return interned;
+		}
+
+		void EndFrame()
+		{
+			Calibrate();
+
+			for (ProfileNode& node : s_Nodes)
+			{
+				node.Calls = 0;
+				node.InclusiveMS = 0.0f;
+				node.ExclusiveMS = 0.0f;
+			}
+
+			unsigned int numDropped = 0;
+			{
+				std::lock_guard<std::mutex> lock(s_BuffersMutex);
+				for (EventBuffer* buffer : s_Buffers)
+				{
+					const unsigned int writeIndex = buffer->WriteIndex.load(std::memory_order_acquire);
+					const unsigned int readIndex = buffer->ReadIndex.load(std::memory_order_relaxed);
+					if (writeIndex == readIndex) continue;
+
+					s_FrameEvents.clear();
+					for (unsigned int i = readIndex; i != writeIndex; i++) s_FrameEvents.push_back(buffer->Events[i & (EVENT_BUFFER_SIZE - 1)]);
+					buffer->ReadIndex.store(writeIndex, std::memory_order_release);
+					numDropped += buffer->NumDropped.exchange(0, std::memory_order_relaxed);
+
+					AddEvents(GetRoot(buffer->ThreadName));
+					if (s_Trace.Active) AddTraceEvents(buffer);
+				}
+			}
+
+			if (s_Trace.Active && --s_Trace.FramesLeft == 0)
+			{
+				WriteTrace();
+				s_Trace = {};
+			}
+
+			if (numDropped > 0) CONSOLE_LOG("[Profiler] Dropped " + std::to_string(numDropped) + " scopes, event buffer is full");
+
+			for (unsigned int root : s_Roots)
+			{
+				ProfileNode& rootNode = s_Nodes[root];
+				for (unsigned int child : rootNode.Children) rootNode.InclusiveMS += s_Nodes[child].InclusiveMS;
+				rootNode.Calls = rootNode.InclusiveMS > 0.0f ? 1 : 0;
+			}
+
+			for (ProfileNode& node : s_Nodes)
+			{
+				if (node.Calls == 0) continue;
+				node.ExclusiveMS = node.InclusiveMS;
+				for (unsigned int child : node.Children) node.ExclusiveMS -= s_Nodes[child].InclusiveMS;
+				UpdateHistory(node);
+			}
+		}
+
+		void CaptureTrace(unsigned int numFrames, const std::string& path)
+		{
+			if (s_Trace.Active)
+			{
+				CONSOLE_LOG("[Profiler] Trace capture already running, " + std::to_string(s_Trace.FramesLeft) + " frames left");
+				return;
+			}
+
+			s_Trace.Active = numFrames > 0;
+			s_Trace.FramesLeft = numFrames;
+			s_Trace.Path = path;
+			CONSOLE_LOG("[Profiler] Capturing trace of the next " + std::to_string(numFrames) + " frames");
+		}
+
+		bool IsCapturingTrace()
+		{
+			return s_Trace.Active;
+		}
+
+		const std::vector<ProfileNode>& GetNodes()
+		{
+			return s_Nodes;
+		}
+
+		const std::vector<unsigned int>& GetRoots()
+		{
+			return s_Roots;
+		}
+
+		ScopeOverhead MeasureScopeOverhead(unsigned int numScopes)
+		{
+			// Scopes are measured in batches that fit the buffer, so none of them take the cheaper dropping path.
+			// Measuring thread has its own buffer and drains it itself, the main thread waits for it so they don't both read it.
+			static constexpr unsigned int BATCH_SIZE = EVENT_BUFFER_SIZE / 2;
+
+			double totalMS = 0.0;
+			double counterMS = 0.0;
+			std::thread measureThread([numScopes, &totalMS, &counterMS]() {
+				ThreadUtil::SetThreadName("Profiler benchmark");
+				for (unsigned int measured = 0; measured < numScopes; measured += BATCH_SIZE)
+				{
+					const unsigned int batchSize = MIN(BATCH_SIZE, numScopes - measured);
+					const Clock::time_point begin = Clock::now();
+					for (unsigned int i = 0; i < batchSize; i++)
+					{
+						GP_SCOPED_CPU_PROFILE("Profiler::MeasureScopeOverhead");
+					}
+					totalMS += std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+
+					EventBuffer* buffer = t_State.Buffer;
+					buffer->ReadIndex.store(buffer->WriteIndex.load(std::memory_order_acquire), std::memory_order_release);
+				}
+
+				// Volatile sum so the reads aren't optimized out
+				volatile long long counterSum = 0;
+				const Clock::time_point begin = Clock::now();
+				for (unsigned int i = 0; i < numScopes; i++) counterSum = counterSum + Now();
+				counterMS = std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+				});
+			measureThread.join();
+
+			ScopeOverhead overhead;
+			if (numScopes == 0) return overhead;
+			overhead.ScopeNS = (float) (totalMS * 1000000.0 / numScopes);
+			overhead.CounterReadNS = (float) (counterMS * 1000000.0 / numScopes);
+			CONSOLE_LOG("[Profiler] Scope overhead: " + std::to_string(overhead.ScopeNS) + " ns, " + std::to_string(2.0f * overhead.CounterReadNS) + " ns of it are the two counter reads");
+			return overhead;
+		}
+	}
+}
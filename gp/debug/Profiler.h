@@ -0,0 +1,78 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "Common.h"
+
+#define GP_SCOPED_CPU_PROFILE(Name) ::GP::Profiler::CPUScope JOIN(_cps, __LINE__)(Name)
+
+namespace GP
+{
+	struct ProfileNode
+	{
+		static constexpr unsigned int HISTORY_SIZE = 120; // frames
+
+		const char* Name = nullptr;
+		unsigned int Parent = 0;
+		std::vector<unsigned int> Children;
+
+		// Last frame, zero calls if the scope didn't run in it
+		unsigned int Calls = 0;
+		float InclusiveMS = 0.0f;
+		float ExclusiveMS = 0.0f;
+
+		// Inclusive time over the last frames the scope ran in
+		float History[HISTORY_SIZE] = {};
+		unsigned int HistoryCount = 0;
+		unsigned int HistoryIndex = 0;
+		float MinMS = 0.0f;
+		float AvgMS = 0.0f;
+		float MaxMS = 0.0f;
+	};
+
+	// A scope reads the time stamp counter twice, how much that costs depends on the CPU and on virtualization
+	struct ScopeOverhead
+	{
+		float ScopeNS = 0.0f;
+		float CounterReadNS = 0.0f;
+	};
+
+	// Scopes are recorded into a buffer owned by the recording thread, the only synchronization is an atomic write index per buffer.
+	// Once per frame the main thread drains all buffers and merges scopes with the same path into a tree, one root for every thread name.
+	// Name of a thread is taken when it records its first scope, see ThreadUtil::SetThreadName.
+	namespace Profiler
+	{
+		static const std::string DEFAULT_TRACE_PATH = "trace.json";
+		static constexpr unsigned int DEFAULT_TRACE_FRAMES = 300;
+
+		// Names are not copied, they must outlive the frame
+		GP_DLL void BeginScope(const char* name);
+		GP_DLL void EndScope();
+
+		// Returns a pointer that stays valid until shutdown, used for names that are not string literals
+		GP_DLL const char* InternName(const std::string& name);
+
+		class CPUScope
+		{
+		public:
+			CPUScope(const char* name) { BeginScope(name); }
+			CPUScope(const std::string& name) { BeginScope(InternName(name)); }
+			~CPUScope() { EndScope(); }
+		};
+
+		// Collects scopes recorded since the last call, called once per frame on the main thread
+		void EndFrame();
+
+		// Scopes of all threads recorded in the next frames are written to a Chrome trace JSON file, called on the main thread
+		GP_DLL void CaptureTrace(unsigned int numFrames = DEFAULT_TRACE_FRAMES, const std::string& path = DEFAULT_TRACE_PATH);
+		GP_DLL bool IsCapturingTrace();
+
+		// Roots are indices into nodes, only valid on the main thread until the next EndFrame
+		GP_DLL const std::vector<ProfileNode>& GetNodes();
+		GP_DLL const std::vector<unsigned int>& GetRoots();
+
+		// Records empty scopes on a new thread and returns the average cost of one and of a single counter read, called on the main thread
+		GP_DLL ScopeOverhead MeasureScopeOverhead(unsigned int numScopes = 1000000);
+	}
+}
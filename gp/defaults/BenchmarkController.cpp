@@ -0,0 +1,247 @@
+#include "BenchmarkController.h"
+
+#include <fstream>
+
+#include "GP.h"
+#include "core/Window.h"
+#include "core/Loading.h"
+#include "core/GlobalVariables.h"
+#include "gfx/GfxShaderCache.h"
+#include "gfx/GfxTextureStreaming.h"
+#include "gfx/GfxGPUProfiler.h"
+#include "debug/LoadingTelemetry.h"
+#include "util/StringUtil.h"
+
+namespace GP
+{
+	namespace
+	{
+		static constexpr unsigned int NUM_COUNTERS = (unsigned int) FrameCounter::Count;
+
+		void WriteTimes(std::ofstream& stream, const char* name, float sumMS, unsigned int numFrames, const FrameTimeHistogram& histogram)
+		{
+			ASSERT(histogram.GetCount() == numFrames, "[Benchmark] Histogram and averages are of different frames");
+			stream << "\t\t" << StringUtil::ToJSONString(name) << ": { \"avg\": " << (numFrames ? sumMS / numFrames : 0.0f);
+			stream << ", \"p50\": " << histogram.GetPercentile(50.0f) << ", \"p95\": " << histogram.GetPercentile(95.0f);
+			stream << ", \"p99\": " << histogram.GetPercentile(99.0f) << ", \"max\": " << histogram.GetMaxMS() << " }";
+		}
+
+		void WriteScopes(std::ofstream& stream, const std::vector<ProfileNode>& nodes, const std::vector<double>& scopeSums, unsigned int numFrames, unsigned int node, const std::string& path, bool& first)
+		{
+			for (unsigned int child : nodes[node].Children)
+			{
+				const std::string childPath = path + "/" + nodes[child].Name;
+				if (child < scopeSums.size() && scopeSums[child] > 0.0)
+				{
+					stream << (first ? "" : ",\n") << "\t\t{ \"name\": " << StringUtil::ToJSONString(childPath) << ", \"avg_ms\": " << scopeSums[child] / numFrames << " }";
+					first = false;
+				}
+				WriteScopes(stream, nodes, scopeSums, numFrames, child, childPath, first);
+			}
+		}
+	}
+
+	BenchmarkController::BenchmarkController(Camera& camera, const BenchmarkSettings& settings) :
+		m_Camera(camera),
+		m_Settings(settings)
+	{
+		if (!m_Path.Load(m_Settings.CameraPath)) CONSOLE_LOG("[Benchmark] Camera path " + m_Settings.CameraPath + " not found, the camera stays in place");
+
+		GPConfig& gpConfig = GlobalVariables::GP_CONFIG;
+		gpConfig.FixedDT = m_Settings.FixedDT;
+		gpConfig.StubDraws = m_Settings.StubDraws;
+		if (m_Settings.HiddenWindow) Window::Get()->SetVisible(false);
+
+		m_GPUProfilerSelfTestPassed = GPUProfiler::RunSelfTest();
+		m_LoadingStart = std::chrono::high_resolution_clock::now();
+	}
+
+	void BenchmarkController::UpdateInput(float dt)
+	{
+		if (Input::IsKeyJustPressed(VK_ESCAPE))
+		{
+			GP::Shutdown();
+			return;
+		}
+
+		switch (m_State)
+		{
+		case State::Loading:
+		{
+			m_Path.Apply(m_Camera, 0.0f);
+
+			// Passes start loading in their Init on the first frame, streaming only requests mips once the scene is rendered
+			m_IdleFrames = (IsLoadingIdle() && m_Frame > 1) ? m_IdleFrames + 1 : 0;
+			m_Frame++;
+			m_LoadingMS = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - m_LoadingStart).count();
+
+			const bool timedOut = m_LoadingMS > LOADING_TIMEOUT_MS;
+			if (m_IdleFrames < LOADING_SETTLE_FRAMES && !timedOut) break;
+
+			if (timedOut) CONSOLE_LOG("[Benchmark] Loading didn't finish in " + std::to_string(LOADING_TIMEOUT_MS) + " ms, measuring anyway");
+			CONSOLE_LOG("[Benchmark] Loaded in " + std::to_string(m_LoadingMS) + " ms");
+			m_State = State::Warmup;
+			m_Frame = 0;
+			break;
+		}
+		case State::Warmup:
+		{
+			if (++m_Frame < m_Settings.WarmupFrames) break;
+
+			m_State = State::Measuring;
+			m_Frame = 0;
+			break;
+		}
+		case State::Measuring:
+		{
+			// Counters of a frame are done once it is rendered, its times and scopes only once the next frame begins.
+			// So they are read one update later, and one more frame is rendered after the last measured one.
+			const unsigned int numFrames = m_Settings.NumFrames;
+			if (m_Frame > 0 && m_Frame <= numFrames) AccumulateCounters();
+			if (m_Frame > 1) AccumulateTimes();
+			if (m_Frame == numFrames + 1)
+			{
+				m_ScopeOverhead = Profiler::MeasureScopeOverhead();
+				WriteReport();
+				m_State = State::Done;
+				if (m_Settings.ExitWhenDone) GP::Shutdown();
+				break;
+			}
+
+			if (m_Frame < numFrames) m_Path.Apply(m_Camera, m_Frame * m_Settings.FixedDT / 1000.0f);
+			m_Frame++;
+			break;
+		}
+		case State::Done:
+			break;
+		}
+	}
+
+	bool BenchmarkController::IsLoadingIdle() const
+	{
+		return g_LoadingThread->IsIdle() && TextureStreaming::GetStats().PendingRequests == 0;
+	}
+
+	void BenchmarkController::AccumulateTimes()
+	{
+		const FrameTimeSample& sample = FrameTimes::GetLastSample();
+		m_TimeSums.FrameMS += sample.FrameMS;
+		m_TimeSums.CPUMS += sample.CPUMS;
+		m_TimeSums.PresentMS += sample.PresentMS;
+		m_FrameHistogram.Add(sample.FrameMS);
+		m_CPUHistogram.Add(sample.CPUMS);
+		m_PresentHistogram.Add(sample.PresentMS);
+
+		const std::vector<ProfileNode>& nodes = Profiler::GetNodes();
+		m_ScopeSums.resize(nodes.size(), 0.0);
+		for (unsigned int i = 0; i < nodes.size(); i++) m_ScopeSums[i] += nodes[i].InclusiveMS;
+	}
+
+	void BenchmarkController::AccumulateCounters()
+	{
+		for (unsigned int i = 0; i < NUM_COUNTERS; i++)
+		{
+			const unsigned int value = FrameCounters::GetLastFrame((FrameCounter) i);
+			m_CounterSums[i] += value;
+			m_CounterMax[i] = MAX(m_CounterMax[i], value);
+		}
+	}
+
+	void BenchmarkController::WriteReport() const
+	{
+		std::ofstream stream(m_Settings.ReportPath, std::ios::out | std::ios::trunc);
+		if (!stream.is_open())
+		{
+			CONSOLE_LOG("[Benchmark] Failed to write report " + m_Settings.ReportPath);
+			return;
+		}
+
+		const unsigned int numFrames = m_Settings.NumFrames;
+		const GPConfig& gpConfig = GlobalVariables::GP_CONFIG;
+
+		stream << "{\n";
+#ifdef DEBUG
+		stream << "\t\"build\": \"Debug\",\n";
+#else
+		stream << "\t\"build\": \"Release\",\n";
+#endif
+		stream << "\t\"settings\": {\n";
+		stream << "\t\t\"camera_path\": " << StringUtil::ToJSONString(m_Settings.CameraPath) << ",\n";
+		stream << "\t\t\"frames\": " << numFrames << ",\n";
+		stream << "\t\t\"warmup_frames\": " << m_Settings.WarmupFrames << ",\n";
+		stream << "\t\t\"fixed_dt_ms\": " << m_Settings.FixedDT << ",\n";
+		stream << "\t\t\"stub_draws\": " << (m_Settings.StubDraws ? "true" : "false") << ",\n";
+		stream << "\t\t\"hidden_window\": " << (m_Settings.HiddenWindow ? "true" : "false") << ",\n";
+		stream << "\t\t\"resolution\": [" << gpConfig.WindowWidth << ", " << gpConfig.WindowHeight << "]\n";
+		stream << "\t},\n";
+
+		const ShaderRegistryStats registryStats = ShaderRegistry::GetStats();
+		const ShaderCacheStats cacheStats = ShaderCache::GetStats();
+		const TextureStreamingStats streamingStats = TextureStreaming::GetStats();
+		const LoadingStats loadingStats = LoadingTelemetry::GetStats();
+		stream << "\t\"loading\": {\n";
+		stream << "\t\t\"time_ms\": " << m_LoadingMS << ",\n";
+		stream << "\t\t\"shaders\": " << registryStats.NumShaders << ",\n";
+		stream << "\t\t\"shader_compile_wall_ms\": " << registryStats.WallTimeMS << ",\n";
+		stream << "\t\t\"shader_compile_cpu_ms\": " << registryStats.CpuTimeMS << ",\n";
+		stream << "\t\t\"shader_cache_hits\": " << cacheStats.Hits << ",\n";
+		stream << "\t\t\"shader_cache_misses\": " << cacheStats.Misses << ",\n";
+		stream << "\t\t\"streamed_textures\": " << streamingStats.NumTextures << ",\n";
+		stream << "\t\t\"resident_texture_bytes\": " << streamingStats.ResidentBytes << ",\n";
+		stream << "\t\t\"bytes_read\": " << loadingStats.BytesRead << ",\n";
+		stream << "\t\t\"bytes_decoded\": " << loadingStats.BytesDecoded << ",\n";
+		stream << "\t\t\"objects_published\": " << loadingStats.ObjectsPublished << ",\n";
+		stream << "\t\t\"tasks\": " << loadingStats.TasksCompleted << ",\n";
+		stream << "\t\t\"max_queue_depth\": " << loadingStats.MaxQueueDepth << ",\n";
+		stream << "\t\t\"stages\": {\n";
+		for (unsigned int i = 0; i < (unsigned int) LoadingStage::Count; i++)
+		{
+			const LoadingStageStats& stageStats = loadingStats.Stages[i];
+			stream << "\t\t\t" << StringUtil::ToJSONString(LoadingTelemetry::GetStageName((LoadingStage) i)) << ": { \"count\": " << stageStats.Count << ", \"total_ms\": " << stageStats.TotalMS;
+			stream << ", \"max_ms\": " << stageStats.MaxMS << " }" << (i + 1 < (unsigned int) LoadingStage::Count ? ",\n" : "\n");
+		}
+		stream << "\t\t}\n";
+		stream << "\t},\n";
+
+		stream << "\t\"times_ms\": {\n";
+		WriteTimes(stream, "frame", m_TimeSums.FrameMS, numFrames, m_FrameHistogram);
+		stream << ",\n";
+		WriteTimes(stream, "cpu", m_TimeSums.CPUMS, numFrames, m_CPUHistogram);
+		stream << ",\n";
+		WriteTimes(stream, "present", m_TimeSums.PresentMS, numFrames, m_PresentHistogram);
+		stream << "\n\t},\n";
+
+		stream << "\t\"counters\": {\n";
+		for (unsigned int i = 0; i < NUM_COUNTERS; i++)
+		{
+			stream << "\t\t" << StringUtil::ToJSONString(FrameCounters::GetName((FrameCounter) i)) << ": { \"total\": " << m_CounterSums[i];
+			stream << ", \"avg\": " << (numFrames ? (double) m_CounterSums[i] / numFrames : 0.0) << ", \"max\": " << m_CounterMax[i] << " }" << (i + 1 < NUM_COUNTERS ? ",\n" : "\n");
+		}
+		stream << "\t},\n";
+
+		// Averaged over all measured frames, also the ones a scope didn't run in
+		stream << "\t\"cpu_scopes\": [\n";
+		const std::vector<ProfileNode>& nodes = Profiler::GetNodes();
+		bool firstScope = true;
+		for (unsigned int root : Profiler::GetRoots()) WriteScopes(stream, nodes, m_ScopeSums, numFrames, root, nodes[root].Name, firstScope);
+		stream << "\n\t],\n";
+
+		stream << "\t\"profiler\": { \"scope_overhead_ns\": " << m_ScopeOverhead.ScopeNS << ", \"counter_read_ns\": " << m_ScopeOverhead.CounterReadNS;
+		stream << ", \"gpu_profiler_self_test\": " << (m_GPUProfilerSelfTestPassed ? "true" : "false") << " },\n";
+
+		// Moving average of the GPU profiler, meaningless with stubbed draws
+		stream << "\t\"gpu_passes\": [\n";
+		if (g_GPUProfiler)
+		{
+			const std::vector<GPUPassTiming>& gpuTimings = g_GPUProfiler->GetTimings();
+			for (unsigned int i = 0; i < gpuTimings.size(); i++)
+			{
+				stream << "\t\t{ \"name\": " << StringUtil::ToJSONString(gpuTimings[i].Name) << ", \"depth\": " << gpuTimings[i].Depth << ", \"avg_ms\": " << gpuTimings[i].AvgMS << " }" << (i + 1 < gpuTimings.size() ? ",\n" : "\n");
+			}
+		}
+		stream << "\t]\n";
+		stream << "}\n";
+
+		CONSOLE_LOG("[Benchmark] Report of " + std::to_string(numFrames) + " frames written to " + m_Settings.ReportPath);
+	}
+}
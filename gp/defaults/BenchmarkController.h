@@ -0,0 +1,80 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <chrono>
+
+#include "core/Controller.h"
+#include "defaults/CameraPath.h"
+#include "debug/FrameCounters.h"
+#include "debug/FrameTimes.h"
+#include "debug/Profiler.h"
+
+namespace GP
+{
+	class Camera;
+
+	static const std::string DEFAULT_BENCHMARK_REPORT_PATH = "benchmark.json";
+
+	struct BenchmarkSettings
+	{
+		std::string CameraPath = DEFAULT_CAMERA_PATH;
+		std::string ReportPath = DEFAULT_BENCHMARK_REPORT_PATH;
+		unsigned int NumFrames = 1000;
+		unsigned int WarmupFrames = 60;
+		float FixedDT = 1000.0f / 60.0f; // Miliseconds
+		bool StubDraws = false;
+		bool HiddenWindow = false;
+		bool ExitWhenDone = true;
+	};
+
+	// Waits until loading is done, renders warmup frames and then moves the camera along the path with a fixed timestep.
+	// Measured frames only depend on the path and the settings, input is ignored except for escape.
+	class BenchmarkController : public Controller
+	{
+		static constexpr unsigned int LOADING_SETTLE_FRAMES = 10; // Loading has to stay idle for this long
+		static constexpr float LOADING_TIMEOUT_MS = 120000.0f;
+
+	public:
+		GP_DLL BenchmarkController(Camera& camera, const BenchmarkSettings& settings);
+		GP_DLL virtual void UpdateInput(float dt);
+
+		inline bool IsDone() const { return m_State == State::Done; }
+
+	private:
+		enum class State
+		{
+			Loading,
+			Warmup,
+			Measuring,
+			Done
+		};
+
+		bool IsLoadingIdle() const;
+		void AccumulateTimes(); // Times and scopes of the frame before the last rendered one
+		void AccumulateCounters(); // Counters of the last rendered frame
+		void WriteReport() const;
+
+	private:
+		Camera& m_Camera;
+		BenchmarkSettings m_Settings;
+		CameraPath m_Path;
+
+		State m_State = State::Loading;
+		unsigned int m_Frame = 0; // In the current state
+		unsigned int m_IdleFrames = 0;
+		std::chrono::high_resolution_clock::time_point m_LoadingStart;
+		float m_LoadingMS = 0.0f;
+
+		// Percentiles come from the same frames as the averages, the histograms of FrameTimes also have the frames before
+		FrameTimeSample m_TimeSums;
+		FrameTimeHistogram m_FrameHistogram;
+		FrameTimeHistogram m_CPUHistogram;
+		FrameTimeHistogram m_PresentHistogram;
+		unsigned long long m_CounterSums[(unsigned int) FrameCounter::Count] = {};
+		unsigned int m_CounterMax[(unsigned int) FrameCounter::Count] = {};
+		std::vector<double> m_ScopeSums; // Inclusive time by profiler node
+		ScopeOverhead m_ScopeOverhead; // Measured after the last frame, so it doesn't disturb the measured ones
+		bool m_GPUProfilerSelfTestPassed = false; // GPU timings in the report are only trusted if it passed
+	};
+}
@@ -0,0 +1,86 @@
+#include "CameraPath.h"
+
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+#include "gfx/GfxTransformations.h"
+
+namespace GP
+{
+	namespace
+	{
+		inline Vec3 CatmullRom(const Vec3& p0, const Vec3& p1, const Vec3& p2, const Vec3& p3, float t)
+		{
+			const float t2 = t * t;
+			const float t3 = t2 * t;
+			return 0.5f * ((2.0f * p1) + (p2 - p0) * t + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * t2 + (3.0f * p1 - p0 - 3.0f * p2 + p3) * t3);
+		}
+	}
+
+	bool CameraPath::Load(const std::string& path)
+	{
+		std::ifstream stream(path);
+		if (!stream.is_open()) return false;
+
+		m_Keys.clear();
+		std::string line;
+		while (std::getline(stream, line))
+		{
+			if (line.empty() || line[0] == '#') continue;
+
+			CameraPathKey key;
+			std::stringstream lineStream(line);
+			lineStream >> key.Time >> key.Position.x >> key.Position.y >> key.Position.z >> key.Rotation.x >> key.Rotation.y >> key.Rotation.z;
+			if (lineStream.fail())
+			{
+				CONSOLE_LOG("[CameraPath] Skipping invalid key in " + path + ": " + line);
+				continue;
+			}
+			m_Keys.push_back(key);
+		}
+		return true;
+	}
+
+	bool CameraPath::Save(const std::string& path) const
+	{
+		std::ofstream stream(path, std::ios::out | std::ios::trunc);
+		if (!stream.is_open()) return false;
+
+		stream << "# time position.x position.y position.z pitch yaw roll\n";
+		for (const CameraPathKey& key : m_Keys)
+		{
+			stream << key.Time << " " << key.Position.x << " " << key.Position.y << " " << key.Position.z << " " << key.Rotation.x << " " << key.Rotation.y << " " << key.Rotation.z << "\n";
+		}
+		return true;
+	}
+
+	void CameraPath::AddKey(float time, const Vec3& position, const Vec3& rotation)
+	{
+		ASSERT(m_Keys.empty() || m_Keys.back().Time <= time, "[CameraPath] Keys must be added in time order");
+		m_Keys.push_back({ time, position, rotation });
+	}
+
+	void CameraPath::Apply(Camera& camera, float time) const
+	{
+		if (m_Keys.empty()) return;
+
+		const float duration = GetDuration();
+		if (duration > 0.0f) time = std::fmod(MAX(time, 0.0f), duration);
+
+		const auto next = std::upper_bound(m_Keys.begin(), m_Keys.end(), time, [](float keyTime, const CameraPathKey& key) { return keyTime < key.Time; });
+		const unsigned int numKeys = (unsigned int) m_Keys.size();
+		const unsigned int i2 = MIN((unsigned int) (next - m_Keys.begin()), numKeys - 1);
+		const unsigned int i1 = i2 > 0 ? i2 - 1 : 0;
+		const unsigned int i0 = i1 > 0 ? i1 - 1 : 0;
+		const unsigned int i3 = MIN(i2 + 1, numKeys - 1);
+
+		const float segmentTime = m_Keys[i2].Time - m_Keys[i1].Time;
+		float t = 0.0f;
+		if (segmentTime > 0.0f) t = CLAMP((time - m_Keys[i1].Time) / segmentTime, 0.0f, 1.0f);
+
+		camera.SetPosition(CatmullRom(m_Keys[i0].Position, m_Keys[i1].Position, m_Keys[i2].Position, m_Keys[i3].Position, t));
+		camera.SetRotation(CatmullRom(m_Keys[i0].Rotation, m_Keys[i1].Rotation, m_Keys[i2].Rotation, m_Keys[i3].Rotation, t));
+	}
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "Common.h"
+
+namespace GP
+{
+	class Camera;
+
+	struct CameraPathKey
+	{
+		float Time; // seconds
+		Vec3 Position;
+		Vec3 Rotation; // (pitch, yaw, roll)
+	};
+
+	// Catmull-Rom spline through camera poses, stored as a text file with one key per line
+	class CameraPath
+	{
+	public:
+		static constexpr float RECORD_INTERVAL = 0.25f; // seconds
+
+		GP_DLL bool Load(const std::string& path);
+		GP_DLL bool Save(const std::string& path) const;
+
+		// Keys must be added in time order
+		GP_DLL void AddKey(float time, const Vec3& position, const Vec3& rotation);
+		inline void Clear() { m_Keys.clear(); }
+
+		// Wraps around after the last key, the path is expected to end where it started
+		GP_DLL void Apply(Camera& camera, float time) const;
+
+		inline bool IsEmpty() const { return m_Keys.empty(); }
+		inline float GetDuration() const { return m_Keys.empty() ? 0.0f : m_Keys.back().Time; }
+
+	private:
+		std::vector<CameraPathKey> m_Keys;
+	};
+
+	static const std::string DEFAULT_CAMERA_PATH = "camera_path.txt";
+}
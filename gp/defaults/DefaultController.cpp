@@ -74,7 +74,34 @@ namespace GP
         if (GP::Input::IsKeyJustPressed('R'))
         {
             GP::ReloadShaders();
-            CONSOLE_LOG("Shader reload finished!");
+            CONSOLE_LOG("Reloading changed shaders...");
+        }
+
+        if (GP::Input::IsKeyJustPressed('C'))
+        {
+            CONSOLE_LOG("Cooking shader archive...");
+            GP::CookShaders();
+        }
+
+        if (GP::Input::IsKeyJustPressed('P'))
+        {
+            GP::Profiler::CaptureTrace();
+        }
+
+        if (GP::Input::IsKeyJustPressed('B'))
+        {
+            m_RecordingPath = !m_RecordingPath;
+            if (m_RecordingPath)
+            {
+                m_RecordedPath.Clear();
+                m_RecordingTime = 0.0f;
+                m_NextKeyTime = 0.0f;
+                CONSOLE_LOG("Recording camera path...");
+            }
+            else if (m_RecordedPath.Save(DEFAULT_CAMERA_PATH))
+            {
+                CONSOLE_LOG("Camera path saved to " + DEFAULT_CAMERA_PATH);
+            }
         }
 
         if (glm::length(moveDir) > 0.001f)
@@ -94,6 +121,18 @@ namespace GP
             cameraRot.x = CLAMP(cameraRot.x, MIN_PITCH, MAX_PITCH);
             m_Camera.SetRotation(cameraRot);
         }
+
+        if (m_RecordingPath) UpdatePathRecording(dt);
+    }
+
+    void DefaultController::UpdatePathRecording(float dt)
+    {
+        if (m_RecordingTime >= m_NextKeyTime)
+        {
+            m_RecordedPath.AddKey(m_RecordingTime, m_Camera.GetPosition(), m_Camera.GetRotation());
+            m_NextKeyTime += CameraPath::RECORD_INTERVAL;
+        }
+        m_RecordingTime += dt / 1000.0f;
     }
 
 	void DefaultController::UpdateInput(float dt)
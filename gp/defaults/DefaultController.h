@@ -1,6 +1,7 @@
 #pragma once
 
 #include "core/Controller.h"
+#include "defaults/CameraPath.h"
 
 namespace GP
 {
@@ -14,8 +15,15 @@ namespace GP
 
 	private:
 		void UpdateGameInput(float dt);
+		void UpdatePathRecording(float dt);
 
 	private:
 		Camera& m_Camera;
+
+		// Toggled with B, the path is saved for the benchmark when the recording stops
+		bool m_RecordingPath = false;
+		float m_RecordingTime = 0.0f;
+		float m_NextKeyTime = 0.0f;
+		CameraPath m_RecordedPath;
 	};
 }
\ No newline at end of file
@@ -1,22 +1,51 @@
 #include "DefaultSceneRenderPass.h"
 
+#include <cfloat>
+
+#include "core/GlobalVariables.h"
 #include "gfx/GfxTransformations.h"
 #include "gfx/GfxTexture.h"
+#include "gfx/GfxTextureStreaming.h"
 #include "gfx/ScopedOperations.h"
 
 namespace GP
 {
+	namespace
+	{
+		// Requests texture mips by the size of the object bounds on the screen
+		void RequestTextureMips(const Camera* camera, SceneObject* sceneObject)
+		{
+			GfxTexture2D* texture = sceneObject->GetMaterial()->GetDiffuseTexture();
+			if (!texture) return;
+
+			const Mesh* mesh = sceneObject->GetMesh();
+			const Vec3 scale = sceneObject->GetScale();
+			const Vec3 center = sceneObject->GetPosition() + mesh->GetBoundsCenter() * scale;
+			const float radius = mesh->GetBoundsRadius() * glm::max(scale.x, glm::max(scale.y, scale.z));
+			const float distance = glm::length(center - camera->GetPosition());
+
+			const float pixelsPerUnit = camera->GetData().projection[1][1] * 0.5f * GlobalVariables::GP_CONFIG.WindowHeight;
+			const float screenSize = distance > radius ? 2.0f * radius / distance * pixelsPerUnit : FLT_MAX;
+			TextureStreaming::RequestScreenSize(texture->GetResource(), screenSize);
+		}
+	}
+
 	DefaultSceneRenderPass::~DefaultSceneRenderPass()
 	{
+		DestroyParameters(m_OpaqueParameters);
+		DestroyParameters(m_TransparentParameters);
 		delete m_DiffuseSampler;
-		delete m_ShaderOpaque;
-		delete m_ShaderTransparent;
+		delete m_Shader;
 	}
 
 	void DefaultSceneRenderPass::Init(GfxContext* context)
 	{
-		m_ShaderOpaque = new GfxShader("gp/shaders/default_scene_phong.hlsl");
-		m_ShaderTransparent = new GfxShader("gp/shaders/default_scene_phong.hlsl", { "USE_ALPHA_BLEND" });
+		m_Shader = new GfxShaderFamily("gp/shaders/default_scene_phong.hlsl");
+		m_AlphaBlendPermutation = m_Shader->GetPermutation("USE_ALPHA_BLEND");
+
+		// Create both variants up front so they get compiled with the rest of the startup shaders
+		InitParameters(m_OpaqueParameters, m_Shader->GetShader());
+		InitParameters(m_TransparentParameters, m_Shader->GetShader(m_AlphaBlendPermutation));
 		m_DiffuseSampler = new GfxSampler(SamplerFilter::Anisotropic, SamplerMode::Wrap);
 	}
 
@@ -27,19 +56,9 @@ namespace GP
 		{
 			GP_SCOPED_PROFILE("Opaque");
 
-			context->BindShader(m_ShaderOpaque);
-			context->BindConstantBuffer(VS, m_Camera->GetBuffer(context), 0);
-			context->BindSampler(PS, m_DiffuseSampler, 0);
-			m_Scene.ForEveryOpaqueObject([context](SceneObject* sceneObject) {
-				const Mesh* mesh = sceneObject->GetMesh();
-				context->BindConstantBuffer(VS, sceneObject->GetTransformBuffer(context), 1);
-				context->BindVertexBufferSlot(mesh->GetPositionBuffer(), 0);
-				context->BindVertexBufferSlot(mesh->GetUVBuffer(), 1);
-				context->BindVertexBufferSlot(mesh->GetNormalBuffer(), 2);
-				context->BindVertexBufferSlot(mesh->GetTangentBuffer(), 3);
-				context->BindIndexBuffer(mesh->GetIndexBuffer());
-				context->BindTexture2D(PS, sceneObject->GetMaterial()->GetDiffuseTexture(), 0);
-				context->DrawIndexed(mesh->GetIndexBuffer()->GetNumIndices());
+			BeginDraw(context, m_OpaqueParameters);
+			m_Scene.ForEveryOpaqueObject([this, context](SceneObject* sceneObject) {
+				DrawObject(context, m_OpaqueParameters, sceneObject);
 				});
 			context->UnbindTexture(PS, 0);
 		}
@@ -47,21 +66,51 @@ namespace GP
 		{
 			GP_SCOPED_PROFILE("Transparent");
 
-			context->BindShader(m_ShaderTransparent);
-			context->BindConstantBuffer(VS, m_Camera->GetBuffer(context), 0);
-			context->BindSampler(PS, m_DiffuseSampler, 0);
-			m_Scene.ForEveryTransparentObjectSorted(m_Camera->GetPosition(), [context](SceneObject* sceneObject) {
-				const Mesh* mesh = sceneObject->GetMesh();
-				context->BindConstantBuffer(VS, sceneObject->GetTransformBuffer(context), 1);
-				context->BindVertexBufferSlot(mesh->GetPositionBuffer(), 0);
-				context->BindVertexBufferSlot(mesh->GetUVBuffer(), 1);
-				context->BindVertexBufferSlot(mesh->GetNormalBuffer(), 2);
-				context->BindVertexBufferSlot(mesh->GetTangentBuffer(), 3);
-				context->BindIndexBuffer(mesh->GetIndexBuffer());
-				context->BindTexture2D(PS, sceneObject->GetMaterial()->GetDiffuseTexture(), 0);
-				context->DrawIndexed(mesh->GetIndexBuffer()->GetNumIndices());
+			BeginDraw(context, m_TransparentParameters);
+			m_Scene.ForEveryTransparentObjectSorted(m_Camera->GetPosition(), [this, context](SceneObject* sceneObject) {
+				DrawObject(context, m_TransparentParameters, sceneObject);
 				});
 			context->UnbindTexture(PS, 0);
 		}
 	}
+
+	void DefaultSceneRenderPass::InitParameters(ShaderParameters& parameters, GfxShader* shader)
+	{
+		parameters.Shader = shader;
+		parameters.PassParameters = new GfxParameterBlock(shader);
+		parameters.ObjectParameters = new GfxParameterBlock(shader);
+		parameters.Camera = parameters.PassParameters->GetParameterID("Camera");
+		parameters.DiffuseSampler = parameters.PassParameters->GetParameterID("diffuseSampler");
+		parameters.Model = parameters.ObjectParameters->GetParameterID("Model");
+		parameters.DiffuseTexture = parameters.ObjectParameters->GetParameterID("diffuseTexture");
+	}
+
+	void DefaultSceneRenderPass::DestroyParameters(ShaderParameters& parameters)
+	{
+		delete parameters.PassParameters;
+		delete parameters.ObjectParameters;
+	}
+
+	void DefaultSceneRenderPass::BeginDraw(GfxContext* context, ShaderParameters& parameters)
+	{
+		context->BindShader(parameters.Shader);
+		parameters.PassParameters->SetConstantBuffer(parameters.Camera, m_Camera->GetBuffer(context));
+		parameters.PassParameters->SetSampler(parameters.DiffuseSampler, m_DiffuseSampler);
+		context->BindParameterBlock(parameters.PassParameters);
+	}
+
+	void DefaultSceneRenderPass::DrawObject(GfxContext* context, ShaderParameters& parameters, SceneObject* sceneObject)
+	{
+		const Mesh* mesh = sceneObject->GetMesh();
+		RequestTextureMips(m_Camera, sceneObject);
+		parameters.ObjectParameters->SetConstantBuffer(parameters.Model, sceneObject->GetTransformBuffer(context));
+		parameters.ObjectParameters->SetTexture(parameters.DiffuseTexture, sceneObject->GetMaterial()->GetDiffuseTexture());
+		context->BindParameterBlock(parameters.ObjectParameters);
+		context->BindVertexBufferSlot(mesh->GetPositionBuffer(), 0);
+		context->BindVertexBufferSlot(mesh->GetUVBuffer(), 1);
+		context->BindVertexBufferSlot(mesh->GetNormalBuffer(), 2);
+		context->BindVertexBufferSlot(mesh->GetTangentBuffer(), 3);
+		context->BindIndexBuffer(mesh->GetIndexBuffer());
+		context->DrawIndexed(mesh->GetIndexBuffer()->GetNumIndices());
+	}
 }
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include "scene/Scene.h"
 #include "gfx/GfxDevice.h"
 #include "gfx/GfxShader.h"
+#include "gfx/GfxParameterBlock.h"
 
 namespace GP
 {
@@ -26,17 +27,32 @@ namespace GP
 		GP_DLL virtual void Init(GfxContext* context) override;
 		GP_DLL virtual void Render(GfxContext* context) override;
 
-		inline virtual void ReloadShaders() override
+	private:
+		// Parameters of one shader variant, pass parameters are bound once and object parameters for every draw
+		struct ShaderParameters
 		{
-			m_ShaderOpaque->Reload();
-			m_ShaderTransparent->Reload();
-		}
+			GfxShader* Shader = nullptr;
+			GfxParameterBlock* PassParameters = nullptr;
+			GfxParameterBlock* ObjectParameters = nullptr;
+
+			GfxParameterBlock::ParameterID Camera = 0;
+			GfxParameterBlock::ParameterID DiffuseSampler = 0;
+			GfxParameterBlock::ParameterID Model = 0;
+			GfxParameterBlock::ParameterID DiffuseTexture = 0;
+		};
+
+		void InitParameters(ShaderParameters& parameters, GfxShader* shader);
+		void DestroyParameters(ShaderParameters& parameters);
+		void BeginDraw(GfxContext* context, ShaderParameters& parameters);
+		void DrawObject(GfxContext* context, ShaderParameters& parameters, SceneObject* sceneObject);
 
 	private:
 		Scene m_Scene;
 		Camera* m_Camera = nullptr;
-		GfxShader* m_ShaderOpaque = nullptr;
-		GfxShader* m_ShaderTransparent = nullptr;
+		GfxShaderFamily* m_Shader = nullptr;
+		GfxShaderFamily::Permutation m_AlphaBlendPermutation = 0;
 		GfxSampler* m_DiffuseSampler = nullptr;
+		ShaderParameters m_OpaqueParameters;
+		ShaderParameters m_TransparentParameters;
 	};
 }
\ No newline at end of file
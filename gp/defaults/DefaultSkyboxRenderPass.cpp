@@ -15,6 +15,11 @@ namespace GP
 		m_Shader = new GfxShader("gp/shaders/default_skybox.hlsl");
 	}
 
+	void DefaultSkyboxRenderPass::PrepareParallel(GfxContext* context)
+	{
+		m_Camera->GetBuffer(context);
+	}
+
 	void DefaultSkyboxRenderPass::Render(GfxContext* context)
 	{
 		GP_SCOPED_PROFILE("Default Skybox Render");
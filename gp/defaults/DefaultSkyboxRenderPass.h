@@ -20,10 +20,9 @@ namespace GP
 		GP_DLL virtual void Init(GfxContext* context) override;
 		GP_DLL virtual void Render(GfxContext* context) override;
 
-		inline virtual void ReloadShaders() override
-		{
-			m_Shader->Reload();
-		}
+		// Only reads the camera buffer and its own cubemap
+		virtual bool CanRecordInParallel() const override { return true; }
+		GP_DLL virtual void PrepareParallel(GfxContext* context) override;
 
 	private:
 		Camera* m_Camera = nullptr;
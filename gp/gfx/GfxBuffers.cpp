@@ -28,6 +28,7 @@ namespace GP
 
 		D3D11_BUFFER_DESC bufferDesc = GetBufferDesc(m_ByteSize, m_CreationFlags, m_Stride);
 		DX_CALL(g_Device->GetDevice()->CreateBuffer(&bufferDesc, subresourceData, &m_Handle));
+		TrackMemory(m_ByteSize, MemoryCategory::Buffer);
 
 		if (m_MemData.numBytes > 0)
 		{
@@ -12,6 +12,8 @@
 #include "gui/GUI.h"
 #include "gfx/GfxTexture.h"
 #include "gfx/GfxShader.h"
+#include "gfx/GfxParameterBlock.h"
+#include "debug/FrameCounters.h"
 
 namespace GP
 {
@@ -102,6 +104,8 @@ namespace GP
 
         if (m_Dirty)
         {
+            FrameCounters::Increment(FrameCounter::InputAssemblerBinds);
+
             // Bind vertex buffers
             unsigned int numBuffers = m_VBResources.size();
             ID3D11Buffer** buffers = numBuffers ? m_VBResources.data() : NULL_BUFFER;
@@ -138,9 +142,12 @@ namespace GP
     GfxContext::GfxContext():
         m_Deferred(true)
     {
-        ID3D11Device1* d = g_Device->GetDevice();
-        DX_CALL(d->CreateDeferredContext1(0, &m_Handle));
+        m_Handle = g_Device->AcquireDeferredContext();
         Reset();
+
+#ifdef DEBUG
+        InitDebugMarkers();
+#endif
     }
 
     GfxContext::GfxContext(ID3D11DeviceContext1* context):
@@ -160,7 +167,10 @@ namespace GP
         if (m_Deferred)
         {
             Submit();
-            m_Handle->Release();
+#ifdef DEBUG
+            m_DebugMarkers->Release();
+#endif
+            g_Device->ReleaseDeferredContext(m_Handle);
         }
     }
 
@@ -191,6 +201,7 @@ namespace GP
     void GfxContext::UploadToTexture(TextureResource2D* textureResource, void* data, unsigned int arrayIndex)
     {
         ContextOperation(this, "Upload to texture");
+        FrameCounters::Increment(FrameCounter::TextureUploads);
         unsigned int subresourceIndex = D3D11CalcSubresource(0, arrayIndex, textureResource->GetNumMips());
         m_Handle->UpdateSubresource(textureResource->GetHandle(), subresourceIndex, nullptr, data, textureResource->GetRowPitch(), 0u);
     }
@@ -208,6 +219,7 @@ namespace GP
     void* GfxContext::Map(GfxBuffer* gfxBuffer, bool read, bool write)
     {
         ContextOperation(this, "Map");
+        FrameCounters::Increment(FrameCounter::BufferMaps);
         if (!gfxBuffer->Initialized())
         {
             if(write) gfxBuffer->AddCreationFlags(RCF_CPUWrite);
@@ -252,6 +264,56 @@ namespace GP
         m_ReloadShader = true;
     }
 
+    void GfxContext::BindParameterBlock(GfxParameterBlock* parameterBlock)
+    {
+        ContextOperation(this, "Bind parameter block");
+
+        GfxShader* shader = parameterBlock->GetShader();
+        if (!shader->IsInitialized()) shader->Initialize();
+        parameterBlock->Resolve();
+
+        ID3D11Buffer* buffers[D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT];
+        ID3D11ShaderResourceView* srvs[D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT];
+        ID3D11UnorderedAccessView* uavs[D3D11_1_UAV_SLOT_COUNT];
+        ID3D11SamplerState* samplers[D3D11_COMMONSHADER_SAMPLER_SLOT_COUNT];
+
+        for (const GfxParameterBlock::BindRange& range : parameterBlock->GetRanges())
+        {
+            for (unsigned int i = 0; i < range.Count; i++)
+            {
+                const GfxParameterBlock::Parameter& parameter = parameterBlock->GetRangeParameter(range.FirstParameter + i);
+                switch (range.Type)
+                {
+                case ShaderBindingType::ConstantBuffer:
+                    buffers[i] = GetDeviceHandle(this, parameter.Buffer);
+                    break;
+                case ShaderBindingType::Resource:
+                    if (parameter.Buffer) srvs[i] = GetDeviceSRV(this, parameter.Buffer);
+                    else if (parameter.Texture2D) srvs[i] = GetDeviceSRV(this, parameter.Texture2D);
+                    else srvs[i] = GetDeviceSRV(this, parameter.Texture3D);
+                    break;
+                case ShaderBindingType::RWResource:
+                    if (parameter.Buffer) uavs[i] = GetDeviceUAV(this, parameter.Buffer);
+                    else uavs[i] = GetDeviceUAV(this, parameter.Texture3D);
+                    break;
+                case ShaderBindingType::Sampler:
+                    samplers[i] = parameter.Sampler ? parameter.Sampler->GetSampler() : nullptr;
+                    break;
+                default: NOT_IMPLEMENTED;
+                }
+            }
+
+            switch (range.Type)
+            {
+            case ShaderBindingType::ConstantBuffer: BindCBs(m_Handle, range.Stage, range.StartSlot, range.Count, buffers); break;
+            case ShaderBindingType::Resource: BindSRVs(m_Handle, range.Stage, range.StartSlot, range.Count, srvs); break;
+            case ShaderBindingType::RWResource: BindUAVs(m_Handle, range.Stage, range.StartSlot, range.Count, uavs); break;
+            case ShaderBindingType::Sampler: BindSamplerStates(m_Handle, range.Stage, range.StartSlot, range.Count, samplers); break;
+            default: NOT_IMPLEMENTED;
+            }
+        }
+    }
+
     void GfxContext::SetRenderTarget(GfxCubemapRenderTarget* cubemapRT, unsigned int face)
     {
         ContextOperation(this, "Bind render target");
@@ -259,6 +321,7 @@ namespace GP
         // HACK
         m_RenderTarget = nullptr;
         m_DepthStencil = nullptr;
+        m_PendingDefaultTargets = false;
 
         if (!cubemapRT->Initialized()) cubemapRT->Initialize(this);
 
@@ -272,46 +335,52 @@ namespace GP
     {
         ContextOperation(this, "Set stencil ref");
         m_StencilRef = ref;
+        m_DeviceState = nullptr;
         m_ReloadShader = true;
     }
 
     void GfxContext::Dispatch(unsigned int x, unsigned int y, unsigned int z)
     {
         ContextOperation(this, "Dispatch");
+        FrameCounters::Increment(FrameCounter::Dispatches);
         if (m_ReloadShader) BindShaderToPipeline();
-        m_Handle->Dispatch(x, y, z);
+        if (!GlobalVariables::GP_CONFIG.StubDraws) m_Handle->Dispatch(x, y, z);
     }
 
     void GfxContext::Draw(unsigned int numVerts)
     {
         ContextOperation(this, "Draw");
+        FrameCounters::Increment(FrameCounter::Draws);
         if (m_ReloadShader) BindShaderToPipeline();
         m_InputAssember.PrepareForDraw(m_Shader, m_Handle);
-        m_Handle->Draw(numVerts, 0);
+        if (!GlobalVariables::GP_CONFIG.StubDraws) m_Handle->Draw(numVerts, 0);
     }
 
     void GfxContext::DrawIndexed(unsigned int numIndices)
     {
         ContextOperation(this, "DrawIndexed");
+        FrameCounters::Increment(FrameCounter::Draws);
         if (m_ReloadShader) BindShaderToPipeline();
         m_InputAssember.PrepareForDraw(m_Shader, m_Handle);
-        m_Handle->DrawIndexed(numIndices, 0, 0);
+        if (!GlobalVariables::GP_CONFIG.StubDraws) m_Handle->DrawIndexed(numIndices, 0, 0);
     }
 
     void GfxContext::DrawInstanced(unsigned int numVerts, unsigned int numInstances)
     {
         ContextOperation(this, "DrawInstanced");
+        FrameCounters::Increment(FrameCounter::Draws);
         m_InputAssember.PrepareForDraw(m_Shader, m_Handle);
         if (m_ReloadShader) BindShaderToPipeline();
-        m_Handle->DrawInstanced(numVerts, numInstances, 0, 0);
+        if (!GlobalVariables::GP_CONFIG.StubDraws) m_Handle->DrawInstanced(numVerts, numInstances, 0, 0);
     }
 
     void GfxContext::DrawIndexedInstanced(unsigned int numIndices, unsigned int numInstances)
     {
         ContextOperation(this, "DrawIndexedInstanced");
+        FrameCounters::Increment(FrameCounter::Draws);
         if (m_ReloadShader) BindShaderToPipeline();
         m_InputAssember.PrepareForDraw(m_Shader, m_Handle);
-        m_Handle->DrawIndexedInstanced(numIndices, numInstances, 0, 0, 0);
+        if (!GlobalVariables::GP_CONFIG.StubDraws) m_Handle->DrawIndexedInstanced(numIndices, numInstances, 0, 0, 0);
     }
 
     void GfxContext::DrawFC()
@@ -325,7 +394,6 @@ namespace GP
     {
 #ifdef DEBUG
         ContextOperation(this, "BeginPass");
-        ASSERT(!m_Deferred, "[GfxContext] Trying to add debug flag to deferred context!");
         std::wstring wDebugName = StringUtil::ToWideString(debugName);
         m_DebugMarkers->BeginEvent(wDebugName.c_str());
 #endif
@@ -335,7 +403,6 @@ namespace GP
     {
 #ifdef DEBUG
         ContextOperation(this, "EndPass");
-        ASSERT(!m_Deferred, "[GfxContext] Trying to add debug flag to deferred context!");
         m_DebugMarkers->EndEvent();
 #endif
     }
@@ -343,10 +410,9 @@ namespace GP
     void GfxContext::Submit()
     {
         ContextOperation(this, "Submit");
-        if(g_Device) g_Device->SubmitContext(*this);
+        g_Device->SubmitContext(*this);
 
-        m_Handle->Release();
-        DX_CALL(g_Device->GetDevice()->CreateDeferredContext1(0, &m_Handle));
+        // FinishCommandList leaves the deferred context in its default state, so it keeps recording without being recreated
         Reset();
     }
 
@@ -362,108 +428,160 @@ namespace GP
 
     void GfxContext::Reset()
     {
+        // Only the tracked state is reset here, defaults are bound before the first draw or dispatch
+        // Contexts that only upload data never touch the pipeline state
+        m_DeviceState = nullptr;
+        m_InputAssember.Invalidate();
+        m_ReloadShader = true;
+
         if (!g_Device) return;
 
         ContextOperation(this, "Reset context");
 
-        SetRenderTarget(g_Device->GetFinalRT());
-        SetDepthStencil(g_Device->GetFinalRT());
+        m_RenderTarget = g_Device->GetFinalRT();
+        m_DepthStencil = g_Device->GetFinalRT();
+        m_PendingDefaultTargets = true;
+        m_PendingDefaultSamplers = true;
+    }
 
-        std::vector<GfxSampler*>& defaultSamplers = g_Device->GetDefaultSamplers();
-        size_t maxCustomSamplers = g_Device->GetMaxCustomSamplers();
-        ID3D11SamplerState** samplers = (ID3D11SamplerState**)malloc(defaultSamplers.size() * sizeof(ID3D11SamplerState*));
-        for (size_t i = 0; i < defaultSamplers.size(); i++)
+    void GfxContext::BindPendingDefaults()
+    {
+        if (m_PendingDefaultTargets)
         {
-            samplers[i] = defaultSamplers[i]->GetSampler();
+            SetRenderTarget(m_RenderTarget);
         }
 
-        m_Handle->VSSetSamplers(maxCustomSamplers, defaultSamplers.size(), samplers);
-        m_Handle->PSSetSamplers(maxCustomSamplers, defaultSamplers.size(), samplers);
-        m_Handle->GSSetSamplers(maxCustomSamplers, defaultSamplers.size(), samplers);
-        m_Handle->CSSetSamplers(maxCustomSamplers, defaultSamplers.size(), samplers);
+        if (m_PendingDefaultSamplers)
+        {
+            const std::vector<ID3D11SamplerState*>& samplers = g_Device->GetDefaultSamplerStates();
+            const unsigned int startSlot = (unsigned int) g_Device->GetMaxCustomSamplers();
+            const unsigned int count = (unsigned int) samplers.size();
+            ID3D11SamplerState* const* samplerData = samplers.data();
+
+            m_Handle->VSSetSamplers(startSlot, count, samplerData);
+            m_Handle->PSSetSamplers(startSlot, count, samplerData);
+            m_Handle->GSSetSamplers(startSlot, count, samplerData);
+            m_Handle->CSSetSamplers(startSlot, count, samplerData);
+            m_PendingDefaultSamplers = false;
+            FrameCounters::Increment(FrameCounter::SamplerBinds);
+        }
     }
 
     void GfxContext::BindUAV(ID3D11DeviceContext1* context, unsigned int shaderStage, ID3D11UnorderedAccessView* uav, unsigned int binding)
     {
-        ASSERT(shaderStage == CS, "[NOT_SUPPORTED] Trying to bind RW resource to stage that isn't compute shader.");
-        context->CSSetUnorderedAccessViews(binding, 1, &uav, nullptr);
+        BindUAVs(context, shaderStage, binding, 1, &uav);
     }
 
     void GfxContext::BindSRV(ID3D11DeviceContext1* context, unsigned int shaderStage, ID3D11ShaderResourceView* srv, unsigned int binding)
     {
+        BindSRVs(context, shaderStage, binding, 1, &srv);
+    }
+
+    void GfxContext::BindCB(ID3D11DeviceContext1* context, unsigned int shaderStage, ID3D11Buffer* buffer, unsigned int binding)
+    {
+        BindCBs(context, shaderStage, binding, 1, &buffer);
+    }
+
+    void GfxContext::BindUAVs(ID3D11DeviceContext1* context, unsigned int shaderStage, unsigned int startSlot, unsigned int count, ID3D11UnorderedAccessView** uavs)
+    {
+        ASSERT(shaderStage == CS, "[NOT_SUPPORTED] Trying to bind RW resource to stage that isn't compute shader.");
+        FrameCounters::Increment(FrameCounter::RWResourceBinds);
+        context->CSSetUnorderedAccessViews(startSlot, count, uavs, nullptr);
+    }
+
+    void GfxContext::BindSRVs(ID3D11DeviceContext1* context, unsigned int shaderStage, unsigned int startSlot, unsigned int count, ID3D11ShaderResourceView** srvs)
+    {
+        FrameCounters::Increment(FrameCounter::ResourceBinds);
+
         if (shaderStage & VS)
-            context->VSSetShaderResources(binding, 1, &srv);
+            context->VSSetShaderResources(startSlot, count, srvs);
 
         if (shaderStage & GS)
-            context->GSSetShaderResources(binding, 1, &srv);
+            context->GSSetShaderResources(startSlot, count, srvs);
 
         if (shaderStage & PS)
-            context->PSSetShaderResources(binding, 1, &srv);
+            context->PSSetShaderResources(startSlot, count, srvs);
 
         if (shaderStage & HS)
-            context->HSSetShaderResources(binding, 1, &srv);
+            context->HSSetShaderResources(startSlot, count, srvs);
 
         if (shaderStage & DS)
-            context->DSSetShaderResources(binding, 1, &srv);
+            context->DSSetShaderResources(startSlot, count, srvs);
 
         if (shaderStage & CS)
-            context->CSSetShaderResources(binding, 1, &srv);
+            context->CSSetShaderResources(startSlot, count, srvs);
     }
 
-    void GfxContext::BindCB(ID3D11DeviceContext1* context, unsigned int shaderStage, ID3D11Buffer* buffer, unsigned int binding)
+    void GfxContext::BindCBs(ID3D11DeviceContext1* context, unsigned int shaderStage, unsigned int startSlot, unsigned int count, ID3D11Buffer** buffers)
     {
+        FrameCounters::Increment(FrameCounter::ConstantBufferBinds);
+
         if (shaderStage & VS)
-            context->VSSetConstantBuffers(binding, 1, &buffer);
+            context->VSSetConstantBuffers(startSlot, count, buffers);
 
         if (shaderStage & GS)
-            context->GSSetConstantBuffers(binding, 1, &buffer);
+            context->GSSetConstantBuffers(startSlot, count, buffers);
 
         if (shaderStage & PS)
-            context->PSSetConstantBuffers(binding, 1, &buffer);
+            context->PSSetConstantBuffers(startSlot, count, buffers);
 
         if (shaderStage & CS)
-            context->CSSetConstantBuffers(binding, 1, &buffer);
+            context->CSSetConstantBuffers(startSlot, count, buffers);
 
         if (shaderStage & HS)
-            context->HSSetConstantBuffers(binding, 1, &buffer);
+            context->HSSetConstantBuffers(startSlot, count, buffers);
 
         if (shaderStage & DS)
-            context->DSSetConstantBuffers(binding, 1, &buffer);
+            context->DSSetConstantBuffers(startSlot, count, buffers);
     }
 
     void GfxContext::BindRT(ID3D11DeviceContext1* context, unsigned int numRTs, ID3D11RenderTargetView** rtvs, ID3D11DepthStencilView* dsv, int width, int height)
     {
         const D3D11_VIEWPORT viewport = { 0.0f, 0.0f, (float)width, (float)height, 0.0f, 1.0f };
         if (width > 0) context->RSSetViewports(1, &viewport);
+        FrameCounters::Increment(FrameCounter::RenderTargetBinds);
         context->OMSetRenderTargets(numRTs, rtvs, dsv);        m_ReloadShader = true;
     }
 
     void GfxContext::BindSamplerState(ID3D11DeviceContext1* context, unsigned int shaderStage, ID3D11SamplerState* sampler, unsigned int binding)
     {
-        ASSERT(binding < g_Device->GetMaxCustomSamplers(), "[GfxDevice::BindSampler] " + std::to_string(binding) + " is out of the limit, maximum binding is " + std::to_string(g_Device->GetMaxCustomSamplers() - 1));
+        BindSamplerStates(context, shaderStage, binding, 1, &sampler);
+    }
+
+    void GfxContext::BindSamplerStates(ID3D11DeviceContext1* context, unsigned int shaderStage, unsigned int startSlot, unsigned int count, ID3D11SamplerState** samplers)
+    {
+        ASSERT(startSlot + count <= g_Device->GetMaxCustomSamplers(), "[GfxDevice::BindSampler] " + std::to_string(startSlot + count - 1) + " is out of the limit, maximum binding is " + std::to_string(g_Device->GetMaxCustomSamplers() - 1));
+        FrameCounters::Increment(FrameCounter::SamplerBinds);
 
         if (shaderStage & VS)
-            context->VSSetSamplers(binding, 1, &sampler);
+            context->VSSetSamplers(startSlot, count, samplers);
 
         if (shaderStage & GS)
-            context->GSSetSamplers(binding, 1, &sampler);
+            context->GSSetSamplers(startSlot, count, samplers);
 
         if (shaderStage & PS)
-            context->PSSetSamplers(binding, 1, &sampler);
+            context->PSSetSamplers(startSlot, count, samplers);
 
         if (shaderStage & CS)
-            context->CSSetSamplers(binding, 1, &sampler);
+            context->CSSetSamplers(startSlot, count, samplers);
 
         if (shaderStage & HS)
-            context->HSSetSamplers(binding, 1, &sampler);
+            context->HSSetSamplers(startSlot, count, samplers);
 
         if (shaderStage & DS)
-            context->DSSetSamplers(binding, 1, &sampler);
+            context->DSSetSamplers(startSlot, count, samplers);
     }
 
     void GfxContext::BindDeviceState(GfxDeviceState* deviceState)
     {
         ContextOperation(this, "Bind device state");
+
+        // States are shared between shaders with the same header, switching between them doesn't need a rebind
+        if (deviceState == m_DeviceState && deviceState->Key == m_DeviceStateKey) return;
+        m_DeviceState = deviceState;
+        m_DeviceStateKey = deviceState->Key;
+        FrameCounters::Increment(FrameCounter::DeviceStateBinds);
+
         const FLOAT blendFactor[] = { 1.0f,1.0f,1.0f,1.0f };
         m_Handle->RSSetState(deviceState->Rasterizer);
         m_Handle->OMSetDepthStencilState(deviceState->DepthStencil, m_StencilRef);
@@ -474,6 +592,9 @@ namespace GP
     void GfxContext::BindShaderToPipeline()
     {
         ContextOperation(this, "Bind shader to pipeline");
+        FrameCounters::Increment(FrameCounter::ShaderBinds);
+        BindPendingDefaults();
+
         if (m_Shader && !m_Shader->IsInitialized())
         {
             m_Shader->Initialize();
@@ -514,6 +635,7 @@ namespace GP
         if (!renderTarget->Initialized()) renderTarget->Initialize(this);
 
         m_RenderTarget = renderTarget;
+        m_PendingDefaultTargets = false;
 
         unsigned int numRTs = m_RenderTarget ? m_RenderTarget->GetNumRTs() : 0;
         ID3D11RenderTargetView** rtvs = m_RenderTarget ? m_RenderTarget->GetRTVs() : nullptr;
@@ -555,6 +677,12 @@ namespace GP
             d3dDebug->Release();
         }
 
+        InitDebugMarkers();
+    }
+
+    void GfxContext::InitDebugMarkers()
+    {
+        // Markers recorded on deferred contexts end up in their command list
         DX_CALL(m_Handle->QueryInterface(__uuidof(ID3DUserDefinedAnnotation), (void**)&m_DebugMarkers));
     }
 #endif // DEBUG
@@ -591,6 +719,9 @@ namespace GP
         for (GfxSampler* sampler : m_Samplers) delete sampler;
         m_SwapChain->Release();
         delete m_ImmediateContext;
+
+        ID3D11DeviceContext1* deferredContext = nullptr;
+        while (m_DeferredContextPool.TryPop(deferredContext)) deferredContext->Release();
         m_Device->Release();
 
 #ifdef DEBUG
@@ -611,6 +742,7 @@ namespace GP
         // Execute pending command lists
         m_PendingCommandLists.ForEachAndClear([this](ID3D11CommandList* cmdList) {
             m_ImmediateContext->GetHandle()->ExecuteCommandList(cmdList, TRUE);
+            cmdList->Release();
             });
         m_PendingCommandLists.Clear();
 
@@ -618,6 +750,46 @@ namespace GP
         m_SwapChain->Present(GlobalVariables::GP_CONFIG.VSYNC ? 1 : 0, 0);
     }
 
+    namespace
+    {
+        thread_local GfxContext* t_CurrentContext = nullptr;
+    }
+
+    GfxContext* GfxDevice::GetCurrentContext() const
+    {
+        return t_CurrentContext ? t_CurrentContext : m_ImmediateContext;
+    }
+
+    void GfxDevice::SetCurrentContext(GfxContext* context)
+    {
+        t_CurrentContext = context;
+    }
+
+    void GfxDevice::ExecuteContext(GfxContext& context)
+    {
+        // Executed right away on the immediate context, unlike SubmitContext which waits for the end of the frame
+        ID3D11CommandList* commandList = context.CreateCommandList();
+        m_DeviceContext->ExecuteCommandList(commandList, TRUE);
+        commandList->Release();
+        context.Reset();
+    }
+
+    ID3D11DeviceContext1* GfxDevice::AcquireDeferredContext()
+    {
+        ID3D11DeviceContext1* context = nullptr;
+        if (!m_DeferredContextPool.TryPop(context))
+        {
+            DX_CALL(m_Device->CreateDeferredContext1(0, &context));
+        }
+        return context;
+    }
+
+    void GfxDevice::ReleaseDeferredContext(ID3D11DeviceContext1* context)
+    {
+        // Owner submits before releasing, so the context is empty and in its default state
+        m_DeferredContextPool.Add(context);
+    }
+
     bool GfxDevice::CreateDevice()
     {
         ID3D11Device* baseDevice;
@@ -695,6 +867,9 @@ namespace GP
         m_Samplers[3] = new GfxSampler(SamplerFilter::Linear, SamplerMode::Wrap);
 
         m_MaxCustomSamplers = 16 - m_Samplers.size();
+
+        m_SamplerStates.resize(m_Samplers.size());
+        for (size_t i = 0; i < m_Samplers.size(); i++) m_SamplerStates[i] = m_Samplers[i]->GetSampler();
     }
 }
 
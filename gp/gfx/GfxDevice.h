@@ -26,6 +26,7 @@ struct ID3DUserDefinedAnnotation;
 namespace GP
 {
 	class GfxShader;
+	class GfxParameterBlock;
 	struct GfxDeviceState;
 	class GfxContext;
 
@@ -139,6 +140,9 @@ namespace GP
 
 		void PrepareForDraw(GfxShader* shader, ID3D11DeviceContext1* context);
 
+		// Device side state was lost, everything is bound again on the next draw
+		inline void Invalidate() { m_Dirty = true; }
+
 	private:
 		bool m_Dirty = true;
 
@@ -177,6 +181,7 @@ namespace GP
 		inline void BindCubemap(unsigned int shaderStage, GfxBaseTexture2D* texture, unsigned int binding);
 		inline void UnbindTexture(unsigned int shaderStage, unsigned int binding);
 		inline void BindSampler(unsigned int shaderStage, GfxSampler* sampler, unsigned int binding);
+		GP_DLL void BindParameterBlock(GfxParameterBlock* parameterBlock);
 		inline void SetDepthStencil(GfxRenderTarget* depthStencil);
 
 		inline void UploadToBuffer(GfxBuffer* gfxBuffer, const void* data, unsigned int numBytes, unsigned int offset);
@@ -226,12 +231,18 @@ namespace GP
 		GP_DLL void BindCB(ID3D11DeviceContext1* context, unsigned int shaderStage, ID3D11Buffer* buffer, unsigned int binding);
 		GP_DLL void BindRT(ID3D11DeviceContext1* context, unsigned int numRTs, ID3D11RenderTargetView** rtvs, ID3D11DepthStencilView* dsv, int width, int height);
 		GP_DLL void BindSamplerState(ID3D11DeviceContext1* context, unsigned int shaderStage, ID3D11SamplerState* sampler, unsigned int binding);
+		GP_DLL void BindUAVs(ID3D11DeviceContext1* context, unsigned int shaderStage, unsigned int startSlot, unsigned int count, ID3D11UnorderedAccessView** uavs);
+		GP_DLL void BindSRVs(ID3D11DeviceContext1* context, unsigned int shaderStage, unsigned int startSlot, unsigned int count, ID3D11ShaderResourceView** srvs);
+		GP_DLL void BindCBs(ID3D11DeviceContext1* context, unsigned int shaderStage, unsigned int startSlot, unsigned int count, ID3D11Buffer** buffers);
+		GP_DLL void BindSamplerStates(ID3D11DeviceContext1* context, unsigned int shaderStage, unsigned int startSlot, unsigned int count, ID3D11SamplerState** samplers);
 		GP_DLL void BindDeviceState(GfxDeviceState* deviceState);
 
 		GP_DLL void BindShaderToPipeline();
+		GP_DLL void BindPendingDefaults();
 
 #ifdef DEBUG
 		void InitDebugLayer();
+		void InitDebugMarkers();
 #endif
 
 	private:
@@ -245,6 +256,12 @@ namespace GP
 		GfxRenderTarget* m_DepthStencil = nullptr;
 		GfxShader* m_Shader = nullptr;
 		bool m_ReloadShader = false;
+		GfxDeviceState* m_DeviceState = nullptr;
+		unsigned long long m_DeviceStateKey = 0;
+
+		// Defaults set by Reset that are not yet bound to the device context
+		bool m_PendingDefaultTargets = false;
+		bool m_PendingDefaultSamplers = false;
 
 #ifdef DEBUG
 		ID3DUserDefinedAnnotation* m_DebugMarkers;
@@ -271,8 +288,20 @@ namespace GP
 			m_PendingCommandLists.Add(context.CreateCommandList());
 		}
 
+		// Records and executes the context now, in order with the work already on the immediate context
+		void ExecuteContext(GfxContext& context);
+
+		// Context of the pass being recorded on the calling thread, immediate context outside of parallel recording
+		GfxContext* GetCurrentContext() const;
+		void SetCurrentContext(GfxContext* context);
+
+		// Deferred contexts are kept when their GfxContext is destroyed and handed to the next one that is created
+		ID3D11DeviceContext1* AcquireDeferredContext();
+		void ReleaseDeferredContext(ID3D11DeviceContext1* context);
+
 		inline size_t GetMaxCustomSamplers() const { return m_MaxCustomSamplers; }
 		inline std::vector<GfxSampler*>& GetDefaultSamplers() { return m_Samplers; }
+		inline const std::vector<ID3D11SamplerState*>& GetDefaultSamplerStates() const { return m_SamplerStates; }
 		inline GfxRenderTarget* GetFinalRT() const { return m_FinalRT; }
 
 		// NOTE: Be careful when using this not to run into MTR issues
@@ -295,6 +324,7 @@ namespace GP
 		// Context
 		GfxContext* m_ImmediateContext;
 		MutexVector<ID3D11CommandList*> m_PendingCommandLists;
+		MutexVector<ID3D11DeviceContext1*> m_DeferredContextPool;
 
 		// Default state
 		GfxRenderTarget* m_FinalRT;
@@ -302,6 +332,7 @@ namespace GP
 		// Statics
 		unsigned int m_MaxCustomSamplers;
 		std::vector<GfxSampler*> m_Samplers;
+		std::vector<ID3D11SamplerState*> m_SamplerStates;
 	};
 
 	GP_DLL extern GfxDevice* g_Device;
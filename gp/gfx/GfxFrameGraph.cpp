@@ -0,0 +1,286 @@
+#include "GfxFrameGraph.h"
+
+#include "core/RenderPass.h"
+#include "core/Threads.h"
+#include "gfx/GfxDevice.h"
+#include "gfx/ScopedOperations.h"
+
+namespace GP
+{
+	FrameGraph* g_FrameGraph = nullptr;
+
+	namespace
+	{
+		inline std::string ToMB(size_t bytes)
+		{
+			return std::to_string(bytes / (1024.0f * 1024.0f)) + " MB";
+		}
+	}
+
+	///////////////////////////////////////
+	//			Builder					//
+	/////////////////////////////////////
+
+	FrameGraphResource FrameGraphBuilder::CreateRenderTarget(const std::string& name, const RenderTargetConfig& config)
+	{
+		const FrameGraphResource resource = (FrameGraphResource) m_FrameGraph.m_Resources.size();
+		FrameGraph::VirtualResource& virtualResource = m_FrameGraph.m_Resources.emplace_back();
+		virtualResource.Name = name;
+		virtualResource.Config = config;
+		return Write(resource);
+	}
+
+	FrameGraphResource FrameGraphBuilder::Read(FrameGraphResource resource)
+	{
+		ASSERT(resource < m_FrameGraph.m_Resources.size(), "[FrameGraph] Reading invalid resource");
+		m_FrameGraph.m_Passes[m_PassIndex].Reads.push_back(resource);
+		return resource;
+	}
+
+	FrameGraphResource FrameGraphBuilder::Write(FrameGraphResource resource)
+	{
+		ASSERT(resource < m_FrameGraph.m_Resources.size(), "[FrameGraph] Writing invalid resource");
+		m_FrameGraph.m_Passes[m_PassIndex].Writes.push_back(resource);
+		return resource;
+	}
+
+	void FrameGraphBuilder::SetSideEffect()
+	{
+		m_FrameGraph.m_Passes[m_PassIndex].SideEffect = true;
+	}
+
+	void FrameGraphBuilder::SetParallel()
+	{
+		m_FrameGraph.m_Passes[m_PassIndex].Parallel = true;
+	}
+
+	///////////////////////////////////////
+	//			Frame graph				//
+	/////////////////////////////////////
+
+	FrameGraph::~FrameGraph()
+	{
+		for (GfxContext* recordingContext : m_RecordingContexts) delete recordingContext;
+	}
+
+	void FrameGraph::AddPass(const std::string& name, const SetupFunc& setup, const ExecuteFunc& execute)
+	{
+		const unsigned int passIndex = (unsigned int) m_Passes.size();
+		Pass& pass = m_Passes.emplace_back();
+		pass.Name = name;
+		pass.Execute = execute;
+
+		FrameGraphBuilder builder{ *this, passIndex };
+		setup(builder);
+	}
+
+	void FrameGraph::AddRenderPass(RenderPass* renderPass)
+	{
+		// Render pass adds its own profile markers, so the graph pass has no name
+		AddPass("", [renderPass](FrameGraphBuilder& builder) {
+			builder.SetSideEffect();
+			if (renderPass->CanRecordInParallel()) builder.SetParallel();
+			}, [renderPass](GfxContext* context, const FrameGraph&) {
+				renderPass->Render(context);
+			});
+
+		Pass& pass = m_Passes.back();
+		if (pass.Parallel) pass.Prepare = [renderPass](GfxContext* context) { renderPass->PrepareParallel(context); };
+	}
+
+	FrameGraphResource FrameGraph::ImportRenderTarget(const std::string& name, GfxRenderTarget* renderTarget)
+	{
+		const FrameGraphResource resource = (FrameGraphResource) m_Resources.size();
+		VirtualResource& virtualResource = m_Resources.emplace_back();
+		virtualResource.Name = name;
+		virtualResource.Imported = true;
+		virtualResource.ImportedRenderTarget = renderTarget;
+		return resource;
+	}
+
+	void FrameGraph::Compile()
+	{
+		GP_SCOPED_CPU_PROFILE("FrameGraph::Compile");
+
+		const FrameGraphStats lastStats = m_Stats;
+		m_Stats = {};
+		m_Stats.NumPasses = (unsigned int) m_Passes.size();
+
+		// Walking backwards, a pass is needed if it has side effects or writes a resource that a later needed pass reads
+		for (VirtualResource& resource : m_Resources) resource.Needed = resource.Imported;
+		for (size_t i = m_Passes.size(); i-- > 0;)
+		{
+			Pass& pass = m_Passes[i];
+			pass.Culled = !pass.SideEffect;
+			for (FrameGraphResource resource : pass.Writes)
+			{
+				if (m_Resources[resource].Needed) pass.Culled = false;
+			}
+
+			if (pass.Culled)
+			{
+				m_Stats.NumCulledPasses++;
+				continue;
+			}
+
+			for (FrameGraphResource resource : pass.Reads) m_Resources[resource].Needed = true;
+		}
+
+		// Lifetime of a resource is from the first to the last pass that wasn't culled and uses it
+		const auto forEveryResource = [](Pass& pass, auto func) {
+			for (FrameGraphResource resource : pass.Reads) func(resource);
+			for (FrameGraphResource resource : pass.Writes) func(resource);
+		};
+
+		for (unsigned int i = 0; i < m_Passes.size(); i++)
+		{
+			if (m_Passes[i].Culled) continue;
+			forEveryResource(m_Passes[i], [this, i](FrameGraphResource resource) {
+				VirtualResource& virtualResource = m_Resources[resource];
+				if (!virtualResource.Used) virtualResource.FirstPass = i;
+				virtualResource.LastPass = i;
+				virtualResource.Used = true;
+				});
+		}
+
+		// Render targets are taken at the first use of a resource and given back after its last use,
+		// so the next resource with the same config can reuse them
+		for (unsigned int i = 0; i < m_Passes.size(); i++)
+		{
+			if (m_Passes[i].Culled) continue;
+
+			forEveryResource(m_Passes[i], [this, i](FrameGraphResource resource) {
+				VirtualResource& virtualResource = m_Resources[resource];
+				if (virtualResource.Imported || virtualResource.FirstPass != i || virtualResource.Physical) return;
+				virtualResource.Physical = AcquirePhysical(virtualResource.Config);
+				m_Stats.NumTransientResources++;
+				m_Stats.TransientBytesWithoutAliasing += virtualResource.Physical->NumBytes;
+				});
+
+			if (!m_AliasingEnabled) continue;
+
+			forEveryResource(m_Passes[i], [this, i](FrameGraphResource resource) {
+				VirtualResource& virtualResource = m_Resources[resource];
+				if (!virtualResource.Physical || virtualResource.LastPass != i) return;
+				for (FrameRenderTarget& frameRenderTarget : m_FrameRenderTargets)
+				{
+					if (frameRenderTarget.Target == virtualResource.Physical) frameRenderTarget.Free = true;
+				}
+				});
+		}
+
+		for (const FrameRenderTarget& frameRenderTarget : m_FrameRenderTargets)
+		{
+			m_Stats.NumPhysicalResources++;
+			m_Stats.TransientBytes += frameRenderTarget.Target->NumBytes;
+		}
+
+		if (m_Stats.NumPasses != lastStats.NumPasses || m_Stats.NumCulledPasses != lastStats.NumCulledPasses || m_Stats.TransientBytes != lastStats.TransientBytes || m_Stats.TransientBytesWithoutAliasing != lastStats.TransientBytesWithoutAliasing)
+		{
+			CONSOLE_LOG("[FrameGraph] " + std::to_string(m_Stats.NumPasses) + " passes (" + std::to_string(m_Stats.NumCulledPasses) + " culled), " +
+				std::to_string(m_Stats.NumTransientResources) + " transient render targets in " + std::to_string(m_Stats.NumPhysicalResources) + " allocations, " +
+				ToMB(m_Stats.TransientBytes) + " (" + ToMB(m_Stats.TransientBytesWithoutAliasing) + " without aliasing)");
+		}
+	}
+
+	PooledRenderTarget* FrameGraph::AcquirePhysical(const RenderTargetConfig& config)
+	{
+		for (FrameRenderTarget& frameRenderTarget : m_FrameRenderTargets)
+		{
+			if (!frameRenderTarget.Free || frameRenderTarget.Target->Config != config) continue;
+
+			frameRenderTarget.Free = false;
+			return frameRenderTarget.Target;
+		}
+
+		// Pool keeps it reserved until the end of the frame, so nothing outside of the graph gets it while passes execute
+		FrameRenderTarget& frameRenderTarget = m_FrameRenderTargets.emplace_back();
+		frameRenderTarget.Target = g_RenderTargetPool->Acquire(config);
+		return frameRenderTarget.Target;
+	}
+
+	void FrameGraph::Execute(GfxContext* context)
+	{
+		// Consecutive passes that can record in parallel are recorded together, command lists still execute in pass order
+		for (unsigned int i = 0; i < m_Passes.size();)
+		{
+			if (m_Passes[i].Culled)
+			{
+				i++;
+				continue;
+			}
+
+			if (!m_Passes[i].Parallel)
+			{
+				ExecutePass(m_Passes[i++], context);
+				continue;
+			}
+
+			m_ParallelBatch.clear();
+			for (; i < m_Passes.size() && (m_Passes[i].Culled || m_Passes[i].Parallel); i++)
+			{
+				if (!m_Passes[i].Culled) m_ParallelBatch.push_back(i);
+			}
+			RecordParallel(m_ParallelBatch, context);
+		}
+	}
+
+	void FrameGraph::ExecutePass(Pass& pass, GfxContext* context)
+	{
+		if (pass.Name.empty())
+		{
+			pass.Execute(context, *this);
+			return;
+		}
+
+		GP_SCOPED_PROFILE(pass.Name);
+		pass.Execute(context, *this);
+	}
+
+	void FrameGraph::RecordParallel(const std::vector<unsigned int>& passes, GfxContext* context)
+	{
+		const unsigned int numPasses = (unsigned int) passes.size();
+		while (m_RecordingContexts.size() < numPasses) m_RecordingContexts.push_back(new GfxContext());
+
+		// Shared buffers are uploaded before any pass records, so recorded passes only read them no matter in which order they run
+		for (unsigned int pass : passes)
+		{
+			if (m_Passes[pass].Prepare) m_Passes[pass].Prepare(context);
+		}
+
+		ThreadUtil::ParallelFor(numPasses, [this, &passes](unsigned int index) {
+			GfxContext* recordingContext = m_RecordingContexts[index];
+			g_Device->SetCurrentContext(recordingContext);
+			ExecutePass(m_Passes[passes[index]], recordingContext);
+			g_Device->SetCurrentContext(nullptr);
+			});
+
+		for (unsigned int i = 0; i < numPasses; i++) g_Device->ExecuteContext(*m_RecordingContexts[i]);
+	}
+
+	void FrameGraph::Reset()
+	{
+		m_Passes.clear();
+		m_Resources.clear();
+		m_FrameRenderTargets.clear();
+	}
+
+	GfxRenderTarget* FrameGraph::GetRenderTarget(FrameGraphResource resource) const
+	{
+		ASSERT(resource < m_Resources.size(), "[FrameGraph] Invalid resource");
+		const VirtualResource& virtualResource = m_Resources[resource];
+		if (virtualResource.Imported) return virtualResource.ImportedRenderTarget;
+
+		ASSERT(virtualResource.Physical, "[FrameGraph] Resource " + virtualResource.Name + " is used by a pass that didn't declare it");
+		return virtualResource.Physical->RenderTarget;
+	}
+
+	GfxTexture2D* FrameGraph::GetTexture(FrameGraphResource resource, unsigned int index) const
+	{
+		ASSERT(resource < m_Resources.size(), "[FrameGraph] Invalid resource");
+		const VirtualResource& virtualResource = m_Resources[resource];
+		ASSERT(!virtualResource.Imported, "[FrameGraph] Textures of imported render targets are not supported");
+		ASSERT(virtualResource.Physical, "[FrameGraph] Resource " + virtualResource.Name + " is used by a pass that didn't declare it");
+		return virtualResource.Physical->Textures[index];
+	}
+}
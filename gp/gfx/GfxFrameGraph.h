@@ -0,0 +1,149 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <functional>
+
+#include "Common.h"
+#include "gfx/GfxTexture.h"
+#include "gfx/GfxRenderTargetPool.h"
+
+namespace GP
+{
+	class GfxContext;
+	class RenderPass;
+	class FrameGraph;
+
+	using FrameGraphResource = unsigned int;
+
+	struct FrameGraphStats
+	{
+		unsigned int NumPasses = 0;
+		unsigned int NumCulledPasses = 0;
+		unsigned int NumTransientResources = 0;
+		unsigned int NumPhysicalResources = 0;
+
+		// Memory of transient render targets used this frame, with and without sharing allocations between them
+		size_t TransientBytes = 0;
+		size_t TransientBytesWithoutAliasing = 0;
+	};
+
+	// Declares what a frame graph pass reads and writes, only valid inside the setup function of the pass
+	class FrameGraphBuilder
+	{
+		friend class FrameGraph;
+	public:
+		// Transient render target that lives from the first to the last pass using it, written by this pass
+		GP_DLL FrameGraphResource CreateRenderTarget(const std::string& name, const RenderTargetConfig& config);
+
+		GP_DLL FrameGraphResource Read(FrameGraphResource resource);
+		GP_DLL FrameGraphResource Write(FrameGraphResource resource);
+
+		// Pass is never culled, used for passes that draw to imported targets or to the screen
+		GP_DLL void SetSideEffect();
+
+		// Pass is recorded on a worker thread with its own deferred context, see RenderPass::CanRecordInParallel
+		GP_DLL void SetParallel();
+
+	private:
+		FrameGraphBuilder(FrameGraph& frameGraph, unsigned int passIndex) :
+			m_FrameGraph(frameGraph),
+			m_PassIndex(passIndex) {}
+
+	private:
+		FrameGraph& m_FrameGraph;
+		unsigned int m_PassIndex;
+	};
+
+	// Passes are added every frame in the order they execute and declare the virtual resources they use.
+	// Compile culls passes whose results are never used and assigns render targets from the RenderTargetPool to transient resources,
+	// resources with the same config whose lifetimes don't overlap share one render target.
+	// D3D11 has no placed resources, so aliasing is done by sharing whole render targets instead of memory ranges.
+	class FrameGraph
+	{
+		DELETE_COPY_CONSTRUCTOR(FrameGraph);
+		friend class FrameGraphBuilder;
+	public:
+		using SetupFunc = std::function<void(FrameGraphBuilder& builder)>;
+		using ExecuteFunc = std::function<void(GfxContext* context, const FrameGraph& frameGraph)>;
+		using PrepareFunc = std::function<void(GfxContext* context)>;
+
+		FrameGraph() {}
+		GP_DLL ~FrameGraph();
+
+		// Setup is called right away, resources it created can be used by passes added after it
+		GP_DLL void AddPass(const std::string& name, const SetupFunc& setup, const ExecuteFunc& execute);
+
+		// Pass without declared resources, never culled
+		GP_DLL void AddRenderPass(RenderPass* renderPass);
+
+		// Render target owned outside of the graph, passes writing to it are never culled
+		GP_DLL FrameGraphResource ImportRenderTarget(const std::string& name, GfxRenderTarget* renderTarget);
+
+		void Compile();
+		void Execute(GfxContext* context);
+
+		// Clears passes and resources of this frame, render targets go back to the pool at the end of the frame
+		void Reset();
+
+		// Only valid while the graph is executing
+		GP_DLL GfxRenderTarget* GetRenderTarget(FrameGraphResource resource) const;
+		GP_DLL GfxTexture2D* GetTexture(FrameGraphResource resource, unsigned int index = 0) const;
+
+		inline void SetAliasingEnabled(bool enabled) { m_AliasingEnabled = enabled; }
+		inline const FrameGraphStats& GetStats() const { return m_Stats; }
+
+	private:
+		// Pool target reserved by the graph for the whole frame, free once the last resource placed in it was used
+		struct FrameRenderTarget
+		{
+			PooledRenderTarget* Target = nullptr;
+			bool Free = false;
+		};
+
+		struct VirtualResource
+		{
+			std::string Name;
+			RenderTargetConfig Config;
+			bool Imported = false;
+			GfxRenderTarget* ImportedRenderTarget = nullptr;
+
+			// Compiled
+			bool Needed = false;
+			bool Used = false;
+			unsigned int FirstPass = 0;
+			unsigned int LastPass = 0;
+			PooledRenderTarget* Physical = nullptr;
+		};
+
+		struct Pass
+		{
+			std::string Name;
+			ExecuteFunc Execute;
+			PrepareFunc Prepare; // Parallel passes only, called on the immediate context before recording
+			std::vector<FrameGraphResource> Reads;
+			std::vector<FrameGraphResource> Writes;
+			bool SideEffect = false;
+			bool Parallel = false;
+
+			// Compiled
+			bool Culled = false;
+		};
+
+		PooledRenderTarget* AcquirePhysical(const RenderTargetConfig& config);
+		void ExecutePass(Pass& pass, GfxContext* context);
+		void RecordParallel(const std::vector<unsigned int>& passes, GfxContext* context);
+
+	private:
+		std::vector<Pass> m_Passes;
+		std::vector<VirtualResource> m_Resources;
+		std::vector<FrameRenderTarget> m_FrameRenderTargets;
+		std::vector<GfxContext*> m_RecordingContexts;
+		std::vector<unsigned int> m_ParallelBatch;
+
+		bool m_AliasingEnabled = true;
+		FrameGraphStats m_Stats;
+	};
+
+	GP_DLL extern FrameGraph* g_FrameGraph;
+}
@@ -0,0 +1,339 @@
+#include "GfxGPUProfiler.h"
+
+#include <d3d11_1.h>
+#include <algorithm>
+#include <cstring>
+
+#include "gfx/GfxDevice.h"
+
+namespace GP
+{
+	GPUProfiler* g_GPUProfiler = nullptr;
+
+	namespace
+	{
+		static constexpr float AVG_WEIGHT = 0.1f; // Weight of the newest frame in the moving average
+
+		thread_local unsigned int t_ScopeDepth = 0;
+
+		class D3D11TimestampBackend : public GPUTimestampBackend
+		{
+			static constexpr unsigned int NUM_QUERIES = GPUProfiler::MAX_SCOPES * 2;
+		public:
+			D3D11TimestampBackend()
+			{
+				ID3D11Device1* device = g_Device->GetDevice();
+
+				D3D11_QUERY_DESC disjointDesc = {};
+				disjointDesc.Query = D3D11_QUERY_TIMESTAMP_DISJOINT;
+
+				D3D11_QUERY_DESC timestampDesc = {};
+				timestampDesc.Query = D3D11_QUERY_TIMESTAMP;
+
+				// Queries are created up front, scopes recorded in parallel write them from several threads
+				for (FrameQueries& frame : m_Frames)
+				{
+					DX_CALL(device->CreateQuery(&disjointDesc, &frame.Disjoint));
+					for (ID3D11Query*& query : frame.Timestamps) DX_CALL(device->CreateQuery(&timestampDesc, &query));
+				}
+			}
+
+			~D3D11TimestampBackend()
+			{
+				for (FrameQueries& frame : m_Frames)
+				{
+					SAFE_RELEASE(frame.Disjoint);
+					for (ID3D11Query*& query : frame.Timestamps) SAFE_RELEASE(query);
+				}
+			}
+
+			void BeginFrame(unsigned int frameSlot) override
+			{
+				g_Device->GetImmediateContext()->GetHandle()->Begin(m_Frames[frameSlot].Disjoint);
+			}
+
+			void EndFrame(unsigned int frameSlot) override
+			{
+				g_Device->GetImmediateContext()->GetHandle()->End(m_Frames[frameSlot].Disjoint);
+			}
+
+			void WriteTimestamp(GfxContext* context, unsigned int frameSlot, unsigned int query) override
+			{
+				context->GetHandle()->End(m_Frames[frameSlot].Timestamps[query]);
+			}
+
+			bool ReadFrame(unsigned int frameSlot, unsigned int numQueries, unsigned long long* timestamps, unsigned long long& frequency, bool& disjoint) override
+			{
+				ID3D11DeviceContext1* context = g_Device->GetImmediateContext()->GetHandle();
+				const FrameQueries& frame = m_Frames[frameSlot];
+
+				D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjointData;
+				if (context->GetData(frame.Disjoint, &disjointData, sizeof(disjointData), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK) return false;
+
+				for (unsigned int i = 0; i < numQueries; i++)
+				{
+					if (context->GetData(frame.Timestamps[i], &timestamps[i], sizeof(UINT64), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK) return false;
+				}
+
+				frequency = disjointData.Frequency;
+				disjoint = disjointData.Disjoint;
+				return true;
+			}
+
+		private:
+			struct FrameQueries
+			{
+				ID3D11Query* Disjoint = nullptr;
+				ID3D11Query* Timestamps[NUM_QUERIES] = {};
+			};
+
+			FrameQueries m_Frames[GPUProfiler::NUM_FRAME_SLOTS];
+		};
+
+		// Frame results become available a fixed number of frames after the frame ended, nothing completes while stalled.
+		// Every timestamp written advances the fake GPU clock by one tick.
+		class FakeTimestampBackend : public GPUTimestampBackend
+		{
+		public:
+			static constexpr unsigned long long FREQUENCY = 1000; // One tick is a millisecond
+
+			FakeTimestampBackend(unsigned int latency) :
+				m_Latency(latency) {}
+
+			void BeginFrame(unsigned int frameSlot) override {}
+
+			void EndFrame(unsigned int frameSlot) override
+			{
+				m_NumEndedFrames++;
+				m_Frames[frameSlot].EndedFrame = m_NumEndedFrames;
+				m_Frames[frameSlot].Disjoint = m_DisjointNextFrame;
+				m_DisjointNextFrame = false;
+			}
+
+			void WriteTimestamp(GfxContext* context, unsigned int frameSlot, unsigned int query) override
+			{
+				m_Frames[frameSlot].Timestamps[query] = ++m_Clock;
+			}
+
+			bool ReadFrame(unsigned int frameSlot, unsigned int numQueries, unsigned long long* timestamps, unsigned long long& frequency, bool& disjoint) override
+			{
+				const FakeFrame& frame = m_Frames[frameSlot];
+				if (m_Stalled || m_NumEndedFrames - frame.EndedFrame < m_Latency) return false;
+
+				for (unsigned int i = 0; i < numQueries; i++) timestamps[i] = frame.Timestamps[i];
+				frequency = FREQUENCY;
+				disjoint = frame.Disjoint;
+				return true;
+			}
+
+			inline void SetStalled(bool stalled) { m_Stalled = stalled; }
+			inline void SetDisjointNextFrame() { m_DisjointNextFrame = true; }
+
+		private:
+			struct FakeFrame
+			{
+				unsigned long long EndedFrame = 0;
+				bool Disjoint = false;
+				unsigned long long Timestamps[GPUProfiler::MAX_SCOPES * 2] = {};
+			};
+
+			unsigned int m_Latency;
+			unsigned long long m_NumEndedFrames = 0;
+			unsigned long long m_Clock = 0;
+			bool m_Stalled = false;
+			bool m_DisjointNextFrame = false;
+			FakeFrame m_Frames[GPUProfiler::NUM_FRAME_SLOTS];
+		};
+	}
+
+	GPUTimestampBackend* CreateD3D11TimestampBackend()
+	{
+		return new D3D11TimestampBackend();
+	}
+
+	GPUProfiler::GPUProfiler(GPUTimestampBackend* backend) :
+		m_Backend(backend)
+	{
+		m_Timestamps.resize(MAX_SCOPES * 2);
+	}
+
+	GPUProfiler::~GPUProfiler()
+	{
+		delete m_Backend;
+	}
+
+	void GPUProfiler::BeginFrame()
+	{
+		m_FrameIndex++;
+		const unsigned int slotIndex = m_FrameIndex % NUM_FRAME_SLOTS;
+		FrameSlot& slot = m_Slots[slotIndex];
+		if (slot.State == SlotState::Pending && !ReadBack(slotIndex))
+		{
+			m_Stats.SkippedFrames++;
+			return;
+		}
+
+		slot.State = SlotState::Recording;
+		slot.FrameIndex = m_FrameIndex;
+		slot.NumScopes = 0;
+		m_Backend->BeginFrame(slotIndex);
+		m_RecordingSlot = slotIndex;
+	}
+
+	void GPUProfiler::EndFrame()
+	{
+		const unsigned int recordingSlot = m_RecordingSlot.exchange(INVALID_SCOPE);
+		if (recordingSlot != INVALID_SCOPE)
+		{
+			m_Backend->EndFrame(recordingSlot);
+			m_Slots[recordingSlot].State = SlotState::Pending;
+		}
+		m_Stats.DroppedScopes = m_DroppedScopes;
+
+		// Slots are read back in the order they were recorded, so timings shown never go back in time
+		while (true)
+		{
+			unsigned int oldestSlot = INVALID_SCOPE;
+			for (unsigned int i = 0; i < NUM_FRAME_SLOTS; i++)
+			{
+				if (m_Slots[i].State != SlotState::Pending) continue;
+				if (oldestSlot == INVALID_SCOPE || m_Slots[i].FrameIndex < m_Slots[oldestSlot].FrameIndex) oldestSlot = i;
+			}
+
+			if (oldestSlot == INVALID_SCOPE || !ReadBack(oldestSlot)) break;
+		}
+	}
+
+	unsigned int GPUProfiler::BeginScope(GfxContext* context, const char* name)
+	{
+		const unsigned int slotIndex = m_RecordingSlot.load(std::memory_order_relaxed);
+		if (slotIndex == INVALID_SCOPE) return INVALID_SCOPE;
+
+		FrameSlot& slot = m_Slots[slotIndex];
+		const unsigned int scope = slot.NumScopes++;
+		if (scope >= MAX_SCOPES)
+		{
+			m_DroppedScopes++;
+			return INVALID_SCOPE;
+		}
+
+		slot.Scopes[scope] = { name, t_ScopeDepth++ };
+		m_Backend->WriteTimestamp(context, slotIndex, scope * 2);
+		return scope;
+	}
+
+	void GPUProfiler::EndScope(GfxContext* context, unsigned int scope)
+	{
+		const unsigned int slotIndex = m_RecordingSlot.load(std::memory_order_relaxed);
+		if (scope == INVALID_SCOPE || slotIndex == INVALID_SCOPE) return;
+
+		t_ScopeDepth--;
+		m_Backend->WriteTimestamp(context, slotIndex, scope * 2 + 1);
+	}
+
+	bool GPUProfiler::RunSelfTest()
+	{
+		static constexpr unsigned int LATENCY = 2;
+		static constexpr unsigned int STEADY_FRAMES = 10;
+		static constexpr unsigned int STALL_FRAMES = 8;
+
+		FakeTimestampBackend* backend = new FakeTimestampBackend(LATENCY);
+		GPUProfiler profiler(backend);
+
+		bool passed = true;
+		const auto check = [&passed](bool condition, const std::string& message)
+		{
+			if (condition) return;
+			CONSOLE_LOG("[GPUProfiler] Self test failed: " + message);
+			passed = false;
+		};
+
+		// Outer pass is three ticks long and the nested one a single tick
+		const auto recordFrame = [&profiler]()
+		{
+			profiler.BeginFrame();
+			const unsigned int outer = profiler.BeginScope(nullptr, "Outer");
+			const unsigned int inner = profiler.BeginScope(nullptr, "Inner");
+			profiler.EndScope(nullptr, inner);
+			profiler.EndScope(nullptr, outer);
+			profiler.EndFrame();
+		};
+
+		const auto checkTimings = [&profiler, &check](const std::string& when)
+		{
+			const std::vector<GPUPassTiming>& timings = profiler.GetTimings();
+			check(timings.size() == 2, when + ", expected 2 passes, got " + std::to_string(timings.size()));
+			if (timings.size() != 2) return;
+			check(strcmp(timings[0].Name, "Outer") == 0 && timings[0].Depth == 0 && timings[0].TimeMS == 3.0f, when + ", wrong outer pass");
+			check(strcmp(timings[1].Name, "Inner") == 0 && timings[1].Depth == 1 && timings[1].TimeMS == 1.0f, when + ", wrong inner pass");
+		};
+
+		for (unsigned int i = 0; i < STEADY_FRAMES; i++) recordFrame();
+		check(profiler.GetStats().Latency == LATENCY, "latency " + std::to_string(profiler.GetStats().Latency) + " instead of " + std::to_string(LATENCY));
+		check(profiler.GetStats().SkippedFrames == 0, "frames skipped while the GPU keeps up");
+		checkTimings("steady");
+
+		// Free slots are used up first, every frame after that is skipped instead of waiting
+		backend->SetStalled(true);
+		for (unsigned int i = 0; i < STALL_FRAMES; i++) recordFrame();
+		profiler.BeginFrame();
+		check(profiler.BeginScope(nullptr, "Skipped") == INVALID_SCOPE, "scope recorded in a skipped frame");
+		profiler.EndFrame();
+		const unsigned int expectedSkipped = STALL_FRAMES + 1 - (NUM_FRAME_SLOTS - LATENCY);
+		check(profiler.GetStats().SkippedFrames == expectedSkipped, "skipped " + std::to_string(profiler.GetStats().SkippedFrames) + " frames instead of " + std::to_string(expectedSkipped));
+
+		// Everything pending is read back oldest first, then the latency settles again
+		backend->SetStalled(false);
+		for (unsigned int i = 0; i < NUM_FRAME_SLOTS; i++) recordFrame();
+		check(profiler.GetStats().Latency == LATENCY, "latency " + std::to_string(profiler.GetStats().Latency) + " after the stall instead of " + std::to_string(LATENCY));
+		checkTimings("after the stall");
+
+		backend->SetDisjointNextFrame();
+		for (unsigned int i = 0; i <= LATENCY; i++) recordFrame();
+		check(profiler.GetStats().DisjointFrames == 1, "disjoint frame counted " + std::to_string(profiler.GetStats().DisjointFrames) + " times");
+
+		CONSOLE_LOG(passed ? "[GPUProfiler] Self test passed" : "[GPUProfiler] Self test failed");
+		return passed;
+	}
+
+	bool GPUProfiler::ReadBack(unsigned int slotIndex)
+	{
+		FrameSlot& slot = m_Slots[slotIndex];
+		const unsigned int numScopes = MIN(slot.NumScopes.load(), MAX_SCOPES);
+
+		unsigned long long frequency = 0;
+		bool disjoint = false;
+		if (!m_Backend->ReadFrame(slotIndex, numScopes * 2, m_Timestamps.data(), frequency, disjoint)) return false;
+
+		slot.State = SlotState::Free;
+		m_Stats.Latency = (unsigned int) (m_FrameIndex - slot.FrameIndex);
+
+		// Timestamps are not reliable when the GPU clock changed during the frame
+		if (disjoint || frequency == 0)
+		{
+			m_Stats.DisjointFrames++;
+			return true;
+		}
+
+		m_ScopeOrder.resize(numScopes);
+		for (unsigned int i = 0; i < numScopes; i++) m_ScopeOrder[i] = i;
+		std::sort(m_ScopeOrder.begin(), m_ScopeOrder.end(), [this](unsigned int a, unsigned int b) { return m_Timestamps[a * 2] < m_Timestamps[b * 2]; });
+
+		m_Timings.clear();
+		for (unsigned int scope : m_ScopeOrder)
+		{
+			const unsigned long long begin = m_Timestamps[scope * 2];
+			const unsigned long long end = m_Timestamps[scope * 2 + 1];
+
+			GPUPassTiming& timing = m_Timings.emplace_back();
+			timing.Name = slot.Scopes[scope].Name;
+			timing.Depth = slot.Scopes[scope].Depth;
+			timing.TimeMS = end > begin ? (float) ((end - begin) * 1000.0 / frequency) : 0.0f;
+
+			const auto avg = m_AvgMS.find(timing.Name);
+			timing.AvgMS = avg == m_AvgMS.end() ? timing.TimeMS : avg->second + (timing.TimeMS - avg->second) * AVG_WEIGHT;
+			m_AvgMS[timing.Name] = timing.AvgMS;
+		}
+		return true;
+	}
+}
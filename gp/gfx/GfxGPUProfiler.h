@@ -0,0 +1,114 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <unordered_map>
+
+#include "Common.h"
+
+namespace GP
+{
+	class GfxContext;
+
+	// Timestamp queries of one frame slot, indices go from 0 to the number of queries written in the frame
+	class GPUTimestampBackend
+	{
+	public:
+		virtual ~GPUTimestampBackend() {}
+
+		virtual void BeginFrame(unsigned int frameSlot) = 0;
+		virtual void EndFrame(unsigned int frameSlot) = 0;
+		virtual void WriteTimestamp(GfxContext* context, unsigned int frameSlot, unsigned int query) = 0;
+
+		// Returns false while the results are not available yet, must not wait for the GPU
+		virtual bool ReadFrame(unsigned int frameSlot, unsigned int numQueries, unsigned long long* timestamps, unsigned long long& frequency, bool& disjoint) = 0;
+	};
+
+	GP_DLL GPUTimestampBackend* CreateD3D11TimestampBackend();
+
+	struct GPUPassTiming
+	{
+		const char* Name = nullptr;
+		unsigned int Depth = 0;
+		float TimeMS = 0.0f;
+		float AvgMS = 0.0f;
+	};
+
+	struct GPUProfilerStats
+	{
+		unsigned int Latency = 0; // Frames between recording and reading back the last timings
+		unsigned int SkippedFrames = 0;
+		unsigned int DisjointFrames = 0;
+		unsigned int DroppedScopes = 0;
+	};
+
+	// Timestamps of every frame go to one of the frame slots and are read back once the GPU is done with them.
+	// When all slots are still waiting for the GPU the frame isn't measured, the CPU never waits for the results.
+	class GPUProfiler
+	{
+		DELETE_COPY_CONSTRUCTOR(GPUProfiler);
+	public:
+		static constexpr unsigned int NUM_FRAME_SLOTS = 4;
+		static constexpr unsigned int MAX_SCOPES = 256; // per frame
+		static constexpr unsigned int INVALID_SCOPE = (unsigned int) -1;
+
+		// Takes ownership of the backend
+		GP_DLL GPUProfiler(GPUTimestampBackend* backend);
+		GP_DLL ~GPUProfiler();
+
+		// Main thread
+		GP_DLL void BeginFrame();
+		GP_DLL void EndFrame();
+
+		// Any thread recording a context of this frame
+		GP_DLL unsigned int BeginScope(GfxContext* context, const char* name);
+		GP_DLL void EndScope(GfxContext* context, unsigned int scope);
+
+		// Passes of the last frame that was read back, in the order they started on the GPU
+		inline const std::vector<GPUPassTiming>& GetTimings() const { return m_Timings; }
+		inline const GPUProfilerStats& GetStats() const { return m_Stats; }
+
+		// Runs the frame slots against a fake backend that completes frames a few frames late and then stalls, doesn't need a device.
+		// Logs every mismatch with the expected readback latency, skipped frames and pass times, returns true if there were none.
+		GP_DLL static bool RunSelfTest();
+
+	private:
+		enum class SlotState
+		{
+			Free,
+			Recording,
+			Pending
+		};
+
+		struct Scope
+		{
+			const char* Name;
+			unsigned int Depth;
+		};
+
+		struct FrameSlot
+		{
+			SlotState State = SlotState::Free;
+			unsigned long long FrameIndex = 0;
+			std::atomic<unsigned int> NumScopes = 0;
+			Scope Scopes[MAX_SCOPES];
+		};
+
+		bool ReadBack(unsigned int slotIndex);
+
+	private:
+		GPUTimestampBackend* m_Backend;
+		FrameSlot m_Slots[NUM_FRAME_SLOTS];
+		unsigned long long m_FrameIndex = 0;
+		std::atomic<unsigned int> m_RecordingSlot = INVALID_SCOPE;
+		std::atomic<unsigned int> m_DroppedScopes = 0;
+
+		std::vector<unsigned long long> m_Timestamps;
+		std::vector<unsigned int> m_ScopeOrder;
+		std::vector<GPUPassTiming> m_Timings;
+		std::unordered_map<const char*, float> m_AvgMS;
+		GPUProfilerStats m_Stats;
+	};
+
+	GP_DLL extern GPUProfiler* g_GPUProfiler;
+}
@@ -0,0 +1,560 @@
+#include "GfxMipGenerator.h"
+
+#include <intrin.h>
+#include <immintrin.h>
+
+#include <cmath>
+#include <cstring>
+#include <string>
+
+#include "util/Timer.h"
+
+namespace GP
+{
+	namespace
+	{
+		static constexpr unsigned int KAISER_TAPS = 8;
+		static constexpr float KAISER_ALPHA = 4.0f;
+		static constexpr unsigned int LINEAR_TO_SRGB_LUT_SIZE = 4096;
+
+		struct FloatImage
+		{
+			unsigned int Width = 0;
+			unsigned int Height = 0;
+			std::vector<Vec4> Pixels;
+
+			inline void Resize(unsigned int width, unsigned int height)
+			{
+				Width = width;
+				Height = height;
+				Pixels.resize((size_t) width * height);
+			}
+
+			inline Vec4* Row(unsigned int y) { return Pixels.data() + (size_t) y * Width; }
+		};
+
+		struct ConversionTables
+		{
+			float SRGBToLinear[256];
+			float UNORMToFloat[256];
+			unsigned char LinearToSRGB[LINEAR_TO_SRGB_LUT_SIZE];
+
+			ConversionTables()
+			{
+				for (unsigned int i = 0; i < 256; i++)
+				{
+					const float c = i / 255.0f;
+					SRGBToLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+					UNORMToFloat[i] = c;
+				}
+
+				for (unsigned int i = 0; i < LINEAR_TO_SRGB_LUT_SIZE; i++)
+				{
+					const float l = i / (float) (LINEAR_TO_SRGB_LUT_SIZE - 1);
+					const float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+					LinearToSRGB[i] = (unsigned char) (c * 255.0f + 0.5f);
+				}
+			}
+		};
+
+		const ConversionTables& GetTables()
+		{
+			static const ConversionTables tables;
+			return tables;
+		}
+
+		inline unsigned char ToUNORM(float x)
+		{
+			x = x < 0.0f ? 0.0f : (x > 1.0f ? 1.0f : x);
+			return (unsigned char) (x * 255.0f + 0.5f);
+		}
+
+		inline unsigned char ToSRGB(float x)
+		{
+			x = x < 0.0f ? 0.0f : (x > 1.0f ? 1.0f : x);
+			return GetTables().LinearToSRGB[(unsigned int) (x * (LINEAR_TO_SRGB_LUT_SIZE - 1) + 0.5f)];
+		}
+
+		float BesselI0(float x)
+		{
+			float sum = 1.0f;
+			float term = 1.0f;
+			const float halfX = x * 0.5f;
+			for (unsigned int k = 1; k < 16; k++)
+			{
+				term *= halfX / k;
+				sum += term * term;
+			}
+			return sum;
+		}
+
+		// Weights for halving the image, tap i samples source texel (2 * x - KAISER_TAPS / 2 + 1 + i)
+		struct KaiserWeights
+		{
+			float Weights[KAISER_TAPS];
+
+			KaiserWeights()
+			{
+				static constexpr float PI = 3.14159265f;
+				const float radius = KAISER_TAPS / 2.0f;
+				float sum = 0.0f;
+				for (unsigned int i = 0; i < KAISER_TAPS; i++)
+				{
+					// Distance in source texels from the output texel center
+					const float d = (float) i - radius + 0.5f;
+					const float x = d * 0.5f;
+					const float sinc = x == 0.0f ? 1.0f : std::sin(PI * x) / (PI * x);
+					const float t = d / radius;
+					const float window = BesselI0(KAISER_ALPHA * std::sqrt(MAX(0.0f, 1.0f - t * t))) / BesselI0(KAISER_ALPHA);
+					Weights[i] = sinc * window;
+					sum += Weights[i];
+				}
+				for (unsigned int i = 0; i < KAISER_TAPS; i++) Weights[i] /= sum;
+			}
+		};
+
+		const float* GetKaiserWeights()
+		{
+			static const KaiserWeights weights;
+			return weights.Weights;
+		}
+
+		inline unsigned int ClampIndex(int index, unsigned int size)
+		{
+			return index < 0 ? 0 : (index >= (int) size ? size - 1 : (unsigned int) index);
+		}
+
+		///////////////////////////////////////
+		//			Conversion				//
+		/////////////////////////////////////
+
+		void DecodeLevel(const unsigned char* rgba, unsigned int width, unsigned int height, bool srgb, FloatImage& image)
+		{
+			const ConversionTables& tables = GetTables();
+			const float* colorTable = srgb ? tables.SRGBToLinear : tables.UNORMToFloat;
+
+			image.Resize(width, height);
+			const size_t numPixels = (size_t) width * height;
+			for (size_t i = 0; i < numPixels; i++)
+			{
+				const unsigned char* src = rgba + i * 4;
+				image.Pixels[i] = Vec4(colorTable[src[0]], colorTable[src[1]], colorTable[src[2]], tables.UNORMToFloat[src[3]]);
+			}
+		}
+
+		void EncodeLevel(const FloatImage& image, bool srgb, float alphaScale, unsigned char* rgba)
+		{
+			const size_t numPixels = (size_t) image.Width * image.Height;
+			for (size_t i = 0; i < numPixels; i++)
+			{
+				const Vec4& p = image.Pixels[i];
+				unsigned char* dst = rgba + i * 4;
+				dst[0] = srgb ? ToSRGB(p.x) : ToUNORM(p.x);
+				dst[1] = srgb ? ToSRGB(p.y) : ToUNORM(p.y);
+				dst[2] = srgb ? ToSRGB(p.z) : ToUNORM(p.z);
+				dst[3] = ToUNORM(p.w * alphaScale);
+			}
+		}
+
+		///////////////////////////////////////
+		//			Alpha coverage			//
+		/////////////////////////////////////
+
+		float CalculateAlphaCoverage(const FloatImage& image, float alphaRef, float alphaScale)
+		{
+			size_t numPassed = 0;
+			for (const Vec4& p : image.Pixels)
+			{
+				if (p.w * alphaScale > alphaRef) numPassed++;
+			}
+			return (float) numPassed / image.Pixels.size();
+		}
+
+		float FindAlphaScale(const FloatImage& image, float alphaRef, float targetCoverage)
+		{
+			float minScale = 0.0f;
+			float maxScale = 4.0f;
+			float scale = 1.0f;
+
+			for (unsigned int i = 0; i < 10; i++)
+			{
+				const float coverage = CalculateAlphaCoverage(image, alphaRef, scale);
+				if (coverage < targetCoverage) minScale = scale;
+				else if (coverage > targetCoverage) maxScale = scale;
+				else break;
+				scale = (minScale + maxScale) * 0.5f;
+			}
+
+			return scale;
+		}
+
+		///////////////////////////////////////
+		//			Box filter				//
+		/////////////////////////////////////
+
+		void DownsampleBoxScalar(FloatImage& src, FloatImage& dst)
+		{
+			for (unsigned int y = 0; y < dst.Height; y++)
+			{
+				const Vec4* row0 = src.Row(ClampIndex(2 * y, src.Height));
+				const Vec4* row1 = src.Row(ClampIndex(2 * y + 1, src.Height));
+				Vec4* dstRow = dst.Row(y);
+				for (unsigned int x = 0; x < dst.Width; x++)
+				{
+					const unsigned int x0 = ClampIndex(2 * x, src.Width);
+					const unsigned int x1 = ClampIndex(2 * x + 1, src.Width);
+					dstRow[x] = (row0[x0] + row0[x1] + row1[x0] + row1[x1]) * 0.25f;
+				}
+			}
+		}
+
+		void DownsampleBoxSSE(FloatImage& src, FloatImage& dst)
+		{
+			const __m128 quarter = _mm_set1_ps(0.25f);
+			for (unsigned int y = 0; y < dst.Height; y++)
+			{
+				const float* row0 = (const float*) src.Row(ClampIndex(2 * y, src.Height));
+				const float* row1 = (const float*) src.Row(ClampIndex(2 * y + 1, src.Height));
+				float* dstRow = (float*) dst.Row(y);
+				for (unsigned int x = 0; x < dst.Width; x++)
+				{
+					const unsigned int x0 = ClampIndex(2 * x, src.Width) * 4;
+					const unsigned int x1 = ClampIndex(2 * x + 1, src.Width) * 4;
+					const __m128 top = _mm_add_ps(_mm_loadu_ps(row0 + x0), _mm_loadu_ps(row0 + x1));
+					const __m128 bottom = _mm_add_ps(_mm_loadu_ps(row1 + x0), _mm_loadu_ps(row1 + x1));
+					_mm_storeu_ps(dstRow + x * 4, _mm_mul_ps(_mm_add_ps(top, bottom), quarter));
+				}
+			}
+		}
+
+		void DownsampleBoxAVX(FloatImage& src, FloatImage& dst)
+		{
+			// Odd widths need clamped reads on the last texel, leave those to the SSE path
+			if (src.Width & 1)
+			{
+				DownsampleBoxSSE(src, dst);
+				return;
+			}
+
+			const __m256 quarter = _mm256_set1_ps(0.25f);
+			for (unsigned int y = 0; y < dst.Height; y++)
+			{
+				const float* row0 = (const float*) src.Row(ClampIndex(2 * y, src.Height));
+				const float* row1 = (const float*) src.Row(ClampIndex(2 * y + 1, src.Height));
+				float* dstRow = (float*) dst.Row(y);
+
+				// Two output texels per iteration
+				unsigned int x = 0;
+				for (; x + 1 < dst.Width; x += 2)
+				{
+					const __m256 a = _mm256_add_ps(_mm256_loadu_ps(row0 + x * 8), _mm256_loadu_ps(row1 + x * 8));
+					const __m256 b = _mm256_add_ps(_mm256_loadu_ps(row0 + x * 8 + 8), _mm256_loadu_ps(row1 + x * 8 + 8));
+					const __m256 lo = _mm256_permute2f128_ps(a, b, 0x20);
+					const __m256 hi = _mm256_permute2f128_ps(a, b, 0x31);
+					_mm256_storeu_ps(dstRow + x * 4, _mm256_mul_ps(_mm256_add_ps(lo, hi), quarter));
+				}
+
+				for (; x < dst.Width; x++)
+				{
+					const __m128 top = _mm_add_ps(_mm_loadu_ps(row0 + x * 8), _mm_loadu_ps(row0 + x * 8 + 4));
+					const __m128 bottom = _mm_add_ps(_mm_loadu_ps(row1 + x * 8), _mm_loadu_ps(row1 + x * 8 + 4));
+					_mm_storeu_ps(dstRow + x * 4, _mm_mul_ps(_mm_add_ps(top, bottom), _mm_set1_ps(0.25f)));
+				}
+			}
+			_mm256_zeroupper();
+		}
+
+		///////////////////////////////////////
+		//			Kaiser filter			//
+		/////////////////////////////////////
+
+		// Separable: horizontal pass into tmp (dst.Width x src.Height) then vertical pass into dst
+
+		void DownsampleKaiserScalar(FloatImage& src, FloatImage& tmp, FloatImage& dst)
+		{
+			const float* weights = GetKaiserWeights();
+			const int tapOffset = 1 - (int) KAISER_TAPS / 2;
+
+			tmp.Resize(dst.Width, src.Height);
+			for (unsigned int y = 0; y < src.Height; y++)
+			{
+				const Vec4* srcRow = src.Row(y);
+				Vec4* tmpRow = tmp.Row(y);
+				for (unsigned int x = 0; x < dst.Width; x++)
+				{
+					Vec4 sum = VEC4_ZERO;
+					for (unsigned int i = 0; i < KAISER_TAPS; i++)
+						sum += srcRow[ClampIndex((int) (2 * x + i) + tapOffset, src.Width)] * weights[i];
+					tmpRow[x] = sum;
+				}
+			}
+
+			for (unsigned int y = 0; y < dst.Height; y++)
+			{
+				Vec4* dstRow = dst.Row(y);
+				for (unsigned int x = 0; x < dst.Width; x++)
+				{
+					Vec4 sum = VEC4_ZERO;
+					for (unsigned int i = 0; i < KAISER_TAPS; i++)
+						sum += tmp.Row(ClampIndex((int) (2 * y + i) + tapOffset, tmp.Height))[x] * weights[i];
+					dstRow[x] = sum;
+				}
+			}
+		}
+
+		void KaiserHorizontalSSE(FloatImage& src, FloatImage& tmp, unsigned int dstWidth)
+		{
+			const float* weights = GetKaiserWeights();
+			const int tapOffset = 1 - (int) KAISER_TAPS / 2;
+
+			__m128 w[KAISER_TAPS];
+			for (unsigned int i = 0; i < KAISER_TAPS; i++) w[i] = _mm_set1_ps(weights[i]);
+
+			tmp.Resize(dstWidth, src.Height);
+			for (unsigned int y = 0; y < src.Height; y++)
+			{
+				const float* srcRow = (const float*) src.Row(y);
+				float* tmpRow = (float*) tmp.Row(y);
+				for (unsigned int x = 0; x < dstWidth; x++)
+				{
+					__m128 sum = _mm_setzero_ps();
+					for (unsigned int i = 0; i < KAISER_TAPS; i++)
+					{
+						const unsigned int srcX = ClampIndex((int) (2 * x + i) + tapOffset, src.Width);
+						sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(srcRow + srcX * 4), w[i]));
+					}
+					_mm_storeu_ps(tmpRow + x * 4, sum);
+				}
+			}
+		}
+
+		void DownsampleKaiserSSE(FloatImage& src, FloatImage& tmp, FloatImage& dst)
+		{
+			const float* weights = GetKaiserWeights();
+			const int tapOffset = 1 - (int) KAISER_TAPS / 2;
+
+			KaiserHorizontalSSE(src, tmp, dst.Width);
+
+			__m128 w[KAISER_TAPS];
+			for (unsigned int i = 0; i < KAISER_TAPS; i++) w[i] = _mm_set1_ps(weights[i]);
+
+			const float* rows[KAISER_TAPS];
+			for (unsigned int y = 0; y < dst.Height; y++)
+			{
+				for (unsigned int i = 0; i < KAISER_TAPS; i++) rows[i] = (const float*) tmp.Row(ClampIndex((int) (2 * y + i) + tapOffset, tmp.Height));
+
+				float* dstRow = (float*) dst.Row(y);
+				for (unsigned int x = 0; x < dst.Width; x++)
+				{
+					__m128 sum = _mm_setzero_ps();
+					for (unsigned int i = 0; i < KAISER_TAPS; i++)
+						sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(rows[i] + x * 4), w[i]));
+					_mm_storeu_ps(dstRow + x * 4, sum);
+				}
+			}
+		}
+
+		void DownsampleKaiserAVX(FloatImage& src, FloatImage& tmp, FloatImage& dst)
+		{
+			const float* weights = GetKaiserWeights();
+			const int tapOffset = 1 - (int) KAISER_TAPS / 2;
+
+			// Horizontal taps gather single texels, there is nothing to win with 256 bit registers there
+			KaiserHorizontalSSE(src, tmp, dst.Width);
+
+			__m256 w[KAISER_TAPS];
+			for (unsigned int i = 0; i < KAISER_TAPS; i++) w[i] = _mm256_set1_ps(weights[i]);
+
+			const float* rows[KAISER_TAPS];
+			for (unsigned int y = 0; y < dst.Height; y++)
+			{
+				for (unsigned int i = 0; i < KAISER_TAPS; i++) rows[i] = (const float*) tmp.Row(ClampIndex((int) (2 * y + i) + tapOffset, tmp.Height));
+
+				float* dstRow = (float*) dst.Row(y);
+				unsigned int x = 0;
+				for (; x + 1 < dst.Width; x += 2)
+				{
+					__m256 sum = _mm256_setzero_ps();
+					for (unsigned int i = 0; i < KAISER_TAPS; i++)
+						sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(rows[i] + x * 4), w[i]));
+					_mm256_storeu_ps(dstRow + x * 4, sum);
+				}
+
+				for (; x < dst.Width; x++)
+				{
+					__m128 sum = _mm_setzero_ps();
+					for (unsigned int i = 0; i < KAISER_TAPS; i++)
+						sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(rows[i] + x * 4), _mm_set1_ps(weights[i])));
+					_mm_storeu_ps(dstRow + x * 4, sum);
+				}
+			}
+			_mm256_zeroupper();
+		}
+
+		void Downsample(MipFilter filter, MipISA isa, FloatImage& src, FloatImage& tmp, FloatImage& dst)
+		{
+			dst.Resize(MAX(1u, src.Width / 2), MAX(1u, src.Height / 2));
+
+			switch (filter)
+			{
+			case MipFilter::Box:
+				if (isa == MipISA::AVX) DownsampleBoxAVX(src, dst);
+				else if (isa == MipISA::SSE) DownsampleBoxSSE(src, dst);
+				else DownsampleBoxScalar(src, dst);
+				break;
+			case MipFilter::Kaiser:
+				if (isa == MipISA::AVX) DownsampleKaiserAVX(src, tmp, dst);
+				else if (isa == MipISA::SSE) DownsampleKaiserSSE(src, tmp, dst);
+				else DownsampleKaiserScalar(src, tmp, dst);
+				break;
+			default: NOT_IMPLEMENTED;
+			}
+		}
+
+		inline const char* ToString(MipFilter filter)
+		{
+			switch (filter)
+			{
+			case MipFilter::Box: return "Box";
+			case MipFilter::Kaiser: return "Kaiser";
+			default: NOT_IMPLEMENTED;
+			}
+			return "";
+		}
+
+		inline const char* ToString(MipISA isa)
+		{
+			switch (isa)
+			{
+			case MipISA::Scalar: return "Scalar";
+			case MipISA::SSE: return "SSE";
+			case MipISA::AVX: return "AVX";
+			default: NOT_IMPLEMENTED;
+			}
+			return "";
+		}
+	}
+
+	///////////////////////////////////////
+	//			MipChain				//
+	/////////////////////////////////////
+
+	void MipChain::Allocate(unsigned int width, unsigned int height, unsigned int numMips)
+	{
+		m_Levels.resize(numMips);
+
+		size_t offset = 0;
+		for (unsigned int i = 0; i < numMips; i++)
+		{
+			m_Levels[i] = { width, height, offset };
+			offset += (size_t) width * height * 4;
+			width = MAX(1u, width / 2);
+			height = MAX(1u, height / 2);
+		}
+		m_Data.resize(offset);
+	}
+
+	///////////////////////////////////////
+	//			MipGenerator			//
+	/////////////////////////////////////
+
+	namespace MipGenerator
+	{
+		unsigned int CalculateNumMips(unsigned int width, unsigned int height)
+		{
+			unsigned int numMips = 1;
+			unsigned int size = MAX(width, height);
+			while (size > 1)
+			{
+				size /= 2;
+				numMips++;
+			}
+			return numMips;
+		}
+
+		MipISA GetBestSupportedISA()
+		{
+			static MipISA bestISA = []() {
+				int cpuInfo[4];
+				__cpuid(cpuInfo, 1);
+				const bool sse2 = cpuInfo[3] & (1 << 26);
+				const bool osxsave = cpuInfo[2] & (1 << 27);
+				const bool avx = cpuInfo[2] & (1 << 28);
+
+				// AVX also needs OS support for saving ymm registers
+				if (osxsave && avx && (_xgetbv(0) & 0x6) == 0x6) return MipISA::AVX;
+				if (sse2) return MipISA::SSE;
+				return MipISA::Scalar;
+			}();
+			return bestISA;
+		}
+
+		void Generate(const unsigned char* rgba, unsigned int width, unsigned int height, unsigned int numMips, const MipGenerationSettings& settings, MipChain& chain)
+		{
+			const unsigned int maxMips = CalculateNumMips(width, height);
+			numMips = numMips == 0 ? maxMips : MIN(numMips, maxMips);
+
+			MipISA isa = settings.ISA == MipISA::Best ? GetBestSupportedISA() : settings.ISA;
+			if (isa == MipISA::AVX && GetBestSupportedISA() != MipISA::AVX) isa = GetBestSupportedISA();
+
+			chain.Allocate(width, height, numMips);
+			memcpy(chain.GetLevelData(0), rgba, (size_t) width * height * 4);
+			if (numMips == 1) return;
+
+			FloatImage levels[2];
+			FloatImage tmp;
+			DecodeLevel(rgba, width, height, settings.SRGB, levels[0]);
+
+			const bool preserveCoverage = settings.AlphaCoverageRef > 0.0f;
+			const float targetCoverage = preserveCoverage ? CalculateAlphaCoverage(levels[0], settings.AlphaCoverageRef, 1.0f) : 0.0f;
+
+			for (unsigned int mip = 1; mip < numMips; mip++)
+			{
+				FloatImage& src = levels[(mip - 1) & 1];
+				FloatImage& dst = levels[mip & 1];
+				Downsample(settings.Filter, isa, src, tmp, dst);
+
+				// Scale is only applied to the stored level, the next one is filtered from unscaled alpha
+				const float alphaScale = preserveCoverage ? FindAlphaScale(dst, settings.AlphaCoverageRef, targetCoverage) : 1.0f;
+				EncodeLevel(dst, settings.SRGB, alphaScale, chain.GetLevelData(mip));
+			}
+		}
+
+		void RunBenchmark(unsigned int width, unsigned int height, unsigned int iterations)
+		{
+			std::vector<unsigned char> image((size_t) width * height * 4);
+			unsigned int seed = 1;
+			for (unsigned char& value : image)
+			{
+				seed = seed * 1664525u + 1013904223u;
+				value = (unsigned char) (seed >> 24);
+			}
+
+			const MipISA bestISA = GetBestSupportedISA();
+			const MipFilter filters[] = { MipFilter::Box, MipFilter::Kaiser };
+			const MipISA isas[] = { MipISA::Scalar, MipISA::SSE, MipISA::AVX };
+
+			MipChain chain;
+			for (MipFilter filter : filters)
+			{
+				for (MipISA isa : isas)
+				{
+					if ((unsigned int) isa > (unsigned int) bestISA) continue;
+
+					MipGenerationSettings settings;
+					settings.Filter = filter;
+					settings.ISA = isa;
+
+					Timer timer;
+					timer.Start();
+					for (unsigned int i = 0; i < iterations; i++) Generate(image.data(), width, height, 0, settings, chain);
+					timer.Stop();
+
+					const float megaPixels = (float) width * height * iterations / 1000000.0f;
+					const float mpixelsPerSecond = megaPixels / (timer.GetTimeMS() / 1000.0f);
+					CONSOLE_LOG("[MipGenerator] " + std::string(ToString(filter)) + " " + ToString(isa) + ": " + std::to_string(mpixelsPerSecond) + " Mpixels/s");
+				}
+			}
+		}
+	}
+}
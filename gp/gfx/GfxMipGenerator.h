@@ -0,0 +1,71 @@
+#pragma once
+
+#include "Common.h"
+
+#include <vector>
+
+namespace GP
+{
+	enum class MipFilter
+	{
+		Box,
+		Kaiser
+	};
+
+	enum class MipISA
+	{
+		Scalar,
+		SSE,
+		AVX,
+
+		Best
+	};
+
+	struct MipGenerationSettings
+	{
+		MipFilter Filter = MipFilter::Box;
+		MipISA ISA = MipISA::Best;
+
+		// Source data is sRGB encoded, filtering is done in linear space
+		bool SRGB = true;
+
+		// If > 0 alpha is rescaled on every mip so the percentage of texels that pass alpha test with this reference stays the same as on mip 0
+		float AlphaCoverageRef = 0.0f;
+	};
+
+	struct MipLevel
+	{
+		unsigned int Width;
+		unsigned int Height;
+		size_t Offset;
+	};
+
+	// RGBA8 mip levels stored in one continuous block
+	class MipChain
+	{
+	public:
+		void Allocate(unsigned int width, unsigned int height, unsigned int numMips);
+
+		inline unsigned int GetNumMips() const { return (unsigned int) m_Levels.size(); }
+		inline const MipLevel& GetLevel(unsigned int mip) const { return m_Levels[mip]; }
+		inline unsigned char* GetLevelData(unsigned int mip) { return m_Data.data() + m_Levels[mip].Offset; }
+		inline unsigned int GetRowPitch(unsigned int mip) const { return m_Levels[mip].Width * 4; }
+		inline size_t GetByteSize() const { return m_Data.size(); }
+
+	private:
+		std::vector<unsigned char> m_Data;
+		std::vector<MipLevel> m_Levels;
+	};
+
+	namespace MipGenerator
+	{
+		unsigned int CalculateNumMips(unsigned int width, unsigned int height);
+		MipISA GetBestSupportedISA();
+
+		// numMips == 0 (MAX_MIPS) generates the full chain down to 1x1
+		void Generate(const unsigned char* rgba, unsigned int width, unsigned int height, unsigned int numMips, const MipGenerationSettings& settings, MipChain& chain);
+
+		// Logs Mpixels/s for every filter and supported ISA to the console
+		GP_DLL void RunBenchmark(unsigned int width = 2048, unsigned int height = 2048, unsigned int iterations = 4);
+	}
+}
@@ -0,0 +1,96 @@
+#include "GfxParameterBlock.h"
+
+#include <algorithm>
+
+#include "gfx/GfxDevice.h"
+
+namespace GP
+{
+	namespace
+	{
+		static constexpr ShaderStage ALL_STAGES[] = { VS, HS, DS, GS, PS, CS };
+
+		struct SlotEntry
+		{
+			ShaderStage Stage;
+			ShaderBindingType Type;
+			unsigned int Slot;
+			GfxParameterBlock::ParameterID Parameter;
+		};
+	}
+
+	GfxParameterBlock::ParameterID GfxParameterBlock::GetParameterID(const std::string& name)
+	{
+		for (ParameterID id = 0; id < m_Parameters.size(); id++)
+		{
+			if (m_Parameters[id].Name == name) return id;
+		}
+
+		Parameter parameter;
+		parameter.Name = name;
+		m_Parameters.push_back(parameter);
+		return (ParameterID) m_Parameters.size() - 1;
+	}
+
+	void GfxParameterBlock::Resolve()
+	{
+		if (!m_Dirty && m_ResolvedVersion == m_Shader->GetVersion()) return;
+
+		m_Dirty = false;
+		m_ResolvedVersion = m_Shader->GetVersion();
+		m_Ranges.clear();
+		m_RangeParameters.clear();
+
+		const GfxBindingLayout& layout = m_Shader->GetBindingLayout();
+
+		std::vector<SlotEntry> entries;
+		for (ParameterID id = 0; id < m_Parameters.size(); id++)
+		{
+			const Parameter& parameter = m_Parameters[id];
+			if (!parameter.Assigned) continue;
+
+			// Compiler strips unused resources so a missing name is not an error for every permutation
+			const ShaderBinding* binding = layout.Find(parameter.Name, parameter.Type);
+			if (!binding)
+			{
+				CONSOLE_LOG("[GfxParameterBlock] Shader " + m_Shader->GetPath() + " doesn't use parameter " + parameter.Name);
+				continue;
+			}
+
+			ASSERT(parameter.Type != ShaderBindingType::Sampler || binding->Slot < g_Device->GetMaxCustomSamplers(), "[GfxParameterBlock] Sampler " + parameter.Name + " is bound to a slot reserved for default samplers");
+			ASSERT(parameter.Type != ShaderBindingType::RWResource || binding->Stages == CS, "[NOT_SUPPORTED] Trying to bind RW resource to stage that isn't compute shader.");
+
+			for (ShaderStage stage : ALL_STAGES)
+			{
+				if (binding->Stages & stage) entries.push_back(SlotEntry{ stage, parameter.Type, binding->Slot, id });
+			}
+		}
+
+		std::sort(entries.begin(), entries.end(), [](const SlotEntry& a, const SlotEntry& b) {
+			if (a.Stage != b.Stage) return a.Stage < b.Stage;
+			if (a.Type != b.Type) return a.Type < b.Type;
+			return a.Slot < b.Slot;
+		});
+
+		// Gaps split ranges so slots that the block doesn't own keep their bindings
+		for (const SlotEntry& entry : entries)
+		{
+			BindRange* last = m_Ranges.empty() ? nullptr : &m_Ranges.back();
+			if (last && last->Stage == entry.Stage && last->Type == entry.Type && last->StartSlot + last->Count == entry.Slot)
+			{
+				last->Count++;
+			}
+			else
+			{
+				BindRange range;
+				range.Stage = entry.Stage;
+				range.Type = entry.Type;
+				range.StartSlot = entry.Slot;
+				range.Count = 1;
+				range.FirstParameter = (unsigned int) m_RangeParameters.size();
+				m_Ranges.push_back(range);
+			}
+			m_RangeParameters.push_back(entry.Parameter);
+		}
+	}
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "gfx/GfxShader.h"
+
+namespace GP
+{
+	class GfxBuffer;
+	class GfxBaseTexture2D;
+	class GfxBaseTexture3D;
+	class GfxSampler;
+
+	// Resources of a shader set by name, names are matched to the reflected binding layout once per shader version
+	// Bound with GfxContext::BindParameterBlock using one call per stage for every run of consecutive slots
+	class GfxParameterBlock
+	{
+		DELETE_COPY_CONSTRUCTOR(GfxParameterBlock);
+	public:
+		using ParameterID = unsigned int;
+
+		struct Parameter
+		{
+			std::string Name;
+			ShaderBindingType Type = ShaderBindingType::ConstantBuffer;
+			bool Assigned = false;
+
+			// Only one of these is set
+			GfxBuffer* Buffer = nullptr;
+			GfxBaseTexture2D* Texture2D = nullptr;
+			GfxBaseTexture3D* Texture3D = nullptr;
+			GfxSampler* Sampler = nullptr;
+		};
+
+		// Consecutive slots of one kind in one stage
+		struct BindRange
+		{
+			ShaderStage Stage = VS;
+			ShaderBindingType Type = ShaderBindingType::ConstantBuffer;
+			unsigned int StartSlot = 0;
+			unsigned int Count = 0;
+			unsigned int FirstParameter = 0; // Index to range parameters
+		};
+
+		GfxParameterBlock(GfxShader* shader):
+			m_Shader(shader) {}
+
+		// Look the id up once and use it for per draw updates
+		GP_DLL ParameterID GetParameterID(const std::string& name);
+
+		inline void SetConstantBuffer(ParameterID id, GfxBuffer* buffer) { SetParameter(id, ShaderBindingType::ConstantBuffer).Buffer = buffer; }
+		inline void SetStructuredBuffer(ParameterID id, GfxBuffer* buffer) { SetParameter(id, ShaderBindingType::Resource).Buffer = buffer; }
+		inline void SetRWStructuredBuffer(ParameterID id, GfxBuffer* buffer) { SetParameter(id, ShaderBindingType::RWResource).Buffer = buffer; }
+		inline void SetTexture(ParameterID id, GfxBaseTexture2D* texture) { SetParameter(id, ShaderBindingType::Resource).Texture2D = texture; }
+		inline void SetTexture(ParameterID id, GfxBaseTexture3D* texture) { SetParameter(id, ShaderBindingType::Resource).Texture3D = texture; }
+		inline void SetRWTexture(ParameterID id, GfxBaseTexture3D* texture) { SetParameter(id, ShaderBindingType::RWResource).Texture3D = texture; }
+		inline void SetSampler(ParameterID id, GfxSampler* sampler) { SetParameter(id, ShaderBindingType::Sampler).Sampler = sampler; }
+
+		inline void SetConstantBuffer(const std::string& name, GfxBuffer* buffer) { SetConstantBuffer(GetParameterID(name), buffer); }
+		inline void SetStructuredBuffer(const std::string& name, GfxBuffer* buffer) { SetStructuredBuffer(GetParameterID(name), buffer); }
+		inline void SetRWStructuredBuffer(const std::string& name, GfxBuffer* buffer) { SetRWStructuredBuffer(GetParameterID(name), buffer); }
+		inline void SetTexture(const std::string& name, GfxBaseTexture2D* texture) { SetTexture(GetParameterID(name), texture); }
+		inline void SetTexture(const std::string& name, GfxBaseTexture3D* texture) { SetTexture(GetParameterID(name), texture); }
+		inline void SetRWTexture(const std::string& name, GfxBaseTexture3D* texture) { SetRWTexture(GetParameterID(name), texture); }
+		inline void SetSampler(const std::string& name, GfxSampler* sampler) { SetSampler(GetParameterID(name), sampler); }
+
+		// Matches parameters to the shader layout, does nothing if neither changed since the last call
+		GP_DLL void Resolve();
+
+		inline GfxShader* GetShader() const { return m_Shader; }
+		inline const std::vector<BindRange>& GetRanges() const { return m_Ranges; }
+		inline const Parameter& GetRangeParameter(unsigned int index) const { return m_Parameters[m_RangeParameters[index]]; }
+
+	private:
+		inline Parameter& SetParameter(ParameterID id, ShaderBindingType type)
+		{
+			ASSERT(id < m_Parameters.size(), "[GfxParameterBlock] Invalid parameter id");
+			Parameter& parameter = m_Parameters[id];
+			if (!parameter.Assigned || parameter.Type != type) m_Dirty = true;
+			parameter.Assigned = true;
+			parameter.Type = type;
+			parameter.Buffer = nullptr;
+			parameter.Texture2D = nullptr;
+			parameter.Texture3D = nullptr;
+			parameter.Sampler = nullptr;
+			return parameter;
+		}
+
+	private:
+		GfxShader* m_Shader;
+		std::vector<Parameter> m_Parameters;
+
+		bool m_Dirty = true;
+		unsigned int m_ResolvedVersion = 0;
+		std::vector<BindRange> m_Ranges;
+		std::vector<ParameterID> m_RangeParameters;
+	};
+}
@@ -0,0 +1,123 @@
+#include "GfxRenderTargetPool.h"
+
+#include "core/GlobalVariables.h"
+
+namespace GP
+{
+	RenderTargetPool* g_RenderTargetPool = nullptr;
+
+	namespace
+	{
+		inline void DeleteTextures(PooledRenderTarget* renderTarget)
+		{
+			for (GfxTexture2D* texture : renderTarget->Textures) delete texture;
+			renderTarget->Textures.clear();
+		}
+	}
+
+	RenderTargetPool::RenderTargetPool():
+		m_WindowWidth(GlobalVariables::GP_CONFIG.WindowWidth),
+		m_WindowHeight(GlobalVariables::GP_CONFIG.WindowHeight)
+	{
+	}
+
+	RenderTargetPool::~RenderTargetPool()
+	{
+		while (!m_RenderTargets.empty()) Evict(m_RenderTargets.size() - 1);
+	}
+
+	PooledRenderTarget* RenderTargetPool::Acquire(const RenderTargetConfig& config)
+	{
+		for (PooledRenderTarget* renderTarget : m_RenderTargets)
+		{
+			if (renderTarget->InUse || renderTarget->Config != config) continue;
+
+			renderTarget->InUse = true;
+			renderTarget->LastUsedFrame = m_FrameIndex;
+			return renderTarget;
+		}
+
+		PooledRenderTarget* renderTarget = new PooledRenderTarget();
+		renderTarget->Config = config;
+		renderTarget->RenderTarget = new GfxRenderTarget(config);
+		renderTarget->NumBytes = GfxRenderTarget::GetMemorySize(config);
+		renderTarget->LastUsedFrame = m_FrameIndex;
+		renderTarget->InUse = true;
+		CreateTextures(renderTarget);
+		m_RenderTargets.push_back(renderTarget);
+		return renderTarget;
+	}
+
+	void RenderTargetPool::Release(PooledRenderTarget* renderTarget)
+	{
+		ASSERT(renderTarget->InUse, "[RenderTargetPool] Releasing render target that wasn't acquired");
+		renderTarget->InUse = false;
+	}
+
+	void RenderTargetPool::EndFrame()
+	{
+		for (size_t i = m_RenderTargets.size(); i-- > 0;)
+		{
+			PooledRenderTarget* renderTarget = m_RenderTargets[i];
+			renderTarget->InUse = false;
+			if (m_FrameIndex - renderTarget->LastUsedFrame >= FRAMES_BEFORE_EVICT) Evict(i);
+		}
+		m_FrameIndex++;
+	}
+
+	void RenderTargetPool::OnWindowResized(unsigned int width, unsigned int height)
+	{
+		for (size_t i = m_RenderTargets.size(); i-- > 0;)
+		{
+			PooledRenderTarget* renderTarget = m_RenderTargets[i];
+			RenderTargetConfig& config = renderTarget->Config;
+			if (config.Width != m_WindowWidth || config.Height != m_WindowHeight) continue;
+
+			// Frame index is already past the last frame here
+			if (m_FrameIndex - renderTarget->LastUsedFrame > 1)
+			{
+				Evict(i);
+				continue;
+			}
+
+			DeleteTextures(renderTarget);
+			renderTarget->RenderTarget->SetRTSize(width, height);
+			config.Width = width;
+			config.Height = height;
+			renderTarget->NumBytes = GfxRenderTarget::GetMemorySize(config);
+			CreateTextures(renderTarget);
+		}
+
+		m_WindowWidth = width;
+		m_WindowHeight = height;
+	}
+
+	RenderTargetPoolStats RenderTargetPool::GetStats() const
+	{
+		RenderTargetPoolStats stats;
+		for (const PooledRenderTarget* renderTarget : m_RenderTargets)
+		{
+			stats.NumTargets++;
+			if (renderTarget->InUse) stats.NumInUse++;
+			stats.NumBytes += renderTarget->NumBytes;
+		}
+		return stats;
+	}
+
+	void RenderTargetPool::CreateTextures(PooledRenderTarget* renderTarget)
+	{
+		for (unsigned int i = 0; i < renderTarget->Config.NumRenderTargets; i++)
+		{
+			renderTarget->Textures.push_back(new GfxTexture2D(renderTarget->RenderTarget->GetResource(i)));
+		}
+	}
+
+	void RenderTargetPool::Evict(size_t index)
+	{
+		PooledRenderTarget* renderTarget = m_RenderTargets[index];
+		DeleteTextures(renderTarget);
+		delete renderTarget->RenderTarget;
+		delete renderTarget;
+		m_RenderTargets.erase(m_RenderTargets.begin() + index);
+	}
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vector>
+
+#include "Common.h"
+#include "gfx/GfxTexture.h"
+
+namespace GP
+{
+	struct PooledRenderTarget
+	{
+		RenderTargetConfig Config;
+		GfxRenderTarget* RenderTarget = nullptr;
+		std::vector<GfxTexture2D*> Textures; // One for every render target, used to read it in later passes
+		size_t NumBytes = 0;
+		unsigned int LastUsedFrame = 0;
+		bool InUse = false;
+	};
+
+	struct RenderTargetPoolStats
+	{
+		unsigned int NumTargets = 0;
+		unsigned int NumInUse = 0;
+		size_t NumBytes = 0;
+	};
+
+	// Temporary render targets handed out by config, a target is reserved until it is released or the frame ends.
+	// Targets are reused across frames and evicted when nobody asked for their config for a while.
+	class RenderTargetPool
+	{
+		DELETE_COPY_CONSTRUCTOR(RenderTargetPool);
+
+		static constexpr unsigned int FRAMES_BEFORE_EVICT = 60;
+	public:
+		GP_DLL RenderTargetPool();
+		GP_DLL ~RenderTargetPool();
+
+		GP_DLL PooledRenderTarget* Acquire(const RenderTargetConfig& config);
+		GP_DLL void Release(PooledRenderTarget* renderTarget);
+
+		// Releases every target and evicts the unused ones
+		void EndFrame();
+
+		// Window sized targets used in the last frame are recreated with the new size, the rest of them are evicted
+		void OnWindowResized(unsigned int width, unsigned int height);
+
+		GP_DLL RenderTargetPoolStats GetStats() const;
+
+	private:
+		void CreateTextures(PooledRenderTarget* renderTarget);
+		void Evict(size_t index);
+
+	private:
+		std::vector<PooledRenderTarget*> m_RenderTargets;
+		unsigned int m_FrameIndex = 1;
+		unsigned int m_WindowWidth = 0;
+		unsigned int m_WindowHeight = 0;
+	};
+
+	GP_DLL extern RenderTargetPool* g_RenderTargetPool;
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "gfx/GfxCommon.h"
+#include "debug/MemoryTracker.h"
 
 struct ID3D11ShaderResourceView;
 struct ID3D11UnorderedAccessView;
@@ -72,7 +73,10 @@ namespace GP
 		GfxResourceHandle(unsigned int creationFlags):
 			m_CreationFlags(creationFlags) { }
 
-		~GfxResourceHandle() { }
+		~GfxResourceHandle()
+		{
+			if (m_MemoryTracked) MemoryTracker::Untrack(this);
+		}
 
 		inline bool Initialized() const { return m_Handle != nullptr; }
 
@@ -95,6 +99,10 @@ namespace GP
 
 		inline HandleType* GetHandle() const { return m_Handle; }
 		inline unsigned int GetCreationFlags() const { return m_CreationFlags; }
+		inline unsigned int GetVersion() const { return m_Version; }
+
+		// Must be set before the resource is initialized, otherwise the category is inferred from creation flags
+		inline void SetMemoryCategory(MemoryCategory category) { m_MemoryCategory = category; }
 
 		inline void SetInitializationData(unsigned int numPaths, std::string paths[])
 		{
@@ -117,10 +125,29 @@ namespace GP
 			memcpy(m_MemData.data, data, numBytes);
 		}
 
+	protected:
+		// Called by the resource whenever its handle is created or replaced
+		inline void TrackMemory(size_t numBytes, MemoryCategory defaultCategory)
+		{
+			MemoryCategory category = m_MemoryCategory;
+			if (category == MemoryCategory::Count)
+			{
+				if (m_CreationFlags & (RCF_RT | RCF_DS)) category = MemoryCategory::RenderTarget;
+				else if (m_CreationFlags & RCF_CB) category = MemoryCategory::ConstantBuffer;
+				else category = defaultCategory;
+			}
+
+			MemoryTracker::Track(this, category, numBytes, m_PathData.numPaths ? m_PathData.paths[0] : "");
+			m_MemoryTracked = true;
+		}
+
 	protected:
 		HandleType* m_Handle = nullptr;
 		unsigned int m_CreationFlags;
 		unsigned int m_RefCount = 1;
+		unsigned int m_Version = 0; // Incremented when the handle is replaced
+		MemoryCategory m_MemoryCategory = MemoryCategory::Count; // Count until set
+		bool m_MemoryTracked = false;
 
 		// TODO: Put this 2 in union
 		PathInitData m_PathData;
@@ -148,7 +175,7 @@ namespace GP
 			const unsigned int creationFlags = m_Resource->GetCreationFlags();
 			bool srvOK = m_SRV || !(creationFlags & RCF_SRV);
 			bool uavOK = m_UAV || !(creationFlags & RCF_UAV);
-			return m_Resource->Initialized() && srvOK && uavOK;
+			return m_Resource->Initialized() && srvOK && uavOK && m_ResourceVersion == m_Resource->GetVersion();
 		}
 
 		GP_DLL void Initialize(GfxContext* context);
@@ -167,5 +194,6 @@ namespace GP
 		ResourceHandle* m_Resource = nullptr;
 		ID3D11ShaderResourceView* m_SRV = nullptr;
 		ID3D11UnorderedAccessView* m_UAV = nullptr;
+		unsigned int m_ResourceVersion = 0; // Version of the handle that views were created for
 	};
 }
\ No newline at end of file
@@ -7,26 +7,27 @@
 #include <fstream>
 #include <vector>
 #include <set>
-
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <memory>
+#include <condition_variable>
+#include <filesystem>
+#include <chrono>
+#include <algorithm>
+
+#include "core/Threads.h"
 #include "gfx/GfxDevice.h"
+#include "gfx/GfxShaderCache.h"
+#include "gfx/GfxShaderArchive.h"
+#include "util/HashUtil.h"
 #include "util/StringUtil.h"
 #include "util/PathUtil.h"
+#include "util/Timer.h"
+#include "debug/Profiler.h"
 
 namespace GP
 {
-    namespace // Util
-    {
-        // Return true if line has comment and containt input after that comment
-        inline bool HasInComment(const std::string& line, const std::string& input)
-        {
-            // TODO: Case insensitive
-
-            const size_t commentBegin = line.find("//");
-            const size_t inputBegin = line.find(input);
-            return commentBegin != -1 && inputBegin != -1 && commentBegin < inputBegin;
-        }
-    }
-
     namespace
     {
         enum class BackfaceCullingMode
@@ -209,25 +210,32 @@ namespace GP
             PrimitiveTopology topology = PrimitiveTopology::Default;
         };
 
-        static const std::unordered_map<std::string, BackfaceCullingMode> BackfaceCullingModeMap = {
+        template<typename T>
+        struct HeaderValue
+        {
+            std::string_view Name;
+            T Value;
+        };
+
+        static constexpr HeaderValue<BackfaceCullingMode> BackfaceCullingModeValues[] = {
             {"BACKFACE_OFF", BackfaceCullingMode::OFF},
             {"BACKFACE_CW", BackfaceCullingMode::CW},
             {"BACKFACE_CCW", BackfaceCullingMode::CCW}
         };
 
-        static const std::unordered_map<std::string, CompareOp> CompareOpMap = {
+        static constexpr HeaderValue<CompareOp> CompareOpValues[] = {
             {"Always", CompareOp::Always},
             {"Equals", CompareOp::Equals},
             {"Less", CompareOp::Less}
         };
 
-        static const std::unordered_map<std::string, StencilOp> StencilOpMap = {
+        static constexpr HeaderValue<StencilOp> StencilOpValues[] = {
             {"Discard", StencilOp::Discard },
             {"Keep", StencilOp::Keep },
             {"Replace", StencilOp::Replace }
         };
 
-        static const std::unordered_map<std::string, BlendOp> BlendOpMap = {
+        static constexpr HeaderValue<BlendOp> BlendOpValues[] = {
             { "Add" , BlendOp::Add },
             { "Substract" , BlendOp::Substract },
             { "SubstractInv" , BlendOp::SubstractInv },
@@ -235,7 +243,7 @@ namespace GP
             { "Max" , BlendOp::Max }
         };
 
-        static const std::unordered_map<std::string, Blend> BlendMap = {
+        static constexpr HeaderValue<Blend> BlendValues[] = {
             {"Zero", Blend::Zero },
             {"One", Blend::One },
             {"SrcColor", Blend::SrcColor },
@@ -255,7 +263,7 @@ namespace GP
             {"BlendFactorInv", Blend::BlendFactorInv }
         };
 
-        static const std::unordered_map<std::string, PrimitiveTopology> PrimitiveTopologyMap = {
+        static constexpr HeaderValue<PrimitiveTopology> PrimitiveTopologyValues[] = {
             {"Points",PrimitiveTopology::Points },
             {"Lines",PrimitiveTopology::Lines },
             {"LineStrip",PrimitiveTopology::LineStrip },
@@ -322,6 +330,118 @@ namespace GP
 
             return true;
         }
+
+        unsigned long long HashDeviceState(const DeviceState& state)
+        {
+            // Field by field, padding bytes of the struct are not initialized
+            unsigned long long hash = HashUtil::FNV_OFFSET_BASIS;
+            hash = HashUtil::HashValue(hash, state.backfaceCullingMode);
+            hash = HashUtil::HashValue(hash, state.wireframeEnabled);
+            hash = HashUtil::HashValue(hash, state.multisamplingEnabled);
+            hash = HashUtil::HashValue(hash, state.depthTestEnabled);
+            hash = HashUtil::HashValue(hash, state.depthWriteEnabled);
+            hash = HashUtil::HashValue(hash, state.depthCompareOp);
+            hash = HashUtil::HashValue(hash, state.stencilEnabled);
+            hash = HashUtil::HashValue(hash, state.stencilRead);
+            hash = HashUtil::HashValue(hash, state.stencilWrite);
+            hash = HashUtil::HashValue(hash, state.stencilOp);
+            hash = HashUtil::HashValue(hash, state.stencilCompareOp);
+            hash = HashUtil::HashValue(hash, state.alphaBlendEnabled);
+            hash = HashUtil::HashValue(hash, state.blendOp);
+            hash = HashUtil::HashValue(hash, state.blendAlphaOp);
+            hash = HashUtil::HashValue(hash, state.sourceColorBlend);
+            hash = HashUtil::HashValue(hash, state.destColorBlend);
+            hash = HashUtil::HashValue(hash, state.sourceAlphaBlend);
+            hash = HashUtil::HashValue(hash, state.destAlphaBlend);
+            hash = HashUtil::HashValue(hash, state.topology);
+            return hash;
+        }
+
+        bool operator==(const DeviceState& a, const DeviceState& b)
+        {
+            // Field by field for the same reason as the hash
+            return a.backfaceCullingMode == b.backfaceCullingMode && a.wireframeEnabled == b.wireframeEnabled && a.multisamplingEnabled == b.multisamplingEnabled &&
+                a.depthTestEnabled == b.depthTestEnabled && a.depthWriteEnabled == b.depthWriteEnabled && a.depthCompareOp == b.depthCompareOp &&
+                a.stencilEnabled == b.stencilEnabled && a.stencilRead == b.stencilRead && a.stencilWrite == b.stencilWrite &&
+                a.stencilOp[0] == b.stencilOp[0] && a.stencilOp[1] == b.stencilOp[1] && a.stencilOp[2] == b.stencilOp[2] && a.stencilCompareOp == b.stencilCompareOp &&
+                a.alphaBlendEnabled == b.alphaBlendEnabled && a.blendOp == b.blendOp && a.blendAlphaOp == b.blendAlphaOp &&
+                a.sourceColorBlend == b.sourceColorBlend && a.destColorBlend == b.destColorBlend && a.sourceAlphaBlend == b.sourceAlphaBlend && a.destAlphaBlend == b.destAlphaBlend &&
+                a.topology == b.topology;
+        }
+
+        // Shaders with the same header state share one GfxDeviceState, it is destroyed with its last shader
+        namespace DeviceStateCache
+        {
+            struct Entry
+            {
+                DeviceState Desc;
+                GfxDeviceState* State = nullptr;
+                unsigned int RefCount = 0;
+            };
+
+            struct CacheState
+            {
+                std::mutex Mutex;
+                std::unordered_map<unsigned long long, std::vector<Entry>> Entries; // Different states with colliding hashes share a bucket
+            };
+
+            CacheState& GetState()
+            {
+                // Never destroyed, global shaders release their states during static destruction
+                static CacheState* state = new CacheState();
+                return *state;
+            }
+
+            // Returns nullptr if the state objects couldn't be created
+            GfxDeviceState* Acquire(const DeviceState& desc)
+            {
+                const unsigned long long key = HashDeviceState(desc);
+
+                CacheState& cache = GetState();
+                std::lock_guard<std::mutex> lock(cache.Mutex);
+
+                std::vector<Entry>& bucket = cache.Entries[key];
+                for (Entry& entry : bucket)
+                {
+                    if (!(entry.Desc == desc)) continue;
+                    entry.RefCount++;
+                    return entry.State;
+                }
+
+                GfxDeviceState* state = new GfxDeviceState();
+                state->Key = key;
+                if (!CompileState(desc, *state))
+                {
+                    delete state;
+                    if (bucket.empty()) cache.Entries.erase(key);
+                    return nullptr;
+                }
+
+                bucket.push_back({ desc, state, 1 });
+                return state;
+            }
+
+            void Release(GfxDeviceState* state)
+            {
+                if (!state) return;
+
+                CacheState& cache = GetState();
+                std::lock_guard<std::mutex> lock(cache.Mutex);
+
+                const auto it = cache.Entries.find(state->Key);
+                ASSERT(it != cache.Entries.end(), "[DeviceStateCache] Releasing state that is not in the cache!");
+
+                std::vector<Entry>& bucket = it->second;
+                const auto entry = std::find_if(bucket.begin(), bucket.end(), [state](const Entry& entry) { return entry.State == state; });
+                ASSERT(entry != bucket.end(), "[DeviceStateCache] Releasing state that is not in the cache!");
+                if (--entry->RefCount == 0)
+                {
+                    delete entry->State;
+                    bucket.erase(entry);
+                    if (bucket.empty()) cache.Entries.erase(it);
+                }
+            }
+        }
     }
 
     namespace HeaderCompiler
@@ -345,78 +465,190 @@ namespace GP
             bool csEnabled = false;
 
             DeviceState deviceState;
+
+            // Defines that GfxShaderFamily combines into variants
+            std::vector<std::string> permutations;
         };
 
-        template<typename ReturnValue, ReturnValue defaultValue>
-        inline ReturnValue GetValueFromMap(const std::string& line, const std::unordered_map<std::string, ReturnValue>& map, const std::string& prefix = "")
+        // Tokens of a header line are separated by spaces, tabs or commas, returns false at the end of the line
+        inline bool NextToken(std::string_view& line, std::string_view& token)
         {
-            for (const auto& it : map)
+            static constexpr std::string_view SEPARATORS = " \t,";
+
+            const size_t tokenBegin = line.find_first_not_of(SEPARATORS);
+            if (tokenBegin == std::string_view::npos) return false;
+
+            line.remove_prefix(tokenBegin);
+            const size_t tokenEnd = MIN(line.find_first_of(SEPARATORS), line.size());
+            token = line.substr(0, tokenEnd);
+            line.remove_prefix(tokenEnd);
+            return true;
+        }
+
+        inline bool ConsumePrefix(std::string_view& token, std::string_view prefix)
+        {
+            if (token.substr(0, prefix.size()) != prefix) return false;
+            token.remove_prefix(prefix.size());
+            return true;
+        }
+
+        template<typename T, size_t N>
+        inline bool FindValue(std::string_view token, const HeaderValue<T> (&values)[N], T& value)
+        {
+            for (const HeaderValue<T>& it : values)
             {
-                if (HasInComment(line, prefix + it.first)) return it.second;
+                if (it.Name != token) continue;
+                value = it.Value;
+                return true;
             }
-            return defaultValue;
+            return false;
         }
 
-        inline void SetShaderStages(const std::string& line, HeaderData& header)
+        inline bool SetShaderStage(std::string_view token, HeaderData& header)
         {
-            header.vsEnabled = HasInComment(line, "VS");
-            header.psEnabled = HasInComment(line, "PS");
-            header.dsEnabled = HasInComment(line, "DS");
-            header.hsEnabled = HasInComment(line, "HS");
-            header.gsEnabled = HasInComment(line, "GS");
-            header.csEnabled = HasInComment(line, "CS");
+            if (token == "VS") header.vsEnabled = true;
+            else if (token == "PS") header.psEnabled = true;
+            else if (token == "DS") header.dsEnabled = true;
+            else if (token == "HS") header.hsEnabled = true;
+            else if (token == "GS") header.gsEnabled = true;
+            else if (token == "CS") header.csEnabled = true;
+            else return false;
+            return true;
         }
 
-        inline void SetRasterizerState(const std::string& line, HeaderData& header)
+        inline bool SetRasterizerState(std::string_view token, HeaderData& header)
         {
-            header.deviceState.backfaceCullingMode = GetValueFromMap<BackfaceCullingMode, BackfaceCullingMode::Default>(line, BackfaceCullingModeMap);
-            if (HasInComment(line, "WIREFRAME_MODE")) header.deviceState.wireframeEnabled = true;
-            if (HasInComment(line, "MULTISAMPLE")) header.deviceState.multisamplingEnabled = true;
+            DeviceState& state = header.deviceState;
+            if (token == "WIREFRAME_MODE") state.wireframeEnabled = true;
+            else if (token == "MULTISAMPLE") state.multisamplingEnabled = true;
+            else return FindValue(token, BackfaceCullingModeValues, state.backfaceCullingMode);
+            return true;
         }
 
-        inline void SetDepthState(const std::string& line, HeaderData& header)
+        inline bool SetDepthState(std::string_view token, HeaderData& header)
         {
-            if (HasInComment(line, "ENABLED")) header.deviceState.depthTestEnabled = true;
-            if (HasInComment(line, "DEPTH_WRITE_OFF")) header.deviceState.depthWriteEnabled = false;
-            header.deviceState.depthCompareOp = GetValueFromMap<CompareOp, CompareOp::DepthCompareDefault>(line, CompareOpMap, "DepthCompare_");
+            DeviceState& state = header.deviceState;
+            if (token == "ENABLED") state.depthTestEnabled = true;
+            else if (token == "DEPTH_WRITE_OFF") state.depthWriteEnabled = false;
+            else if (ConsumePrefix(token, "DepthCompare_")) return FindValue(token, CompareOpValues, state.depthCompareOp);
+            else return false;
+            return true;
         }
 
-        inline void SetStencilState(const std::string& line, HeaderData& header)
+        inline bool SetStencilState(std::string_view token, HeaderData& header)
         {
             // TODO
             NOT_IMPLEMENTED;
+            return false;
         }
 
-        inline void SetBlendState(const std::string& line, HeaderData& header)
+        inline bool SetBlendState(std::string_view token, HeaderData& header)
         {
-            if (HasInComment(line, "ENABLED")) header.deviceState.alphaBlendEnabled = true;
-            header.deviceState.blendOp = GetValueFromMap<BlendOp, BlendOp::Default>(line, BlendOpMap, "ColorOp_");
-            header.deviceState.blendAlphaOp = GetValueFromMap<BlendOp, BlendOp::AlphaDefault>(line, BlendOpMap, "AlphaOp_");
-            header.deviceState.sourceColorBlend = GetValueFromMap<Blend, Blend::SourceColorDefault>(line, BlendMap, "SrcColor_");
-            header.deviceState.destColorBlend = GetValueFromMap<Blend, Blend::DestColorDefault>(line, BlendMap, "DstColor_");
-            header.deviceState.sourceAlphaBlend = GetValueFromMap<Blend, Blend::SourceAlphaDefault>(line, BlendMap, "SrcAlpha_");
-            header.deviceState.destAlphaBlend = GetValueFromMap<Blend, Blend::DestAlphaDefault>(line, BlendMap, "DstAlpha_");
+            DeviceState& state = header.deviceState;
+            if (token == "ENABLED") state.alphaBlendEnabled = true;
+            else if (ConsumePrefix(token, "ColorOp_")) return FindValue(token, BlendOpValues, state.blendOp);
+            else if (ConsumePrefix(token, "AlphaOp_")) return FindValue(token, BlendOpValues, state.blendAlphaOp);
+            else if (ConsumePrefix(token, "SrcColor_")) return FindValue(token, BlendValues, state.sourceColorBlend);
+            else if (ConsumePrefix(token, "DstColor_")) return FindValue(token, BlendValues, state.destColorBlend);
+            else if (ConsumePrefix(token, "SrcAlpha_")) return FindValue(token, BlendValues, state.sourceAlphaBlend);
+            else if (ConsumePrefix(token, "DstAlpha_")) return FindValue(token, BlendValues, state.destAlphaBlend);
+            else return false;
+            return true;
         }
 
-        inline void SetPrimitiveTopology(const std::string& line, HeaderData& header)
+        inline bool SetPrimitiveTopology(std::string_view token, HeaderData& header)
         {
-            header.deviceState.topology = GetValueFromMap<PrimitiveTopology, PrimitiveTopology::Default>(line, PrimitiveTopologyMap);
+            return FindValue(token, PrimitiveTopologyValues, header.deviceState.topology);
         }
 
-        void CompileHeader(std::vector<std::string>& shaderCode, HeaderData& header)
+        inline bool AddPermutation(std::string_view token, HeaderData& header)
         {
-            for (const std::string& line : shaderCode)
+            header.permutations.emplace_back(token);
+            return true;
+        }
+
+        using HeaderTokenHandler = bool(*)(std::string_view token, HeaderData& header);
+
+        // Comments that are not one of these keys are allowed in the header and skipped
+        inline HeaderTokenHandler GetTokenHandler(std::string_view key, HeaderData& header)
+        {
+            if (key == "ShaderStages")
             {
-                // If doesn't contain comment skip the line
-                if (!StringUtil::Contains(line, "//")) continue;
+                header.vsEnabled = header.psEnabled = header.dsEnabled = header.hsEnabled = header.gsEnabled = header.csEnabled = false;
+                return SetShaderStage;
+            }
+            if (key == "RasterizerState") return SetRasterizerState;
+            if (key == "DepthState") return SetDepthState;
+            if (key == "StencilState") return SetStencilState;
+            if (key == "BlendState") return SetBlendState;
+            if (key == "Topology") return SetPrimitiveTopology;
+            if (key == "Permutations") return AddPermutation;
+            return nullptr;
+        }
+
+        // Single pass over the leading comment lines of the file, stops at the first line that is not a comment or empty
+        void CompileHeader(std::string_view content, HeaderData& header)
+        {
+            while (!content.empty())
+            {
+                const size_t lineEnd = MIN(content.find('\n'), content.size());
+                std::string_view line = content.substr(0, lineEnd);
+                content.remove_prefix(MIN(lineEnd + 1, content.size()));
+
+                const size_t lineBegin = line.find_first_not_of(" \t\r");
+                if (lineBegin == std::string_view::npos) continue;
+                line.remove_prefix(lineBegin);
+                if (line.substr(0, 2) != "//") break;
+                line.remove_prefix(2);
+
+                std::string_view key;
+                if (!NextToken(line, key)) continue;
+                if (key.back() == ':') key.remove_suffix(1);
+
+                const HeaderTokenHandler handler = GetTokenHandler(key, header);
+                if (!handler) continue;
+
+                std::string_view token;
+                while (NextToken(line, token))
+                {
+                    if (token.back() == '\r') token.remove_suffix(1);
+                    if (!token.empty() && !handler(token, header)) CONSOLE_LOG("[GfxShader] Unknown value " + std::string(token) + " in shader header " + std::string(key));
+                }
+            }
+        }
+
+        struct HeaderCacheState
+        {
+            std::mutex Mutex;
+            std::unordered_map<unsigned long long, HeaderData> Entries;
+        };
+
+        HeaderCacheState& GetHeaderCache()
+        {
+            static HeaderCacheState state;
+            return state;
+        }
 
-                if (HasInComment(line, "ShaderStages")) SetShaderStages(line, header);
-                else if (HasInComment(line, "RasterizerState")) SetRasterizerState(line, header);
-                else if (HasInComment(line, "DepthState")) SetDepthState(line, header);
-                else if (HasInComment(line, "StencilState")) SetStencilState(line, header);
-                else if (HasInComment(line, "BlendState")) SetBlendState(line, header);
-                else if (HasInComment(line, "Topology")) SetPrimitiveTopology(line, header);
+        // Parsed headers are kept by the hash of the file, files that didn't change are never scanned again
+        void CompileHeaderCached(std::string_view content, HeaderData& header)
+        {
+            const unsigned long long fileHash = HashUtil::HashBytes(HashUtil::FNV_OFFSET_BASIS, content.data(), content.size());
+
+            HeaderCacheState& cache = GetHeaderCache();
+            {
+                std::lock_guard<std::mutex> lock(cache.Mutex);
+                const auto it = cache.Entries.find(fileHash);
+                if (it != cache.Entries.end())
+                {
+                    header = it->second;
+                    return;
+                }
             }
+
+            CompileHeader(content, header);
+
+            std::lock_guard<std::mutex> lock(cache.Mutex);
+            cache.Entries[fileHash] = header;
         }
     }
 
@@ -436,8 +668,21 @@ namespace GP
             ID3D11InputLayout* il = nullptr;
             ID3D11InputLayout* mil = nullptr;
 
-            GfxDeviceState* state = new GfxDeviceState();
-            GfxDeviceState* stateMS = new GfxDeviceState();
+            GfxDeviceState* state = nullptr;
+            GfxDeviceState* stateMS = nullptr;
+
+            GfxBindingLayout bindingLayout;
+
+            std::vector<std::string> dependencies;
+        };
+
+        struct ShaderSource
+        {
+            std::string code;
+            HeaderCompiler::HeaderData header;
+
+            // Every file that was read to expand the code, including the shader itself
+            std::vector<std::string> dependencies;
         };
 
         DXGI_FORMAT ToDXGIFormat(D3D11_SIGNATURE_PARAMETER_DESC paramDesc)
@@ -495,78 +740,104 @@ namespace GP
             return DXGI_FORMAT_UNKNOWN;
         }
 
-        static bool ReadFile(const std::string& path, std::vector<std::string>& content)
+        static bool ReadFile(const std::string& path, std::string& content)
         {
             content.clear();
 
-            std::ifstream fileStream(path, std::ios::in);
+            std::ifstream fileStream(path, std::ios::in | std::ios::binary);
 
             if (!fileStream.is_open()) {
                 return false;
             }
 
-            std::string line = "";
-            while (!fileStream.eof()) {
-                std::getline(fileStream, line);
-                content.push_back(line);
-            }
+            fileStream.seekg(0, std::ios::end);
+            content.resize((size_t) fileStream.tellg());
+            fileStream.seekg(0, std::ios::beg);
+            fileStream.read(content.data(), content.size());
 
             fileStream.close();
             return true;
         }
 
-        static void ReadShaderFile(std::string path, std::string& shaderCode, HeaderCompiler::HeaderData& headerData)
+        // Appends content line by line, every file is included only once and its content is expanded in place of the #include
+        static bool AppendShaderCode(std::string_view content, const std::string& rootPath, std::set<std::string>& loadedFiles, ShaderSource& source)
         {
-            static const std::string commonInclude = "gp/gfx/GPShaderCommon.h";
+            while (!content.empty())
+            {
+                const size_t lineEnd = MIN(content.find('\n'), content.size());
+                std::string_view line = content.substr(0, lineEnd);
+                content.remove_prefix(MIN(lineEnd + 1, content.size()));
+                if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
 
-            shaderCode = "";
+                if (line.find("#include") == std::string_view::npos)
+                {
+                    source.code.append(line);
+                    source.code.append("\n");
+                    continue;
+                }
 
-            std::string rootPath = PathUtil::GetPathWitoutFile(path);
-            std::vector<std::string> shaderContent;
-            std::vector<std::string> tmp;
+                std::string fileName = std::string(line);
+                StringUtil::ReplaceAll(fileName, "#include", "");
+                StringUtil::ReplaceAll(fileName, " ", "");
+                StringUtil::ReplaceAll(fileName, "\"", "");
 
-            bool readSuccess = false;
+                if (loadedFiles.count(fileName)) continue;
+                loadedFiles.insert(fileName);
 
-            readSuccess = ReadFile(path, shaderContent);
-            ASSERT(readSuccess, "Failed to load shader: " + path);
+                const std::string includePath = rootPath + fileName;
+                std::string includeContent;
+                if (!ReadFile(includePath, includeContent))
+                {
+                    CONSOLE_LOG("Failed to include file in shader: " + includePath);
+                    return false;
+                }
+                source.dependencies.push_back(includePath);
 
-            // TODO: Apply defines on shader content so we can have multiple variations of header
-            HeaderCompiler::CompileHeader(shaderContent, headerData);
+                if (!AppendShaderCode(includeContent, rootPath, loadedFiles, source)) return false;
+            }
+            return true;
+        }
+
+        // Returns false if the shader or any of its includes can't be read
+        static bool ReadShaderFile(const std::string& path, ShaderSource& source)
+        {
+            static const std::string commonInclude = "gp/gfx/GPShaderCommon.h";
 
-            readSuccess = ReadFile(commonInclude, tmp);
-            ASSERT(readSuccess, "Failed to include common shader header!");
+            source.code = "";
+            source.header = HeaderCompiler::HeaderData();
+            source.dependencies = { path, commonInclude };
 
-            shaderContent.insert((shaderContent.begin()), tmp.begin(), tmp.end());
+            const std::string rootPath = PathUtil::GetPathWitoutFile(path);
+            std::string shaderContent;
+            std::string commonContent;
 
-            std::set<std::string> loadedFiles = {};
-            for (size_t i = 0; i < shaderContent.size(); i++)
+            if (!ReadFile(path, shaderContent))
             {
-                std::string& line = shaderContent[i];
-                if (StringUtil::Contains(line, "#include"))
-                {
-                    std::string fileName = line;
-                    StringUtil::ReplaceAll(fileName, "#include", "");
-                    StringUtil::ReplaceAll(fileName, " ", "");
-                    StringUtil::ReplaceAll(fileName, "\"", "");
+                CONSOLE_LOG("Failed to load shader: " + path);
+                return false;
+            }
 
-                    if (loadedFiles.count(fileName)) continue;
-                    loadedFiles.insert(fileName);
+            // TODO: Apply defines on shader content so we can have multiple variations of header
+            HeaderCompiler::CompileHeaderCached(shaderContent, source.header);
 
-                    readSuccess = ReadFile(rootPath + fileName, tmp);
-                    ASSERT(readSuccess, "Failed to include file in shader: " + rootPath + fileName);
-                    shaderContent.insert((shaderContent.begin() + (i + 1)), tmp.begin(), tmp.end());
-                }
-                else
-                {
-                    shaderCode.append(line + "\n");
-                }
+            if (!ReadFile(commonInclude, commonContent))
+            {
+                CONSOLE_LOG("Failed to include common shader header!");
+                return false;
             }
+
+            source.code.reserve(commonContent.size() + shaderContent.size());
+
+            std::set<std::string> loadedFiles = {};
+            return AppendShaderCode(commonContent, rootPath, loadedFiles, source) && AppendShaderCode(shaderContent, rootPath, loadedFiles, source);
         }
 
+        static constexpr unsigned int COMPILE_FLAGS = 0;
+
         ID3DBlob* ReadBlobFromFile(const std::string& shaderCode, const std::string& entry, const std::string& hlsl_target, D3D_SHADER_MACRO* configuration)
         {
             ID3DBlob *shaderCompileErrorsBlob, *blob;
-            HRESULT hResult = D3DCompile(shaderCode.c_str(), shaderCode.size(), nullptr, configuration, nullptr,  entry.c_str(), hlsl_target.c_str(), 0, 0, &blob, &shaderCompileErrorsBlob);
+            HRESULT hResult = D3DCompile(shaderCode.c_str(), shaderCode.size(), nullptr, configuration, nullptr,  entry.c_str(), hlsl_target.c_str(), COMPILE_FLAGS, 0, &blob, &shaderCompileErrorsBlob);
             if (FAILED(hResult))
             {
                 const char* errorString = NULL;
@@ -580,10 +851,39 @@ namespace GP
             return blob;
         }
 
-        ID3D11InputLayout* CreateInputLayout(ID3D11Device1* device, ID3DBlob* vsBlob, bool multiInput)
+        // Compiled bytecode is taken from the shader cache when the same expanded source was compiled before
+        ID3DBlob* CompileStage(const std::string& shaderCode, const std::vector<std::string>& defines, const std::string& entry, const std::string& hlsl_target, D3D_SHADER_MACRO* configuration)
+        {
+            const ShaderCache::Key cacheKey = ShaderCache::ComputeKey(shaderCode, defines, entry, hlsl_target, COMPILE_FLAGS);
+
+            std::vector<unsigned char> bytecode;
+            if (ShaderCache::Load(cacheKey, bytecode))
+            {
+                ID3DBlob* blob;
+                DX_CALL(D3DCreateBlob(bytecode.size(), &blob));
+                memcpy(blob->GetBufferPointer(), bytecode.data(), bytecode.size());
+                return blob;
+            }
+
+            Timer compileTimer;
+            compileTimer.Start();
+            ID3DBlob* blob = ReadBlobFromFile(shaderCode, entry, hlsl_target, configuration);
+            compileTimer.Stop();
+
+            if (blob) ShaderCache::Store(cacheKey, blob->GetBufferPointer(), blob->GetBufferSize(), compileTimer.GetTimeMS());
+            return blob;
+        }
+
+        struct ShaderBytecode
+        {
+            const void* data = nullptr;
+            size_t size = 0;
+        };
+
+        ID3D11InputLayout* CreateInputLayout(ID3D11Device1* device, const ShaderBytecode& vsBytecode, bool multiInput)
         {
             ID3D11ShaderReflection* reflection;
-            DX_CALL(D3DReflect(vsBlob->GetBufferPointer(), vsBlob->GetBufferSize(), IID_ID3D11ShaderReflection, (void**)&reflection));
+            DX_CALL(D3DReflect(vsBytecode.data, vsBytecode.size, IID_ID3D11ShaderReflection, (void**)&reflection));
             D3D11_SHADER_DESC desc;
             reflection->GetDesc(&desc);
 
@@ -616,7 +916,7 @@ namespace GP
             }
 
             ID3D11InputLayout* inputLayout;
-            DX_CALL(device->CreateInputLayout(inputElements.data(), desc.InputParameters, vsBlob->GetBufferPointer(), vsBlob->GetBufferSize(), &inputLayout));
+            DX_CALL(device->CreateInputLayout(inputElements.data(), desc.InputParameters, vsBytecode.data, vsBytecode.size, &inputLayout));
 
             reflection->Release();
 
@@ -640,57 +940,303 @@ namespace GP
             return compiledConfig;
         }
 
-        CompiledShader CompileShader(const std::string& path, const std::vector<std::string>& defines)
+        enum StageIndex
         {
-            CompiledShader result;
+            STAGE_VS,
+            STAGE_PS,
+            STAGE_DS,
+            STAGE_HS,
+            STAGE_GS,
+            STAGE_CS,
+            STAGE_COUNT
+        };
 
-            std::string shaderCode;
-            HeaderCompiler::HeaderData header;
-            ReadShaderFile(path, shaderCode, header);
+        // Returns false if the stage is not enabled in the shader header
+        bool GetStageDesc(const HeaderCompiler::HeaderData& header, unsigned int stage, std::string& entry, std::string& target)
+        {
+            switch (stage)
+            {
+            case STAGE_VS: entry = header.vsEntry; target = "vs_" + header.shaderVersion; return header.vsEnabled;
+            case STAGE_PS: entry = header.psEntry; target = "ps_" + header.shaderVersion; return header.psEnabled;
+            case STAGE_DS: entry = header.dsEntry; target = "ds_" + header.shaderVersion; return header.dsEnabled;
+            case STAGE_HS: entry = header.hsEntry; target = "hs_" + header.shaderVersion; return header.hsEnabled;
+            case STAGE_GS: entry = header.gsEntry; target = "gs_" + header.shaderVersion; return header.gsEnabled;
+            case STAGE_CS: entry = header.csEntry; target = "cs_" + header.shaderVersion; return header.csEnabled;
+            default: NOT_IMPLEMENTED;
+            }
+            return false;
+        }
+
+        ShaderStage GetStageBit(unsigned int stage)
+        {
+            switch (stage)
+            {
+            case STAGE_VS: return VS;
+            case STAGE_PS: return PS;
+            case STAGE_DS: return DS;
+            case STAGE_HS: return HS;
+            case STAGE_GS: return GS;
+            case STAGE_CS: return CS;
+            default: NOT_IMPLEMENTED;
+            }
+            return VS;
+        }
+
+        bool GetBindingType(D3D_SHADER_INPUT_TYPE inputType, ShaderBindingType& type)
+        {
+            switch (inputType)
+            {
+            case D3D_SIT_CBUFFER:
+                type = ShaderBindingType::ConstantBuffer; return true;
+            case D3D_SIT_TBUFFER:
+            case D3D_SIT_TEXTURE:
+            case D3D_SIT_STRUCTURED:
+            case D3D_SIT_BYTEADDRESS:
+                type = ShaderBindingType::Resource; return true;
+            case D3D_SIT_UAV_RWTYPED:
+            case D3D_SIT_UAV_RWSTRUCTURED:
+            case D3D_SIT_UAV_RWBYTEADDRESS:
+            case D3D_SIT_UAV_APPEND_STRUCTURED:
+            case D3D_SIT_UAV_CONSUME_STRUCTURED:
+            case D3D_SIT_UAV_RWSTRUCTURED_WITH_COUNTER:
+                type = ShaderBindingType::RWResource; return true;
+            case D3D_SIT_SAMPLER:
+                type = ShaderBindingType::Sampler; return true;
+            default:
+                return false;
+            }
+        }
+
+        // Adds resources that the stage reads, a resource shared between stages becomes one binding with more stage bits
+        void ReflectBindings(const ShaderBytecode& bytecode, ShaderStage stage, GfxBindingLayout& layout)
+        {
+            ID3D11ShaderReflection* reflection;
+            if (FAILED(D3DReflect(bytecode.data, bytecode.size, IID_ID3D11ShaderReflection, (void**)&reflection))) return;
+
+            D3D11_SHADER_DESC desc;
+            reflection->GetDesc(&desc);
+
+            for (unsigned int i = 0; i < desc.BoundResources; i++)
+            {
+                D3D11_SHADER_INPUT_BIND_DESC bindDesc;
+                reflection->GetResourceBindingDesc(i, &bindDesc);
+
+                ShaderBindingType type;
+                if (!GetBindingType(bindDesc.Type, type)) continue;
+
+                ShaderBinding* binding = nullptr;
+                for (ShaderBinding& existing : layout.Bindings)
+                {
+                    if (existing.Type == type && existing.Slot == bindDesc.BindPoint && existing.Name == bindDesc.Name) binding = &existing;
+                }
+
+                if (!binding)
+                {
+                    layout.Bindings.push_back(ShaderBinding{});
+                    binding = &layout.Bindings.back();
+                    binding->Name = bindDesc.Name;
+                    binding->Type = type;
+                    binding->Slot = bindDesc.BindPoint;
+                }
+                binding->Stages |= stage;
+            }
+
+            reflection->Release();
+        }
+
+        // Safe to call from any thread, stages of the same shader don't depend on each other
+        ID3DBlob* CompileShaderStage(const ShaderSource& source, const std::vector<std::string>& defines, unsigned int stage)
+        {
+            std::string entry, target;
+            if (!GetStageDesc(source.header, stage, entry, target)) return nullptr;
 
             D3D_SHADER_MACRO* configuration = CompileConfiguration(defines);
-            ID3DBlob* vsBlob = header.vsEnabled ? ReadBlobFromFile(shaderCode, header.vsEntry, "vs_" + header.shaderVersion, configuration) : nullptr;
-            ID3DBlob* psBlob = header.psEnabled ? ReadBlobFromFile(shaderCode, header.psEntry, "ps_" + header.shaderVersion, configuration) : nullptr;
-            ID3DBlob* dsBlob = header.dsEnabled ? ReadBlobFromFile(shaderCode, header.dsEntry, "ds_" + header.shaderVersion, configuration) : nullptr;
-            ID3DBlob* hsBlob = header.hsEnabled ? ReadBlobFromFile(shaderCode, header.hsEntry, "hs_" + header.shaderVersion, configuration) : nullptr;
-            ID3DBlob* gsBlob = header.gsEnabled ? ReadBlobFromFile(shaderCode, header.gsEntry, "gs_" + header.shaderVersion, configuration) : nullptr;
-            ID3DBlob* csBlob = header.csEnabled ? ReadBlobFromFile(shaderCode, header.csEntry, "cs_" + header.shaderVersion, configuration) : nullptr;
+            ID3DBlob* blob = CompileStage(source.code, defines, entry, target, configuration);
+            free(configuration);
+            return blob;
+        }
+
+        // Creates device objects from stage bytecode, the binding layout is reflected if it is not given
+        CompiledShader CreateShader(const DeviceState& deviceState, const ShaderBytecode bytecode[STAGE_COUNT], const GfxBindingLayout* bindingLayout)
+        {
+            CompiledShader result;
+
+            const ShaderBytecode& vs = bytecode[STAGE_VS];
+            const ShaderBytecode& ps = bytecode[STAGE_PS];
+            const ShaderBytecode& ds = bytecode[STAGE_DS];
+            const ShaderBytecode& hs = bytecode[STAGE_HS];
+            const ShaderBytecode& gs = bytecode[STAGE_GS];
+            const ShaderBytecode& cs = bytecode[STAGE_CS];
 
             ID3D11Device1* device = g_Device->GetDevice();
 
-            result.success = vsBlob || psBlob || dsBlob || hsBlob || gsBlob || csBlob;
-            if (vsBlob) result.success = result.success && SUCCEEDED(device->CreateVertexShader(vsBlob->GetBufferPointer(), vsBlob->GetBufferSize(), nullptr, &result.vs));
-            if (psBlob) result.success = result.success && SUCCEEDED(device->CreatePixelShader(psBlob->GetBufferPointer(), psBlob->GetBufferSize(), nullptr, &result.ps));
-            if (dsBlob) result.success = result.success && SUCCEEDED(device->CreateDomainShader(dsBlob->GetBufferPointer(), dsBlob->GetBufferSize(), nullptr, &result.ds));
-            if (hsBlob) result.success = result.success && SUCCEEDED(device->CreateHullShader(hsBlob->GetBufferPointer(), hsBlob->GetBufferSize(), nullptr, &result.hs));
-            if (gsBlob) result.success = result.success && SUCCEEDED(device->CreateGeometryShader(gsBlob->GetBufferPointer(), gsBlob->GetBufferSize(), nullptr, &result.gs));
-            if (csBlob) result.success = result.success && SUCCEEDED(device->CreateComputeShader(csBlob->GetBufferPointer(), csBlob->GetBufferSize(), nullptr, &result.cs));
+            result.success = vs.data || ps.data || ds.data || hs.data || gs.data || cs.data;
 
-            if (vsBlob)
+            if (vs.data) result.success = result.success && SUCCEEDED(device->CreateVertexShader(vs.data, vs.size, nullptr, &result.vs));
+            if (ps.data) result.success = result.success && SUCCEEDED(device->CreatePixelShader(ps.data, ps.size, nullptr, &result.ps));
+            if (ds.data) result.success = result.success && SUCCEEDED(device->CreateDomainShader(ds.data, ds.size, nullptr, &result.ds));
+            if (hs.data) result.success = result.success && SUCCEEDED(device->CreateHullShader(hs.data, hs.size, nullptr, &result.hs));
+            if (gs.data) result.success = result.success && SUCCEEDED(device->CreateGeometryShader(gs.data, gs.size, nullptr, &result.gs));
+            if (cs.data) result.success = result.success && SUCCEEDED(device->CreateComputeShader(cs.data, cs.size, nullptr, &result.cs));
+
+            if (vs.data)
             {
-                result.il = CreateInputLayout(device, vsBlob, false);
-                result.mil = CreateInputLayout(device, vsBlob, true);
+                result.il = CreateInputLayout(device, vs, false);
+                result.mil = CreateInputLayout(device, vs, true);
             }
 
-            SAFE_RELEASE(vsBlob);
-            SAFE_RELEASE(psBlob);
-            SAFE_RELEASE(dsBlob);
-            SAFE_RELEASE(hsBlob);
-            SAFE_RELEASE(gsBlob);
-            SAFE_RELEASE(csBlob);
+            if (bindingLayout)
+            {
+                result.bindingLayout = *bindingLayout;
+            }
+            else
+            {
+                for (unsigned int i = 0; i < STAGE_COUNT; i++)
+                {
+                    if (bytecode[i].data) ReflectBindings(bytecode[i], GetStageBit(i), result.bindingLayout);
+                }
+            }
 
             // Compile state
 
-            DeviceState state = header.deviceState;
+            DeviceState state = deviceState;
             
             state.multisamplingEnabled = false;
-            result.success = result.success && CompileState(state, *result.state);
+            result.state = DeviceStateCache::Acquire(state);
+            result.success = result.success && result.state;
             
             state.multisamplingEnabled = true;
-            result.success = result.success && CompileState(state, *result.stateMS);
+            result.stateMS = DeviceStateCache::Acquire(state);
+            result.success = result.success && result.stateMS;
+
+            return result;
+        }
+
+        // Creates device objects from compiled stages and releases the blobs
+        CompiledShader CreateShader(const HeaderCompiler::HeaderData& header, ID3DBlob* blobs[STAGE_COUNT])
+        {
+            ShaderBytecode bytecode[STAGE_COUNT];
+            for (unsigned int i = 0; i < STAGE_COUNT; i++)
+            {
+                if (blobs[i]) bytecode[i] = { blobs[i]->GetBufferPointer(), blobs[i]->GetBufferSize() };
+            }
+
+            CompiledShader result = CreateShader(header.deviceState, bytecode, nullptr);
+
+            // Stage that failed to compile would otherwise leave a null shader bound
+            std::string entry, target;
+            for (unsigned int i = 0; i < STAGE_COUNT; i++) result.success = result.success && (blobs[i] || !GetStageDesc(header, i, entry, target));
+
+            for (unsigned int i = 0; i < STAGE_COUNT; i++) SAFE_RELEASE(blobs[i]);
+
+            return result;
+        }
+
+        static_assert(ArchivedShader::NUM_STAGES == STAGE_COUNT, "Shader archive must store every stage");
+
+        // Every field is stored as a 32 bit value, cooked bytes don't depend on padding or on the struct layout of the compiler
+        template<typename State, typename Visitor>
+        void VisitDeviceState(State& state, Visitor visit)
+        {
+            visit(state.backfaceCullingMode);
+            visit(state.wireframeEnabled);
+            visit(state.multisamplingEnabled);
+            visit(state.depthTestEnabled);
+            visit(state.depthWriteEnabled);
+            visit(state.depthCompareOp);
+            visit(state.stencilEnabled);
+            visit(state.stencilRead);
+            visit(state.stencilWrite);
+            for (auto& stencilOp : state.stencilOp) visit(stencilOp);
+            visit(state.stencilCompareOp);
+            visit(state.alphaBlendEnabled);
+            visit(state.blendOp);
+            visit(state.blendAlphaOp);
+            visit(state.sourceColorBlend);
+            visit(state.destColorBlend);
+            visit(state.sourceAlphaBlend);
+            visit(state.destAlphaBlend);
+            visit(state.topology);
+        }
 
+        std::vector<unsigned char> SerializeDeviceState(const DeviceState& state)
+        {
+            std::vector<unsigned char> data;
+            VisitDeviceState(state, [&data](const auto& field)
+            {
+                const unsigned int value = (unsigned int) field;
+                const unsigned char* bytes = (const unsigned char*) &value;
+                data.insert(data.end(), bytes, bytes + sizeof(unsigned int));
+            });
+            return data;
+        }
+
+        bool DeserializeDeviceState(const std::vector<unsigned char>& data, DeviceState& state)
+        {
+            size_t numFields = 0;
+            VisitDeviceState(state, [&numFields](const auto&) { numFields++; });
+            if (data.size() != numFields * sizeof(unsigned int)) return false;
+
+            const unsigned char* bytes = data.data();
+            VisitDeviceState(state, [&bytes](auto& field)
+            {
+                unsigned int value;
+                memcpy(&value, bytes, sizeof(unsigned int));
+                bytes += sizeof(unsigned int);
+                field = (std::remove_reference_t<decltype(field)>) value;
+            });
+            return true;
+        }
+
+        // Archive entry has everything the compiler would produce, the source is never read
+        CompiledShader LoadArchivedShader(const ArchivedShader& archivedShader)
+        {
+            DeviceState deviceState;
+            if (!DeserializeDeviceState(archivedShader.HeaderState, deviceState)) return CompiledShader{};
+
+            ShaderBytecode bytecode[STAGE_COUNT];
+            for (unsigned int i = 0; i < STAGE_COUNT; i++)
+            {
+                const std::vector<unsigned char>& stageBytecode = archivedShader.Bytecode[i];
+                if (!stageBytecode.empty()) bytecode[i] = { stageBytecode.data(), stageBytecode.size() };
+            }
+
+            return CreateShader(deviceState, bytecode, &archivedShader.BindingLayout);
+        }
+
+        CompiledShader CompileShader(const ShaderSource& source, const std::vector<std::string>& defines)
+        {
+            ID3DBlob* blobs[STAGE_COUNT];
+            for (unsigned int i = 0; i < STAGE_COUNT; i++) blobs[i] = CompileShaderStage(source, defines, i);
+
+            CompiledShader result = CreateShader(source.header, blobs);
+            result.dependencies = source.dependencies;
             return result;
         }
+
+        CompiledShader CompileShader(const std::string& path, const std::vector<std::string>& defines)
+        {
+            ShaderSource source;
+            const bool readSuccess = ReadShaderFile(path, source);
+            ASSERT(readSuccess, "[GfxShader] Failed to read shader: " + path);
+            return CompileShader(source, defines);
+        }
+
+        void ReleaseCompiledShader(CompiledShader& compiledShader)
+        {
+            SAFE_RELEASE(compiledShader.vs);
+            SAFE_RELEASE(compiledShader.ps);
+            SAFE_RELEASE(compiledShader.hs);
+            SAFE_RELEASE(compiledShader.ds);
+            SAFE_RELEASE(compiledShader.gs);
+            SAFE_RELEASE(compiledShader.cs);
+            SAFE_RELEASE(compiledShader.il);
+            SAFE_RELEASE(compiledShader.mil);
+            DeviceStateCache::Release(compiledShader.state);
+            DeviceStateCache::Release(compiledShader.stateMS);
+            compiledShader.state = nullptr;
+            compiledShader.stateMS = nullptr;
+        }
     }
 
     GfxDeviceState::~GfxDeviceState()
@@ -700,6 +1246,552 @@ namespace GP
         SAFE_RELEASE(Blend);
     }
 
+    ///////////////////////////////////////
+    //			Shader registry	        //
+    /////////////////////////////////////
+
+    namespace
+    {
+        struct PendingShader
+        {
+            std::string Path;
+            std::vector<std::string> Defines;
+            bool HasSource = false;
+            ShaderCompiler::ShaderSource Source;
+            ID3DBlob* Blobs[ShaderCompiler::STAGE_COUNT] = {};
+            std::atomic<unsigned int> RemainingStages = 0;
+
+            bool Ready = false;
+            ShaderCompiler::CompiledShader Result;
+        };
+
+        struct StageJob
+        {
+            PendingShader* Shader;
+            unsigned int Stage;
+        };
+
+        using FileTime = std::filesystem::file_time_type;
+        using Clock = std::chrono::high_resolution_clock;
+
+        // Files are polled, only the ones some shader was compiled from
+        static constexpr std::chrono::milliseconds WATCH_INTERVAL{ 250 };
+
+        struct HotReload
+        {
+            GfxShader* Shader;
+            ShaderCompiler::ShaderSource Source;
+            ShaderCompiler::CompiledShader Result;
+            Clock::time_point ChangeTime;
+        };
+
+        struct RegistryState
+        {
+            std::mutex Mutex;
+            std::condition_variable ReadyCondition;
+            std::vector<GfxShader*> Shaders;
+            std::unordered_map<GfxShader*, std::unique_ptr<PendingShader>> Pending;
+            std::thread CompileThread;
+            ShaderRegistryStats Stats;
+
+            // Dependency graph, edges go from a shader to every file it was compiled from
+            std::unordered_map<GfxShader*, std::vector<std::string>> Dependencies;
+            std::unordered_map<std::string, FileTime> FileTimes;
+            std::vector<HotReload> HotReloads;
+
+            std::thread WatchThread;
+            std::condition_variable WatchCondition;
+            bool WatchStop = false;
+            bool WatchForceCheck = false;
+
+            void StopThreads()
+            {
+                {
+                    std::lock_guard<std::mutex> lock(Mutex);
+                    WatchStop = true;
+                }
+                WatchCondition.notify_all();
+                if (WatchThread.joinable()) WatchThread.join();
+                if (CompileThread.joinable()) CompileThread.join();
+            }
+
+            ~RegistryState()
+            {
+                StopThreads();
+            }
+        };
+
+        RegistryState& GetRegistry()
+        {
+            static RegistryState state;
+            return state;
+        }
+
+        void FinishPendingShader(RegistryState& registry, PendingShader* pendingShader)
+        {
+            ShaderCompiler::CompiledShader result = ShaderCompiler::CreateShader(pendingShader->Source.header, pendingShader->Blobs);
+            result.dependencies = pendingShader->Source.dependencies;
+            {
+                std::lock_guard<std::mutex> lock(registry.Mutex);
+                pendingShader->Result = result;
+                pendingShader->Ready = true;
+            }
+            registry.ReadyCondition.notify_all();
+        }
+
+        // Runs on the compile thread, shaders are handed to GfxShader::Initialize as soon as their last stage is done
+        void CompileBatch(std::vector<PendingShader*> batch)
+        {
+            ThreadUtil::SetThreadName("Shader compile");
+            GP_SCOPED_CPU_PROFILE("ShaderRegistry::CompileBatch");
+            RegistryState& registry = GetRegistry();
+
+            Timer wallTimer;
+            wallTimer.Start();
+
+            std::atomic<unsigned int> numStageJobs = 0;
+            std::mutex jobTimeMutex;
+            float jobTimeMS = 0.0f;
+            const auto addJobTime = [&](float timeMS)
+            {
+                std::lock_guard<std::mutex> lock(jobTimeMutex);
+                jobTimeMS += timeMS;
+            };
+
+            ThreadUtil::ParallelFor((unsigned int) batch.size(), [&](unsigned int index)
+            {
+                GP_SCOPED_CPU_PROFILE("ShaderRegistry::ReadSource");
+                Timer jobTimer;
+                jobTimer.Start();
+                PendingShader* pendingShader = batch[index];
+                if (!pendingShader->HasSource) ShaderCompiler::ReadShaderFile(pendingShader->Path, pendingShader->Source);
+                jobTimer.Stop();
+                addJobTime(jobTimer.GetTimeMS());
+            });
+
+            std::vector<StageJob> jobs;
+            for (PendingShader* pendingShader : batch)
+            {
+                std::string entry, target;
+                unsigned int numStages = 0;
+                for (unsigned int stage = 0; stage < ShaderCompiler::STAGE_COUNT; stage++)
+                {
+                    if (!ShaderCompiler::GetStageDesc(pendingShader->Source.header, stage, entry, target)) continue;
+                    jobs.push_back({ pendingShader, stage });
+                    numStages++;
+                }
+                pendingShader->RemainingStages = numStages;
+                if (numStages == 0) FinishPendingShader(registry, pendingShader);
+            }
+
+            ThreadUtil::ParallelFor((unsigned int) jobs.size(), [&](unsigned int index)
+            {
+                GP_SCOPED_CPU_PROFILE("ShaderRegistry::CompileStage");
+                Timer jobTimer;
+                jobTimer.Start();
+
+                const StageJob& job = jobs[index];
+                PendingShader* pendingShader = job.Shader;
+                pendingShader->Blobs[job.Stage] = ShaderCompiler::CompileShaderStage(pendingShader->Source, pendingShader->Defines, job.Stage);
+
+                // Last stage to finish creates the device objects, device is free threaded
+                if (--pendingShader->RemainingStages == 0) FinishPendingShader(registry, pendingShader);
+
+                jobTimer.Stop();
+                addJobTime(jobTimer.GetTimeMS());
+                numStageJobs++;
+            });
+
+            wallTimer.Stop();
+
+            std::lock_guard<std::mutex> lock(registry.Mutex);
+            registry.Stats.NumShaders += (unsigned int) batch.size();
+            registry.Stats.NumStageJobs += numStageJobs;
+            registry.Stats.WallTimeMS += wallTimer.GetTimeMS();
+            registry.Stats.CpuTimeMS += jobTimeMS;
+            CONSOLE_LOG("[ShaderRegistry] Compiled " + std::to_string(batch.size()) + " shaders (" + std::to_string(numStageJobs) + " stage jobs) in " + std::to_string(wallTimer.GetTimeMS()) + " ms wall time, " + std::to_string(jobTimeMS) + " ms summed CPU time");
+        }
+
+        FileTime GetFileTime(const std::string& path)
+        {
+            std::error_code error;
+            const FileTime fileTime = std::filesystem::last_write_time(path, error);
+            return error ? FileTime::min() : fileTime;
+        }
+
+        // Runs on the watch thread, changed shaders are compiled here and swapped in ShaderRegistry::Update
+        void WatchFiles()
+        {
+            ThreadUtil::SetThreadName("Shader watch");
+            RegistryState& registry = GetRegistry();
+            while (true)
+            {
+                std::vector<std::pair<std::string, FileTime>> files;
+                {
+                    std::unique_lock<std::mutex> lock(registry.Mutex);
+                    registry.WatchCondition.wait_for(lock, WATCH_INTERVAL, [&registry]() { return registry.WatchStop || registry.WatchForceCheck; });
+                    if (registry.WatchStop) return;
+                    registry.WatchForceCheck = false;
+                    files.assign(registry.FileTimes.begin(), registry.FileTimes.end());
+                }
+
+                std::set<std::string> changedFiles;
+                for (auto& file : files)
+                {
+                    const FileTime fileTime = GetFileTime(file.first);
+                    if (fileTime == file.second) continue;
+                    file.second = fileTime;
+                    changedFiles.insert(file.first);
+                }
+                if (changedFiles.empty()) continue;
+
+                const Clock::time_point changeTime = Clock::now();
+
+                struct ReloadJob
+                {
+                    GfxShader* Shader;
+                    std::string Path;
+                    std::vector<std::string> Defines;
+                };
+
+                std::vector<ReloadJob> jobs;
+                {
+                    std::lock_guard<std::mutex> lock(registry.Mutex);
+                    for (const auto& file : files)
+                    {
+                        if (changedFiles.count(file.first)) registry.FileTimes[file.first] = file.second;
+                    }
+
+                    for (const auto& it : registry.Dependencies)
+                    {
+                        const std::vector<std::string>& dependencies = it.second;
+                        const bool changed = std::any_of(dependencies.begin(), dependencies.end(), [&changedFiles](const std::string& dependency) { return changedFiles.count(dependency) > 0; });
+                        if (changed) jobs.push_back({ it.first, it.first->GetPath(), it.first->GetDefines() });
+                    }
+                }
+
+                ThreadUtil::ParallelFor((unsigned int) jobs.size(), [&](unsigned int index)
+                {
+                    GP_SCOPED_CPU_PROFILE("ShaderRegistry::HotReload");
+                    const ReloadJob& job = jobs[index];
+
+                    HotReload hotReload;
+                    hotReload.Shader = job.Shader;
+                    hotReload.ChangeTime = changeTime;
+                    if (ShaderCompiler::ReadShaderFile(job.Path, hotReload.Source))
+                    {
+                        hotReload.Result = ShaderCompiler::CompileShader(hotReload.Source, job.Defines);
+                    }
+
+                    std::lock_guard<std::mutex> lock(registry.Mutex);
+                    if (registry.Dependencies.count(job.Shader)) registry.HotReloads.push_back(std::move(hotReload));
+                    else ShaderCompiler::ReleaseCompiledShader(hotReload.Result);
+                });
+            }
+        }
+
+        // Called whenever a shader gets new compiled objects, starts watching its files
+        void TrackDependencies(GfxShader* shader, const std::vector<std::string>& dependencies)
+        {
+            RegistryState& registry = GetRegistry();
+            std::lock_guard<std::mutex> lock(registry.Mutex);
+            registry.Dependencies[shader] = dependencies;
+            for (const std::string& dependency : dependencies)
+            {
+                if (!registry.FileTimes.count(dependency)) registry.FileTimes[dependency] = GetFileTime(dependency);
+            }
+
+            if (!registry.WatchThread.joinable() && !registry.WatchStop) registry.WatchThread = std::thread(WatchFiles);
+        }
+
+        // Waits for the shader if it was scheduled by the registry, otherwise compiles it in place
+        ShaderCompiler::CompiledShader WaitOrCompile(GfxShader* shader)
+        {
+            RegistryState& registry = GetRegistry();
+            {
+                std::unique_lock<std::mutex> lock(registry.Mutex);
+                const auto it = registry.Pending.find(shader);
+                if (it != registry.Pending.end() && it->second)
+                {
+                    // Owned here while waiting, the empty entry keeps CompileAll from scheduling the shader again
+                    std::unique_ptr<PendingShader> pendingShader = std::move(it->second);
+                    registry.ReadyCondition.wait(lock, [&pendingShader]() { return pendingShader->Ready; });
+                    registry.Pending.erase(shader);
+                    return pendingShader->Result;
+                }
+            }
+
+            ArchivedShader archivedShader;
+            if (ShaderArchive::Find(ShaderArchive::GetShaderID(shader->GetPath(), shader->GetDefines()), archivedShader))
+            {
+                return ShaderCompiler::LoadArchivedShader(archivedShader);
+            }
+
+#ifndef DEBUG
+            // Shipping builds with an archive never compile
+            if (ShaderArchive::IsOpen())
+            {
+                CONSOLE_LOG("[ShaderArchive] Shader is missing from the archive, cook it again: " + shader->GetPath());
+                return ShaderCompiler::CompiledShader{};
+            }
+#endif
+
+            if (shader->GetSource()) return ShaderCompiler::CompileShader(*shader->GetSource(), shader->GetDefines());
+            return ShaderCompiler::CompileShader(shader->GetPath(), shader->GetDefines());
+        }
+    }
+
+    namespace ShaderRegistry
+    {
+        void Register(GfxShader* shader)
+        {
+            RegistryState& registry = GetRegistry();
+            std::lock_guard<std::mutex> lock(registry.Mutex);
+            registry.Shaders.push_back(shader);
+        }
+
+        void Unregister(GfxShader* shader)
+        {
+            RegistryState& registry = GetRegistry();
+            std::unique_lock<std::mutex> lock(registry.Mutex);
+            registry.Shaders.erase(std::remove(registry.Shaders.begin(), registry.Shaders.end(), shader), registry.Shaders.end());
+            registry.Dependencies.erase(shader);
+
+            for (HotReload& hotReload : registry.HotReloads)
+            {
+                if (hotReload.Shader != shader) continue;
+                ShaderCompiler::ReleaseCompiledShader(hotReload.Result);
+                hotReload.Shader = nullptr;
+            }
+
+            // Compile jobs still reference the pending entry so it can only go away once it is ready
+            const auto it = registry.Pending.find(shader);
+            if (it != registry.Pending.end() && it->second)
+            {
+                std::unique_ptr<PendingShader> pendingShader = std::move(it->second);
+                registry.ReadyCondition.wait(lock, [&pendingShader]() { return pendingShader->Ready; });
+                ShaderCompiler::ReleaseCompiledShader(pendingShader->Result);
+                registry.Pending.erase(shader);
+            }
+        }
+
+        void CompileAll()
+        {
+            RegistryState& registry = GetRegistry();
+
+            const bool archiveOpen = ShaderArchive::IsOpen();
+
+            std::vector<PendingShader*> batch;
+            {
+                std::lock_guard<std::mutex> lock(registry.Mutex);
+                for (GfxShader* shader : registry.Shaders)
+                {
+                    if (shader->IsInitialized() || registry.Pending.count(shader)) continue;
+
+                    // Archived shaders are only created on first use, there is nothing to compile
+                    if (archiveOpen && ShaderArchive::Contains(ShaderArchive::GetShaderID(shader->GetPath(), shader->GetDefines()))) continue;
+
+                    PendingShader* pendingShader = new PendingShader();
+                    pendingShader->Path = shader->GetPath();
+                    pendingShader->Defines = shader->GetDefines();
+
+                    // Copied so reloading the family doesn't race with the compile thread
+                    if (shader->GetSource())
+                    {
+                        pendingShader->HasSource = true;
+                        pendingShader->Source = *shader->GetSource();
+                    }
+                    registry.Pending[shader].reset(pendingShader);
+                    batch.push_back(pendingShader);
+                }
+            }
+
+            if (batch.empty()) return;
+
+            // Previous batch is only running if passes were added in the middle of its compilation
+            if (registry.CompileThread.joinable()) registry.CompileThread.join();
+            registry.CompileThread = std::thread(CompileBatch, std::move(batch));
+        }
+
+        void Update()
+        {
+            RegistryState& registry = GetRegistry();
+
+            std::vector<HotReload> hotReloads;
+            {
+                std::lock_guard<std::mutex> lock(registry.Mutex);
+                hotReloads.swap(registry.HotReloads);
+            }
+
+            for (HotReload& hotReload : hotReloads)
+            {
+                GfxShader* shader = hotReload.Shader;
+                if (!shader) continue;
+
+                if (!hotReload.Result.success)
+                {
+                    // Old shader stays in use until the file is fixed
+                    CONSOLE_LOG("Reload for shader " + shader->GetPath() + " failed!");
+                    ShaderCompiler::ReleaseCompiledShader(hotReload.Result);
+                    continue;
+                }
+
+                shader->SetCompiledShader(hotReload.Result);
+
+                // Variants created later must see the new code too
+                ShaderCompiler::ShaderSource* familySource = shader->m_Source;
+                if (familySource && familySource->header.permutations == hotReload.Source.header.permutations) *familySource = hotReload.Source;
+
+                const float latencyMS = std::chrono::duration<float, std::milli>(Clock::now() - hotReload.ChangeTime).count();
+                CONSOLE_LOG("[ShaderRegistry] Reloaded " + shader->GetPath() + " " + std::to_string(latencyMS) + " ms after the change was detected");
+
+                std::lock_guard<std::mutex> lock(registry.Mutex);
+                registry.Stats.NumHotReloads++;
+                registry.Stats.LastReloadLatencyMS = latencyMS;
+            }
+        }
+
+        void ReloadChanged()
+        {
+            RegistryState& registry = GetRegistry();
+            {
+                std::lock_guard<std::mutex> lock(registry.Mutex);
+                registry.WatchForceCheck = true;
+            }
+            registry.WatchCondition.notify_all();
+        }
+
+        void Shutdown()
+        {
+            GetRegistry().StopThreads();
+        }
+
+        bool CookArchive(const std::string& path)
+        {
+            struct CookJob
+            {
+                std::string Path;
+                std::vector<std::string> Defines;
+                bool HasSource = false;
+                ShaderCompiler::ShaderSource Source;
+                ID3DBlob* Blobs[ShaderCompiler::STAGE_COUNT] = {};
+                bool Success = false;
+            };
+
+            RegistryState& registry = GetRegistry();
+
+            Timer timer;
+            timer.Start();
+
+            std::vector<CookJob> jobs;
+            std::unordered_set<ShaderArchive::ShaderID> ids;
+            const auto addJob = [&jobs, &ids](const std::string& path, const std::vector<std::string>& defines, const ShaderCompiler::ShaderSource* source)
+            {
+                if (!ids.insert(ShaderArchive::GetShaderID(path, defines)).second) return;
+
+                CookJob job;
+                job.Path = path;
+                job.Defines = defines;
+
+                // Family loaded from an archive has no code
+                job.HasSource = source && !source->code.empty();
+                if (job.HasSource) job.Source = *source;
+                jobs.push_back(std::move(job));
+            };
+
+            {
+                std::lock_guard<std::mutex> lock(registry.Mutex);
+                for (GfxShader* shader : registry.Shaders)
+                {
+                    const ShaderCompiler::ShaderSource* source = shader->GetSource();
+                    if (!source || source->header.permutations.empty())
+                    {
+                        addJob(shader->GetPath(), shader->GetDefines(), source);
+                        continue;
+                    }
+
+                    // Every combination of a family, not only the variants that were used so far
+                    const std::vector<std::string>& permutations = source->header.permutations;
+                    std::vector<std::string> familyDefines;
+                    for (const std::string& define : shader->GetDefines())
+                    {
+                        if (std::find(permutations.begin(), permutations.end(), define) == permutations.end()) familyDefines.push_back(define);
+                    }
+
+                    for (unsigned int permutation = 0; permutation < (1u << permutations.size()); permutation++)
+                    {
+                        std::vector<std::string> defines = familyDefines;
+                        for (size_t i = 0; i < permutations.size(); i++)
+                        {
+                            if (permutation & (1u << i)) defines.push_back(permutations[i]);
+                        }
+                        addJob(shader->GetPath(), defines, source);
+                    }
+                }
+            }
+
+            ThreadUtil::ParallelFor((unsigned int) jobs.size(), [&jobs](unsigned int index)
+            {
+                CookJob& job = jobs[index];
+                if (!job.HasSource && !ShaderCompiler::ReadShaderFile(job.Path, job.Source)) return;
+
+                std::string entry, target;
+                job.Success = true;
+                for (unsigned int stage = 0; stage < ShaderCompiler::STAGE_COUNT; stage++)
+                {
+                    if (!ShaderCompiler::GetStageDesc(job.Source.header, stage, entry, target)) continue;
+                    job.Blobs[stage] = ShaderCompiler::CompileShaderStage(job.Source, job.Defines, stage);
+                    job.Success = job.Success && job.Blobs[stage];
+                }
+            });
+
+            std::vector<ArchivedShader> archivedShaders;
+            unsigned int numFailed = 0;
+            for (CookJob& job : jobs)
+            {
+                if (!job.Success)
+                {
+                    CONSOLE_LOG("[ShaderArchive] Failed to cook shader: " + job.Path);
+                    numFailed++;
+                    continue;
+                }
+
+                ArchivedShader archivedShader;
+                archivedShader.ID = ShaderArchive::GetShaderID(job.Path, job.Defines);
+                archivedShader.HeaderState = ShaderCompiler::SerializeDeviceState(job.Source.header.deviceState);
+                archivedShader.Permutations = job.Source.header.permutations;
+                for (unsigned int stage = 0; stage < ShaderCompiler::STAGE_COUNT; stage++)
+                {
+                    ID3DBlob* blob = job.Blobs[stage];
+                    if (!blob) continue;
+
+                    const unsigned char* bytecode = (const unsigned char*) blob->GetBufferPointer();
+                    archivedShader.Bytecode[stage].assign(bytecode, bytecode + blob->GetBufferSize());
+                    ShaderCompiler::ReflectBindings({ blob->GetBufferPointer(), blob->GetBufferSize() }, ShaderCompiler::GetStageBit(stage), archivedShader.BindingLayout);
+                }
+                archivedShaders.push_back(std::move(archivedShader));
+            }
+
+            const bool success = ShaderArchive::Write(path, archivedShaders);
+
+            for (CookJob& job : jobs)
+            {
+                for (unsigned int stage = 0; stage < ShaderCompiler::STAGE_COUNT; stage++) SAFE_RELEASE(job.Blobs[stage]);
+            }
+
+            timer.Stop();
+            CONSOLE_LOG("[ShaderArchive] Cooked " + std::to_string(archivedShaders.size()) + " shaders into " + path + " in " + std::to_string(timer.GetTimeMS()) + " ms" + (numFailed ? ", " + std::to_string(numFailed) + " failed" : ""));
+            return success && numFailed == 0;
+        }
+
+        ShaderRegistryStats GetStats()
+        {
+            RegistryState& registry = GetRegistry();
+            std::lock_guard<std::mutex> lock(registry.Mutex);
+            return registry.Stats;
+        }
+    }
+
     ///////////////////////////////////////
     //			Shader  		        //
     /////////////////////////////////////
@@ -714,68 +1806,151 @@ namespace GP
         SAFE_RELEASE(m_CS);
         SAFE_RELEASE(m_IL);
         SAFE_RELEASE(m_MIL);
+        DeviceStateCache::Release(m_State);
+        DeviceStateCache::Release(m_StateMS);
+
+        ShaderRegistry::Unregister(this);
     }
 
     void GfxShader::Reload()
     {
-        ShaderCompiler::CompiledShader compiledShader = ShaderCompiler::CompileShader(m_Path, m_Defines);
+        ShaderCompiler::CompiledShader compiledShader = m_Source ? ShaderCompiler::CompileShader(*m_Source, m_Defines) : ShaderCompiler::CompileShader(m_Path, m_Defines);
         if (compiledShader.success)
         {
-            SAFE_RELEASE(m_VS);
-            SAFE_RELEASE(m_PS);
-            SAFE_RELEASE(m_HS);
-            SAFE_RELEASE(m_DS);
-            SAFE_RELEASE(m_GS);
-            SAFE_RELEASE(m_CS);
-            SAFE_RELEASE(m_IL);
-            SAFE_RELEASE(m_MIL);
-
-            m_VS = compiledShader.vs;
-            m_PS = compiledShader.ps;
-            m_HS = compiledShader.hs;
-            m_DS = compiledShader.ds;
-            m_GS = compiledShader.gs;
-            m_CS = compiledShader.cs;
-            m_IL = compiledShader.il;
-            m_MIL = compiledShader.mil;
-
-            m_State = compiledShader.state;
-            m_StateMS = compiledShader.stateMS;
+            SetCompiledShader(compiledShader);
         }
         else
         {
             CONSOLE_LOG("Reload for shader " + m_Path + " failed!");
-            SAFE_RELEASE(compiledShader.vs);
-            SAFE_RELEASE(compiledShader.ps);
-            SAFE_RELEASE(compiledShader.hs);
-            SAFE_RELEASE(compiledShader.ds);
-            SAFE_RELEASE(compiledShader.gs);
-            SAFE_RELEASE(compiledShader.cs);
-            SAFE_RELEASE(compiledShader.il);
-            SAFE_RELEASE(compiledShader.mil);
-            SAFE_DELETE(compiledShader.state);
-            SAFE_DELETE(compiledShader.stateMS);
+            ShaderCompiler::ReleaseCompiledShader(compiledShader);
         }
     }
 
     void GfxShader::Initialize()
     {
-        ShaderCompiler::CompiledShader compiledShader = ShaderCompiler::CompileShader(m_Path, m_Defines);
-        m_Initialized = compiledShader.success;
-        ASSERT(m_Initialized, "[GfxShader] Shader comilation failed for shader: " + m_Path);
-        if (compiledShader.success)
+        // Parallel passes can use a shader for the first time on several threads, only the first one creates it
+        std::lock_guard<std::mutex> lock(m_InitializeMutex);
+        if (m_Initialized) return;
+
+        ShaderCompiler::CompiledShader compiledShader = WaitOrCompile(this);
+        ASSERT(compiledShader.success, "[GfxShader] Shader comilation failed for shader: " + m_Path);
+        if (!compiledShader.success)
+        {
+            ShaderCompiler::ReleaseCompiledShader(compiledShader);
+            return;
+        }
+
+        SetCompiledShader(compiledShader);
+        m_Initialized.store(true, std::memory_order_release);
+    }
+
+    void GfxShader::SetCompiledShader(ShaderCompiler::CompiledShader& compiledShader)
+    {
+        SAFE_RELEASE(m_VS);
+        SAFE_RELEASE(m_PS);
+        SAFE_RELEASE(m_HS);
+        SAFE_RELEASE(m_DS);
+        SAFE_RELEASE(m_GS);
+        SAFE_RELEASE(m_CS);
+        SAFE_RELEASE(m_IL);
+        SAFE_RELEASE(m_MIL);
+        DeviceStateCache::Release(m_State);
+        DeviceStateCache::Release(m_StateMS);
+
+        m_VS = compiledShader.vs;
+        m_PS = compiledShader.ps;
+        m_HS = compiledShader.hs;
+        m_DS = compiledShader.ds;
+        m_GS = compiledShader.gs;
+        m_CS = compiledShader.cs;
+        m_IL = compiledShader.il;
+        m_MIL = compiledShader.mil;
+
+        m_State = compiledShader.state;
+        m_StateMS = compiledShader.stateMS;
+
+        m_BindingLayout = std::move(compiledShader.bindingLayout);
+        m_Version++;
+
+        TrackDependencies(this, compiledShader.dependencies);
+    }
+
+    ///////////////////////////////////////
+    //			Shader family	        //
+    /////////////////////////////////////
+
+    GfxShaderFamily::GfxShaderFamily(const std::string& path, const std::vector<std::string>& defines):
+        m_Path(path),
+        m_Defines(defines),
+        m_Source(new ShaderCompiler::ShaderSource())
+    {
+        // Permutations of an archived family come from the archive, the file is not needed
+        ArchivedShader archivedShader;
+        if (ShaderArchive::Find(ShaderArchive::GetShaderID(m_Path, m_Defines), archivedShader))
+        {
+            m_Source->header.permutations = archivedShader.Permutations;
+        }
+        else
+        {
+            const bool readSuccess = ShaderCompiler::ReadShaderFile(m_Path, *m_Source);
+            ASSERT(readSuccess, "[GfxShaderFamily] Failed to read shader: " + m_Path);
+        }
+
+        const std::vector<std::string>& permutations = m_Source->header.permutations;
+        ASSERT(permutations.size() <= MAX_PERMUTATION_AXES, "[GfxShaderFamily] Too many permutations in shader: " + m_Path);
+        m_Variants.resize(1ull << permutations.size(), nullptr);
+    }
+
+    GfxShaderFamily::~GfxShaderFamily()
+    {
+        for (GfxShader* variant : m_Variants) delete variant;
+        delete m_Source;
+    }
+
+    void GfxShaderFamily::Reload()
+    {
+        ShaderCompiler::ShaderSource source;
+        if (!ShaderCompiler::ReadShaderFile(m_Path, source))
+        {
+            CONSOLE_LOG("Reload for shader family " + m_Path + " failed!");
+            return;
+        }
+
+        if (source.header.permutations != m_Source->header.permutations)
         {
-            m_VS = compiledShader.vs;
-            m_PS = compiledShader.ps;
-            m_HS = compiledShader.hs;
-            m_DS = compiledShader.ds;
-            m_GS = compiledShader.gs;
-            m_CS = compiledShader.cs;
-            m_IL = compiledShader.il;
-            m_MIL = compiledShader.mil;
+            // Permutation bits that passes already hold would point to different variants
+            CONSOLE_LOG("Reload for shader family " + m_Path + " failed, permutations can't change at runtime!");
+            return;
+        }
 
-            m_State = compiledShader.state;
-            m_StateMS = compiledShader.stateMS;
+        *m_Source = source;
+        for (GfxShader* variant : m_Variants)
+        {
+            if (variant) variant->Reload();
         }
     }
-}
\ No newline at end of file
+
+    GfxShaderFamily::Permutation GfxShaderFamily::GetPermutation(const std::string& define) const
+    {
+        const std::vector<std::string>& permutations = m_Source->header.permutations;
+        for (size_t i = 0; i < permutations.size(); i++)
+        {
+            if (permutations[i] == define) return 1u << i;
+        }
+        ASSERT(0, "[GfxShaderFamily] Permutation " + define + " is not declared in shader: " + m_Path);
+        return 0;
+    }
+
+    GfxShader* GfxShaderFamily::CreateVariant(Permutation permutation)
+    {
+        std::vector<std::string> defines = m_Defines;
+        const std::vector<std::string>& permutations = m_Source->header.permutations;
+        for (size_t i = 0; i < permutations.size(); i++)
+        {
+            if (permutation & (1u << i)) defines.push_back(permutations[i]);
+        }
+
+        m_Variants[permutation] = new GfxShader(m_Path, defines, m_Source);
+        return m_Variants[permutation];
+    }
+}
@@ -1,6 +1,9 @@
 #pragma once
 
 #include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
 
 #include "gfx/GfxCommon.h"
 
@@ -18,6 +21,14 @@ struct ID3D11BlendState1;
 namespace GP
 {
 	class GfxDevice;
+	class GfxShader;
+	class GfxShaderFamily;
+
+	namespace ShaderCompiler
+	{
+		struct ShaderSource;
+		struct CompiledShader;
+	}
 
 	enum ShaderStage
 	{
@@ -51,9 +62,77 @@ namespace GP
 		ID3D11BlendState1* Blend = nullptr;
 		PrimitiveTopology Topology = PrimitiveTopology::Default;
 
+		// Hash of the description the state was created from, different states can share it
+		unsigned long long Key = 0;
+
 		GP_DLL ~GfxDeviceState();
 	};
 
+	enum class ShaderBindingType
+	{
+		ConstantBuffer,
+		Resource,
+		RWResource,
+		Sampler,
+	};
+
+	struct ShaderBinding
+	{
+		std::string Name;
+		ShaderBindingType Type = ShaderBindingType::ConstantBuffer;
+		unsigned int Slot = 0;
+		unsigned int Stages = 0;	// ShaderStage bits of every stage that uses the binding
+	};
+
+	// Resources of a compiled shader taken from reflection of all of its stages
+	struct GfxBindingLayout
+	{
+		std::vector<ShaderBinding> Bindings;
+
+		inline const ShaderBinding* Find(const std::string& name, ShaderBindingType type) const
+		{
+			for (const ShaderBinding& binding : Bindings)
+			{
+				if (binding.Type == type && binding.Name == name) return &binding;
+			}
+			return nullptr;
+		}
+	};
+
+	struct ShaderRegistryStats
+	{
+		unsigned int NumShaders = 0;
+		unsigned int NumStageJobs = 0;
+		float WallTimeMS = 0.0f;	// From scheduling a batch until its last shader is ready
+		float CpuTimeMS = 0.0f;		// Summed time of every compile job in a batch
+
+		unsigned int NumHotReloads = 0;
+		float LastReloadLatencyMS = 0.0f;	// From detecting a file change until the new shader was swapped in
+	};
+
+	// Knows every constructed shader so they can be compiled up front on worker threads instead of at first bind
+	namespace ShaderRegistry
+	{
+		GP_DLL void Register(GfxShader* shader);
+		GP_DLL void Unregister(GfxShader* shader);
+
+		// Schedules every registered shader that is not initialized yet, one job per stage, returns without waiting
+		GP_DLL void CompileAll();
+
+		// Swaps in shaders that were recompiled in the background because one of their files changed, call between frames
+		GP_DLL void Update();
+
+		// Checks watched files right away instead of waiting for the next poll
+		GP_DLL void ReloadChanged();
+
+		GP_DLL void Shutdown();
+
+		// Compiles every registered shader, and all permutations of shader families, into the shader archive at path
+		GP_DLL bool CookArchive(const std::string& path);
+
+		GP_DLL ShaderRegistryStats GetStats();
+	}
+
 	class GfxShader
 	{
 		DELETE_COPY_CONSTRUCTOR(GfxShader);
@@ -61,13 +140,33 @@ namespace GP
 		GfxShader::GfxShader(const std::string& path, const std::vector<std::string>& defines = {}):
 			m_Defines(defines),
 			m_Path(path)
-		{ }
+		{
+			ShaderRegistry::Register(this);
+		}
+
+	private:
+		friend class GfxShaderFamily;
+		friend void ShaderRegistry::Update();
+
+		// Variant of a family, source is owned by the family and parsed only once
+		GfxShader(const std::string& path, const std::vector<std::string>& defines, ShaderCompiler::ShaderSource* source):
+			m_Defines(defines),
+			m_Path(path),
+			m_Source(source)
+		{
+			ShaderRegistry::Register(this);
+		}
+
+	public:
 
 		GP_DLL ~GfxShader();
 		GP_DLL void Reload();
 
 		void Initialize();
-		inline bool IsInitialized() const { return m_Initialized; }
+		inline bool IsInitialized() const { return m_Initialized.load(std::memory_order_acquire); }
+		inline const std::string& GetPath() const { return m_Path; }
+		inline const std::vector<std::string>& GetDefines() const { return m_Defines; }
+		inline const ShaderCompiler::ShaderSource* GetSource() const { return m_Source; }
 		inline ID3D11VertexShader* GetVS() const { return m_VS; }
 		inline ID3D11PixelShader* GetPS() const { return m_PS; }
 		inline ID3D11HullShader* GetHS() const { return m_HS; }
@@ -80,8 +179,19 @@ namespace GP
 		inline GfxDeviceState* GetDeviceState() const { return m_State; }
 		inline GfxDeviceState* GetDeviceStateMS() const { return m_StateMS; }
 
+		inline const GfxBindingLayout& GetBindingLayout() const { return m_BindingLayout; }
+
+		// Increased every time new compiled objects are set, lets users of the binding layout notice a reload
+		inline unsigned int GetVersion() const { return m_Version; }
+
 	private:
-		bool m_Initialized = false;
+		// Takes ownership of the compiled objects and releases the current ones
+		void SetCompiledShader(ShaderCompiler::CompiledShader& compiledShader);
+
+	private:
+		std::mutex m_InitializeMutex;
+		std::atomic<bool> m_Initialized = false;
+		unsigned int m_Version = 0;
 
 		ID3D11VertexShader* m_VS = nullptr;
 		ID3D11PixelShader* m_PS = nullptr;
@@ -90,13 +200,50 @@ namespace GP
 		ID3D11GeometryShader* m_GS = nullptr;
 		ID3D11ComputeShader* m_CS = nullptr;
 
-		GfxDeviceState* m_State;
-		GfxDeviceState* m_StateMS;
+		GfxDeviceState* m_State = nullptr;
+		GfxDeviceState* m_StateMS = nullptr;
+
+		ID3D11InputLayout* m_IL = nullptr;
+		ID3D11InputLayout* m_MIL = nullptr;
 
-		ID3D11InputLayout* m_IL;
-		ID3D11InputLayout* m_MIL;
+		GfxBindingLayout m_BindingLayout;
 
 		std::vector<std::string> m_Defines;
 		std::string m_Path;
+		ShaderCompiler::ShaderSource* m_Source = nullptr;
+	};
+
+	// Shader file with variants for every combination of the defines listed in the "// Permutations:" header line
+	// Variants are created on first use and stored in a table indexed by permutation bits
+	class GfxShaderFamily
+	{
+		DELETE_COPY_CONSTRUCTOR(GfxShaderFamily);
+	public:
+		using Permutation = unsigned int;
+
+		static constexpr unsigned int MAX_PERMUTATION_AXES = 8;
+
+		GP_DLL GfxShaderFamily(const std::string& path, const std::vector<std::string>& defines = {});
+		GP_DLL ~GfxShaderFamily();
+		GP_DLL void Reload();
+
+		// Bit of the define in the permutation mask, look it up once and combine bits with |
+		GP_DLL Permutation GetPermutation(const std::string& define) const;
+
+		inline GfxShader* GetShader(Permutation permutation = 0)
+		{
+			ASSERT(permutation < m_Variants.size(), "[GfxShaderFamily] Invalid permutation for shader: " + m_Path);
+			GfxShader* variant = m_Variants[permutation];
+			return variant ? variant : CreateVariant(permutation);
+		}
+
+	private:
+		GP_DLL GfxShader* CreateVariant(Permutation permutation);
+
+	private:
+		std::string m_Path;
+		std::vector<std::string> m_Defines;
+		ShaderCompiler::ShaderSource* m_Source;
+		std::vector<GfxShader*> m_Variants;
 	};
 }
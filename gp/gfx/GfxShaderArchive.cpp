@@ -0,0 +1,383 @@
+#include "GfxShaderArchive.h"
+
+#include <windows.h>
+#include <cstring>
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+#include <unordered_set>
+#include <mutex>
+
+#include "util/HashUtil.h"
+
+namespace GP
+{
+	namespace
+	{
+		static constexpr unsigned int MAX_NAME_LENGTH = 64;
+
+		struct ArchiveFileHeader
+		{
+			static constexpr unsigned int MAGIC = 0x41535047; // GPSA
+			static constexpr unsigned int VERSION = 2;
+
+			unsigned int Magic = MAGIC;
+			unsigned int Version = VERSION;
+			unsigned int NumEntries = 0;
+			unsigned int Reserved = 0;
+		};
+
+		// Index is sorted by ID, offsets are from the start of the file
+		struct ArchiveIndexEntry
+		{
+			unsigned long long ID = 0;
+			unsigned long long BytecodeOffset[ArchivedShader::NUM_STAGES] = {};
+			unsigned int BytecodeSize[ArchivedShader::NUM_STAGES] = {};
+			unsigned long long HeaderStateOffset = 0;
+			unsigned int HeaderStateSize = 0;
+			unsigned int NumBindings = 0;
+			unsigned long long BindingsOffset = 0;
+			unsigned int NumPermutations = 0;
+			unsigned int Reserved = 0;
+			unsigned long long PermutationsOffset = 0;
+		};
+
+		struct ArchiveBinding
+		{
+			char Name[MAX_NAME_LENGTH];
+			unsigned int Type;
+			unsigned int Slot;
+			unsigned int Stages;
+		};
+
+		struct ArchiveName
+		{
+			char Value[MAX_NAME_LENGTH];
+		};
+
+		struct ArchiveState
+		{
+			std::mutex Mutex;
+			std::string Path;
+			void* File = nullptr;
+			void* Mapping = nullptr;
+			const unsigned char* Data = nullptr;
+			size_t Size = 0;
+			const ArchiveIndexEntry* Index = nullptr;
+			unsigned int NumEntries = 0;
+		};
+
+		ArchiveState& GetState()
+		{
+			static ArchiveState state;
+			return state;
+		}
+
+		void CloseArchive(ArchiveState& state)
+		{
+			if (state.Data) UnmapViewOfFile(state.Data);
+			if (state.Mapping) CloseHandle(state.Mapping);
+			if (state.File) CloseHandle(state.File);
+
+			state.Path.clear();
+			state.File = nullptr;
+			state.Mapping = nullptr;
+			state.Data = nullptr;
+			state.Size = 0;
+			state.Index = nullptr;
+			state.NumEntries = 0;
+		}
+
+		bool InRange(size_t fileSize, unsigned long long offset, unsigned long long size)
+		{
+			return offset <= fileSize && size <= fileSize - offset;
+		}
+
+		// Returns false if the file is not an archive or some entry points outside of it
+		bool ReadIndex(const unsigned char* data, size_t size, const ArchiveIndexEntry*& index, unsigned int& numEntries)
+		{
+			if (size < sizeof(ArchiveFileHeader)) return false;
+
+			const ArchiveFileHeader& header = *(const ArchiveFileHeader*) data;
+			if (header.Magic != ArchiveFileHeader::MAGIC || header.Version != ArchiveFileHeader::VERSION) return false;
+			if (!InRange(size, sizeof(ArchiveFileHeader), (unsigned long long) header.NumEntries * sizeof(ArchiveIndexEntry))) return false;
+
+			index = (const ArchiveIndexEntry*)(data + sizeof(ArchiveFileHeader));
+			numEntries = header.NumEntries;
+
+			for (unsigned int i = 0; i < numEntries; i++)
+			{
+				const ArchiveIndexEntry& entry = index[i];
+				for (unsigned int stage = 0; stage < ArchivedShader::NUM_STAGES; stage++)
+				{
+					if (!InRange(size, entry.BytecodeOffset[stage], entry.BytecodeSize[stage])) return false;
+				}
+				if (!InRange(size, entry.HeaderStateOffset, entry.HeaderStateSize)) return false;
+				if (!InRange(size, entry.BindingsOffset, (unsigned long long) entry.NumBindings * sizeof(ArchiveBinding))) return false;
+				if (!InRange(size, entry.PermutationsOffset, (unsigned long long) entry.NumPermutations * sizeof(ArchiveName))) return false;
+			}
+			return true;
+		}
+
+		std::string ReadName(const char (&name)[MAX_NAME_LENGTH])
+		{
+			return std::string(name, strnlen(name, MAX_NAME_LENGTH));
+		}
+
+		void WriteName(char (&name)[MAX_NAME_LENGTH], const std::string& value)
+		{
+			ASSERT(value.size() < MAX_NAME_LENGTH, "[ShaderArchive] Name is too long: " + value);
+			memset(name, 0, MAX_NAME_LENGTH);
+			memcpy(name, value.data(), MIN(value.size(), (size_t) MAX_NAME_LENGTH - 1));
+		}
+
+		void ReadEntry(const unsigned char* data, const ArchiveIndexEntry& entry, ArchivedShader& shader)
+		{
+			shader.ID = entry.ID;
+			for (unsigned int stage = 0; stage < ArchivedShader::NUM_STAGES; stage++)
+			{
+				const unsigned char* bytecode = data + entry.BytecodeOffset[stage];
+				shader.Bytecode[stage].assign(bytecode, bytecode + entry.BytecodeSize[stage]);
+			}
+
+			const unsigned char* headerState = data + entry.HeaderStateOffset;
+			shader.HeaderState.assign(headerState, headerState + entry.HeaderStateSize);
+
+			const ArchiveBinding* bindings = (const ArchiveBinding*)(data + entry.BindingsOffset);
+			shader.BindingLayout.Bindings.resize(entry.NumBindings);
+			for (unsigned int i = 0; i < entry.NumBindings; i++)
+			{
+				ShaderBinding& binding = shader.BindingLayout.Bindings[i];
+				binding.Name = ReadName(bindings[i].Name);
+				binding.Type = (ShaderBindingType) bindings[i].Type;
+				binding.Slot = bindings[i].Slot;
+				binding.Stages = bindings[i].Stages;
+			}
+
+			const ArchiveName* permutations = (const ArchiveName*)(data + entry.PermutationsOffset);
+			shader.Permutations.resize(entry.NumPermutations);
+			for (unsigned int i = 0; i < entry.NumPermutations; i++) shader.Permutations[i] = ReadName(permutations[i].Value);
+		}
+
+		const ArchiveIndexEntry* FindEntry(const ArchiveState& state, ShaderArchive::ShaderID id)
+		{
+			if (!state.Data) return nullptr;
+
+			const ArchiveIndexEntry* indexEnd = state.Index + state.NumEntries;
+			const ArchiveIndexEntry* entry = std::lower_bound(state.Index, indexEnd, id, [](const ArchiveIndexEntry& entry, ShaderArchive::ShaderID id) { return entry.ID < id; });
+			return entry != indexEnd && entry->ID == id ? entry : nullptr;
+		}
+
+		template<typename T>
+		unsigned long long Append(std::vector<unsigned char>& data, const T* values, size_t count)
+		{
+			const unsigned long long offset = data.size();
+			const unsigned char* bytes = (const unsigned char*) values;
+			data.insert(data.end(), bytes, bytes + sizeof(T) * count);
+			return offset;
+		}
+	}
+
+	namespace ShaderArchive
+	{
+		ShaderID GetShaderID(const std::string& path, const std::vector<std::string>& defines)
+		{
+			std::vector<std::string> sortedDefines = defines;
+			std::sort(sortedDefines.begin(), sortedDefines.end());
+
+			ShaderID id = HashUtil::FNV_OFFSET_BASIS;
+			id = HashUtil::HashString(id, path);
+			id = HashUtil::HashValue(id, sortedDefines.size());
+			for (const std::string& define : sortedDefines) id = HashUtil::HashString(id, define);
+			return id;
+		}
+
+		bool Open(const std::string& path)
+		{
+			ArchiveState& state = GetState();
+			std::lock_guard<std::mutex> lock(state.Mutex);
+			CloseArchive(state);
+
+			HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr);
+			if (file == INVALID_HANDLE_VALUE) return false;
+			state.File = file;
+
+			LARGE_INTEGER fileSize;
+			if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+			{
+				CONSOLE_LOG("[ShaderArchive] File is empty: " + path);
+				CloseArchive(state);
+				return false;
+			}
+			state.Size = (size_t) fileSize.QuadPart;
+
+			state.Mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			state.Data = state.Mapping ? (const unsigned char*) MapViewOfFile(state.Mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+			if (!state.Data)
+			{
+				CONSOLE_LOG("[ShaderArchive] Failed to map file: " + path);
+				CloseArchive(state);
+				return false;
+			}
+
+			if (!ReadIndex(state.Data, state.Size, state.Index, state.NumEntries))
+			{
+				CONSOLE_LOG("[ShaderArchive] Unsupported or corrupted shader archive: " + path);
+				CloseArchive(state);
+				return false;
+			}
+
+			state.Path = path;
+			CONSOLE_LOG("[ShaderArchive] Opened " + path + " with " + std::to_string(state.NumEntries) + " shaders");
+			return true;
+		}
+
+		void Close()
+		{
+			ArchiveState& state = GetState();
+			std::lock_guard<std::mutex> lock(state.Mutex);
+			CloseArchive(state);
+		}
+
+		bool IsOpen()
+		{
+			ArchiveState& state = GetState();
+			std::lock_guard<std::mutex> lock(state.Mutex);
+			return state.Data != nullptr;
+		}
+
+		bool Contains(ShaderID id)
+		{
+			ArchiveState& state = GetState();
+			std::lock_guard<std::mutex> lock(state.Mutex);
+			return FindEntry(state, id) != nullptr;
+		}
+
+		bool Find(ShaderID id, ArchivedShader& shader)
+		{
+			ArchiveState& state = GetState();
+			std::lock_guard<std::mutex> lock(state.Mutex);
+			const ArchiveIndexEntry* entry = FindEntry(state, id);
+			if (!entry) return false;
+
+			// Copied while locked, the mapping is replaced when the archive is written
+			ReadEntry(state.Data, *entry, shader);
+			return true;
+		}
+
+		bool Write(const std::string& path, const std::vector<ArchivedShader>& shaders)
+		{
+			std::vector<const ArchivedShader*> entries;
+			std::unordered_set<ShaderID> ids;
+			for (const ArchivedShader& shader : shaders)
+			{
+				if (ids.insert(shader.ID).second) entries.push_back(&shader);
+			}
+
+			// Keep the entries of the previous archive that were not cooked again
+			std::vector<unsigned char> previousData;
+			std::vector<ArchivedShader> previousShaders;
+			{
+				std::ifstream file(path, std::ios::binary | std::ios::ate);
+				if (file.is_open())
+				{
+					previousData.resize((size_t) file.tellg());
+					file.seekg(0);
+					file.read((char*) previousData.data(), previousData.size());
+				}
+
+				const ArchiveIndexEntry* index = nullptr;
+				unsigned int numEntries = 0;
+				if (!previousData.empty() && ReadIndex(previousData.data(), previousData.size(), index, numEntries))
+				{
+					previousShaders.resize(numEntries);
+					for (unsigned int i = 0; i < numEntries; i++) ReadEntry(previousData.data(), index[i], previousShaders[i]);
+				}
+			}
+			for (const ArchivedShader& shader : previousShaders)
+			{
+				if (ids.insert(shader.ID).second) entries.push_back(&shader);
+			}
+
+			std::sort(entries.begin(), entries.end(), [](const ArchivedShader* a, const ArchivedShader* b) { return a->ID < b->ID; });
+
+			ArchiveFileHeader header;
+			header.NumEntries = (unsigned int) entries.size();
+
+			std::vector<ArchiveIndexEntry> index(entries.size());
+			std::vector<unsigned char> data;
+			const unsigned long long dataOffset = sizeof(ArchiveFileHeader) + sizeof(ArchiveIndexEntry) * index.size();
+
+			for (size_t i = 0; i < entries.size(); i++)
+			{
+				const ArchivedShader& shader = *entries[i];
+				ArchiveIndexEntry& entry = index[i];
+				entry.ID = shader.ID;
+
+				for (unsigned int stage = 0; stage < ArchivedShader::NUM_STAGES; stage++)
+				{
+					entry.BytecodeOffset[stage] = dataOffset + Append(data, shader.Bytecode[stage].data(), shader.Bytecode[stage].size());
+					entry.BytecodeSize[stage] = (unsigned int) shader.Bytecode[stage].size();
+				}
+
+				entry.HeaderStateOffset = dataOffset + Append(data, shader.HeaderState.data(), shader.HeaderState.size());
+				entry.HeaderStateSize = (unsigned int) shader.HeaderState.size();
+
+				std::vector<ArchiveBinding> bindings(shader.BindingLayout.Bindings.size());
+				for (size_t j = 0; j < bindings.size(); j++)
+				{
+					const ShaderBinding& binding = shader.BindingLayout.Bindings[j];
+					WriteName(bindings[j].Name, binding.Name);
+					bindings[j].Type = (unsigned int) binding.Type;
+					bindings[j].Slot = binding.Slot;
+					bindings[j].Stages = binding.Stages;
+				}
+				entry.BindingsOffset = dataOffset + Append(data, bindings.data(), bindings.size());
+				entry.NumBindings = (unsigned int) bindings.size();
+
+				std::vector<ArchiveName> permutations(shader.Permutations.size());
+				for (size_t j = 0; j < permutations.size(); j++) WriteName(permutations[j].Value, shader.Permutations[j]);
+				entry.PermutationsOffset = dataOffset + Append(data, permutations.data(), permutations.size());
+				entry.NumPermutations = (unsigned int) permutations.size();
+			}
+
+			std::error_code error;
+			const std::filesystem::path directory = std::filesystem::path(path).parent_path();
+			if (!directory.empty()) std::filesystem::create_directories(directory, error);
+
+			// Write to temporary file first so a crash never leaves a partial archive
+			const std::string tempPath = path + ".tmp";
+			{
+				std::ofstream file(tempPath, std::ios::binary);
+				if (!file.is_open())
+				{
+					CONSOLE_LOG("[ShaderArchive] Failed to write archive: " + path);
+					return false;
+				}
+				file.write((const char*) &header, sizeof(ArchiveFileHeader));
+				file.write((const char*) index.data(), sizeof(ArchiveIndexEntry) * index.size());
+				file.write((const char*) data.data(), data.size());
+			}
+
+			// Mapped file can't be replaced
+			ArchiveState& state = GetState();
+			bool reopen;
+			{
+				std::lock_guard<std::mutex> lock(state.Mutex);
+				reopen = state.Data && state.Path == path;
+				if (reopen) CloseArchive(state);
+			}
+
+			std::filesystem::rename(tempPath, path, error);
+			const bool replaced = !error;
+			if (!replaced)
+			{
+				CONSOLE_LOG("[ShaderArchive] Failed to replace archive: " + path);
+				std::filesystem::remove(tempPath, error);
+			}
+
+			if (reopen) Open(path);
+			return replaced;
+		}
+	}
+}
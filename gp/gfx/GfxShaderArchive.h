@@ -0,0 +1,48 @@
+#pragma once
+
+#include "Common.h"
+
+#include <string>
+#include <vector>
+
+#include "gfx/GfxShader.h"
+
+namespace GP
+{
+	// One shader variant as stored in the archive. Found entries are copied out of the mapped file, it can be remapped when the archive is cooked again.
+	struct ArchivedShader
+	{
+		static constexpr unsigned int NUM_STAGES = 6;
+
+		unsigned long long ID = 0;
+		std::vector<unsigned char> Bytecode[NUM_STAGES];
+
+		// Parsed header state, only the shader compiler knows its format
+		std::vector<unsigned char> HeaderState;
+
+		GfxBindingLayout BindingLayout;
+		std::vector<std::string> Permutations;
+	};
+
+	// Shaders cooked ahead of time into one indexed file, entries are found by a hash of path and defines
+	namespace ShaderArchive
+	{
+		using ShaderID = unsigned long long;
+
+		static const std::string DEFAULT_PATH = "cooked/shaders.gpsa";
+
+		// Order of the defines doesn't matter
+		ShaderID GetShaderID(const std::string& path, const std::vector<std::string>& defines);
+
+		// Maps the archive into memory, shaders found in it are created without reading or compiling their source
+		GP_DLL bool Open(const std::string& path);
+		GP_DLL void Close();
+		GP_DLL bool IsOpen();
+
+		bool Contains(ShaderID id);
+		bool Find(ShaderID id, ArchivedShader& shader);
+
+		// Entries already in the file that are not in shaders are kept, so cooking can be done in several runs
+		bool Write(const std::string& path, const std::vector<ArchivedShader>& shaders);
+	}
+}
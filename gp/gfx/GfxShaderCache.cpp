@@ -0,0 +1,161 @@
+#include "GfxShaderCache.h"
+
+#include <cstdio>
+#include <fstream>
+#include <filesystem>
+#include <mutex>
+
+#include "util/HashUtil.h"
+#include "util/Timer.h"
+
+namespace GP
+{
+	namespace
+	{
+		static const std::string CACHE_DIRECTORY = "cache/shaders/";
+		static const std::string CACHE_FILE_EXTENSION = ".gpsc";
+
+		// Bump when the way shaders are compiled changes so old entries stop matching
+		static constexpr unsigned int COMPILER_VERSION = 1;
+
+		struct CacheFileHeader
+		{
+			static constexpr unsigned int MAGIC = 0x43535047; // GPSC
+			static constexpr unsigned int VERSION = 1;
+
+			unsigned int Magic = MAGIC;
+			unsigned int Version = VERSION;
+			unsigned long long Key = 0;
+			unsigned long long BytecodeSize = 0;
+			float CompileTimeMS = 0.0f;
+		};
+
+		struct CacheState
+		{
+			std::mutex Mutex;
+			bool Initialized = false;
+			ShaderCacheStats Stats;
+		};
+
+		CacheState& GetState()
+		{
+			static CacheState state;
+			return state;
+		}
+
+		std::string GetEntryPath(ShaderCache::Key key)
+		{
+			char name[17];
+			snprintf(name, sizeof(name), "%016llx", key);
+			return CACHE_DIRECTORY + name + CACHE_FILE_EXTENSION;
+		}
+
+		void InitializeCache(CacheState& state)
+		{
+			std::lock_guard<std::mutex> lock(state.Mutex);
+			if (state.Initialized) return;
+			state.Initialized = true;
+
+			std::error_code error;
+			std::filesystem::create_directories(CACHE_DIRECTORY, error);
+		}
+	}
+
+	namespace ShaderCache
+	{
+		Key ComputeKey(const std::string& shaderCode, const std::vector<std::string>& defines, const std::string& entry, const std::string& target, unsigned int compileFlags)
+		{
+			Key key = HashUtil::FNV_OFFSET_BASIS;
+			key = HashUtil::HashValue(key, COMPILER_VERSION);
+			key = HashUtil::HashString(key, shaderCode);
+			key = HashUtil::HashValue(key, defines.size());
+			for (const std::string& define : defines) key = HashUtil::HashString(key, define);
+			key = HashUtil::HashString(key, entry);
+			key = HashUtil::HashString(key, target);
+			key = HashUtil::HashValue(key, compileFlags);
+			return key;
+		}
+
+		bool Load(Key key, std::vector<unsigned char>& bytecode)
+		{
+			CacheState& state = GetState();
+			InitializeCache(state);
+
+			Timer timer;
+			timer.Start();
+
+			bool hit = false;
+			CacheFileHeader header;
+			std::ifstream file(GetEntryPath(key), std::ios::binary);
+			if (file.is_open() && file.read((char*) &header, sizeof(CacheFileHeader)) && header.Magic == CacheFileHeader::MAGIC && header.Version == CacheFileHeader::VERSION && header.Key == key)
+			{
+				bytecode.resize((size_t) header.BytecodeSize);
+				hit = (bool) file.read((char*) bytecode.data(), bytecode.size());
+			}
+			file.close();
+
+			timer.Stop();
+
+			std::lock_guard<std::mutex> lock(state.Mutex);
+			if (hit)
+			{
+				state.Stats.Hits++;
+				state.Stats.LoadTimeMS += timer.GetTimeMS();
+				state.Stats.SavedTimeMS += header.CompileTimeMS - timer.GetTimeMS();
+			}
+			else
+			{
+				state.Stats.Misses++;
+			}
+			return hit;
+		}
+
+		void Store(Key key, const void* bytecode, size_t size, float compileTimeMS)
+		{
+			CacheState& state = GetState();
+			InitializeCache(state);
+
+			CacheFileHeader header;
+			header.Key = key;
+			header.BytecodeSize = size;
+			header.CompileTimeMS = compileTimeMS;
+
+			// Write to temporary file first so a crash never leaves a partial entry
+			const std::string path = GetEntryPath(key);
+			const std::string tempPath = path + ".tmp";
+			{
+				std::ofstream file(tempPath, std::ios::binary);
+				if (!file.is_open())
+				{
+					CONSOLE_LOG("[ShaderCache] Failed to write cache entry: " + path);
+					return;
+				}
+				file.write((const char*) &header, sizeof(CacheFileHeader));
+				file.write((const char*) bytecode, size);
+			}
+
+			std::error_code error;
+			std::filesystem::rename(tempPath, path, error);
+			if (error) std::filesystem::remove(tempPath, error);
+
+			std::lock_guard<std::mutex> lock(state.Mutex);
+			state.Stats.CompileTimeMS += compileTimeMS;
+		}
+
+		ShaderCacheStats GetStats()
+		{
+			CacheState& state = GetState();
+			std::lock_guard<std::mutex> lock(state.Mutex);
+			return state.Stats;
+		}
+
+		void LogStats()
+		{
+			const ShaderCacheStats stats = GetStats();
+			const unsigned int numRequests = stats.Hits + stats.Misses;
+			const float hitRate = numRequests ? 100.0f * stats.Hits / numRequests : 0.0f;
+			CONSOLE_LOG("[ShaderCache] Hits: " + std::to_string(stats.Hits) + ", Misses: " + std::to_string(stats.Misses) + ", Hit rate: " + std::to_string(hitRate) + "%");
+			CONSOLE_LOG("[ShaderCache] Compiled: " + std::to_string(stats.CompileTimeMS) + " ms, Loaded: " + std::to_string(stats.LoadTimeMS) + " ms, Saved: " + std::to_string(stats.SavedTimeMS) + " ms");
+		}
+	}
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "Common.h"
+
+#include <string>
+#include <vector>
+
+namespace GP
+{
+	struct ShaderCacheStats
+	{
+		unsigned int Hits = 0;
+		unsigned int Misses = 0;
+		float CompileTimeMS = 0.0f;	// Spent in the compiler on misses
+		float LoadTimeMS = 0.0f;	// Spent reading bytecode on hits
+		float SavedTimeMS = 0.0f;	// Compile time that hits skipped, minus their load time
+	};
+
+	// Directory of compiled shader bytecode, entries are keyed by the expanded source so edited includes are recompiled
+	namespace ShaderCache
+	{
+		using Key = unsigned long long;
+
+		Key ComputeKey(const std::string& shaderCode, const std::vector<std::string>& defines, const std::string& entry, const std::string& target, unsigned int compileFlags);
+
+		bool Load(Key key, std::vector<unsigned char>& bytecode);
+		void Store(Key key, const void* bytecode, size_t size, float compileTimeMS);
+
+		GP_DLL ShaderCacheStats GetStats();
+		GP_DLL void LogStats();
+	}
+}
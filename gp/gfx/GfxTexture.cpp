@@ -4,10 +4,16 @@
 #include "stb/stb_image.h"
 
 #include <d3d11_1.h>
+#include <fstream>
 
 #include "core/GlobalVariables.h"
 #include "gfx/GfxDevice.h"
 #include "gfx/GfxResourceHelpers.h"
+#include "gfx/GfxTextureCompressor.h"
+#include "gfx/GfxTextureCache.h"
+#include "gfx/GfxTextureContainer.h"
+#include "gfx/GfxTextureStreaming.h"
+#include "debug/LoadingTelemetry.h"
 
 namespace GP
 {
@@ -19,6 +25,10 @@ namespace GP
         case TextureFormat::RGBA_FLOAT: return DXGI_FORMAT_R32G32B32A32_FLOAT;
         case TextureFormat::R24G8_TYPELESS: return DXGI_FORMAT_R24G8_TYPELESS;
         case TextureFormat::R32_TYPELESS: return DXGI_FORMAT_R32_TYPELESS;
+        case TextureFormat::BC1_UNORM: return DXGI_FORMAT_BC1_UNORM;
+        case TextureFormat::BC3_UNORM: return DXGI_FORMAT_BC3_UNORM;
+        case TextureFormat::BC5_UNORM: return DXGI_FORMAT_BC5_UNORM;
+        case TextureFormat::BC7_UNORM: return DXGI_FORMAT_BC7_UNORM;
         case TextureFormat::UNKNOWN: return DXGI_FORMAT_UNKNOWN;
         default: NOT_IMPLEMENTED;
         }
@@ -36,6 +46,10 @@ namespace GP
             case TextureFormat::RGBA_FLOAT: return DXGI_FORMAT_R32G32B32A32_FLOAT;
             case TextureFormat::R24G8_TYPELESS: return DXGI_FORMAT_R24_UNORM_X8_TYPELESS;
             case TextureFormat::R32_TYPELESS: return DXGI_FORMAT_R32_FLOAT;
+            case TextureFormat::BC1_UNORM: return DXGI_FORMAT_BC1_UNORM;
+            case TextureFormat::BC3_UNORM: return DXGI_FORMAT_BC3_UNORM;
+            case TextureFormat::BC5_UNORM: return DXGI_FORMAT_BC5_UNORM;
+            case TextureFormat::BC7_UNORM: return DXGI_FORMAT_BC7_UNORM;
             case TextureFormat::UNKNOWN: return DXGI_FORMAT_UNKNOWN;
             default: NOT_IMPLEMENTED;
             }
@@ -72,6 +86,19 @@ namespace GP
             return 0;
         }
 
+        TextureCompression ToTextureCompression(TextureFormat format)
+        {
+            switch (format)
+            {
+            case TextureFormat::BC1_UNORM: return TextureCompression::BC1;
+            case TextureFormat::BC3_UNORM: return TextureCompression::BC3;
+            case TextureFormat::BC5_UNORM: return TextureCompression::BC5;
+            case TextureFormat::BC7_UNORM: return TextureCompression::BC7;
+            default: NOT_IMPLEMENTED;
+            }
+            return TextureCompression::None;
+        }
+
         D3D11_FILTER GetDXFilter(SamplerFilter filter)
         {
             switch (filter)
@@ -100,27 +127,113 @@ namespace GP
 
         unsigned char INVALID_TEXTURE_COLOR[] = { 0xff, 0x00, 0x33, 0xff };
 
-        void* LoadTexture(const std::string& path, int& width, int& height, int& bpp)
+        void LoadInvalidTexture(const std::string& path, TextureMipChain& result)
+        {
+            CONSOLE_LOG("Failed to load texture: " + path);
+            result.Allocate(TextureFormat::RGBA8_UNORM, 1, 1, 1);
+            memcpy(result.GetData(), INVALID_TEXTURE_COLOR, sizeof(INVALID_TEXTURE_COLOR));
+        }
+
+        bool ReadFileBytes(const std::string& path, std::vector<unsigned char>& data)
         {
-            void* data = stbi_load(path.c_str(), &width, &height, &bpp, 4);
+            std::ifstream file(path, std::ios::binary | std::ios::ate);
+            if (!file.is_open()) return false;
+
+            data.resize((size_t) file.tellg());
+            file.seekg(0);
+            return (bool) file.read((char*) data.data(), data.size());
+        }
 
-            if (!data)
+        // Builds the ready to upload mip chain of an image, texture cache is checked before decoding
+        void ImportTexture(const std::string& path, const TextureImportSettings& settings, TextureMipChain& result, TextureCache::Key& cacheKey)
+        {
+            std::vector<unsigned char> source;
+            bool sourceRead = false;
+            {
+                ScopedLoadingStage stage(LoadingStage::Read);
+                sourceRead = ReadFileBytes(path, source);
+            }
+
+            if (!sourceRead)
             {
-                CONSOLE_LOG("Failed to load texture: " + path);
-                data = INVALID_TEXTURE_COLOR;
-                width = 1;
-                height = 1;
-                bpp = 4;
+                LoadInvalidTexture(path, result);
+                return;
             }
+            LoadingTelemetry::AddBytesRead(source.size());
 
-            return data;
+            cacheKey = TextureCache::ComputeKey(source.data(), source.size(), settings);
+            bool cached = false;
+            {
+                ScopedLoadingStage stage(LoadingStage::Read);
+                cached = TextureCache::Load(cacheKey, result);
+            }
+
+            if (cached)
+            {
+                LoadingTelemetry::AddBytesRead(result.GetByteSize());
+                TextureCompressor::RecordLoadedTexture(result);
+                return;
+            }
+
+            {
+                ScopedLoadingStage stage(LoadingStage::Decode);
+
+                int width, height, bpp;
+                unsigned char* data = stbi_load_from_memory(source.data(), (int) source.size(), &width, &height, &bpp, 4);
+                if (!data)
+                {
+                    LoadInvalidTexture(path, result);
+                    return;
+                }
+
+                MipChain chain;
+                MipGenerator::Generate(data, width, height, settings.NumMips, settings.MipSettings, chain);
+                stbi_image_free(data);
+
+                if (settings.Compression != TextureCompression::None && TextureCompressor::CanCompress(width, height))
+                {
+                    TextureCompressor::Compress(chain, TextureCompressor::SelectFormat(settings.Compression, chain), result);
+                }
+                else
+                {
+                    if (settings.Compression != TextureCompression::None) CONSOLE_LOG("[TextureResource2D] Texture size is not a multiple of 4, loading it uncompressed: " + path);
+                    result.CopyFrom(chain);
+                }
+            }
+            LoadingTelemetry::AddBytesDecoded(result.GetByteSize());
+
+            TextureCache::Store(cacheKey, result);
+            TextureCompressor::RecordLoadedTexture(result);
         }
+    }
+
+    bool IsBlockCompressed(TextureFormat format)
+    {
+        return format == TextureFormat::BC1_UNORM || format == TextureFormat::BC3_UNORM || format == TextureFormat::BC5_UNORM || format == TextureFormat::BC7_UNORM;
+    }
+
+    unsigned int GetRowPitch(TextureFormat format, unsigned int width)
+    {
+        if (IsBlockCompressed(format)) return ((width + 3) / 4) * TextureCompressor::GetBlockByteSize(format);
+        return width * ToBPP(format);
+    }
+
+    unsigned int GetNumRows(TextureFormat format, unsigned int height)
+    {
+        return IsBlockCompressed(format) ? (height + 3) / 4 : height;
+    }
 
-        void FreeTexture(void* data)
+    size_t GetTextureByteSize(TextureFormat format, unsigned int width, unsigned int height, unsigned int numMips)
+    {
+        size_t numBytes = 0;
+        for (unsigned int mip = 0; numMips == 0 || mip < numMips; mip++)
         {
-            if (data != INVALID_TEXTURE_COLOR)
-                stbi_image_free(data);
+            numBytes += (size_t) GetRowPitch(format, width) * GetNumRows(format, height);
+            if (width == 1 && height == 1) break;
+            width = MAX(width / 2, 1u);
+            height = MAX(height / 2, 1u);
         }
+        return numBytes;
     }
 
     ///////////////////////////////////////////
@@ -129,78 +242,172 @@ namespace GP
 
     void TextureResource2D::Initialize(GfxContext* context)
     {
-        m_RowPitch = m_Width * ToBPP(m_Format);
-        m_SlicePitch = m_RowPitch * m_Height;
+        if (m_PathData.numPaths == 1 && TextureContainer::IsContainerPath(m_PathData.paths[0]))
+        {
+            InitializeFromContainer(m_PathData.paths[0]);
+            return;
+        }
+
+        m_RowPitch = GetRowPitch(m_Format, m_Width);
+        m_SlicePitch = m_RowPitch * GetNumRows(m_Format, m_Height);
 
         D3D11_SUBRESOURCE_DATA* subresourceData = nullptr;
-        void* texData[PathInitData::MAX_NUM_PATHS];
-        bool freeMemoryAfter = false;
-        bool uploadToTextureAfter = false;
+        TextureMipChain mipChains[PathInitData::MAX_NUM_PATHS];
+        TextureCache::Key cacheKeys[PathInitData::MAX_NUM_PATHS] = {};
+        unsigned int firstMip = 0;
+        ScopedMemoryTracking loadingMemory(MemoryCategory::TextureLoading, m_PathData.numPaths ? m_PathData.paths[0] : "");
 
         // If we have data paths defined load it here
         if (m_PathData.numPaths != 0) 
         {
             ASSERT(m_ArraySize == m_PathData.numPaths, "[TextureResource2D] If we are preloading textures array size must match with number of provided paths!");
+            ASSERT(!m_Streaming || m_ArraySize == 1, "[TextureResource2D] Only single textures can be streamed!");
+
+            TextureImportSettings importSettings;
+            importSettings.NumMips = m_NumMips;
+            importSettings.MipSettings = m_MipSettings;
+            importSettings.Compression = m_Compression;
 
-            freeMemoryAfter = true;
-            
             for (size_t i = 0; i < m_ArraySize; i++)
             {
-                int width, height, bpp;
-                texData[i] = LoadTexture(m_PathData.paths[i], width, height, bpp);
+                ImportTexture(m_PathData.paths[i], importSettings, mipChains[i], cacheKeys[i]);
 
-                // Fill the width and height data from first element
-                if (i == 0) 
+                // Other elements use the format that was selected for the first one
+                if (i == 0)
                 {
-                    m_Width = width;
-                    m_Height = height;
+                    const TextureFormat format = mipChains[0].GetFormat();
+                    importSettings.Compression = IsBlockCompressed(format) ? ToTextureCompression(format) : TextureCompression::None;
                 }
-                ASSERT(texData[i], "[TextureResource2D] Error loading element data: " + m_PathData.paths[i]);
-                //ASSERT(bpp == 4, "[TextureResource2D] Failed loading face data. We are only supporting RGBA8 textures.") TODO: Fix this, some texutres have bpp = 3 for some reason.
-                ASSERT(m_Width == width && m_Height == height, "[TextureResource2D] Error: Face data size doesn't match with other faces : " + m_PathData.paths[i]);
+
+                ASSERT(mipChains[i].GetLevel(0).Width == mipChains[0].GetLevel(0).Width && mipChains[i].GetLevel(0).Height == mipChains[0].GetLevel(0).Height, "[TextureResource2D] Error: Face data size doesn't match with other faces : " + m_PathData.paths[i]);
+                ASSERT(mipChains[i].GetFormat() == mipChains[0].GetFormat() && mipChains[i].GetNumMips() == mipChains[0].GetNumMips(), "[TextureResource2D] Error: Face data format doesn't match with other faces : " + m_PathData.paths[i]);
             }
 
-            m_RowPitch = m_Width * ToBPP(m_Format);
-            m_SlicePitch = m_RowPitch * m_Height;
+            size_t loadedBytes = 0;
+            for (size_t i = 0; i < m_ArraySize; i++) loadedBytes += mipChains[i].GetByteSize();
+            loadingMemory.SetNumBytes(loadedBytes);
+
+            // Streamed textures keep only the low mips resident until finer ones are requested
+            const MipLevel& topLevel = mipChains[0].GetLevel(0);
+            if (m_Streaming && cacheKeys[0] != 0) firstMip = TextureStreaming::GetInitialMip(mipChains[0].GetFormat(), topLevel.Width, topLevel.Height, mipChains[0].GetNumMips());
+
+            m_Format = mipChains[0].GetFormat();
+            m_Width = mipChains[0].GetLevel(firstMip).Width;
+            m_Height = mipChains[0].GetLevel(firstMip).Height;
+            m_NumMips = mipChains[0].GetNumMips() - firstMip;
+            m_RowPitch = GetRowPitch(m_Format, m_Width);
+            m_SlicePitch = m_RowPitch * GetNumRows(m_Format, m_Height);
 
-            if (m_NumMips == 1)
+            // Subresources are ordered by mips first, then by array slices
+            subresourceData = (D3D11_SUBRESOURCE_DATA*)malloc(m_ArraySize * m_NumMips * sizeof(D3D11_SUBRESOURCE_DATA));
+            for (size_t i = 0; i < m_ArraySize; i++)
             {
-                subresourceData = (D3D11_SUBRESOURCE_DATA*)malloc(m_ArraySize * sizeof(D3D11_SUBRESOURCE_DATA));
-                for (size_t i = 0; i < m_ArraySize; i++)
+                for (unsigned int mip = 0; mip < m_NumMips; mip++)
                 {
-                    subresourceData[i].pSysMem = texData[i];
-                    subresourceData[i].SysMemPitch = m_RowPitch;
-                    subresourceData[i].SysMemSlicePitch = m_SlicePitch;
+                    D3D11_SUBRESOURCE_DATA& data = subresourceData[mip + i * m_NumMips];
+                    data.pSysMem = mipChains[i].GetLevelData(firstMip + mip);
+                    data.SysMemPitch = mipChains[i].GetRowPitch(firstMip + mip);
+                    data.SysMemSlicePitch = data.SysMemPitch * mipChains[i].GetNumRows(firstMip + mip);
                 }
             }
-            else
-            {
-                // Prepare resource for mip generation
-                AddCreationFlags(RCF_SRV | RCF_RT | RCF_GenerateMips);
-                uploadToTextureAfter = true;
-            }
         }
 
         const D3D11_TEXTURE2D_DESC textureDesc = FillTexture2DDescription(m_Width, m_Height, m_NumMips, m_ArraySize, m_NumSamples, ToDXGIFormat(m_Format), m_CreationFlags);
-        DX_CALL(g_Device->GetDevice()->CreateTexture2D(&textureDesc, subresourceData, &m_Handle));
+        {
+            ScopedLoadingStage stage(LoadingStage::Upload);
+            DX_CALL(g_Device->GetDevice()->CreateTexture2D(&textureDesc, subresourceData, &m_Handle));
+        }
+        TrackMemory(GetTextureByteSize(m_Format, m_Width, m_Height, m_NumMips) * m_ArraySize * m_NumSamples, MemoryCategory::Texture);
+
+        free(subresourceData);
 
-        if (uploadToTextureAfter)
+        if (firstMip != 0) m_StreamedTexture = TextureStreaming::Register(this, cacheKeys[0], mipChains[0], firstMip);
+    }
+
+    void TextureResource2D::InitializeFromContainer(const std::string& path)
+    {
+        TextureContainer container;
+        bool loaded = false;
+        {
+            ScopedLoadingStage stage(LoadingStage::Read);
+            loaded = container.Open(path);
+        }
+        if (loaded && container.IsCubemap() != ((m_CreationFlags & RCF_Cubemap) != 0))
         {
-            for (size_t i = 0; i < m_ArraySize; i++) context->UploadToTexture(this, texData[i], i);
+            CONSOLE_LOG("[TextureResource2D] Texture file cubemap layout doesn't match the texture type: " + path);
+            loaded = false;
         }
 
-        if (freeMemoryAfter)
+        std::vector<D3D11_SUBRESOURCE_DATA> subresourceData;
+        TextureMipChain invalidTexture;
+        if (loaded)
         {
-            for (size_t i = 0; i < m_ArraySize; i++)
+            m_Format = container.GetFormat();
+            m_Width = container.GetWidth();
+            m_Height = container.GetHeight();
+            m_NumMips = container.GetNumMips();
+            m_ArraySize = container.GetArraySize();
+
+            // Subresources point directly into the mapped file
+            subresourceData.resize(m_NumMips * m_ArraySize);
+            for (unsigned int slice = 0; slice < m_ArraySize; slice++)
             {
-                FreeTexture(texData[i]);
+                for (unsigned int mip = 0; mip < m_NumMips; mip++)
+                {
+                    const TextureSubresource& subresource = container.GetSubresource(mip, slice);
+                    D3D11_SUBRESOURCE_DATA& data = subresourceData[mip + slice * m_NumMips];
+                    data.pSysMem = subresource.Data;
+                    data.SysMemPitch = subresource.RowPitch;
+                    data.SysMemSlicePitch = subresource.SlicePitch;
+                    LoadingTelemetry::AddBytesRead(subresource.SlicePitch);
+                }
             }
         }
+        else
+        {
+            LoadInvalidTexture(path, invalidTexture);
+            m_Format = invalidTexture.GetFormat();
+            m_Width = 1;
+            m_Height = 1;
+            m_NumMips = 1;
+
+            subresourceData.resize(m_ArraySize);
+            for (D3D11_SUBRESOURCE_DATA& data : subresourceData)
+            {
+                data.pSysMem = invalidTexture.GetData();
+                data.SysMemPitch = invalidTexture.GetRowPitch(0);
+                data.SysMemSlicePitch = data.SysMemPitch;
+            }
+        }
+
+        m_RowPitch = GetRowPitch(m_Format, m_Width);
+        m_SlicePitch = m_RowPitch * GetNumRows(m_Format, m_Height);
+
+        const D3D11_TEXTURE2D_DESC textureDesc = FillTexture2DDescription(m_Width, m_Height, m_NumMips, m_ArraySize, m_NumSamples, ToDXGIFormat(m_Format), m_CreationFlags);
+        {
+            ScopedLoadingStage stage(LoadingStage::Upload);
+            DX_CALL(g_Device->GetDevice()->CreateTexture2D(&textureDesc, subresourceData.data(), &m_Handle));
+        }
+        TrackMemory(GetTextureByteSize(m_Format, m_Width, m_Height, m_NumMips) * m_ArraySize, MemoryCategory::Texture);
+    }
+
+    void TextureResource2D::ReplaceHandle(ID3D11Texture2D* handle, unsigned int width, unsigned int height, unsigned int numMips)
+    {
+        SAFE_RELEASE(m_Handle);
+        m_Handle = handle;
+        m_Width = width;
+        m_Height = height;
+        m_NumMips = numMips;
+        m_RowPitch = GetRowPitch(m_Format, m_Width);
+        m_SlicePitch = m_RowPitch * GetNumRows(m_Format, m_Height);
+        m_Version++;
+        TrackMemory(GetTextureByteSize(m_Format, m_Width, m_Height, m_NumMips) * m_ArraySize * m_NumSamples, MemoryCategory::Texture);
     }
 
     TextureResource2D::~TextureResource2D()
     {
         ASSERT(m_RefCount == 0, "[~TextureResource2D] Trying to delete a referenced texture!");
+        if (m_StreamedTexture) TextureStreaming::Unregister(m_StreamedTexture);
         SAFE_RELEASE(m_Handle);
     }
 
@@ -210,11 +417,12 @@ namespace GP
 
     void TextureResource3D::Initialize(GfxContext* context)
     {
-        m_RowPitch = m_Width * ToBPP(m_Format);
-        m_SlicePitch = m_RowPitch * m_Height;
+        m_RowPitch = GetRowPitch(m_Format, m_Width);
+        m_SlicePitch = m_RowPitch * GetNumRows(m_Format, m_Height);
 
         D3D11_TEXTURE3D_DESC textureDesc = Fill3DTextureDescription(m_Width, m_Height, m_Depth, m_NumMips, ToDXGIFormat(m_Format), m_CreationFlags);
         DX_CALL(g_Device->GetDevice()->CreateTexture3D(&textureDesc, nullptr, &m_Handle));
+        TrackMemory(GetTextureByteSize(m_Format, m_Width, m_Height, m_NumMips) * m_Depth, MemoryCategory::Texture);
 
         // TODO: Data initialization
     }
@@ -234,6 +442,11 @@ namespace GP
     {
         if (!m_Resource->Initialized()) m_Resource->Initialize(context);
 
+        // Views of a replaced handle are recreated
+        SAFE_RELEASE(m_SRV);
+        SAFE_RELEASE(m_UAV);
+        m_ResourceVersion = m_Resource->GetVersion();
+
         unsigned int creationFlags = m_Resource->GetCreationFlags();
         unsigned int numMips = m_Resource->GetNumMips();
 
@@ -245,6 +458,7 @@ namespace GP
             switch (m_Type)
             {
             case ResourceType::Texture2D:
+                ASSERT(m_Resource->GetArraySize() == 1, "[GfxResource<TextureResource2D>::Initialize] Texture file contains an array, load it with GfxTextureArray2D!");
                 srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
                 srvDesc.Texture2D.MipLevels = numMips == MAX_MIPS ? -1 : numMips;
                 srvDesc.Texture2D.MostDetailedMip = 0;
@@ -293,7 +507,7 @@ namespace GP
             DX_CALL(g_Device->GetDevice()->CreateUnorderedAccessView(m_Resource->GetHandle(), &uavDesc, &m_UAV));
         }
 
-        if (numMips != 1)
+        if (creationFlags & RCF_GenerateMips)
         {
             context->GenerateMips((GfxBaseTexture2D*)this);
         }
@@ -460,11 +674,18 @@ namespace GP
         m_Initialized = false;
     }
 
+    size_t GfxRenderTarget::GetMemorySize(const RenderTargetConfig& config)
+    {
+        size_t numBytes = (size_t) GetRowPitch(config.Format, config.Width) * config.Height * config.NumSamples * config.NumRenderTargets;
+        if (config.UseDepth) numBytes += (size_t) GetRowPitch(config.UseStencil ? DEFAULT_DS_STENCIL_FORMAT : DEFAULT_DS_FORMAT, config.Width) * config.Height;
+        return numBytes;
+    }
+
     void GfxRenderTarget::FreeResources()
     {
         for (unsigned int i = 0; i < m_Config.NumRenderTargets; i++)
         {
-            m_RTVs[i]->Release();
+            SAFE_RELEASE(m_RTVs[i]);
             m_Resources[i]->Release();
         }
 
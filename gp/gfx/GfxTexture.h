@@ -2,6 +2,7 @@
 
 #include "gfx/GfxCommon.h"
 #include "gfx/GfxResource.h"
+#include "gfx/GfxMipGenerator.h"
 
 #include <string>
 #include <vector>
@@ -17,6 +18,8 @@ struct ID3D11SamplerState;
 
 namespace GP
 {
+	struct StreamedTexture;
+
 	enum class TextureFormat
 	{
 		UNKNOWN,
@@ -24,6 +27,21 @@ namespace GP
 		RGBA_FLOAT,
 		R24G8_TYPELESS,
 		R32_TYPELESS,
+		BC1_UNORM,
+		BC3_UNORM,
+		BC5_UNORM,
+		BC7_UNORM,
+	};
+
+	// Block compression applied to textures loaded from paths
+	enum class TextureCompression
+	{
+		None,
+		Auto,	// BC3 if the texture has alpha, BC1 otherwise
+		BC1,	// Opaque
+		BC3,	// With alpha
+		BC5,	// Normal maps, only RG is stored
+		BC7		// High quality RGBA
 	};
 
 	enum class SamplerFilter
@@ -45,6 +63,15 @@ namespace GP
 
 	static unsigned int MAX_MIPS = 0;
 
+	bool IsBlockCompressed(TextureFormat format);
+
+	// Row is one line of texels, or one line of 4x4 blocks for block compressed formats
+	unsigned int GetRowPitch(TextureFormat format, unsigned int width);
+	unsigned int GetNumRows(TextureFormat format, unsigned int height);
+
+	// Bytes of one array slice with all of its mips, numMips of 0 means the full chain
+	size_t GetTextureByteSize(TextureFormat format, unsigned int width, unsigned int height, unsigned int numMips);
+
 	class TextureResource2D : public GfxResourceHandle<ID3D11Texture2D>
 	{
 	public:
@@ -70,6 +97,17 @@ namespace GP
 
 		void Initialize(GfxContext* context);
 
+		// Used when mips are generated on the CPU for textures loaded from paths
+		inline void SetMipGenerationSettings(const MipGenerationSettings& settings) { m_MipSettings = settings; }
+		inline void SetCompression(TextureCompression compression) { m_Compression = compression; }
+
+		// Streamed textures start with only the low mips resident, see TextureStreaming
+		inline void SetStreaming(bool streaming) { m_Streaming = streaming; }
+		inline StreamedTexture* GetStreamedTexture() const { return m_StreamedTexture; }
+
+		// Used by texture streaming to change resident mips, views are recreated on the next bind
+		void ReplaceHandle(ID3D11Texture2D* handle, unsigned int width, unsigned int height, unsigned int numMips);
+
 		inline unsigned int GetWidth() const { return m_Width; }
 		inline unsigned int GetHeight() const { return m_Height; }
 		inline TextureFormat GetFormat() const { return m_Format; }
@@ -83,6 +121,9 @@ namespace GP
 	private:
 		~TextureResource2D();
 
+		// DDS and KTX2 files carry their own format, mips and array slices
+		void InitializeFromContainer(const std::string& path);
+
 	private:
 		unsigned int m_Width;
 		unsigned int m_Height;
@@ -90,6 +131,10 @@ namespace GP
 		unsigned int m_NumMips;
 		unsigned int m_ArraySize;
 		unsigned int m_NumSamples;
+		MipGenerationSettings m_MipSettings;
+		TextureCompression m_Compression = TextureCompression::None;
+		bool m_Streaming = false;
+		StreamedTexture* m_StreamedTexture = nullptr;
 
 		unsigned int m_RowPitch;
 		unsigned int m_SlicePitch;
@@ -160,10 +205,12 @@ namespace GP
 		static constexpr unsigned int DEFAULT_FLAGS = RCF_SRV;
 		static constexpr TextureFormat DEFAULT_FORMAT = TextureFormat::RGBA8_UNORM;
 	public:
-		GfxTexture2D(const std::string& path, unsigned int numMips = 1):
+		GfxTexture2D(const std::string& path, unsigned int numMips = 1, const MipGenerationSettings& mipSettings = {}, TextureCompression compression = TextureCompression::None):
 			GfxBaseTexture2D(ResourceType::Texture2D)
 		{
 			m_Resource = new TextureResource2D(0, 0, DEFAULT_FORMAT, numMips, 1, 1, DEFAULT_FLAGS);
+			m_Resource->SetMipGenerationSettings(mipSettings);
+			m_Resource->SetCompression(compression);
 			std::string paths[1] = { path };
 			m_Resource->SetInitializationData(1, paths);
 		}
@@ -188,6 +235,15 @@ namespace GP
 		static constexpr unsigned int DEFAULT_FLAGS = RCF_SRV;
 		static constexpr TextureFormat DEFAULT_FORMAT = TextureFormat::RGBA8_UNORM;
 	public:
+		// Loads every array slice from a single DDS or KTX2 file
+		GfxTextureArray2D(const std::string& path) :
+			GfxBaseTexture2D(ResourceType::TextureArray2D)
+		{
+			m_Resource = new TextureResource2D(0, 0, DEFAULT_FORMAT, 1, 1, 1, DEFAULT_FLAGS);
+			std::string paths[1] = { path };
+			m_Resource->SetInitializationData(1, paths);
+		}
+
 		GfxTextureArray2D(unsigned int width, unsigned int height, unsigned int arraySize, TextureFormat format = DEFAULT_FORMAT, unsigned int numMips = 1, unsigned int numSamples = 1) :
 			GfxBaseTexture2D(ResourceType::TextureArray2D)
 		{
@@ -209,13 +265,24 @@ namespace GP
 		static constexpr TextureFormat DEFAULT_FORMAT = TextureFormat::RGBA8_UNORM;
 	public:
 		// The order of textures:  Right, Left, Up, Down, Back, Front
-		GfxCubemap(std::string textures[6], unsigned int numMips = 1):
+		GfxCubemap(std::string textures[6], unsigned int numMips = 1, const MipGenerationSettings& mipSettings = {}, TextureCompression compression = TextureCompression::None):
 			GfxBaseTexture2D(ResourceType::Cubemap)
 		{
 			m_Resource = new TextureResource2D(0, 0, DEFAULT_FORMAT, numMips, 6, 1, DEFAULT_FLAGS);
+			m_Resource->SetMipGenerationSettings(mipSettings);
+			m_Resource->SetCompression(compression);
 			m_Resource->SetInitializationData(6, textures);
 		}
 
+		// Loads all faces from a single DDS or KTX2 cubemap file
+		GfxCubemap(const std::string& path) :
+			GfxBaseTexture2D(ResourceType::Cubemap)
+		{
+			m_Resource = new TextureResource2D(0, 0, DEFAULT_FORMAT, 1, 6, 1, DEFAULT_FLAGS);
+			std::string paths[1] = { path };
+			m_Resource->SetInitializationData(1, paths);
+		}
+
 		GfxCubemap(TextureResource2D* resource) :
 			GfxBaseTexture2D(ResourceType::Cubemap, resource)
 		{
@@ -278,6 +345,14 @@ namespace GP
 		bool UseStencil = false;
 	};
 
+	inline bool operator==(const RenderTargetConfig& a, const RenderTargetConfig& b)
+	{
+		return a.Width == b.Width && a.Height == b.Height && a.NumRenderTargets == b.NumRenderTargets && a.NumSamples == b.NumSamples &&
+			a.Format == b.Format && a.UseDepth == b.UseDepth && a.UseStencil == b.UseStencil;
+	}
+
+	inline bool operator!=(const RenderTargetConfig& a, const RenderTargetConfig& b) { return !(a == b); }
+
 	class GfxRenderTarget
 	{
 		DELETE_COPY_CONSTRUCTOR(GfxRenderTarget);
@@ -309,6 +384,9 @@ namespace GP
 		GP_DLL void InitResources();
 		GP_DLL void FreeResources();
 
+		// Memory of all targets and the depth buffer created for the config
+		GP_DLL static size_t GetMemorySize(const RenderTargetConfig& config);
+
 		inline bool Initialized() const { return m_Initialized; }
 		inline unsigned int GetNumRTs() const { return m_Config.NumRenderTargets; }
 		inline bool UseMultisampling() const { return m_Config.NumSamples != 1; }
@@ -0,0 +1,264 @@
+#include "GfxTextureCache.h"
+
+#include <cstdio>
+#include <fstream>
+#include <filesystem>
+#include <mutex>
+#include <algorithm>
+
+#include "util/HashUtil.h"
+
+namespace GP
+{
+	namespace
+	{
+		static const std::string CACHE_DIRECTORY = "cache/textures/";
+		static const std::string CACHE_FILE_EXTENSION = ".gptc";
+		static constexpr size_t DEFAULT_MAX_CACHE_SIZE = 2ull * 1024 * 1024 * 1024;
+
+		// Bump when the import pipeline output changes so old entries stop matching
+		static constexpr unsigned int IMPORT_VERSION = 1;
+
+		struct CacheFileHeader
+		{
+			static constexpr unsigned int MAGIC = 0x43545047; // GPTC
+			static constexpr unsigned int VERSION = 2;
+
+			unsigned int Magic = MAGIC;
+			unsigned int Version = VERSION;
+			unsigned long long Key = 0;
+			unsigned int Format = 0;
+			unsigned int Width = 0;
+			unsigned int Height = 0;
+			unsigned int NumMips = 0;
+			unsigned long long PayloadSize = 0;
+		};
+
+		struct CacheState
+		{
+			std::mutex Mutex;
+			bool Initialized = false;
+			size_t MaxSize = DEFAULT_MAX_CACHE_SIZE;
+			TextureCacheStats Stats;
+		};
+
+		CacheState& GetState()
+		{
+			static CacheState state;
+			return state;
+		}
+
+		std::string ToMB(size_t bytes)
+		{
+			return std::to_string(bytes / (1024.0f * 1024.0f)) + " MB";
+		}
+
+		std::string GetEntryPath(TextureCache::Key key)
+		{
+			char name[17];
+			snprintf(name, sizeof(name), "%016llx", key);
+			return CACHE_DIRECTORY + name + CACHE_FILE_EXTENSION;
+		}
+
+		// Must be called with state mutex locked
+		void InitializeCache(CacheState& state)
+		{
+			if (state.Initialized) return;
+			state.Initialized = true;
+
+			std::error_code error;
+			std::filesystem::create_directories(CACHE_DIRECTORY, error);
+			for (const auto& entry : std::filesystem::directory_iterator(CACHE_DIRECTORY, error))
+			{
+				if (!entry.is_regular_file()) continue;
+
+				// Leftovers from interrupted writes
+				if (entry.path().extension() != CACHE_FILE_EXTENSION)
+				{
+					std::filesystem::remove(entry.path(), error);
+					continue;
+				}
+				state.Stats.CacheSize += (size_t) entry.file_size(error);
+			}
+		}
+
+		// Must be called with state mutex locked
+		void EvictEntries(CacheState& state)
+		{
+			if (state.Stats.CacheSize <= state.MaxSize) return;
+
+			struct CacheEntry
+			{
+				std::filesystem::path Path;
+				size_t Size;
+				std::filesystem::file_time_type LastUse;
+			};
+
+			std::error_code error;
+			std::vector<CacheEntry> entries;
+			for (const auto& entry : std::filesystem::directory_iterator(CACHE_DIRECTORY, error))
+			{
+				if (!entry.is_regular_file() || entry.path().extension() != CACHE_FILE_EXTENSION) continue;
+				entries.push_back({ entry.path(), (size_t) entry.file_size(error), entry.last_write_time(error) });
+			}
+
+			std::sort(entries.begin(), entries.end(), [](const CacheEntry& a, const CacheEntry& b) { return a.LastUse < b.LastUse; });
+
+			for (const CacheEntry& entry : entries)
+			{
+				if (state.Stats.CacheSize <= state.MaxSize) break;
+				if (!std::filesystem::remove(entry.Path, error)) continue;
+
+				state.Stats.CacheSize -= MIN(entry.Size, state.Stats.CacheSize);
+				state.Stats.Evictions++;
+			}
+		}
+	}
+
+	namespace TextureCache
+	{
+		Key ComputeKey(const void* sourceData, size_t sourceSize, const TextureImportSettings& settings)
+		{
+			Key key = HashUtil::FNV_OFFSET_BASIS;
+			key = HashUtil::HashValue(key, IMPORT_VERSION);
+			key = HashUtil::HashBytes(key, sourceData, sourceSize);
+			key = HashUtil::HashValue(key, settings.NumMips);
+			key = HashUtil::HashValue(key, settings.MipSettings.Filter);
+			key = HashUtil::HashValue(key, settings.MipSettings.SRGB);
+			key = HashUtil::HashValue(key, settings.MipSettings.AlphaCoverageRef);
+			key = HashUtil::HashValue(key, settings.Compression);
+			return key;
+		}
+
+		bool Load(Key key, TextureMipChain& result)
+		{
+			return LoadMips(key, 0, result);
+		}
+
+		bool LoadMips(Key key, unsigned int firstMip, TextureMipChain& result)
+		{
+			CacheState& state = GetState();
+			{
+				std::lock_guard<std::mutex> lock(state.Mutex);
+				InitializeCache(state);
+			}
+
+			const std::string path = GetEntryPath(key);
+			bool hit = false;
+			size_t bytesRead = 0;
+
+			// Header and payload are read in one sequential pass directly into the chain
+			std::ifstream file(path, std::ios::binary);
+			if (file.is_open())
+			{
+				CacheFileHeader header;
+				if (file.read((char*) &header, sizeof(CacheFileHeader)) && header.Magic == CacheFileHeader::MAGIC && header.Version == CacheFileHeader::VERSION && header.Key == key && firstMip < header.NumMips)
+				{
+					// Mips are stored from the finest one, so skipped mips are at the start of the payload
+					const TextureFormat format = (TextureFormat) header.Format;
+					unsigned int width = header.Width;
+					unsigned int height = header.Height;
+					size_t skippedBytes = 0;
+					for (unsigned int mip = 0; mip < firstMip; mip++)
+					{
+						skippedBytes += (size_t) GetRowPitch(format, width) * GetNumRows(format, height);
+						width = MAX(1u, width / 2);
+						height = MAX(1u, height / 2);
+					}
+
+					result.Allocate(format, width, height, header.NumMips - firstMip);
+					hit = skippedBytes + result.GetByteSize() == header.PayloadSize && file.seekg(skippedBytes, std::ios::cur) && file.read((char*) result.GetData(), result.GetByteSize());
+					bytesRead = sizeof(CacheFileHeader) + result.GetByteSize();
+				}
+				file.close();
+			}
+
+			std::lock_guard<std::mutex> lock(state.Mutex);
+			if (hit)
+			{
+				// Write time is used as last use time for eviction
+				std::error_code error;
+				std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), error);
+
+				state.Stats.Hits++;
+				state.Stats.BytesRead += bytesRead;
+			}
+			else
+			{
+				state.Stats.Misses++;
+			}
+			return hit;
+		}
+
+		void Store(Key key, const TextureMipChain& chain)
+		{
+			CacheState& state = GetState();
+			{
+				std::lock_guard<std::mutex> lock(state.Mutex);
+				InitializeCache(state);
+			}
+
+			CacheFileHeader header;
+			header.Key = key;
+			header.Format = (unsigned int) chain.GetFormat();
+			header.Width = chain.GetLevel(0).Width;
+			header.Height = chain.GetLevel(0).Height;
+			header.NumMips = chain.GetNumMips();
+			header.PayloadSize = chain.GetByteSize();
+
+			// Write to temporary file first so a crash never leaves a partial entry
+			const std::string path = GetEntryPath(key);
+			const std::string tempPath = path + ".tmp";
+			{
+				std::ofstream file(tempPath, std::ios::binary);
+				if (!file.is_open())
+				{
+					CONSOLE_LOG("[TextureCache] Failed to write cache entry: " + path);
+					return;
+				}
+				file.write((const char*) &header, sizeof(CacheFileHeader));
+				file.write((const char*) chain.GetData(), chain.GetByteSize());
+			}
+
+			const size_t entrySize = sizeof(CacheFileHeader) + chain.GetByteSize();
+
+			std::lock_guard<std::mutex> lock(state.Mutex);
+			std::error_code error;
+			const size_t replacedSize = std::filesystem::exists(path, error) ? (size_t) std::filesystem::file_size(path, error) : 0;
+			std::filesystem::rename(tempPath, path, error);
+			if (error)
+			{
+				std::filesystem::remove(tempPath, error);
+				return;
+			}
+
+			state.Stats.CacheSize -= MIN(replacedSize, state.Stats.CacheSize);
+			state.Stats.CacheSize += entrySize;
+			state.Stats.BytesWritten += entrySize;
+			EvictEntries(state);
+		}
+
+		void SetMaxSize(size_t maxSize)
+		{
+			CacheState& state = GetState();
+			std::lock_guard<std::mutex> lock(state.Mutex);
+			InitializeCache(state);
+			state.MaxSize = maxSize;
+			EvictEntries(state);
+		}
+
+		TextureCacheStats GetStats()
+		{
+			CacheState& state = GetState();
+			std::lock_guard<std::mutex> lock(state.Mutex);
+			return state.Stats;
+		}
+
+		void LogStats()
+		{
+			const TextureCacheStats stats = GetStats();
+			CONSOLE_LOG("[TextureCache] Hits: " + std::to_string(stats.Hits) + ", Misses: " + std::to_string(stats.Misses) + ", Evictions: " + std::to_string(stats.Evictions));
+			CONSOLE_LOG("[TextureCache] Read: " + ToMB(stats.BytesRead) + ", Written: " + ToMB(stats.BytesWritten) + ", Size: " + ToMB(stats.CacheSize));
+		}
+	}
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "Common.h"
+#include "gfx/GfxTextureCompressor.h"
+
+namespace GP
+{
+	struct TextureImportSettings
+	{
+		unsigned int NumMips = 1;
+		MipGenerationSettings MipSettings;
+		TextureCompression Compression = TextureCompression::None;
+	};
+
+	struct TextureCacheStats
+	{
+		unsigned int Hits = 0;
+		unsigned int Misses = 0;
+		unsigned int Evictions = 0;
+		size_t BytesRead = 0;
+		size_t BytesWritten = 0;
+		size_t CacheSize = 0;
+	};
+
+	// Directory of ready to upload texture payloads, entries are evicted by least recent use when the cache grows over its max size
+	namespace TextureCache
+	{
+		using Key = unsigned long long;
+
+		Key ComputeKey(const void* sourceData, size_t sourceSize, const TextureImportSettings& settings);
+
+		bool Load(Key key, TextureMipChain& result);
+
+		// Loads only mips starting from firstMip, used for streaming finer mips of already imported textures
+		bool LoadMips(Key key, unsigned int firstMip, TextureMipChain& result);
+		void Store(Key key, const TextureMipChain& chain);
+
+		GP_DLL void SetMaxSize(size_t maxSize);
+		GP_DLL TextureCacheStats GetStats();
+		GP_DLL void LogStats();
+	}
+}
@@ -0,0 +1,509 @@
+#include "GfxTextureCompressor.h"
+
+#define STB_DXT_IMPLEMENTATION
+#include "stb/stb_dxt.h"
+
+#include <cmath>
+#include <cstring>
+#include <cfloat>
+#include <climits>
+#include <utility>
+#include <mutex>
+
+#include "core/Threads.h"
+#include "util/Timer.h"
+
+namespace GP
+{
+	namespace
+	{
+		static constexpr unsigned int BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+		struct FormatStats
+		{
+			unsigned int NumLoaded = 0;
+			size_t UncompressedBytes = 0;
+			size_t CompressedBytes = 0;
+
+			unsigned int NumEncoded = 0;
+			double EncodedPixels = 0.0;
+			float EncodeTimeMS = 0.0f;
+		};
+
+		static constexpr unsigned int NUM_COMPRESSED_FORMATS = 4;
+		std::mutex s_StatsMutex;
+		FormatStats s_Stats[NUM_COMPRESSED_FORMATS];
+
+		unsigned int GetStatsIndex(TextureFormat format)
+		{
+			switch (format)
+			{
+			case TextureFormat::BC1_UNORM: return 0;
+			case TextureFormat::BC3_UNORM: return 1;
+			case TextureFormat::BC5_UNORM: return 2;
+			case TextureFormat::BC7_UNORM: return 3;
+			default: NOT_IMPLEMENTED;
+			}
+			return 0;
+		}
+
+		const char* ToString(TextureFormat format)
+		{
+			switch (format)
+			{
+			case TextureFormat::BC1_UNORM: return "BC1";
+			case TextureFormat::BC3_UNORM: return "BC3";
+			case TextureFormat::BC5_UNORM: return "BC5";
+			case TextureFormat::BC7_UNORM: return "BC7";
+			default: NOT_IMPLEMENTED;
+			}
+			return "";
+		}
+
+		std::string ToMB(size_t bytes)
+		{
+			return std::to_string(bytes / (1024.0f * 1024.0f)) + " MB";
+		}
+
+		size_t GetUncompressedByteSize(const TextureMipChain& chain)
+		{
+			size_t size = 0;
+			for (unsigned int mip = 0; mip < chain.GetNumMips(); mip++)
+			{
+				const MipLevel& level = chain.GetLevel(mip);
+				size += (size_t) level.Width * level.Height * 4;
+			}
+			return size;
+		}
+
+		// Fetches 4x4 RGBA texels, texels outside of the level are clamped to the edge
+		void FetchBlock(const unsigned char* rgba, unsigned int width, unsigned int height, unsigned int blockX, unsigned int blockY, unsigned char block[64])
+		{
+			for (unsigned int y = 0; y < 4; y++)
+			{
+				const unsigned int sy = MIN(blockY * 4 + y, height - 1);
+				for (unsigned int x = 0; x < 4; x++)
+				{
+					const unsigned int sx = MIN(blockX * 4 + x, width - 1);
+					memcpy(block + (y * 4 + x) * 4, rgba + ((size_t) sy * width + sx) * 4, 4);
+				}
+			}
+		}
+
+		///////////////////////////////////////
+		//			BC7 Mode 6				//
+		/////////////////////////////////////
+
+		// 7 bit RGBA endpoint with one shared p-bit
+		struct BC7Endpoint
+		{
+			unsigned int Value[4];
+			unsigned int PBit;
+
+			inline unsigned int Get(unsigned int channel) const { return (Value[channel] << 1) | PBit; }
+		};
+
+		BC7Endpoint QuantizeEndpoint(const float color[4])
+		{
+			BC7Endpoint best = {};
+			float bestError = FLT_MAX;
+			for (unsigned int pBit = 0; pBit < 2; pBit++)
+			{
+				BC7Endpoint endpoint = {};
+				endpoint.PBit = pBit;
+
+				float error = 0.0f;
+				for (unsigned int c = 0; c < 4; c++)
+				{
+					int value = (int) std::lround((color[c] - pBit) / 2.0f);
+					value = value < 0 ? 0 : (value > 127 ? 127 : value);
+					endpoint.Value[c] = (unsigned int) value;
+
+					const float diff = (float) endpoint.Get(c) - color[c];
+					error += diff * diff;
+				}
+
+				if (error < bestError)
+				{
+					bestError = error;
+					best = endpoint;
+				}
+			}
+			return best;
+		}
+
+		unsigned int FindIndices(const unsigned char* block, const BC7Endpoint& e0, const BC7Endpoint& e1, unsigned int indices[16])
+		{
+			int palette[16][4];
+			for (unsigned int i = 0; i < 16; i++)
+			{
+				for (unsigned int c = 0; c < 4; c++)
+					palette[i][c] = (int) (((64 - BC7_WEIGHTS[i]) * e0.Get(c) + BC7_WEIGHTS[i] * e1.Get(c) + 32) >> 6);
+			}
+
+			unsigned int totalError = 0;
+			for (unsigned int p = 0; p < 16; p++)
+			{
+				const unsigned char* texel = block + p * 4;
+				unsigned int bestError = UINT_MAX;
+				for (unsigned int i = 0; i < 16; i++)
+				{
+					unsigned int error = 0;
+					for (unsigned int c = 0; c < 4; c++)
+					{
+						const int diff = palette[i][c] - texel[c];
+						error += diff * diff;
+					}
+
+					if (error < bestError)
+					{
+						bestError = error;
+						indices[p] = i;
+					}
+				}
+				totalError += bestError;
+			}
+			return totalError;
+		}
+
+		// Least squares fit of endpoints for the current indices
+		bool RefineEndpoints(const unsigned char* block, const unsigned int indices[16], float c0[4], float c1[4])
+		{
+			float a = 0.0f, b = 0.0f, c = 0.0f;
+			float x0[4] = {}, x1[4] = {};
+			for (unsigned int p = 0; p < 16; p++)
+			{
+				const float w = BC7_WEIGHTS[indices[p]] / 64.0f;
+				a += (1.0f - w) * (1.0f - w);
+				b += (1.0f - w) * w;
+				c += w * w;
+				for (unsigned int ch = 0; ch < 4; ch++)
+				{
+					x0[ch] += (1.0f - w) * block[p * 4 + ch];
+					x1[ch] += w * block[p * 4 + ch];
+				}
+			}
+
+			const float det = a * c - b * b;
+			if (std::abs(det) < 1e-6f) return false;
+
+			for (unsigned int ch = 0; ch < 4; ch++)
+			{
+				c0[ch] = CLAMP((c * x0[ch] - b * x1[ch]) / det, 0.0f, 255.0f);
+				c1[ch] = CLAMP((a * x1[ch] - b * x0[ch]) / det, 0.0f, 255.0f);
+			}
+			return true;
+		}
+
+		struct BlockWriter
+		{
+			unsigned char* Data;
+			unsigned int Bit = 0;
+
+			void Write(unsigned int value, unsigned int numBits)
+			{
+				for (unsigned int i = 0; i < numBits; i++, Bit++)
+				{
+					if ((value >> i) & 1) Data[Bit >> 3] |= 1 << (Bit & 7);
+				}
+			}
+		};
+
+		// Mode 6: one subset, 7777.1 endpoints and 4 bit indices
+		void EncodeBC7Block(unsigned char* dest, const unsigned char* block)
+		{
+			float mean[4] = {};
+			for (unsigned int p = 0; p < 16; p++)
+				for (unsigned int c = 0; c < 4; c++) mean[c] += block[p * 4 + c] / 16.0f;
+
+			float covariance[4][4] = {};
+			for (unsigned int p = 0; p < 16; p++)
+			{
+				float d[4];
+				for (unsigned int c = 0; c < 4; c++) d[c] = block[p * 4 + c] - mean[c];
+				for (unsigned int i = 0; i < 4; i++)
+					for (unsigned int j = 0; j < 4; j++) covariance[i][j] += d[i] * d[j];
+			}
+
+			// Principal axis with power iteration
+			float axis[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+			for (unsigned int iteration = 0; iteration < 8; iteration++)
+			{
+				float next[4] = {};
+				for (unsigned int i = 0; i < 4; i++)
+					for (unsigned int j = 0; j < 4; j++) next[i] += covariance[i][j] * axis[j];
+
+				const float length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2] + next[3] * next[3]);
+				if (length < 1e-6f) break;
+				for (unsigned int i = 0; i < 4; i++) axis[i] = next[i] / length;
+			}
+
+			float minT = FLT_MAX, maxT = -FLT_MAX;
+			for (unsigned int p = 0; p < 16; p++)
+			{
+				float t = 0.0f;
+				for (unsigned int c = 0; c < 4; c++) t += (block[p * 4 + c] - mean[c]) * axis[c];
+				minT = MIN(minT, t);
+				maxT = MAX(maxT, t);
+			}
+
+			float c0[4], c1[4];
+			for (unsigned int c = 0; c < 4; c++)
+			{
+				c0[c] = CLAMP(mean[c] + axis[c] * minT, 0.0f, 255.0f);
+				c1[c] = CLAMP(mean[c] + axis[c] * maxT, 0.0f, 255.0f);
+			}
+
+			BC7Endpoint e0 = QuantizeEndpoint(c0);
+			BC7Endpoint e1 = QuantizeEndpoint(c1);
+			unsigned int indices[16];
+			unsigned int error = FindIndices(block, e0, e1, indices);
+
+			for (unsigned int iteration = 0; iteration < 2 && error > 0; iteration++)
+			{
+				if (!RefineEndpoints(block, indices, c0, c1)) break;
+
+				const BC7Endpoint refined0 = QuantizeEndpoint(c0);
+				const BC7Endpoint refined1 = QuantizeEndpoint(c1);
+				unsigned int refinedIndices[16];
+				const unsigned int refinedError = FindIndices(block, refined0, refined1, refinedIndices);
+				if (refinedError >= error) break;
+
+				e0 = refined0;
+				e1 = refined1;
+				error = refinedError;
+				memcpy(indices, refinedIndices, sizeof(indices));
+			}
+
+			// Highest bit of the anchor index is implicit zero
+			if (indices[0] & 8)
+			{
+				std::swap(e0, e1);
+				for (unsigned int& index : indices) index = 15 - index;
+			}
+
+			memset(dest, 0, 16);
+			BlockWriter writer{ dest };
+			writer.Write(1 << 6, 7);
+			for (unsigned int c = 0; c < 4; c++)
+			{
+				writer.Write(e0.Value[c], 7);
+				writer.Write(e1.Value[c], 7);
+			}
+			writer.Write(e0.PBit, 1);
+			writer.Write(e1.PBit, 1);
+			writer.Write(indices[0], 3);
+			for (unsigned int p = 1; p < 16; p++) writer.Write(indices[p], 4);
+		}
+
+		void EncodeBlock(TextureFormat format, const unsigned char block[64], unsigned char* dest)
+		{
+			switch (format)
+			{
+			case TextureFormat::BC1_UNORM:
+				stb_compress_dxt_block(dest, block, 0, STB_DXT_HIGHQUAL);
+				break;
+			case TextureFormat::BC3_UNORM:
+				stb_compress_dxt_block(dest, block, 1, STB_DXT_HIGHQUAL);
+				break;
+			case TextureFormat::BC5_UNORM:
+			{
+				unsigned char rg[32];
+				for (unsigned int p = 0; p < 16; p++)
+				{
+					rg[p * 2 + 0] = block[p * 4 + 0];
+					rg[p * 2 + 1] = block[p * 4 + 1];
+				}
+				stb_compress_bc5_block(dest, rg);
+				break;
+			}
+			case TextureFormat::BC7_UNORM:
+				EncodeBC7Block(dest, block);
+				break;
+			default: NOT_IMPLEMENTED;
+			}
+		}
+	}
+
+	///////////////////////////////////////
+	//			TextureMipChain			//
+	/////////////////////////////////////
+
+	void TextureMipChain::Allocate(TextureFormat format, unsigned int width, unsigned int height, unsigned int numMips)
+	{
+		m_Format = format;
+		m_Levels.resize(numMips);
+
+		size_t offset = 0;
+		for (unsigned int i = 0; i < numMips; i++)
+		{
+			m_Levels[i] = { width, height, offset };
+			offset += (size_t) ::GP::GetRowPitch(format, width) * ::GP::GetNumRows(format, height);
+			width = MAX(1u, width / 2);
+			height = MAX(1u, height / 2);
+		}
+		m_Data.resize(offset);
+	}
+
+	void TextureMipChain::CopyFrom(MipChain& chain)
+	{
+		const MipLevel& topLevel = chain.GetLevel(0);
+		Allocate(TextureFormat::RGBA8_UNORM, topLevel.Width, topLevel.Height, chain.GetNumMips());
+		memcpy(m_Data.data(), chain.GetLevelData(0), chain.GetByteSize());
+	}
+
+	///////////////////////////////////////
+	//			TextureCompressor		//
+	/////////////////////////////////////
+
+	namespace TextureCompressor
+	{
+		unsigned int GetBlockByteSize(TextureFormat format)
+		{
+			switch (format)
+			{
+			case TextureFormat::BC1_UNORM: return 8;
+			case TextureFormat::BC3_UNORM: return 16;
+			case TextureFormat::BC5_UNORM: return 16;
+			case TextureFormat::BC7_UNORM: return 16;
+			default: NOT_IMPLEMENTED;
+			}
+			return 0;
+		}
+
+		TextureFormat SelectFormat(TextureCompression compression, MipChain& source)
+		{
+			switch (compression)
+			{
+			case TextureCompression::BC1: return TextureFormat::BC1_UNORM;
+			case TextureCompression::BC3: return TextureFormat::BC3_UNORM;
+			case TextureCompression::BC5: return TextureFormat::BC5_UNORM;
+			case TextureCompression::BC7: return TextureFormat::BC7_UNORM;
+			case TextureCompression::Auto:
+			{
+				const MipLevel& level = source.GetLevel(0);
+				const unsigned char* data = source.GetLevelData(0);
+				const size_t numPixels = (size_t) level.Width * level.Height;
+				for (size_t i = 0; i < numPixels; i++)
+				{
+					if (data[i * 4 + 3] != 0xff) return TextureFormat::BC3_UNORM;
+				}
+				return TextureFormat::BC1_UNORM;
+			}
+			default: NOT_IMPLEMENTED;
+			}
+			return TextureFormat::UNKNOWN;
+		}
+
+		void Compress(MipChain& source, TextureFormat format, TextureMipChain& result)
+		{
+			Timer timer;
+			timer.Start();
+
+			const MipLevel& topLevel = source.GetLevel(0);
+			result.Allocate(format, topLevel.Width, topLevel.Height, source.GetNumMips());
+
+			// One job per row of blocks across the whole chain
+			struct BlockRow { unsigned int Mip; unsigned int Row; };
+			std::vector<BlockRow> jobs;
+			double numPixels = 0.0;
+			for (unsigned int mip = 0; mip < result.GetNumMips(); mip++)
+			{
+				for (unsigned int row = 0; row < result.GetNumRows(mip); row++) jobs.push_back({ mip, row });
+				numPixels += (double) source.GetLevel(mip).Width * source.GetLevel(mip).Height;
+			}
+
+			const unsigned int blockSize = GetBlockByteSize(format);
+			ThreadUtil::ParallelFor((unsigned int) jobs.size(), [&](unsigned int jobIndex)
+			{
+				const BlockRow& job = jobs[jobIndex];
+				const MipLevel& level = source.GetLevel(job.Mip);
+				const unsigned char* src = source.GetLevelData(job.Mip);
+				unsigned char* dst = result.GetLevelData(job.Mip) + (size_t) job.Row * result.GetRowPitch(job.Mip);
+
+				unsigned char block[64];
+				const unsigned int numBlocks = (level.Width + 3) / 4;
+				for (unsigned int blockX = 0; blockX < numBlocks; blockX++)
+				{
+					FetchBlock(src, level.Width, level.Height, blockX, job.Row, block);
+					EncodeBlock(format, block, dst + blockX * blockSize);
+				}
+			});
+
+			timer.Stop();
+
+			std::lock_guard<std::mutex> lock(s_StatsMutex);
+			FormatStats& stats = s_Stats[GetStatsIndex(format)];
+			stats.NumEncoded++;
+			stats.EncodedPixels += numPixels;
+			stats.EncodeTimeMS += timer.GetTimeMS();
+		}
+
+		void RecordLoadedTexture(const TextureMipChain& chain)
+		{
+			if (!IsBlockCompressed(chain.GetFormat())) return;
+
+			std::lock_guard<std::mutex> lock(s_StatsMutex);
+			FormatStats& stats = s_Stats[GetStatsIndex(chain.GetFormat())];
+			stats.NumLoaded++;
+			stats.UncompressedBytes += GetUncompressedByteSize(chain);
+			stats.CompressedBytes += chain.GetByteSize();
+		}
+
+		void LogStats()
+		{
+			const TextureFormat formats[] = { TextureFormat::BC1_UNORM, TextureFormat::BC3_UNORM, TextureFormat::BC5_UNORM, TextureFormat::BC7_UNORM };
+
+			std::lock_guard<std::mutex> lock(s_StatsMutex);
+			for (TextureFormat format : formats)
+			{
+				const FormatStats& stats = s_Stats[GetStatsIndex(format)];
+				if (stats.NumLoaded == 0 && stats.NumEncoded == 0) continue;
+
+				std::string message = "[TextureCompressor] " + std::string(ToString(format)) + ": " + std::to_string(stats.NumLoaded) + " textures, ";
+				message += ToMB(stats.UncompressedBytes) + " -> " + ToMB(stats.CompressedBytes) + ", saved " + ToMB(stats.UncompressedBytes - stats.CompressedBytes);
+				if (stats.EncodeTimeMS > 0.0f)
+				{
+					const double mpixelsPerSecond = stats.EncodedPixels / 1000000.0 / (stats.EncodeTimeMS / 1000.0);
+					message += ", encode " + std::to_string(mpixelsPerSecond) + " Mpixels/s";
+				}
+				CONSOLE_LOG(message);
+			}
+		}
+
+		void RunBenchmark(unsigned int width, unsigned int height)
+		{
+			std::vector<unsigned char> image((size_t) width * height * 4);
+			unsigned int seed = 1;
+			for (unsigned int y = 0; y < height; y++)
+			{
+				for (unsigned int x = 0; x < width; x++)
+				{
+					// Gradients with some noise, closer to real textures than pure noise
+					seed = seed * 1664525u + 1013904223u;
+					unsigned char* texel = image.data() + ((size_t) y * width + x) * 4;
+					texel[0] = (unsigned char) ((x * 255 / width + (seed >> 28)) & 0xff);
+					texel[1] = (unsigned char) ((y * 255 / height + (seed >> 27 & 0xf)) & 0xff);
+					texel[2] = (unsigned char) (((x + y) * 127 / width) & 0xff);
+					texel[3] = (unsigned char) (seed >> 24);
+				}
+			}
+
+			MipChain source;
+			MipGenerator::Generate(image.data(), width, height, 1, {}, source);
+
+			const TextureFormat formats[] = { TextureFormat::BC1_UNORM, TextureFormat::BC3_UNORM, TextureFormat::BC5_UNORM, TextureFormat::BC7_UNORM };
+			TextureMipChain result;
+			for (TextureFormat format : formats)
+			{
+				Timer timer;
+				timer.Start();
+				Compress(source, format, result);
+				timer.Stop();
+
+				const float mpixelsPerSecond = (float) width * height / 1000000.0f / (timer.GetTimeMS() / 1000.0f);
+				CONSOLE_LOG("[TextureCompressor] " + std::string(ToString(format)) + ": " + std::to_string(mpixelsPerSecond) + " Mpixels/s");
+			}
+		}
+	}
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "Common.h"
+#include "gfx/GfxTexture.h"
+
+#include <vector>
+
+namespace GP
+{
+	// Ready to upload mip levels of any texture format stored in one continuous block
+	class TextureMipChain
+	{
+	public:
+		void Allocate(TextureFormat format, unsigned int width, unsigned int height, unsigned int numMips);
+		void CopyFrom(MipChain& chain);
+
+		inline TextureFormat GetFormat() const { return m_Format; }
+		inline unsigned int GetNumMips() const { return (unsigned int) m_Levels.size(); }
+		inline const MipLevel& GetLevel(unsigned int mip) const { return m_Levels[mip]; }
+		inline unsigned char* GetLevelData(unsigned int mip) { return m_Data.data() + m_Levels[mip].Offset; }
+		inline unsigned char* GetData() { return m_Data.data(); }
+		inline const unsigned char* GetData() const { return m_Data.data(); }
+		inline size_t GetByteSize() const { return m_Data.size(); }
+
+		inline unsigned int GetRowPitch(unsigned int mip) const { return ::GP::GetRowPitch(m_Format, m_Levels[mip].Width); }
+		inline unsigned int GetNumRows(unsigned int mip) const { return ::GP::GetNumRows(m_Format, m_Levels[mip].Height); }
+
+	private:
+		TextureFormat m_Format = TextureFormat::UNKNOWN;
+		std::vector<unsigned char> m_Data;
+		std::vector<MipLevel> m_Levels;
+	};
+
+	namespace TextureCompressor
+	{
+		// D3D11 requires the top level of a block compressed texture to be a multiple of 4
+		inline bool CanCompress(unsigned int width, unsigned int height) { return width % 4 == 0 && height % 4 == 0; }
+
+		unsigned int GetBlockByteSize(TextureFormat format);
+
+		// Resolves TextureCompression::Auto by looking for alpha in the top mip
+		TextureFormat SelectFormat(TextureCompression compression, MipChain& source);
+
+		// Encodes every mip of the source, blocks are encoded in parallel
+		void Compress(MipChain& source, TextureFormat format, TextureMipChain& result);
+
+		// Tracks memory saved by compression of loaded textures
+		void RecordLoadedTexture(const TextureMipChain& chain);
+
+		GP_DLL void LogStats();
+
+		// Logs encode Mpixels/s for every format to the console
+		GP_DLL void RunBenchmark(unsigned int width = 1024, unsigned int height = 1024);
+	}
+}
@@ -0,0 +1,341 @@
+#include "GfxTextureContainer.h"
+
+#include <windows.h>
+#include <d3d11_1.h>
+#include <cstring>
+#include <algorithm>
+
+namespace GP
+{
+	namespace
+	{
+		///////////////////////////////////////
+		//			DDS						//
+		/////////////////////////////////////
+
+		static constexpr unsigned int DDS_MAGIC = 0x20534444; // "DDS "
+		static constexpr unsigned int DDS_FOURCC = 0x4;
+		static constexpr unsigned int DDS_RGB = 0x40;
+		static constexpr unsigned int DDS_CAPS2_CUBEMAP = 0x200;
+		static constexpr unsigned int DDS_CAPS2_VOLUME = 0x200000;
+		static constexpr unsigned int DDS_RESOURCE_DIMENSION_TEXTURE2D = 3;
+		static constexpr unsigned int DDS_RESOURCE_MISC_TEXTURECUBE = 0x4;
+
+		constexpr unsigned int MakeFourCC(char a, char b, char c, char d)
+		{
+			return (unsigned int) a | ((unsigned int) b << 8) | ((unsigned int) c << 16) | ((unsigned int) d << 24);
+		}
+
+		struct DDSPixelFormat
+		{
+			unsigned int Size;
+			unsigned int Flags;
+			unsigned int FourCC;
+			unsigned int RGBBitCount;
+			unsigned int RBitMask;
+			unsigned int GBitMask;
+			unsigned int BBitMask;
+			unsigned int ABitMask;
+		};
+
+		struct DDSHeader
+		{
+			unsigned int Size;
+			unsigned int Flags;
+			unsigned int Height;
+			unsigned int Width;
+			unsigned int PitchOrLinearSize;
+			unsigned int Depth;
+			unsigned int MipMapCount;
+			unsigned int Reserved1[11];
+			DDSPixelFormat PixelFormat;
+			unsigned int Caps;
+			unsigned int Caps2;
+			unsigned int Caps3;
+			unsigned int Caps4;
+			unsigned int Reserved2;
+		};
+
+		struct DDSHeaderDX10
+		{
+			unsigned int DXGIFormat;
+			unsigned int ResourceDimension;
+			unsigned int MiscFlag;
+			unsigned int ArraySize;
+			unsigned int MiscFlags2;
+		};
+
+		// Formats are loaded as UNORM like the rest of the textures
+		TextureFormat FromDXGIFormat(unsigned int format)
+		{
+			switch (format)
+			{
+			case DXGI_FORMAT_R8G8B8A8_UNORM: case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB: return TextureFormat::RGBA8_UNORM;
+			case DXGI_FORMAT_R32G32B32A32_FLOAT: return TextureFormat::RGBA_FLOAT;
+			case DXGI_FORMAT_BC1_UNORM: case DXGI_FORMAT_BC1_UNORM_SRGB: return TextureFormat::BC1_UNORM;
+			case DXGI_FORMAT_BC3_UNORM: case DXGI_FORMAT_BC3_UNORM_SRGB: return TextureFormat::BC3_UNORM;
+			case DXGI_FORMAT_BC5_UNORM: return TextureFormat::BC5_UNORM;
+			case DXGI_FORMAT_BC7_UNORM: case DXGI_FORMAT_BC7_UNORM_SRGB: return TextureFormat::BC7_UNORM;
+			}
+			return TextureFormat::UNKNOWN;
+		}
+
+		TextureFormat FromDDSPixelFormat(const DDSPixelFormat& pixelFormat)
+		{
+			if (pixelFormat.Flags & DDS_FOURCC)
+			{
+				switch (pixelFormat.FourCC)
+				{
+				case MakeFourCC('D', 'X', 'T', '1'): return TextureFormat::BC1_UNORM;
+				case MakeFourCC('D', 'X', 'T', '5'): return TextureFormat::BC3_UNORM;
+				case MakeFourCC('A', 'T', 'I', '2'): case MakeFourCC('B', 'C', '5', 'U'): return TextureFormat::BC5_UNORM;
+				case 116: return TextureFormat::RGBA_FLOAT; // D3DFMT_A32B32G32R32F
+				}
+			}
+			else if (pixelFormat.Flags & DDS_RGB && pixelFormat.RGBBitCount == 32 && pixelFormat.RBitMask == 0x000000ff && pixelFormat.GBitMask == 0x0000ff00 && pixelFormat.BBitMask == 0x00ff0000)
+			{
+				return TextureFormat::RGBA8_UNORM;
+			}
+			return TextureFormat::UNKNOWN;
+		}
+
+		///////////////////////////////////////
+		//			KTX2					//
+		/////////////////////////////////////
+
+		static constexpr unsigned char KTX2_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+		struct KTX2Header
+		{
+			unsigned char Identifier[12];
+			unsigned int VkFormat;
+			unsigned int TypeSize;
+			unsigned int PixelWidth;
+			unsigned int PixelHeight;
+			unsigned int PixelDepth;
+			unsigned int LayerCount;
+			unsigned int FaceCount;
+			unsigned int LevelCount;
+			unsigned int SupercompressionScheme;
+
+			unsigned int DFDByteOffset;
+			unsigned int DFDByteLength;
+			unsigned int KVDByteOffset;
+			unsigned int KVDByteLength;
+			unsigned long long SGDByteOffset;
+			unsigned long long SGDByteLength;
+		};
+
+		struct KTX2LevelIndex
+		{
+			unsigned long long ByteOffset;
+			unsigned long long ByteLength;
+			unsigned long long UncompressedByteLength;
+		};
+
+		TextureFormat FromVkFormat(unsigned int format)
+		{
+			switch (format)
+			{
+			case 37: case 43: return TextureFormat::RGBA8_UNORM;				// VK_FORMAT_R8G8B8A8_UNORM, _SRGB
+			case 109: return TextureFormat::RGBA_FLOAT;						// VK_FORMAT_R32G32B32A32_SFLOAT
+			case 131: case 132: case 133: case 134: return TextureFormat::BC1_UNORM;	// VK_FORMAT_BC1_RGB(A)_UNORM_BLOCK, _SRGB_BLOCK
+			case 137: case 138: return TextureFormat::BC3_UNORM;				// VK_FORMAT_BC3_UNORM_BLOCK, _SRGB_BLOCK
+			case 141: return TextureFormat::BC5_UNORM;						// VK_FORMAT_BC5_UNORM_BLOCK
+			case 145: case 146: return TextureFormat::BC7_UNORM;				// VK_FORMAT_BC7_UNORM_BLOCK, _SRGB_BLOCK
+			}
+			return TextureFormat::UNKNOWN;
+		}
+
+		// D3D11 limits, also keep every size computed from the header far from overflowing
+		static constexpr unsigned int MAX_DIMENSION = D3D11_REQ_TEXTURE2D_U_OR_V_DIMENSION;
+		static constexpr unsigned int MAX_ARRAY_SIZE = D3D11_REQ_TEXTURE2D_ARRAY_AXIS_DIMENSION;
+
+		unsigned int GetFullMipChainLength(unsigned int width, unsigned int height)
+		{
+			unsigned int numMips = 1;
+			for (unsigned int size = MAX(width, height); size > 1; size >>= 1) numMips++;
+			return numMips;
+		}
+
+		size_t GetSubresourceSize(TextureFormat format, unsigned int width, unsigned int height, unsigned int mip)
+		{
+			const unsigned int mipWidth = MAX(1u, width >> mip);
+			const unsigned int mipHeight = MAX(1u, height >> mip);
+			return (size_t) GetRowPitch(format, mipWidth) * GetNumRows(format, mipHeight);
+		}
+	}
+
+	bool TextureContainer::IsContainerPath(const std::string& path)
+	{
+		const size_t extensionStart = path.find_last_of('.');
+		if (extensionStart == std::string::npos) return false;
+
+		std::string extension = path.substr(extensionStart + 1);
+		std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return (char) tolower(c); });
+		return extension == "dds" || extension == "ktx2";
+	}
+
+	bool TextureContainer::Open(const std::string& path)
+	{
+		Close();
+
+		HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			CONSOLE_LOG("[TextureContainer] Failed to open file: " + path);
+			return false;
+		}
+		m_File = file;
+
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+		{
+			CONSOLE_LOG("[TextureContainer] File is empty: " + path);
+			Close();
+			return false;
+		}
+		m_Size = (size_t) fileSize.QuadPart;
+
+		m_Mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		m_Data = m_Mapping ? (const unsigned char*) MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+		if (!m_Data)
+		{
+			CONSOLE_LOG("[TextureContainer] Failed to map file: " + path);
+			Close();
+			return false;
+		}
+
+		const bool isKTX2 = m_Size >= sizeof(KTX2_IDENTIFIER) && memcmp(m_Data, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) == 0;
+		if (!(isKTX2 ? ParseKTX2() : ParseDDS()))
+		{
+			CONSOLE_LOG("[TextureContainer] Unsupported or corrupted texture file: " + path);
+			Close();
+			return false;
+		}
+		return true;
+	}
+
+	void TextureContainer::Close()
+	{
+		if (m_Data) UnmapViewOfFile(m_Data);
+		if (m_Mapping) CloseHandle(m_Mapping);
+		if (m_File) CloseHandle(m_File);
+
+		m_Data = nullptr;
+		m_Mapping = nullptr;
+		m_File = nullptr;
+		m_Size = 0;
+		m_Subresources.clear();
+	}
+
+	bool TextureContainer::ParseDDS()
+	{
+		const size_t headerSize = sizeof(unsigned int) + sizeof(DDSHeader);
+		if (m_Size < headerSize || *(const unsigned int*) m_Data != DDS_MAGIC) return false;
+
+		const DDSHeader& header = *(const DDSHeader*)(m_Data + sizeof(unsigned int));
+		if (header.Size != sizeof(DDSHeader) || header.Caps2 & DDS_CAPS2_VOLUME) return false;
+
+		unsigned long long offset = headerSize;
+		m_Width = header.Width;
+		m_Height = header.Height;
+		m_NumMips = MAX(1u, header.MipMapCount);
+
+		if (header.PixelFormat.Flags & DDS_FOURCC && header.PixelFormat.FourCC == MakeFourCC('D', 'X', '1', '0'))
+		{
+			if (m_Size < offset + sizeof(DDSHeaderDX10)) return false;
+
+			const DDSHeaderDX10& headerDX10 = *(const DDSHeaderDX10*)(m_Data + offset);
+			offset += sizeof(DDSHeaderDX10);
+			if (headerDX10.ResourceDimension != DDS_RESOURCE_DIMENSION_TEXTURE2D) return false;
+
+			m_Format = FromDXGIFormat(headerDX10.DXGIFormat);
+			const unsigned int numElements = MAX(1u, headerDX10.ArraySize);
+			if (numElements > MAX_ARRAY_SIZE) return false;
+			m_Cubemap = (headerDX10.MiscFlag & DDS_RESOURCE_MISC_TEXTURECUBE) != 0;
+			m_ArraySize = numElements * (m_Cubemap ? 6 : 1);
+		}
+		else
+		{
+			m_Format = FromDDSPixelFormat(header.PixelFormat);
+			m_Cubemap = (header.Caps2 & DDS_CAPS2_CUBEMAP) != 0;
+			m_ArraySize = m_Cubemap ? 6 : 1;
+		}
+
+		if (!ValidateLayout()) return false;
+
+		// Every array slice is stored with its full mip chain
+		m_Subresources.resize(m_NumMips * m_ArraySize);
+		for (unsigned int slice = 0; slice < m_ArraySize; slice++)
+		{
+			for (unsigned int mip = 0; mip < m_NumMips; mip++)
+			{
+				if (!SetSubresource(offset, mip, slice)) return false;
+				offset += GetSubresourceSize(m_Format, m_Width, m_Height, mip);
+			}
+		}
+		return true;
+	}
+
+	bool TextureContainer::ParseKTX2()
+	{
+		if (m_Size < sizeof(KTX2Header)) return false;
+
+		const KTX2Header& header = *(const KTX2Header*) m_Data;
+		if (header.SupercompressionScheme != 0 || header.PixelDepth > 1 || (header.FaceCount != 1 && header.FaceCount != 6)) return false;
+
+		m_Format = FromVkFormat(header.VkFormat);
+		m_Width = header.PixelWidth;
+		m_Height = header.PixelHeight;
+		m_NumMips = MAX(1u, header.LevelCount);
+		const unsigned int numLayers = MAX(1u, header.LayerCount);
+		if (numLayers > MAX_ARRAY_SIZE) return false;
+		m_Cubemap = header.FaceCount == 6;
+		m_ArraySize = numLayers * header.FaceCount;
+
+		if (!ValidateLayout()) return false;
+		if (m_Size < sizeof(KTX2Header) + (unsigned long long) m_NumMips * sizeof(KTX2LevelIndex)) return false;
+
+		// Every level stores images of all layers and faces, level 0 is the most detailed one
+		const KTX2LevelIndex* levels = (const KTX2LevelIndex*)(m_Data + sizeof(KTX2Header));
+		m_Subresources.resize(m_NumMips * m_ArraySize);
+		for (unsigned int mip = 0; mip < m_NumMips; mip++)
+		{
+			// Level has to lie inside the file, then no offset inside it can overflow
+			const KTX2LevelIndex& level = levels[mip];
+			if (level.ByteOffset > m_Size || level.ByteLength > m_Size - level.ByteOffset) return false;
+
+			const unsigned long long imageSize = GetSubresourceSize(m_Format, m_Width, m_Height, mip);
+			if (level.ByteLength < imageSize * m_ArraySize) return false;
+
+			for (unsigned int slice = 0; slice < m_ArraySize; slice++)
+			{
+				if (!SetSubresource(level.ByteOffset + slice * imageSize, mip, slice)) return false;
+			}
+		}
+		return true;
+	}
+
+	bool TextureContainer::ValidateLayout() const
+	{
+		if (m_Format == TextureFormat::UNKNOWN) return false;
+		if (m_Width == 0 || m_Height == 0 || m_Width > MAX_DIMENSION || m_Height > MAX_DIMENSION) return false;
+		if (m_ArraySize == 0 || m_ArraySize > MAX_ARRAY_SIZE * 6) return false;
+		return m_NumMips <= GetFullMipChainLength(m_Width, m_Height);
+	}
+
+	bool TextureContainer::SetSubresource(unsigned long long offset, unsigned int mip, unsigned int slice)
+	{
+		const unsigned int mipWidth = MAX(1u, m_Width >> mip);
+		const unsigned int mipHeight = MAX(1u, m_Height >> mip);
+
+		TextureSubresource& subresource = m_Subresources[mip + slice * m_NumMips];
+		subresource.RowPitch = GetRowPitch(m_Format, mipWidth);
+		subresource.SlicePitch = subresource.RowPitch * GetNumRows(m_Format, mipHeight);
+		if (offset > m_Size || subresource.SlicePitch > m_Size - offset) return false;
+
+		subresource.Data = m_Data + (size_t) offset;
+		return true;
+	}
+}
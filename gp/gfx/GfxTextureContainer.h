@@ -0,0 +1,64 @@
+#pragma once
+
+#include "Common.h"
+#include "gfx/GfxTexture.h"
+
+#include <string>
+#include <vector>
+
+namespace GP
+{
+	struct TextureSubresource
+	{
+		const void* Data = nullptr;
+		unsigned int RowPitch = 0;
+		unsigned int SlicePitch = 0;
+	};
+
+	// DDS or KTX2 file mapped into memory, subresources point directly into the mapped file
+	class TextureContainer
+	{
+		DELETE_COPY_CONSTRUCTOR(TextureContainer);
+	public:
+		static bool IsContainerPath(const std::string& path);
+
+		TextureContainer() {}
+		~TextureContainer() { Close(); }
+
+		bool Open(const std::string& path);
+		void Close();
+
+		inline TextureFormat GetFormat() const { return m_Format; }
+		inline unsigned int GetWidth() const { return m_Width; }
+		inline unsigned int GetHeight() const { return m_Height; }
+		inline unsigned int GetNumMips() const { return m_NumMips; }
+		inline unsigned int GetArraySize() const { return m_ArraySize; }
+		inline bool IsCubemap() const { return m_Cubemap; }
+
+		// Subresources are ordered by mips first, then by array slices, same as in D3D11
+		inline const TextureSubresource& GetSubresource(unsigned int mip, unsigned int slice) const { return m_Subresources[mip + slice * m_NumMips]; }
+
+	private:
+		bool ParseDDS();
+		bool ParseKTX2();
+
+		// Returns false if the subresource is not inside of the file
+		// Rejects dimensions, mip counts and array sizes D3D11 can't create before anything is sized from them
+		bool ValidateLayout() const;
+		bool SetSubresource(unsigned long long offset, unsigned int mip, unsigned int slice);
+
+	private:
+		void* m_File = nullptr;
+		void* m_Mapping = nullptr;
+		const unsigned char* m_Data = nullptr;
+		size_t m_Size = 0;
+
+		TextureFormat m_Format = TextureFormat::UNKNOWN;
+		unsigned int m_Width = 0;
+		unsigned int m_Height = 0;
+		unsigned int m_NumMips = 0;
+		unsigned int m_ArraySize = 0;
+		bool m_Cubemap = false;
+		std::vector<TextureSubresource> m_Subresources;
+	};
+}
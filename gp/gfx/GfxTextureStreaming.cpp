@@ -0,0 +1,377 @@
+#include "GfxTextureStreaming.h"
+
+#include <d3d11_1.h>
+#include <mutex>
+#include <cmath>
+#include <algorithm>
+
+#include "core/Loading.h"
+#include "gfx/GfxDevice.h"
+#include "gfx/GfxResourceHelpers.h"
+#include "gfx/GfxTextureCompressor.h"
+#include "gfx/GfxTextureCache.h"
+#include "debug/LoadingTelemetry.h"
+
+namespace GP
+{
+	DXGI_FORMAT ToDXGIFormat(TextureFormat format);
+
+	struct StreamedTexture
+	{
+		TextureResource2D* Resource = nullptr; // Null once the texture is deleted while a load is pending
+		TextureCache::Key CacheKey = 0;
+		TextureFormat Format = TextureFormat::UNKNOWN;
+		unsigned int CreationFlags = 0;
+
+		// Full mip chain
+		unsigned int Width = 0;
+		unsigned int Height = 0;
+		unsigned int NumMips = 0;
+		std::vector<size_t> ChainBytes; // Bytes of the chain starting at each mip
+
+		unsigned int ResidentMip = 0;
+		unsigned int CoarsestMip = 0;
+		unsigned int RequestedMip = 0;
+		unsigned int PendingMip = 0;
+		unsigned long long LastUsedFrame = 0;
+		bool Pending = false;
+		bool Failed = false;
+	};
+
+	namespace
+	{
+		static constexpr size_t DEFAULT_BUDGET = 512ull * 1024 * 1024;
+		static constexpr unsigned int MAX_PENDING_STREAM_INS = 4;
+
+		struct StreamingResult
+		{
+			StreamedTexture* Texture;
+			ID3D11Texture2D* Handle;
+			unsigned int FirstMip;
+		};
+
+		struct StreamingState
+		{
+			std::mutex Mutex;
+			std::vector<StreamedTexture*> Textures;
+			std::vector<StreamedTexture*> Orphans; // Deleted textures that still have a pending load
+			std::vector<StreamingResult> Results;
+			unsigned long long Frame = 1;
+			TextureStreamingStats Stats;
+
+			StreamingState() { Stats.Budget = DEFAULT_BUDGET; }
+		};
+
+		StreamingState& GetState()
+		{
+			static StreamingState state;
+			return state;
+		}
+
+		// D3D11 requires the top level of a block compressed texture to be a multiple of 4
+		bool IsValidTopMip(TextureFormat format, unsigned int width, unsigned int height, unsigned int mip)
+		{
+			if (!IsBlockCompressed(format)) return true;
+			const unsigned int mipWidth = MAX(1u, width >> mip);
+			const unsigned int mipHeight = MAX(1u, height >> mip);
+			return mipWidth % 4 == 0 && mipHeight % 4 == 0;
+		}
+
+		unsigned int ToValidTopMip(const StreamedTexture* texture, unsigned int mip)
+		{
+			while (mip > 0 && !IsValidTopMip(texture->Format, texture->Width, texture->Height, mip)) mip--;
+			return mip;
+		}
+
+		unsigned int GetWantedMip(const StreamedTexture* texture, unsigned long long lastFrame)
+		{
+			return texture->LastUsedFrame == lastFrame ? texture->RequestedMip : texture->CoarsestMip;
+		}
+
+		class TextureStreamingTask : public LoadingTask
+		{
+		public:
+			TextureStreamingTask(StreamedTexture* texture, unsigned int firstMip):
+				m_Texture(texture),
+				m_FirstMip(firstMip) {}
+
+			void Run(GfxContext* context) override
+			{
+				ID3D11Texture2D* handle = nullptr;
+
+				TextureMipChain chain;
+				ScopedMemoryTracking loadingMemory(MemoryCategory::TextureLoading);
+				bool loaded = false;
+				{
+					ScopedLoadingStage stage(LoadingStage::Read);
+					loaded = TextureCache::LoadMips(m_Texture->CacheKey, m_FirstMip, chain);
+				}
+
+				if (loaded)
+				{
+					loadingMemory.SetNumBytes(chain.GetByteSize());
+					LoadingTelemetry::AddBytesRead(chain.GetByteSize());
+
+					D3D11_SUBRESOURCE_DATA* subresourceData = (D3D11_SUBRESOURCE_DATA*)malloc(chain.GetNumMips() * sizeof(D3D11_SUBRESOURCE_DATA));
+					for (unsigned int mip = 0; mip < chain.GetNumMips(); mip++)
+					{
+						D3D11_SUBRESOURCE_DATA& data = subresourceData[mip];
+						data.pSysMem = chain.GetLevelData(mip);
+						data.SysMemPitch = chain.GetRowPitch(mip);
+						data.SysMemSlicePitch = data.SysMemPitch * chain.GetNumRows(mip);
+					}
+
+					const MipLevel& topLevel = chain.GetLevel(0);
+					const D3D11_TEXTURE2D_DESC textureDesc = FillTexture2DDescription(topLevel.Width, topLevel.Height, chain.GetNumMips(), 1, 1, ToDXGIFormat(chain.GetFormat()), m_Texture->CreationFlags);
+					{
+						ScopedLoadingStage stage(LoadingStage::Upload);
+						DX_CALL(g_Device->GetDevice()->CreateTexture2D(&textureDesc, subresourceData, &handle));
+					}
+					free(subresourceData);
+				}
+
+				StreamingState& state = GetState();
+				std::lock_guard<std::mutex> lock(state.Mutex);
+				state.Results.push_back({ m_Texture, handle, m_FirstMip });
+			}
+
+		private:
+			StreamedTexture* m_Texture;
+			unsigned int m_FirstMip;
+		};
+
+		// Must be called with state mutex locked
+		void RequestMips(StreamingState& state, StreamedTexture* texture, unsigned int firstMip)
+		{
+			texture->Pending = true;
+			texture->PendingMip = firstMip;
+			state.Stats.PendingRequests++;
+			g_LoadingThread->Submit(new TextureStreamingTask(texture, firstMip));
+		}
+
+		// Must be called with state mutex locked
+		void ApplyResults(StreamingState& state)
+		{
+			for (StreamingResult& result : state.Results)
+			{
+				StreamedTexture* texture = result.Texture;
+				texture->Pending = false;
+				state.Stats.PendingRequests--;
+
+				if (!texture->Resource)
+				{
+					SAFE_RELEASE(result.Handle);
+					state.Orphans.erase(std::find(state.Orphans.begin(), state.Orphans.end(), texture));
+					delete texture;
+					continue;
+				}
+
+				if (!result.Handle)
+				{
+					// Cache entry was evicted, texture stays at its current mips
+					CONSOLE_LOG("[TextureStreaming] Failed to stream texture mips, streaming is disabled for the texture.");
+					texture->Failed = true;
+					continue;
+				}
+
+				if (result.FirstMip < texture->ResidentMip) state.Stats.StreamedIn++;
+
+				state.Stats.ResidentBytes -= texture->ChainBytes[texture->ResidentMip];
+				state.Stats.ResidentBytes += texture->ChainBytes[result.FirstMip];
+				texture->ResidentMip = result.FirstMip;
+
+				const unsigned int width = MAX(1u, texture->Width >> result.FirstMip);
+				const unsigned int height = MAX(1u, texture->Height >> result.FirstMip);
+				texture->Resource->ReplaceHandle(result.Handle, width, height, texture->NumMips - result.FirstMip);
+			}
+			state.Results.clear();
+		}
+	}
+
+	namespace TextureStreaming
+	{
+		unsigned int GetInitialMip(TextureFormat format, unsigned int width, unsigned int height, unsigned int numMips)
+		{
+			unsigned int mip = 0;
+			while (mip + 1 < numMips && ((width >> mip) > INITIAL_MIP_SIZE || (height >> mip) > INITIAL_MIP_SIZE) && IsValidTopMip(format, width, height, mip + 1)) mip++;
+			return mip;
+		}
+
+		StreamedTexture* Register(TextureResource2D* resource, unsigned long long cacheKey, const TextureMipChain& fullChain, unsigned int residentMip)
+		{
+			StreamedTexture* texture = new StreamedTexture();
+			texture->Resource = resource;
+			texture->CacheKey = cacheKey;
+			texture->Format = fullChain.GetFormat();
+			texture->CreationFlags = resource->GetCreationFlags();
+			texture->Width = fullChain.GetLevel(0).Width;
+			texture->Height = fullChain.GetLevel(0).Height;
+			texture->NumMips = fullChain.GetNumMips();
+			texture->ResidentMip = residentMip;
+			texture->CoarsestMip = residentMip;
+			texture->RequestedMip = residentMip;
+
+			texture->ChainBytes.resize(texture->NumMips + 1, 0);
+			for (unsigned int mip = texture->NumMips; mip > 0; mip--)
+				texture->ChainBytes[mip - 1] = texture->ChainBytes[mip] + (size_t) fullChain.GetRowPitch(mip - 1) * fullChain.GetNumRows(mip - 1);
+
+			StreamingState& state = GetState();
+			std::lock_guard<std::mutex> lock(state.Mutex);
+			state.Textures.push_back(texture);
+			state.Stats.NumTextures++;
+			state.Stats.ResidentBytes += texture->ChainBytes[residentMip];
+			return texture;
+		}
+
+		void Unregister(StreamedTexture* texture)
+		{
+			StreamingState& state = GetState();
+			std::lock_guard<std::mutex> lock(state.Mutex);
+			state.Textures.erase(std::find(state.Textures.begin(), state.Textures.end(), texture));
+			state.Stats.NumTextures--;
+			state.Stats.ResidentBytes -= texture->ChainBytes[texture->ResidentMip];
+
+			texture->Resource = nullptr;
+			if (texture->Pending) state.Orphans.push_back(texture);
+			else delete texture;
+		}
+
+		void RequestScreenSize(TextureResource2D* resource, float screenSizePixels)
+		{
+			StreamedTexture* texture = resource->GetStreamedTexture();
+			if (!texture) return;
+
+			// One texel per pixel, assuming that the texture is mapped once over the object
+			const float texels = (float) MAX(texture->Width, texture->Height);
+			unsigned int mip = texture->CoarsestMip;
+			if (screenSizePixels >= texels) mip = 0;
+			else if (screenSizePixels > 0.0f) mip = MIN((unsigned int) std::log2(texels / screenSizePixels), texture->CoarsestMip);
+			mip = ToValidTopMip(texture, mip);
+
+			StreamingState& state = GetState();
+			std::lock_guard<std::mutex> lock(state.Mutex);
+			if (texture->LastUsedFrame != state.Frame)
+			{
+				texture->LastUsedFrame = state.Frame;
+				texture->RequestedMip = mip;
+			}
+			texture->RequestedMip = MIN(texture->RequestedMip, mip);
+		}
+
+		void Update()
+		{
+			StreamingState& state = GetState();
+			std::lock_guard<std::mutex> lock(state.Mutex);
+
+			ApplyResults(state);
+
+			const unsigned long long lastFrame = state.Frame;
+			state.Frame++;
+
+			// Bytes that will be resident once pending loads finish
+			size_t committedBytes = 0;
+			unsigned int pendingStreamIns = 0;
+			std::vector<StreamedTexture*> streamIns;
+			std::vector<StreamedTexture*> evictable;
+			for (StreamedTexture* texture : state.Textures)
+			{
+				if (texture->Pending)
+				{
+					committedBytes += texture->ChainBytes[texture->PendingMip];
+					if (texture->PendingMip < texture->ResidentMip) pendingStreamIns++;
+					continue;
+				}
+
+				committedBytes += texture->ChainBytes[texture->ResidentMip];
+				if (texture->Failed) continue;
+
+				const unsigned int wantedMip = GetWantedMip(texture, lastFrame);
+				if (wantedMip < texture->ResidentMip) streamIns.push_back(texture);
+				else if (wantedMip > texture->ResidentMip) evictable.push_back(texture);
+			}
+
+			// Textures that gain the most detail go first
+			std::sort(streamIns.begin(), streamIns.end(), [lastFrame](StreamedTexture* a, StreamedTexture* b) {
+				return a->ResidentMip - GetWantedMip(a, lastFrame) > b->ResidentMip - GetWantedMip(b, lastFrame);
+				});
+
+			// Least recently used textures lose their fine mips first
+			std::sort(evictable.begin(), evictable.end(), [](StreamedTexture* a, StreamedTexture* b) {
+				return a->LastUsedFrame < b->LastUsedFrame;
+				});
+
+			size_t evictIndex = 0;
+			const auto evictNext = [&]()
+			{
+				StreamedTexture* texture = evictable[evictIndex++];
+				const unsigned int wantedMip = GetWantedMip(texture, lastFrame);
+				committedBytes -= texture->ChainBytes[texture->ResidentMip] - texture->ChainBytes[wantedMip];
+				state.Stats.Evictions++;
+				RequestMips(state, texture, wantedMip);
+			};
+
+			for (StreamedTexture* texture : streamIns)
+			{
+				if (pendingStreamIns >= MAX_PENDING_STREAM_INS) break;
+
+				unsigned int mip = GetWantedMip(texture, lastFrame);
+				const auto getGrowth = [texture, &mip]() { return texture->ChainBytes[mip] - texture->ChainBytes[texture->ResidentMip]; };
+
+				while (committedBytes + getGrowth() > state.Stats.Budget && evictIndex < evictable.size()) evictNext();
+
+				// Stream in only as much as fits in the budget
+				while (mip < texture->ResidentMip && committedBytes + getGrowth() > state.Stats.Budget) mip++;
+				mip = ToValidTopMip(texture, mip);
+				if (mip >= texture->ResidentMip || committedBytes + getGrowth() > state.Stats.Budget) continue;
+
+				committedBytes += getGrowth();
+				pendingStreamIns++;
+				RequestMips(state, texture, mip);
+			}
+
+			// Budget could be lowered while nothing needs streaming in
+			while (committedBytes > state.Stats.Budget && evictIndex < evictable.size()) evictNext();
+		}
+
+		void Reset()
+		{
+			StreamingState& state = GetState();
+			std::lock_guard<std::mutex> lock(state.Mutex);
+
+			const auto hasResult = [&state](StreamedTexture* texture)
+			{
+				return std::find_if(state.Results.begin(), state.Results.end(), [texture](const StreamingResult& result) { return result.Texture == texture; }) != state.Results.end();
+			};
+
+			for (StreamedTexture* texture : state.Textures)
+			{
+				if (!texture->Pending || hasResult(texture)) continue;
+				texture->Pending = false;
+				state.Stats.PendingRequests--;
+			}
+
+			for (size_t i = 0; i < state.Orphans.size();)
+			{
+				StreamedTexture* texture = state.Orphans[i];
+				if (hasResult(texture)) { i++; continue; }
+				state.Stats.PendingRequests--;
+				state.Orphans.erase(state.Orphans.begin() + i);
+				delete texture;
+			}
+		}
+
+		void SetBudget(size_t budgetBytes)
+		{
+			StreamingState& state = GetState();
+			std::lock_guard<std::mutex> lock(state.Mutex);
+			state.Stats.Budget = budgetBytes;
+		}
+
+		TextureStreamingStats GetStats()
+		{
+			StreamingState& state = GetState();
+			std::lock_guard<std::mutex> lock(state.Mutex);
+			return state.Stats;
+		}
+	}
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "Common.h"
+#include "gfx/GfxTexture.h"
+
+namespace GP
+{
+	class TextureMipChain;
+
+	struct TextureStreamingStats
+	{
+		size_t ResidentBytes = 0;
+		size_t Budget = 0;
+		unsigned int NumTextures = 0;
+		unsigned int PendingRequests = 0;
+		unsigned int StreamedIn = 0;
+		unsigned int Evictions = 0;
+	};
+
+	// Streamed textures start with only the low mips resident, finer mips are loaded from the texture cache on the loading thread when they are requested.
+	// When resident bytes would go over the budget, fine mips of least recently used textures are dropped.
+	namespace TextureStreaming
+	{
+		// Largest size of the top mip that is resident right after load
+		static constexpr unsigned int INITIAL_MIP_SIZE = 64;
+
+		unsigned int GetInitialMip(TextureFormat format, unsigned int width, unsigned int height, unsigned int numMips);
+
+		StreamedTexture* Register(TextureResource2D* resource, unsigned long long cacheKey, const TextureMipChain& fullChain, unsigned int residentMip);
+		void Unregister(StreamedTexture* texture);
+
+		// Requests mip by the size that texture covers on the screen, should be called every frame the texture is used
+		GP_DLL void RequestScreenSize(TextureResource2D* resource, float screenSizePixels);
+
+		// Applies finished loads and schedules new ones, called once per frame on the main thread
+		void Update();
+
+		// Drops requests whose tasks were cleared from the loading thread
+		void Reset();
+
+		GP_DLL void SetBudget(size_t budgetBytes);
+		GP_DLL TextureStreamingStats GetStats();
+	}
+}
@@ -1,18 +1,32 @@
 #include "ScopedOperations.h"
 
 #include  "gfx/GfxDevice.h"
+#include  "gfx/GfxGPUProfiler.h"
 
 namespace GP
 {
-    BeginRenderPassScoped::BeginRenderPassScoped(const std::string& debugName)
+    // Passes recorded in parallel get the markers and timestamps in their own deferred context
+    BeginRenderPassScoped::BeginRenderPassScoped(const char* debugName) :
+        m_Context(g_Device->GetCurrentContext()),
+        m_GPUScope(g_GPUProfiler ? g_GPUProfiler->BeginScope(m_Context, debugName) : GPUProfiler::INVALID_SCOPE)
+    {
+#ifdef DEBUG
+        m_Context->BeginPass(debugName);
+#endif
+    }
+
+    // Timings are read a few frames later, so the name must outlive the pass
+    BeginRenderPassScoped::BeginRenderPassScoped(const std::string& debugName) :
+        BeginRenderPassScoped(Profiler::InternName(debugName))
     {
-        // Using immediate context here because this function can be called only from main thread
-        g_Device->GetImmediateContext()->BeginPass(debugName);
     }
 
     BeginRenderPassScoped::~BeginRenderPassScoped()
     {
-        g_Device->GetImmediateContext()->EndPass();
+#ifdef DEBUG
+        m_Context->EndPass();
+#endif
+        if (g_GPUProfiler) g_GPUProfiler->EndScope(m_Context, m_GPUScope);
     }
 
     RenderTargetScoped::RenderTargetScoped(GfxContext* context, GfxRenderTarget* rt, GfxRenderTarget* ds) :
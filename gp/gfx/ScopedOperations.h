@@ -1,10 +1,11 @@
 #pragma once
 
 #include "gfx/GfxCommon.h"
+#include "debug/Profiler.h"
 
 #include <string>
 
-#define GP_SCOPED_PROFILE(DebugName) ::GP::BeginRenderPassScoped JOIN(_rps, __LINE__)(DebugName)
+#define GP_SCOPED_PROFILE(DebugName) GP_SCOPED_CPU_PROFILE(DebugName); ::GP::BeginRenderPassScoped JOIN(_rps, __LINE__)(DebugName)
 #define GP_SCOPED_RT(Context, RenderTarget, DepthStencil)  ::GP::RenderTargetScoped JOIN(_rts, __LINE__)(Context, RenderTarget, DepthStencil)
 
 namespace GP
@@ -12,11 +13,17 @@ namespace GP
 	class GfxContext;
 	class GfxRenderTarget;
 
+	// Measures the pass on the GPU, debug markers are only added in debug builds
 	class BeginRenderPassScoped
 	{
 	public:
+		GP_DLL BeginRenderPassScoped(const char* debugName);
 		GP_DLL BeginRenderPassScoped(const std::string& debugName);
 		GP_DLL ~BeginRenderPassScoped();
+
+	private:
+		GfxContext* m_Context;
+		unsigned int m_GPUScope;
 	};
 
 	class RenderTargetScoped
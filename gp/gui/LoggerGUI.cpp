@@ -18,12 +18,9 @@ namespace GP
 
 	void LoggerGUI::Update(float dt)
 	{
-        std::vector<std::string>& pendingLogs = Logger::Get()->m_PendingConsoleLogs;
-        for (const std::string& line : pendingLogs)
-        {
-            AddLine(line + "\n");
-        }
-        pendingLogs.clear();
+        // Shader and texture threads log too
+        const auto addLine = [this](const std::string& line) { AddLine(line + "\n"); };
+        Logger::Get()->m_PendingConsoleLogs.ForEachAndClear(addLine);
 	}
 
 	void LoggerGUI::Render()
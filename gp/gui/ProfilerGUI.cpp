@@ -4,9 +4,86 @@
 
 #include "Common.h"
 #include "core/GlobalVariables.h"
+#include "gfx/GfxShader.h"
+#include "gfx/GfxShaderCache.h"
+#include "gfx/GfxTextureStreaming.h"
+#include "gfx/GfxFrameGraph.h"
+#include "gfx/GfxRenderTargetPool.h"
+#include "gfx/GfxGPUProfiler.h"
+#include "gfx/GfxMipGenerator.h"
+#include "gfx/GfxTextureCompressor.h"
+#include "debug/Profiler.h"
+#include "debug/FrameCounters.h"
+#include "debug/FrameTimes.h"
+#include "debug/MemoryTracker.h"
+#include "debug/LoadingTelemetry.h"
 
 namespace GP
 {
+	namespace
+	{
+		void RenderProfileNode(const std::vector<ProfileNode>& nodes, unsigned int index)
+		{
+			const ProfileNode& node = nodes[index];
+			if (node.Calls == 0) return;
+
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			const ImGuiTreeNodeFlags flags = ImGuiTreeNodeFlags_SpanFullWidth | (node.Children.empty() ? ImGuiTreeNodeFlags_Leaf : ImGuiTreeNodeFlags_DefaultOpen);
+			const bool open = ImGui::TreeNodeEx((void*) (size_t) index, flags, "%s", node.Name);
+			ImGui::TableNextColumn(); ImGui::Text("%.3f", node.InclusiveMS);
+			ImGui::TableNextColumn(); ImGui::Text("%.3f", node.ExclusiveMS);
+			ImGui::TableNextColumn(); ImGui::Text("%.3f / %.3f / %.3f", node.MinMS, node.AvgMS, node.MaxMS);
+			ImGui::TableNextColumn(); ImGui::Text("%u", node.Calls);
+
+			if (!open) return;
+			for (unsigned int child : node.Children) RenderProfileNode(nodes, child);
+			ImGui::TreePop();
+		}
+
+		void RenderPercentiles(const char* name, const FrameTimeHistogram& histogram)
+		{
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn(); ImGui::Text("%s", name);
+			ImGui::TableNextColumn(); ImGui::Text("%.2f", histogram.GetPercentile(50.0f));
+			ImGui::TableNextColumn(); ImGui::Text("%.2f", histogram.GetPercentile(95.0f));
+			ImGui::TableNextColumn(); ImGui::Text("%.2f", histogram.GetPercentile(99.0f));
+			ImGui::TableNextColumn(); ImGui::Text("%.2f", histogram.GetMaxMS());
+		}
+
+		struct HistogramRange
+		{
+			const FrameTimeHistogram* Histogram;
+			unsigned int FirstBucket;
+		};
+
+		float GetHistogramBucket(void* data, int index)
+		{
+			const HistogramRange* range = (const HistogramRange*) data;
+			return (float) range->Histogram->GetBucketCount(range->FirstBucket + index);
+		}
+
+		// Buckets grow with the frame time, so the x axis is close to logarithmic
+		void RenderHistogram(const FrameTimeHistogram& histogram)
+		{
+			if (histogram.GetCount() == 0) return;
+
+			unsigned int firstBucket = FrameTimeHistogram::NUM_BUCKETS;
+			unsigned int lastBucket = 0;
+			for (unsigned int bucket = 0; bucket < FrameTimeHistogram::NUM_BUCKETS; bucket++)
+			{
+				if (histogram.GetBucketCount(bucket) == 0) continue;
+				firstBucket = MIN(firstBucket, bucket);
+				lastBucket = bucket;
+			}
+
+			HistogramRange range = { &histogram, firstBucket };
+			const float firstMS = firstBucket ? FrameTimeHistogram::GetBucketUpperMS(firstBucket - 1) : 0.0f;
+			const std::string overlay = std::to_string(firstMS) + " - " + std::to_string(FrameTimeHistogram::GetBucketUpperMS(lastBucket)) + " ms";
+			ImGui::PlotHistogram("##Frame time histogram", GetHistogramBucket, &range, lastBucket - firstBucket + 1, 0, overlay.c_str(), 0.0f, FLT_MAX, ImVec2(400.0f, 60.0f));
+		}
+	}
+
 	void ProfilerGUI::Update(float dt)
 	{
 		m_FPSLastUpdate += dt;
@@ -27,6 +104,206 @@ namespace GP
 		ImGui::SetNextWindowSize(ImVec2(0, 0));
 		ImGui::Begin("Profiler", &active);
 		ImGui::Text("FPS: %d", m_FPS);
+
+		ImGui::Separator();
+		ImGui::Text("Frame times (ms)");
+		ImGui::PlotLines("##Frame times", &FrameTimes::GetHistory()->FrameMS, FrameTimes::HISTORY_SIZE, FrameTimes::GetHistoryOffset(), "Frame", 0.0f, FLT_MAX, ImVec2(400.0f, 60.0f), sizeof(FrameTimeSample));
+		ImGui::PlotLines("##CPU times", &FrameTimes::GetHistory()->CPUMS, FrameTimes::HISTORY_SIZE, FrameTimes::GetHistoryOffset(), "CPU", 0.0f, FLT_MAX, ImVec2(400.0f, 60.0f), sizeof(FrameTimeSample));
+		if (ImGui::BeginTable("Frame times", 5, ImGuiTableFlags_SizingFixedFit | ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersInnerV))
+		{
+			ImGui::TableSetupColumn("");
+			ImGui::TableSetupColumn("P50");
+			ImGui::TableSetupColumn("P95");
+			ImGui::TableSetupColumn("P99");
+			ImGui::TableSetupColumn("Max");
+			ImGui::TableHeadersRow();
+			RenderPercentiles("Frame", FrameTimes::GetFrameHistogram());
+			RenderPercentiles("CPU", FrameTimes::GetCPUHistogram());
+			RenderPercentiles("Present", FrameTimes::GetPresentHistogram());
+			ImGui::EndTable();
+		}
+		RenderHistogram(FrameTimes::GetFrameHistogram());
+		ImGui::Text("%u frames", FrameTimes::GetFrameHistogram().GetCount());
+		ImGui::SameLine();
+		if (ImGui::Button("Reset")) FrameTimes::ResetHistograms();
+
+		float hitchThreshold = FrameTimes::GetHitchThreshold();
+		if (ImGui::SliderFloat("Hitch threshold (ms)", &hitchThreshold, 1.0f, 200.0f)) FrameTimes::SetHitchThreshold(hitchThreshold);
+		const std::vector<FrameHitch>& hitches = FrameTimes::GetHitches();
+		if (ImGui::TreeNode("Hitches", "Hitches (%u)", (unsigned int) hitches.size()))
+		{
+			for (auto it = hitches.rbegin(); it != hitches.rend(); it++) ImGui::Text("Frame %llu: %.2f ms, %s", it->Frame, it->FrameMS, it->Scopes.c_str());
+			ImGui::TreePop();
+		}
+
+		ImGui::Separator();
+		ImGui::Text("CPU scopes (ms)");
+		if (ImGui::BeginTable("CPU scopes", 5, ImGuiTableFlags_SizingFixedFit | ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersInnerV))
+		{
+			ImGui::TableSetupColumn("Scope");
+			ImGui::TableSetupColumn("Inclusive");
+			ImGui::TableSetupColumn("Exclusive");
+			ImGui::TableSetupColumn("Min / Avg / Max");
+			ImGui::TableSetupColumn("Calls");
+			ImGui::TableHeadersRow();
+
+			const std::vector<ProfileNode>& nodes = Profiler::GetNodes();
+			for (unsigned int root : Profiler::GetRoots()) RenderProfileNode(nodes, root);
+			ImGui::EndTable();
+		}
+		if (ImGui::Button("Measure scope overhead")) m_ScopeOverhead = Profiler::MeasureScopeOverhead();
+		if (m_ScopeOverhead.ScopeNS > 0.0f)
+		{
+			ImGui::SameLine();
+			ImGui::Text("%.1f ns (counter read %.1f ns)", m_ScopeOverhead.ScopeNS, m_ScopeOverhead.CounterReadNS);
+		}
+		if (Profiler::IsCapturingTrace()) ImGui::Text("Capturing trace...");
+		else if (ImGui::Button("Capture trace")) Profiler::CaptureTrace();
+
+		if (g_GPUProfiler)
+		{
+			const GPUProfilerStats& gpuStats = g_GPUProfiler->GetStats();
+			ImGui::Separator();
+			ImGui::Text("GPU passes (ms), %u frames old", gpuStats.Latency);
+			if (ImGui::BeginTable("GPU passes", 3, ImGuiTableFlags_SizingFixedFit | ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersInnerV))
+			{
+				ImGui::TableSetupColumn("Pass");
+				ImGui::TableSetupColumn("Time");
+				ImGui::TableSetupColumn("Avg");
+				ImGui::TableHeadersRow();
+				for (const GPUPassTiming& timing : g_GPUProfiler->GetTimings())
+				{
+					ImGui::TableNextRow();
+					ImGui::TableNextColumn(); ImGui::Text("%*s%s", timing.Depth * 2, "", timing.Name);
+					ImGui::TableNextColumn(); ImGui::Text("%.3f", timing.TimeMS);
+					ImGui::TableNextColumn(); ImGui::Text("%.3f", timing.AvgMS);
+				}
+				ImGui::EndTable();
+			}
+			ImGui::Text("Skipped frames: %u, disjoint: %u, dropped scopes: %u", gpuStats.SkippedFrames, gpuStats.DisjointFrames, gpuStats.DroppedScopes);
+		}
+
+		ImGui::Separator();
+		ImGui::Text("Frame counters");
+		if (ImGui::BeginTable("Frame counters", 3, ImGuiTableFlags_SizingFixedFit | ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersInnerV))
+		{
+			ImGui::TableSetupColumn("Counter");
+			ImGui::TableSetupColumn("Last frame");
+			ImGui::TableSetupColumn("Avg");
+			ImGui::TableHeadersRow();
+			for (unsigned int i = 0; i < (unsigned int) FrameCounter::Count; i++)
+			{
+				const FrameCounter counter = (FrameCounter) i;
+				ImGui::TableNextRow();
+				ImGui::TableNextColumn(); ImGui::Text("%s", FrameCounters::GetName(counter));
+				ImGui::TableNextColumn(); ImGui::Text("%u", FrameCounters::GetLastFrame(counter));
+				ImGui::TableNextColumn(); ImGui::Text("%.1f", FrameCounters::GetAverage(counter));
+			}
+			ImGui::EndTable();
+		}
+		if (FrameCounters::IsRecordingCSV()) ImGui::Text("Recording counters...");
+		else if (ImGui::Button("Export counters to CSV")) FrameCounters::RecordCSV();
+
+		const MemoryStats memoryStats = MemoryTracker::GetStats();
+		ImGui::Separator();
+		ImGui::Text("Memory");
+		ImGui::Text("GPU: %.1f MB (peak %.1f MB), CPU: %.1f MB (peak %.1f MB)", memoryStats.GPUBytes / (1024.0f * 1024.0f), memoryStats.GPUPeakBytes / (1024.0f * 1024.0f), memoryStats.CPUBytes / (1024.0f * 1024.0f), memoryStats.CPUPeakBytes / (1024.0f * 1024.0f));
+		if (ImGui::BeginTable("Memory", 4, ImGuiTableFlags_SizingFixedFit | ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersInnerV))
+		{
+			ImGui::TableSetupColumn("Category");
+			ImGui::TableSetupColumn("Allocations");
+			ImGui::TableSetupColumn("MB");
+			ImGui::TableSetupColumn("Peak MB");
+			ImGui::TableHeadersRow();
+			for (unsigned int i = 0; i < (unsigned int) MemoryCategory::Count; i++)
+			{
+				const MemoryCategory category = (MemoryCategory) i;
+				const MemoryCategoryStats& categoryStats = memoryStats.Categories[i];
+				ImGui::TableNextRow();
+				ImGui::TableNextColumn(); ImGui::Text("%s (%s)", MemoryTracker::GetName(category), MemoryTracker::IsGPU(category) ? "GPU" : "CPU");
+				ImGui::TableNextColumn(); ImGui::Text("%u", categoryStats.NumAllocations);
+				ImGui::TableNextColumn(); ImGui::Text("%.2f", categoryStats.NumBytes / (1024.0f * 1024.0f));
+				ImGui::TableNextColumn(); ImGui::Text("%.2f", categoryStats.PeakBytes / (1024.0f * 1024.0f));
+			}
+			ImGui::EndTable();
+		}
+		if (ImGui::Button("Reset peaks")) MemoryTracker::ResetPeaks();
+
+		const LoadingStats loadingStats = LoadingTelemetry::GetStats();
+		const LoadingBurst& burst = loadingStats.Busy ? loadingStats.CurrentBurst : loadingStats.LastBurst;
+		ImGui::Separator();
+		ImGui::Text("Loading");
+		ImGui::Text("%s: %.1f ms, %u tasks, %u objects", loadingStats.Busy ? "Loading" : "Last load", burst.TimeMS, burst.NumTasks, burst.ObjectsPublished);
+		ImGui::Text("Read: %.1f MB, decoded: %.1f MB (%.1f MB/s)", burst.BytesRead / (1024.0f * 1024.0f), burst.BytesDecoded / (1024.0f * 1024.0f), burst.TimeMS > 0.0f ? burst.BytesDecoded / (1024.0f * 1024.0f) / (burst.TimeMS / 1000.0f) : 0.0f);
+		ImGui::Text("Queue depth: %u (max %u)", loadingStats.QueueDepth, loadingStats.MaxQueueDepth);
+		ImGui::Text("Total: %u / %u tasks, %u objects, read %.1f MB, decoded %.1f MB", loadingStats.TasksCompleted, loadingStats.TasksSubmitted, loadingStats.ObjectsPublished, loadingStats.BytesRead / (1024.0f * 1024.0f), loadingStats.BytesDecoded / (1024.0f * 1024.0f));
+		if (ImGui::BeginTable("Loading stages", 5, ImGuiTableFlags_SizingFixedFit | ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersInnerV))
+		{
+			ImGui::TableSetupColumn("Stage");
+			ImGui::TableSetupColumn("Count");
+			ImGui::TableSetupColumn("Avg ms");
+			ImGui::TableSetupColumn("Max ms");
+			ImGui::TableSetupColumn("Total ms");
+			ImGui::TableHeadersRow();
+			for (unsigned int i = 0; i < (unsigned int) LoadingStage::Count; i++)
+			{
+				const LoadingStageStats& stageStats = loadingStats.Stages[i];
+				ImGui::TableNextRow();
+				ImGui::TableNextColumn(); ImGui::Text("%s", LoadingTelemetry::GetStageName((LoadingStage) i));
+				ImGui::TableNextColumn(); ImGui::Text("%u", stageStats.Count);
+				ImGui::TableNextColumn(); ImGui::Text("%.2f", stageStats.Count ? stageStats.TotalMS / stageStats.Count : 0.0f);
+				ImGui::TableNextColumn(); ImGui::Text("%.2f", stageStats.MaxMS);
+				ImGui::TableNextColumn(); ImGui::Text("%.1f", stageStats.TotalMS);
+			}
+			ImGui::EndTable();
+		}
+		if (ImGui::Button("Reset loading stats")) LoadingTelemetry::Reset();
+		ImGui::SameLine();
+		if (ImGui::Button("Benchmark mip generation")) MipGenerator::RunBenchmark(); // Results go to the console
+		ImGui::SameLine();
+		if (ImGui::Button("Benchmark texture compression")) TextureCompressor::RunBenchmark();
+
+		const TextureStreamingStats streamingStats = TextureStreaming::GetStats();
+		ImGui::Separator();
+		ImGui::Text("Texture streaming");
+		ImGui::Text("Resident: %.1f / %.1f MB", streamingStats.ResidentBytes / (1024.0f * 1024.0f), streamingStats.Budget / (1024.0f * 1024.0f));
+		ImGui::Text("Textures: %u", streamingStats.NumTextures);
+		ImGui::Text("Pending requests: %u", streamingStats.PendingRequests);
+		ImGui::Text("Streamed in: %u", streamingStats.StreamedIn);
+		ImGui::Text("Evictions: %u", streamingStats.Evictions);
+
+		const ShaderCacheStats shaderStats = ShaderCache::GetStats();
+		const unsigned int shaderRequests = shaderStats.Hits + shaderStats.Misses;
+		ImGui::Separator();
+		ImGui::Text("Shader cache");
+		ImGui::Text("Hit rate: %.1f%% (%u / %u)", shaderRequests ? 100.0f * shaderStats.Hits / shaderRequests : 0.0f, shaderStats.Hits, shaderRequests);
+		ImGui::Text("Compile time saved: %.1f ms", shaderStats.SavedTimeMS);
+
+		const ShaderRegistryStats registryStats = ShaderRegistry::GetStats();
+		ImGui::Text("Compiled shaders: %u (%u stage jobs)", registryStats.NumShaders, registryStats.NumStageJobs);
+		ImGui::Text("Compile wall time: %.1f ms, CPU time: %.1f ms", registryStats.WallTimeMS, registryStats.CpuTimeMS);
+		ImGui::Text("Hot reloads: %u, last latency: %.1f ms", registryStats.NumHotReloads, registryStats.LastReloadLatencyMS);
+
+		if (g_FrameGraph)
+		{
+			static bool aliasingEnabled = true;
+			const FrameGraphStats& graphStats = g_FrameGraph->GetStats();
+			ImGui::Separator();
+			ImGui::Text("Frame graph");
+			ImGui::Text("Passes: %u (%u culled)", graphStats.NumPasses, graphStats.NumCulledPasses);
+			ImGui::Text("Transient render targets: %u in %u allocations", graphStats.NumTransientResources, graphStats.NumPhysicalResources);
+			ImGui::Text("Transient memory: %.1f MB (%.1f MB without aliasing)", graphStats.TransientBytes / (1024.0f * 1024.0f), graphStats.TransientBytesWithoutAliasing / (1024.0f * 1024.0f));
+			if (ImGui::Checkbox("Aliasing", &aliasingEnabled)) g_FrameGraph->SetAliasingEnabled(aliasingEnabled);
+		}
+
+		if (g_RenderTargetPool)
+		{
+			const RenderTargetPoolStats poolStats = g_RenderTargetPool->GetStats();
+			ImGui::Separator();
+			ImGui::Text("Render target pool");
+			ImGui::Text("Targets: %u (%u in use)", poolStats.NumTargets, poolStats.NumInUse);
+			ImGui::Text("Memory: %.1f MB", poolStats.NumBytes / (1024.0f * 1024.0f));
+		}
 		ImGui::End();
 	}
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "gui/GUI.h"
+#include "debug/Profiler.h"
 
 namespace GP
 {
@@ -17,5 +18,6 @@ namespace GP
 		int m_FPSSampleCount = 0;
 		int m_FPS = 0;
 		float m_FPSLastUpdate = FPS_UPDATE_INTERVAL;
+		ScopeOverhead m_ScopeOverhead;
 	};
 }
\ No newline at end of file
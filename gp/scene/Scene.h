@@ -57,6 +57,11 @@ namespace GP
 		inline GfxVertexBuffer<Vec4>* GetTangentBuffer() const { return m_TangentBuffer; }
 		inline GfxIndexBuffer* GetIndexBuffer() const { return m_IndexBuffer; }
 
+		// Bounding sphere in object space
+		inline void SetBounds(Vec3 center, float radius) { m_BoundsCenter = center; m_BoundsRadius = radius; }
+		inline Vec3 GetBoundsCenter() const { return m_BoundsCenter; }
+		inline float GetBoundsRadius() const { return m_BoundsRadius; }
+
 	private:
 		GfxVertexBuffer<Vec3>* m_PositionBuffer;
 		GfxVertexBuffer<Vec2>* m_UVBuffer;
@@ -64,6 +69,9 @@ namespace GP
 		GfxVertexBuffer<Vec4>* m_TangentBuffer;
 
 		GfxIndexBuffer* m_IndexBuffer;
+
+		Vec3 m_BoundsCenter = VEC3_ZERO;
+		float m_BoundsRadius = 0.0f;
 	};
 
 	class SceneObject
@@ -5,12 +5,17 @@
 #pragma warning (disable : 4996)
 #define CGLTF_IMPLEMENTATION
 #include <cgltf.h>
+#include <cfloat>
 
 #include "scene/Scene.h"
 
 #include "gfx/GfxBuffers.h"
 #include "gfx/GfxTexture.h"
+#include "gfx/GfxTextureCache.h"
 #include "gfx/GfxDevice.h"
+#include "debug/Profiler.h"
+#include "debug/MemoryTracker.h"
+#include "debug/LoadingTelemetry.h"
 
 #define CGTF_CALL(X) { cgltf_result result = X; ASSERT(result == cgltf_result_success, "CGTF_CALL_FAIL") }
 
@@ -32,6 +37,7 @@ namespace GP
 
 			void* indexData = GetBufferData(indexAccessor);
 			GfxIndexBuffer* indexBuffer = new GfxIndexBuffer(indexData, indexAccessor->count, cgltf_component_size(indexAccessor->component_type));
+			indexBuffer->GetResource()->SetMemoryCategory(MemoryCategory::SceneMesh);
 			return indexBuffer;
 		}
 
@@ -40,6 +46,7 @@ namespace GP
 		{
 			void* vbData = calloc(numVertices, sizeof(T));
 			GfxVertexBuffer<T>* vb = new GfxVertexBuffer<T>(vbData, numVertices);
+			vb->GetResource()->SetMemoryCategory(MemoryCategory::SceneMesh);
 			free(vbData);
 			return vb;
 		}
@@ -52,17 +59,53 @@ namespace GP
 
 			T* attributeData = (T*)GetBufferData(vertexAttribute->data);
 			GfxVertexBuffer<T>* vertexBuffer = new GfxVertexBuffer<T>(attributeData, vertexAttribute->data->count);
+			vertexBuffer->GetResource()->SetMemoryCategory(MemoryCategory::SceneMesh);
 
 			return vertexBuffer;
 		}
+
+		void GetBounds(cgltf_accessor* positionAccessor, Vec3& center, float& radius)
+		{
+			Vec3 minPosition{ FLT_MAX };
+			Vec3 maxPosition{ -FLT_MAX };
+			if (positionAccessor->has_min && positionAccessor->has_max)
+			{
+				minPosition = Vec3(positionAccessor->min[0], positionAccessor->min[1], positionAccessor->min[2]);
+				maxPosition = Vec3(positionAccessor->max[0], positionAccessor->max[1], positionAccessor->max[2]);
+			}
+			else
+			{
+				const Vec3* positions = (Vec3*)GetBufferData(positionAccessor);
+				for (size_t i = 0; i < positionAccessor->count; i++)
+				{
+					minPosition = glm::min(minPosition, positions[i]);
+					maxPosition = glm::max(maxPosition, positions[i]);
+				}
+			}
+
+			center = (minPosition + maxPosition) * 0.5f;
+			radius = glm::length(maxPosition - minPosition) * 0.5f;
+		}
 	}
 
 	void SceneLoadingTask::LoadScene()
 	{
+		GP_SCOPED_CPU_PROFILE("SceneLoadingTask::LoadScene");
+
 		cgltf_options options = {};
 		cgltf_data* data = NULL;
-		CGTF_CALL(cgltf_parse_file(&options, m_Path.c_str(), &data));
-		CGTF_CALL(cgltf_load_buffers(&options, data, m_Path.c_str()));
+		ScopedMemoryTracking gltfMemory(MemoryCategory::SceneLoading, m_Path);
+		{
+			GP_SCOPED_CPU_PROFILE("SceneLoadingTask::ParseGLTF");
+			ScopedLoadingStage stage(LoadingStage::Read);
+			CGTF_CALL(cgltf_parse_file(&options, m_Path.c_str(), &data));
+			CGTF_CALL(cgltf_load_buffers(&options, data, m_Path.c_str()));
+		}
+
+		size_t gltfBytes = data->json_size;
+		for (size_t i = 0; i < data->buffers_count; i++) gltfBytes += data->buffers[i].size;
+		gltfMemory.SetNumBytes(gltfBytes);
+		LoadingTelemetry::AddBytesRead(gltfBytes);
 
 		std::vector<SceneObject*> sceneObjects;
 		for (size_t i = 0; i < data->meshes_count; i++)
@@ -80,16 +123,26 @@ namespace GP
 
 				if (sceneObjects.size() >= BATCH_SIZE)
 				{
-					m_Context->Submit();
-					m_Scene->AddSceneObjects(sceneObjects);
+					PublishSceneObjects(sceneObjects);
 					sceneObjects.clear();
 				}
 				
 			}
 		}
-		m_Scene->AddSceneObjects(sceneObjects);
+		PublishSceneObjects(sceneObjects);
 
 		cgltf_free(data);
+
+		TextureCompressor::LogStats();
+		TextureCache::LogStats();
+	}
+
+	void SceneLoadingTask::PublishSceneObjects(const std::vector<SceneObject*>& sceneObjects)
+	{
+		ScopedLoadingStage stage(LoadingStage::Publish);
+		m_Context->Submit();
+		m_Scene->AddSceneObjects(sceneObjects);
+		LoadingTelemetry::AddObjectsPublished((unsigned int) sceneObjects.size());
 	}
 
 	SceneObject* SceneLoadingTask::LoadSceneObject(cgltf_primitive* meshData)
@@ -102,6 +155,8 @@ namespace GP
 
 	Mesh* SceneLoadingTask::LoadMesh(cgltf_primitive* meshData)
 	{
+		GP_SCOPED_CPU_PROFILE("SceneLoadingTask::LoadMesh");
+		ScopedLoadingStage stage(LoadingStage::Decode);
 		ASSERT(meshData->type == cgltf_primitive_type_triangles, "[SceneLoading] Scene contains quad meshes. We are supporting just triangle meshes.");
 
 		GfxVertexBuffer<Vec3>* positionBuffer = nullptr;
@@ -109,6 +164,9 @@ namespace GP
 		GfxVertexBuffer<Vec3>* normalBuffer = nullptr;
 		GfxVertexBuffer<Vec4>* tangentBuffer = nullptr;
 
+		Vec3 boundsCenter = VEC3_ZERO;
+		float boundsRadius = 0.0f;
+
 		for (size_t i = 0; i < meshData->attributes_count; i++)
 		{
 			cgltf_attribute* vertexAttribute = (meshData->attributes + i);
@@ -116,6 +174,7 @@ namespace GP
 			{
 			case cgltf_attribute_type_position:
 				positionBuffer = GetVB<Vec3, cgltf_type_vec3, cgltf_component_type_r_32f>(vertexAttribute);
+				GetBounds(vertexAttribute->data, boundsCenter, boundsRadius);
 				break;
 			case cgltf_attribute_type_texcoord:
 				uvBuffer = GetVB<Vec2, cgltf_type_vec2, cgltf_component_type_r_32f>(vertexAttribute);
@@ -137,11 +196,15 @@ namespace GP
 
 		GfxIndexBuffer* indexBuffer = GetIndices(meshData->indices);
 
-		return new Mesh{ positionBuffer, uvBuffer, normalBuffer, tangentBuffer, indexBuffer };
+		Mesh* mesh = new Mesh{ positionBuffer, uvBuffer, normalBuffer, tangentBuffer, indexBuffer };
+		LoadingTelemetry::AddBytesDecoded((size_t) positionBuffer->GetResource()->GetByteSize() + uvBuffer->GetResource()->GetByteSize() + normalBuffer->GetResource()->GetByteSize() + tangentBuffer->GetResource()->GetByteSize() + indexBuffer->GetResource()->GetByteSize());
+		mesh->SetBounds(boundsCenter, boundsRadius);
+		return mesh;
 	}
 
 	Material* SceneLoadingTask::LoadMaterial(cgltf_material* materialData)
 	{
+		GP_SCOPED_CPU_PROFILE("SceneLoadingTask::LoadMaterial");
 		ASSERT(materialData->has_pbr_metallic_roughness, "[SceneLoading] Every material must have a base color texture!");
 		GfxTexture2D* diffuseTexture = nullptr;
 		const bool  isTransparent = materialData->alpha_mode == cgltf_alpha_mode_blend;
@@ -149,7 +212,14 @@ namespace GP
 		{
 			std::string imageURI = materialData->pbr_metallic_roughness.base_color_texture.texture->image->uri;
 			std::string diffuseTexturePath = m_FolderPath + "/" + imageURI;
-			diffuseTexture = new GfxTexture2D(diffuseTexturePath, MAX_MIPS);
+
+			// Keep alpha tested geometry from thinning out in lower mips
+			MipGenerationSettings mipSettings;
+			if (materialData->alpha_mode == cgltf_alpha_mode_mask) mipSettings.AlphaCoverageRef = materialData->alpha_cutoff;
+
+			diffuseTexture = new GfxTexture2D(diffuseTexturePath, MAX_MIPS, mipSettings, TextureCompression::Auto);
+			diffuseTexture->GetResource()->SetStreaming(true);
+			diffuseTexture->GetResource()->SetMemoryCategory(MemoryCategory::SceneTexture);
 			diffuseTexture->Initialize(m_Context); // Initialize on loading thread
 		}
 		else
@@ -157,6 +227,7 @@ namespace GP
 			cgltf_float* diffuseColorFloat = materialData->pbr_metallic_roughness.base_color_factor;
 			ColorUNORM diffuseColor{ Vec4(diffuseColorFloat[0],diffuseColorFloat[1],diffuseColorFloat[2],diffuseColorFloat[3]) };
 			diffuseTexture = new GfxTexture2D(1, 1);
+			diffuseTexture->GetResource()->SetMemoryCategory(MemoryCategory::SceneTexture);
 			m_Context->UploadToTexture(diffuseTexture, &diffuseColor);
 		}
 
@@ -6,6 +6,7 @@
 
 #include <string>
 #include <thread>
+#include <vector>
 
 #include "util/PathUtil.h"
 #include "core/Loading.h"
@@ -44,6 +45,7 @@ namespace GP
 
 	private:
 		void LoadScene();
+		void PublishSceneObjects(const std::vector<SceneObject*>& sceneObjects);
 		SceneObject* LoadSceneObject(cgltf_primitive* meshData);
 		Mesh* LoadMesh(cgltf_primitive* mesh);
 		Material* LoadMaterial(cgltf_material* materialData);
@@ -1,7 +1,7 @@
 // RasterizerState: BACKFACE_CCW
 // DepthState: ENABLED
 
-// TODO: Sepparate variation for USE_ALPHA_BLEND
+// Permutations: USE_ALPHA_BLEND
 
 CB_CAMERA(0);
 CB_MODEL(1);
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <string>
+
+namespace GP
+{
+    namespace HashUtil
+    {
+        static constexpr unsigned long long FNV_OFFSET_BASIS = 14695981039346656037ull;
+        static constexpr unsigned long long FNV_PRIME = 1099511628211ull;
+
+        // FNV-1a, used for content keys of on disk caches
+        inline unsigned long long HashBytes(unsigned long long hash, const void* data, size_t size)
+        {
+            const unsigned char* bytes = (const unsigned char*) data;
+            for (size_t i = 0; i < size; i++)
+            {
+                hash ^= bytes[i];
+                hash *= FNV_PRIME;
+            }
+            return hash;
+        }
+
+        inline unsigned long long HashString(unsigned long long hash, const std::string& value)
+        {
+            // Length is hashed as well so concatenated strings don't collide
+            const size_t length = value.size();
+            hash = HashBytes(hash, &length, sizeof(size_t));
+            return HashBytes(hash, value.data(), value.size());
+        }
+
+        template<typename T>
+        inline unsigned long long HashValue(unsigned long long hash, const T& value)
+        {
+            return HashBytes(hash, &value, sizeof(T));
+        }
+    }
+}
@@ -40,5 +40,17 @@ namespace GP
         {
             return string.find(param) != std::string::npos;
         }
+
+        // Quoted and escaped, control characters are dropped
+        inline std::string ToJSONString(const std::string& text)
+        {
+            std::string json = "\"";
+            for (const char c : text)
+            {
+                if (c == '"' || c == '\\') json += '\\';
+                if ((unsigned char) c >= 0x20) json += c;
+            }
+            return json + "\"";
+        }
     }
 }
\ No newline at end of file